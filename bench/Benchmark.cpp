@@ -0,0 +1,489 @@
+/** FaithfulAssetProcessorBench measures throughput of the processors and of
+ * AssetLoadingThreadPool on deterministic synthetic inputs
+ * (see SyntheticAssets.h), so results of two runs can be compared:
+ * - textures: encode/decode megapixels per second per category and size;
+ * - models: processing time of a procedural grid (including gltfpack);
+ * - audio: megabytes per second of pcm .wav;
+ * - thread pool: Execute() dispatch overhead and scaling from 1 to N threads.
+ *
+ * usage: FaithfulAssetProcessorBench <output.json> [options]
+ *   --baseline <file.json>  compare with previously saved output
+ *   --threshold <fraction>  allowed regression (0.1 by default, i.e. 10%)
+ *   --threads <N>           max thread count (all usable cpus by default)
+ *   --work-dir <dir>        where synthetic inputs & outputs are written
+ *
+ * exit code: 0 - ok, 1 - at least one metric regressed, 2 - incorrect usage
+ * */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "rapidjson/document.h"
+#include "rapidjson/istreamwrapper.h"
+#include "rapidjson/ostreamwrapper.h"
+#include "rapidjson/prettywriter.h"
+
+#include "../config/Paths.h"
+#include "../src/AssetLoadingThreadPool.h"
+#include "../src/AudioProcessor.h"
+#include "../src/BatchIo.h"
+#include "../src/CpuTopology.h"
+#include "../src/ModelProcessor.h"
+#include "../src/ReplaceRequest.h"
+#include "../src/TextureProcessor.h"
+#include "SyntheticAssets.h"
+
+namespace {
+
+/// the best of several runs is the least noisy estimation
+constexpr int kRepetitions = 3;
+constexpr int kDispatchIterations = 2000;
+constexpr double kDefaultThreshold = 0.1;
+
+constexpr int kTextureSizes[] = {256, 1024};
+constexpr int kScalingTextureSize = 1024;
+constexpr int kModelGridSizes[] = {64, 256};
+constexpr int kModelTextureSize = 256;
+constexpr int kAudioSeconds = 30;
+
+struct Metric {
+  std::string name;
+  double value;
+  std::string unit;
+  bool higher_is_better;
+};
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+/// prepare() isn't measured (e.g. removing previous output,
+/// copying input which is consumed by processor)
+template <typename Prepare, typename Body>
+double MeasureBest(Prepare prepare, Body body) {
+  double best = std::numeric_limits<double>::max();
+  for (int i = 0; i < kRepetitions; ++i) {
+    prepare();
+    auto start = std::chrono::steady_clock::now();
+    body();
+    best = std::min(best, Seconds(start));
+  }
+  return best;
+}
+
+void ResetDirectory(const std::filesystem::path& path) {
+  std::filesystem::remove_all(path);
+  std::filesystem::create_directories(path);
+}
+
+std::unique_ptr<uint8_t[]> CopyImage(const std::unique_ptr<uint8_t[]>& image,
+                                     int width, int height) {
+  std::size_t size = static_cast<std::size_t>(width) * height * 4;
+  auto copy = std::make_unique<uint8_t[]>(size);
+  std::copy_n(image.get(), size, copy.get());
+  return copy;
+}
+
+class Benchmark {
+ public:
+  Benchmark(std::filesystem::path work_dir, int thread_count)
+      : work_dir_(std::move(work_dir)),
+        input_dir_(work_dir_ / "input"),
+        output_dir_(work_dir_ / "output"),
+        thread_count_(thread_count) {}
+
+  void Run() {
+    ResetDirectory(input_dir_);
+    ResetDirectory(output_dir_);
+    RunTextures();
+    RunModels();
+    RunAudio();
+    RunThreadPool();
+    RunScaling();
+  }
+
+  const std::vector<Metric>& GetMetrics() const {
+    return metrics_;
+  }
+
+ private:
+  void AddMetric(std::string name, double value, std::string unit,
+                 bool higher_is_better) {
+    std::cout << std::left << std::setw(48) << name << std::right
+              << std::setw(12) << std::fixed << std::setprecision(3) << value
+              << " " << unit << std::endl;
+    metrics_.push_back({std::move(name), value, std::move(unit),
+                        higher_is_better});
+  }
+
+  void RunTextures() {
+    AssetLoadingThreadPool thread_pool(thread_count_);
+    BatchIo batch_io(thread_pool);
+    ReplaceRequest replace_request;
+    TextureProcessor texture_processor(thread_pool, batch_io,
+                                       replace_request);
+    texture_processor.SetDestinationDirectory(output_dir_);
+    thread_pool.Run();
+
+    struct LdrInput {
+      std::string name;
+      TextureProcessor::TextureCategory category;
+    };
+    const LdrInput ldr_inputs[] = {
+        {"gradient_rgba", TextureProcessor::TextureCategory::kLdrRgba},
+        {"noise_r", TextureProcessor::TextureCategory::kLdrR},
+        {"normal_rg", TextureProcessor::TextureCategory::kLdrRgNmap}};
+
+    for (int size : kTextureSizes) {
+      double megapixels = static_cast<double>(size) * size / 1e6;
+      for (const auto& input : ldr_inputs) {
+        std::unique_ptr<uint8_t[]> image;
+        if (input.category == TextureProcessor::TextureCategory::kLdrRgba) {
+          image = GenerateGradient(size, size);
+        } else if (input.category == TextureProcessor::TextureCategory::kLdrR) {
+          image = GenerateNoise(size, size, static_cast<uint64_t>(size));
+        } else {
+          image = GenerateNormalMap(size, size);
+        }
+        std::string name = input.name + "_" + std::to_string(size);
+        auto encoded_path = output_dir_ / (name + ".astc");
+        auto decoded_path = output_dir_ / (name + ".png");
+
+        std::unique_ptr<uint8_t[]> image_copy;
+        double encode_time = MeasureBest(
+            [&]() {
+              std::filesystem::remove(encoded_path);
+              image_copy = CopyImage(image, size, size);
+            },
+            [&]() {
+              texture_processor.Encode(encoded_path, std::move(image_copy),
+                                       size, size, input.category);
+            });
+        AddMetric("texture/encode/" + name, megapixels / encode_time,
+                  "MP/s", true);
+
+        double decode_time = MeasureBest(
+            [&]() {
+              std::filesystem::remove(decoded_path);
+            },
+            [&]() {
+              texture_processor.Decode(encoded_path, decoded_path,
+                                       input.category);
+            });
+        AddMetric("texture/decode/" + name, megapixels / decode_time,
+                  "MP/s", true);
+      }
+
+      /// hdr is loaded only from file, so loading is measured as well
+      std::string name = "sky_" + std::to_string(size);
+      auto source_path = input_dir_ / (name + ".hdr");
+      auto encoded_path = output_dir_ / ("hdr_" + name + ".astc");
+      auto decoded_path = output_dir_ / ("hdr_" + name + ".hdr");
+      if (!WriteHdrFile(source_path, size, size)) {
+        std::cerr << "Error: can't write " << source_path << std::endl;
+        continue;
+      }
+      double encode_time = MeasureBest(
+          [&]() {
+            std::filesystem::remove(encoded_path);
+          },
+          [&]() {
+            texture_processor.Encode(source_path);
+          });
+      AddMetric("texture/encode/hdr_rgb_" + std::to_string(size),
+                megapixels / encode_time, "MP/s", true);
+      double decode_time = MeasureBest(
+          [&]() {
+            std::filesystem::remove(decoded_path);
+          },
+          [&]() {
+            texture_processor.Decode(encoded_path);
+          });
+      AddMetric("texture/decode/hdr_rgb_" + std::to_string(size),
+                megapixels / decode_time, "MP/s", true);
+    }
+    thread_pool.Stop();
+  }
+
+  void RunModels() {
+    /// otherwise ModelProcessor fails after writing .gltf and time is wrong
+    if (!std::filesystem::exists(FAITHFUL_ASSET_PROCESSOR_GLTFPACK_PATH)) {
+      std::cerr << "Warning: gltfpack not found, model benchmark skipped"
+                << std::endl;
+      return;
+    }
+    AssetLoadingThreadPool thread_pool(thread_count_);
+    BatchIo batch_io(thread_pool);
+    ReplaceRequest replace_request;
+    TextureProcessor texture_processor(thread_pool, batch_io,
+                                       replace_request);
+    ModelProcessor model_processor(thread_pool, batch_io, texture_processor,
+                                   replace_request);
+    thread_pool.Run();
+    for (int grid_size : kModelGridSizes) {
+      auto model_path =
+          input_dir_ / ("grid_" + std::to_string(grid_size) + ".gltf");
+      if (!WriteGltfGrid(model_path, grid_size, kModelTextureSize)) {
+        std::cerr << "Error: can't write " << model_path << std::endl;
+        continue;
+      }
+      double time = MeasureBest(
+          [&]() {
+            ResetDirectory(output_dir_ / "models");
+            model_processor.SetDestinationDirectory(output_dir_);
+          },
+          [&]() {
+            model_processor.Encode(model_path);
+          });
+      AddMetric("model/encode/grid_" + std::to_string(grid_size),
+                time * 1000.0, "ms", false);
+    }
+    thread_pool.Stop();
+  }
+
+  void RunAudio() {
+    AssetLoadingThreadPool thread_pool(thread_count_);
+    BatchIo batch_io(thread_pool);
+    ReplaceRequest replace_request;
+    AudioProcessor audio_processor(thread_pool, batch_io, replace_request);
+    audio_processor.SetDestinationDirectory(output_dir_);
+    thread_pool.Run();
+    auto sound_path = input_dir_ / "sweep.wav";
+    if (!WritePcmWav(sound_path, kAudioSeconds, 1)) {
+      std::cerr << "Error: can't write " << sound_path << std::endl;
+      thread_pool.Stop();
+      return;
+    }
+    double megabytes =
+        static_cast<double>(std::filesystem::file_size(sound_path)) / 1e6;
+    double time = MeasureBest(
+        [&]() {
+          std::filesystem::remove(output_dir_ / "sounds" / "sweep.wav");
+        },
+        [&]() {
+          audio_processor.EncodeSounds({sound_path});
+        });
+    AddMetric("audio/encode/pcm_wav", megabytes / time, "MB/s", true);
+    thread_pool.Stop();
+  }
+
+  void RunThreadPool() {
+    AssetLoadingThreadPool thread_pool(thread_count_);
+    thread_pool.Run();
+    double time = MeasureBest(
+        []() {},
+        [&]() {
+          for (int i = 0; i < kDispatchIterations; ++i) {
+            thread_pool.Execute([](int) {});
+          }
+        });
+    thread_pool.Stop();
+    AddMetric("thread_pool/dispatch", time / kDispatchIterations * 1e6,
+              "us", false);
+  }
+
+  void RunScaling() {
+    constexpr int kSize = kScalingTextureSize;
+    auto image = GenerateGradient(kSize, kSize);
+    double megapixels = static_cast<double>(kSize) * kSize / 1e6;
+    auto encoded_path = output_dir_ / "scaling.astc";
+
+    std::vector<int> thread_counts;
+    for (int threads = 1; threads < thread_count_; threads *= 2) {
+      thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(thread_count_);
+
+    double single_thread_speed = 0.0;
+    for (int threads : thread_counts) {
+      AssetLoadingThreadPool thread_pool(threads);
+      BatchIo batch_io(thread_pool);
+      ReplaceRequest replace_request;
+      TextureProcessor texture_processor(thread_pool, batch_io,
+                                         replace_request);
+      thread_pool.Run();
+      std::unique_ptr<uint8_t[]> image_copy;
+      double time = MeasureBest(
+          [&]() {
+            std::filesystem::remove(encoded_path);
+            image_copy = CopyImage(image, kSize, kSize);
+          },
+          [&]() {
+            texture_processor.Encode(
+                encoded_path, std::move(image_copy), kSize, kSize,
+                TextureProcessor::TextureCategory::kLdrRgba);
+          });
+      thread_pool.Stop();
+      double speed = megapixels / time;
+      if (threads == 1) {
+        single_thread_speed = speed;
+      }
+      AddMetric("scaling/encode/threads_" + std::to_string(threads),
+                speed, "MP/s", true);
+      if (single_thread_speed > 0.0) {
+        AddMetric("scaling/speedup/threads_" + std::to_string(threads),
+                  speed / single_thread_speed, "x", true);
+      }
+    }
+  }
+
+  std::filesystem::path work_dir_;
+  std::filesystem::path input_dir_;
+  std::filesystem::path output_dir_;
+  int thread_count_;
+  std::vector<Metric> metrics_;
+};
+
+bool WriteResults(const std::filesystem::path& path,
+                  const std::vector<Metric>& metrics, int thread_count) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    std::cerr << "Error: can't write results to " << path << std::endl;
+    return false;
+  }
+  rapidjson::OStreamWrapper stream(file);
+  rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(stream);
+  writer.StartObject();
+  writer.Key("threads");
+  writer.Int(thread_count);
+  writer.Key("metrics");
+  writer.StartObject();
+  for (const auto& metric : metrics) {
+    writer.Key(metric.name.c_str());
+    writer.StartObject();
+    writer.Key("value");
+    writer.Double(metric.value);
+    writer.Key("unit");
+    writer.String(metric.unit.c_str());
+    writer.Key("higher_is_better");
+    writer.Bool(metric.higher_is_better);
+    writer.EndObject();
+  }
+  writer.EndObject();
+  writer.EndObject();
+  return true;
+}
+
+/// returns number of regressed metrics or -1 if baseline can't be read;
+/// metrics absent in baseline (or vice versa) are skipped
+int CompareWithBaseline(const std::filesystem::path& path,
+                        const std::vector<Metric>& metrics, double threshold) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    std::cerr << "Error: can't open baseline " << path << std::endl;
+    return -1;
+  }
+  rapidjson::IStreamWrapper stream(file);
+  rapidjson::Document baseline;
+  baseline.ParseStream(stream);
+  if (baseline.HasParseError() || !baseline.IsObject() ||
+      !baseline.HasMember("metrics") || !baseline["metrics"].IsObject()) {
+    std::cerr << "Error: invalid baseline " << path << std::endl;
+    return -1;
+  }
+  const auto& baseline_metrics = baseline["metrics"];
+  int regressions = 0;
+  std::cout << "\ncomparison with " << path << " (threshold " << std::fixed
+            << std::setprecision(1)
+            << threshold * 100.0 << "%):" << std::endl;
+  for (const auto& metric : metrics) {
+    auto found = baseline_metrics.FindMember(metric.name.c_str());
+    if (found == baseline_metrics.MemberEnd() || !found->value.IsObject() ||
+        !found->value.HasMember("value") || !found->value["value"].IsNumber()) {
+      continue;
+    }
+    double old_value = found->value["value"].GetDouble();
+    if (old_value <= 0.0) {
+      continue;
+    }
+    double change = (metric.value - old_value) / old_value;
+    bool regressed = metric.higher_is_better ? change < -threshold
+                                             : change > threshold;
+    std::cout << std::left << std::setw(48) << metric.name << std::right
+              << std::setw(9) << std::showpos << std::setprecision(1)
+              << change * 100.0 << "%" << std::noshowpos
+              << (regressed ? "  REGRESSION" : "") << std::endl;
+    if (regressed) {
+      ++regressions;
+    }
+  }
+  return regressions;
+}
+
+void PrintUsage() {
+  std::cout << "usage: FaithfulAssetProcessorBench <output.json> [options]"
+            << "\noptions:"
+            << "\n  --baseline <file.json>  compare with saved results"
+            << "\n  --threshold <fraction>  allowed regression (default 0.1)"
+            << "\n  --threads <N>           max thread count"
+            << "\n  --work-dir <dir>        directory for synthetic assets"
+            << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    PrintUsage();
+    return 2;
+  }
+  std::filesystem::path output_path{argv[1]};
+  std::filesystem::path baseline_path;
+  std::filesystem::path work_dir =
+      std::filesystem::temp_directory_path() / "FaithfulAssetProcessorBench";
+  double threshold = kDefaultThreshold;
+  int thread_count = CpuTopology::Get().GetUsableCpuCount();
+
+  for (int i = 2; i < argc; ++i) {
+    std::string_view option{argv[i]};
+    if (i + 1 >= argc) {
+      PrintUsage();
+      return 2;
+    }
+    if (option == "--baseline") {
+      baseline_path = argv[++i];
+    } else if (option == "--threshold") {
+      threshold = std::atof(argv[++i]);
+    } else if (option == "--threads") {
+      thread_count = std::max(1, std::atoi(argv[++i]));
+    } else if (option == "--work-dir") {
+      work_dir = argv[++i];
+    } else {
+      PrintUsage();
+      return 2;
+    }
+  }
+
+  Benchmark benchmark(work_dir, thread_count);
+  try {
+    benchmark.Run();
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 2;
+  }
+  if (!WriteResults(output_path, benchmark.GetMetrics(), thread_count)) {
+    return 2;
+  }
+  if (!baseline_path.empty()) {
+    int regressions = CompareWithBaseline(baseline_path, benchmark.GetMetrics(),
+                                          threshold);
+    if (regressions < 0) {
+      return 2;
+    }
+    if (regressions > 0) {
+      std::cout << regressions << " metric(s) regressed" << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,344 @@
+#include "SyntheticAssets.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numbers>
+#include <string>
+#include <vector>
+
+#include "rapidjson/ostreamwrapper.h"
+#include "rapidjson/writer.h"
+#include "stb_image_write.h"
+
+std::unique_ptr<uint8_t[]> GenerateGradient(int width, int height) {
+  auto data = std::make_unique<uint8_t[]>(
+      static_cast<std::size_t>(width) * height * 4);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint8_t* pixel = data.get() + (static_cast<std::size_t>(y) * width + x) * 4;
+      pixel[0] = static_cast<uint8_t>(x * 255 / std::max(1, width - 1));
+      pixel[1] = static_cast<uint8_t>(y * 255 / std::max(1, height - 1));
+      pixel[2] = static_cast<uint8_t>((x + y) * 255 / std::max(1, width + height - 2));
+      pixel[3] = 255;
+    }
+  }
+  return data;
+}
+
+std::unique_ptr<uint8_t[]> GenerateNoise(int width, int height, uint64_t seed) {
+  std::size_t pixel_count = static_cast<std::size_t>(width) * height;
+  auto data = std::make_unique<uint8_t[]>(pixel_count * 4);
+  SyntheticRandom random(seed);
+  for (std::size_t i = 0; i < pixel_count; ++i) {
+    /// single channel noise (as "noise_" textures, rrr1)
+    auto value = static_cast<uint8_t>(random.Next() >> 56);
+    data[i * 4] = data[i * 4 + 1] = data[i * 4 + 2] = value;
+    data[i * 4 + 3] = 255;
+  }
+  return data;
+}
+
+std::unique_ptr<uint8_t[]> GenerateNormalMap(int width, int height) {
+  auto data = std::make_unique<uint8_t[]>(
+      static_cast<std::size_t>(width) * height * 4);
+  /// height field h = sin(fx * x) * sin(fy * y), normal = (-dh/dx, -dh/dy, 1)
+  const float fx = 2.0f * std::numbers::pi_v<float> * 8.0f / static_cast<float>(width);
+  const float fy = 2.0f * std::numbers::pi_v<float> * 8.0f / static_cast<float>(height);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      float dx = fx * std::cos(fx * x) * std::sin(fy * y) * 8.0f;
+      float dy = fy * std::sin(fx * x) * std::cos(fy * y) * 8.0f;
+      float length = std::sqrt(dx * dx + dy * dy + 1.0f);
+      uint8_t* pixel = data.get() + (static_cast<std::size_t>(y) * width + x) * 4;
+      pixel[0] = static_cast<uint8_t>((-dx / length * 0.5f + 0.5f) * 255.0f);
+      pixel[1] = static_cast<uint8_t>((-dy / length * 0.5f + 0.5f) * 255.0f);
+      pixel[2] = static_cast<uint8_t>((1.0f / length * 0.5f + 0.5f) * 255.0f);
+      pixel[3] = 255;
+    }
+  }
+  return data;
+}
+
+std::unique_ptr<float[]> GenerateHdr(int width, int height) {
+  auto data = std::make_unique<float[]>(static_cast<std::size_t>(width) * height * 4);
+  /// sky-like: bright "sun" spot over a vertical gradient, values up to ~16
+  float sun_x = static_cast<float>(width) * 0.7f;
+  float sun_y = static_cast<float>(height) * 0.3f;
+  float sun_radius = static_cast<float>(std::min(width, height)) * 0.05f;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      float t = static_cast<float>(y) / static_cast<float>(std::max(1, height - 1));
+      float dx = (static_cast<float>(x) - sun_x) / sun_radius;
+      float dy = (static_cast<float>(y) - sun_y) / sun_radius;
+      float sun = 16.0f * std::exp(-(dx * dx + dy * dy));
+      float* pixel = data.get() + (static_cast<std::size_t>(y) * width + x) * 4;
+      pixel[0] = 0.2f + 0.6f * t + sun;
+      pixel[1] = 0.4f + 0.4f * t + sun;
+      pixel[2] = 1.0f - 0.5f * t + sun * 0.9f;
+      pixel[3] = 1.0f;
+    }
+  }
+  return data;
+}
+
+bool WriteHdrFile(const std::filesystem::path& path, int width, int height) {
+  auto data = GenerateHdr(width, height);
+  return stbi_write_hdr(path.string().c_str(), width, height, 4, data.get()) != 0;
+}
+
+bool WriteGltfGrid(const std::filesystem::path& path,
+                   int grid_size, int texture_size) {
+  auto texture_path = std::filesystem::path(path).replace_extension(".png");
+  auto buffer_path = std::filesystem::path(path).replace_extension(".bin");
+  auto texture = GenerateGradient(texture_size, texture_size);
+  if (!stbi_write_png(texture_path.string().c_str(), texture_size, texture_size,
+                      4, texture.get(), texture_size * 4)) {
+    return false;
+  }
+
+  std::size_t vertex_count = static_cast<std::size_t>(grid_size) * grid_size;
+  std::vector<float> positions;
+  std::vector<float> texcoords;
+  std::vector<uint32_t> indices;
+  positions.reserve(vertex_count * 3);
+  texcoords.reserve(vertex_count * 2);
+  float step = 1.0f / static_cast<float>(grid_size - 1);
+  for (int z = 0; z < grid_size; ++z) {
+    for (int x = 0; x < grid_size; ++x) {
+      float u = static_cast<float>(x) * step;
+      float v = static_cast<float>(z) * step;
+      positions.push_back(u);
+      positions.push_back(0.05f * std::sin(u * 20.0f) * std::cos(v * 20.0f));
+      positions.push_back(v);
+      texcoords.push_back(u);
+      texcoords.push_back(v);
+    }
+  }
+  for (int z = 0; z + 1 < grid_size; ++z) {
+    for (int x = 0; x + 1 < grid_size; ++x) {
+      auto i = static_cast<uint32_t>(z * grid_size + x);
+      auto row = static_cast<uint32_t>(grid_size);
+      indices.insert(indices.end(), {i, i + row, i + 1, i + 1, i + row, i + row + 1});
+    }
+  }
+  float min_y = *std::min_element(positions.begin(), positions.end());
+  float max_y = *std::max_element(positions.begin(), positions.end());
+
+  std::size_t positions_size = positions.size() * sizeof(float);
+  std::size_t texcoords_size = texcoords.size() * sizeof(float);
+  std::size_t indices_size = indices.size() * sizeof(uint32_t);
+  {
+    std::ofstream buffer_file(buffer_path, std::ios::binary);
+    if (!buffer_file.is_open()) {
+      return false;
+    }
+    buffer_file.write(reinterpret_cast<const char*>(positions.data()),
+                      static_cast<std::streamsize>(positions_size));
+    buffer_file.write(reinterpret_cast<const char*>(texcoords.data()),
+                      static_cast<std::streamsize>(texcoords_size));
+    buffer_file.write(reinterpret_cast<const char*>(indices.data()),
+                      static_cast<std::streamsize>(indices_size));
+  }
+
+  std::ofstream gltf_file(path);
+  if (!gltf_file.is_open()) {
+    return false;
+  }
+  rapidjson::OStreamWrapper stream(gltf_file);
+  rapidjson::Writer<rapidjson::OStreamWrapper> writer(stream);
+  auto buffer_view = [&](std::size_t offset, std::size_t length, int target) {
+    writer.StartObject();
+    writer.Key("buffer");
+    writer.Int(0);
+    writer.Key("byteOffset");
+    writer.Uint64(offset);
+    writer.Key("byteLength");
+    writer.Uint64(length);
+    writer.Key("target");
+    writer.Int(target);
+    writer.EndObject();
+  };
+  auto accessor = [&](int view, int component_type, std::size_t count,
+                      const char* type) {
+    writer.StartObject();
+    writer.Key("bufferView");
+    writer.Int(view);
+    writer.Key("componentType");
+    writer.Int(component_type);
+    writer.Key("count");
+    writer.Uint64(count);
+    writer.Key("type");
+    writer.String(type);
+  };
+
+  writer.StartObject();
+  writer.Key("asset");
+  writer.StartObject();
+  writer.Key("version");
+  writer.String("2.0");
+  writer.EndObject();
+
+  writer.Key("scene");
+  writer.Int(0);
+  writer.Key("scenes");
+  writer.StartArray();
+  writer.StartObject();
+  writer.Key("nodes");
+  writer.StartArray();
+  writer.Int(0);
+  writer.EndArray();
+  writer.EndObject();
+  writer.EndArray();
+
+  writer.Key("nodes");
+  writer.StartArray();
+  writer.StartObject();
+  writer.Key("mesh");
+  writer.Int(0);
+  writer.EndObject();
+  writer.EndArray();
+
+  writer.Key("meshes");
+  writer.StartArray();
+  writer.StartObject();
+  writer.Key("primitives");
+  writer.StartArray();
+  writer.StartObject();
+  writer.Key("attributes");
+  writer.StartObject();
+  writer.Key("POSITION");
+  writer.Int(0);
+  writer.Key("TEXCOORD_0");
+  writer.Int(1);
+  writer.EndObject();
+  writer.Key("indices");
+  writer.Int(2);
+  writer.Key("material");
+  writer.Int(0);
+  writer.EndObject();
+  writer.EndArray();
+  writer.EndObject();
+  writer.EndArray();
+
+  writer.Key("materials");
+  writer.StartArray();
+  writer.StartObject();
+  writer.Key("pbrMetallicRoughness");
+  writer.StartObject();
+  writer.Key("baseColorTexture");
+  writer.StartObject();
+  writer.Key("index");
+  writer.Int(0);
+  writer.EndObject();
+  writer.EndObject();
+  writer.EndObject();
+  writer.EndArray();
+
+  writer.Key("textures");
+  writer.StartArray();
+  writer.StartObject();
+  writer.Key("source");
+  writer.Int(0);
+  writer.EndObject();
+  writer.EndArray();
+
+  writer.Key("images");
+  writer.StartArray();
+  writer.StartObject();
+  writer.Key("uri");
+  writer.String(texture_path.filename().string().c_str());
+  writer.EndObject();
+  writer.EndArray();
+
+  constexpr int kArrayBuffer = 34962;
+  constexpr int kElementArrayBuffer = 34963;
+  constexpr int kFloat = 5126;
+  constexpr int kUnsignedInt = 5125;
+  writer.Key("bufferViews");
+  writer.StartArray();
+  buffer_view(0, positions_size, kArrayBuffer);
+  buffer_view(positions_size, texcoords_size, kArrayBuffer);
+  buffer_view(positions_size + texcoords_size, indices_size, kElementArrayBuffer);
+  writer.EndArray();
+
+  writer.Key("accessors");
+  writer.StartArray();
+  accessor(0, kFloat, vertex_count, "VEC3");
+  writer.Key("min");
+  writer.StartArray();
+  writer.Double(0.0);
+  writer.Double(min_y);
+  writer.Double(0.0);
+  writer.EndArray();
+  writer.Key("max");
+  writer.StartArray();
+  writer.Double(1.0);
+  writer.Double(max_y);
+  writer.Double(1.0);
+  writer.EndArray();
+  writer.EndObject();
+  accessor(1, kFloat, vertex_count, "VEC2");
+  writer.EndObject();
+  accessor(2, kUnsignedInt, indices.size(), "SCALAR");
+  writer.EndObject();
+  writer.EndArray();
+
+  writer.Key("buffers");
+  writer.StartArray();
+  writer.StartObject();
+  writer.Key("uri");
+  writer.String(buffer_path.filename().string().c_str());
+  writer.Key("byteLength");
+  writer.Uint64(positions_size + texcoords_size + indices_size);
+  writer.EndObject();
+  writer.EndArray();
+
+  writer.EndObject();
+  return true;
+}
+
+bool WritePcmWav(const std::filesystem::path& path, int seconds, uint64_t seed) {
+  constexpr int kSampleRate = 44100;
+  constexpr int kChannels = 2;
+  std::size_t frame_count = static_cast<std::size_t>(kSampleRate) * seconds;
+  std::vector<int16_t> samples(frame_count * kChannels);
+  SyntheticRandom random(seed);
+  for (std::size_t i = 0; i < frame_count; ++i) {
+    float t = static_cast<float>(i) / kSampleRate;
+    /// sweep 110 Hz -> 880 Hz
+    float frequency = 110.0f + 770.0f * t / static_cast<float>(seconds);
+    float tone = std::sin(2.0f * std::numbers::pi_v<float> * frequency * t);
+    for (int c = 0; c < kChannels; ++c) {
+      float noise = random.NextFloat() * 2.0f - 1.0f;
+      samples[i * kChannels + c] =
+          static_cast<int16_t>((tone * 0.6f + noise * 0.05f) * 32767.0f);
+    }
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  auto write_u32 = [&](uint32_t value) {
+    file.write(reinterpret_cast<const char*>(&value), 4);
+  };
+  auto write_u16 = [&](uint16_t value) {
+    file.write(reinterpret_cast<const char*>(&value), 2);
+  };
+  auto data_size = static_cast<uint32_t>(samples.size() * sizeof(int16_t));
+  file.write("RIFF", 4);
+  write_u32(36 + data_size);
+  file.write("WAVEfmt ", 8);
+  write_u32(16);
+  write_u16(1); // pcm
+  write_u16(kChannels);
+  write_u32(kSampleRate);
+  write_u32(kSampleRate * kChannels * 2);
+  write_u16(kChannels * 2);
+  write_u16(16);
+  file.write("data", 4);
+  write_u32(data_size);
+  file.write(reinterpret_cast<const char*>(samples.data()), data_size);
+  return true;
+}
@@ -0,0 +1,52 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_BENCH_SYNTHETICASSETS_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_BENCH_SYNTHETICASSETS_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+/// Deterministic synthetic inputs for FaithfulAssetProcessorBench:
+/// the same parameters always give the same bytes, so results are comparable
+/// between runs and between machines.
+
+/// SplitMix64, we don't use <random> because distributions are
+/// implementation-defined
+class SyntheticRandom {
+ public:
+  explicit SyntheticRandom(uint64_t seed)
+      : state_(seed) {}
+
+  uint64_t Next() {
+    uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  /// [0; 1)
+  float NextFloat() {
+    return static_cast<float>(Next() >> 40) / static_cast<float>(1 << 24);
+  }
+
+ private:
+  uint64_t state_;
+};
+
+/// all ldr images are rgba8, hdr - rgba32f (what TextureProcessor expects)
+std::unique_ptr<uint8_t[]> GenerateGradient(int width, int height);
+std::unique_ptr<uint8_t[]> GenerateNoise(int width, int height, uint64_t seed);
+std::unique_ptr<uint8_t[]> GenerateNormalMap(int width, int height);
+std::unique_ptr<float[]> GenerateHdr(int width, int height);
+
+/// .hdr file (TextureProcessor loads hdr only from files)
+bool WriteHdrFile(const std::filesystem::path& path, int width, int height);
+
+/// .gltf + .bin + albedo .png: grid of grid_size^2 vertices
+/// with one material (as ModelProcessor expects)
+bool WriteGltfGrid(const std::filesystem::path& path,
+                   int grid_size, int texture_size);
+
+/// 16-bit stereo 44100 Hz pcm .wav: sine sweep with some noise
+bool WritePcmWav(const std::filesystem::path& path, int seconds, uint64_t seed);
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_BENCH_SYNTHETICASSETS_H
@@ -1,8 +1,8 @@
 #ifndef FAITHFUL_ASSET_FORMATS_H
 #define FAITHFUL_ASSET_FORMATS_H
 
-#include <thread>
 #include <array>
+#include <cstddef>
 #include <string_view>
 
 #include <astcenc.h>
@@ -32,8 +32,7 @@ inline constexpr int kDefaultUrlRedirectionsCount = 0;
 
 /// compression:
 
-// TODO: need to deduce std::thread::hardware_concurrency in CMake
-inline const int kMaxHardwareThread = std::thread::hardware_concurrency();
+/// thread count is detected at runtime, see src/CpuTopology.h
 
 constexpr std::array<std::string_view, 4> kAudioCompFormats = {
     ".flac", ".mp3", ".ogg", ".wav"
@@ -66,6 +65,27 @@ inline constexpr int kAudioCompChunkSize = 8192; // pcm to ogg, also serves as L
 
 inline constexpr int kAudioCompThreshold = 0; // TODO: where 1 thread or all threads
 
+/// output of sounds (.wav), music is always .ogg (streamed one at a time):
+/// kCopy - source as is, kImaAdpcm - IMA ADPCM .wav (4:1 of 16-bit pcm,
+/// cheap to decode for many simultaneous one-shots); sources with more
+/// than 2 channels or already ADPCM are copied
+enum class SoundFormat {
+  kCopy,
+  kImaAdpcm
+};
+inline constexpr SoundFormat kSoundsFormat = SoundFormat::kImaAdpcm;
+/// per channel: 1017 frames, 23 ms at 44.1 kHz
+inline constexpr int kSoundAdpcmBlockBytes = 512;
+/// frames of each block on which all step indices are tried
+inline constexpr int kSoundAdpcmSearchFrames = 64;
+/// EBU R128 loudness of music & sounds (see src/Loudness.h), kept in this
+/// file of category directory until copied into its info.txt
+inline constexpr char kAudioLoudnessName[] = ".loudness";
+/// seek table beside each music track (<name>.ogg.seek, see
+/// src/OggSeekIndex.h): page offsets at least every interval of audio
+inline constexpr char kMusicSeekExtension[] = ".seek";
+inline constexpr int kMusicSeekIntervalMs = 1000;
+
 /// threshold which determine should it be encoded
 /// as a music(.ogg) or as an sound(.wav)
 inline constexpr int kMusicFlacThreshold = 0;
@@ -78,8 +98,120 @@ inline constexpr int kTexCompBlockX = 4;
 inline constexpr int kTexCompBlockY = 4;
 inline constexpr int kTexCompBlockZ = 1;
 
+/// should match ASTCENC_BLOCK_MAX_TEXELS from external/CMakeLists.txt,
+/// so the biggest supported block is 8x8
+inline constexpr int kTexMaxBlockTexels = 64;
+
+/// images with all texels equal are written as ASTC void-extent blocks
+/// (one color per block, nothing to compress), so the biggest supported
+/// block takes the least memory; explicit block size of --profile is kept
+inline constexpr int kTexConstantBlockX = 8;
+inline constexpr int kTexConstantBlockY = 8;
+
+/// automatic block size selection (option --auto-block):
+/// candidates sorted from the smallest block (best quality) to the biggest
+/// (least memory); the first one is a fallback and never tested
+inline constexpr std::array<std::array<int, 2>, 4> kTexAutoBlockSizes = {{
+    {4, 4}, {5, 5}, {6, 6}, {8, 8}
+}};
+/// sample tiles are stacked into one image, so tile size should be divisible
+/// by all block sizes - then no block crosses two tiles
+inline constexpr int kTexAutoBlockTileSize = 120;
+/// up to kTexAutoBlockTileGrid^2 tiles evenly spread over the image
+inline constexpr int kTexAutoBlockTileGrid = 4;
+/// the largest block which passes the target is chosen (dB for ldr)
+inline constexpr double kTexAutoBlockPsnrR = 38.0; // maps, noises, fonts, ao
+inline constexpr double kTexAutoBlockPsnrGb = 40.0; // metallic_roughness
+inline constexpr double kTexAutoBlockPsnrRgb = 40.0; // emission
+inline constexpr double kTexAutoBlockPsnrRgba = 42.0; // albedo, other
+inline constexpr double kTexAutoBlockPsnrRgNmap = 42.0; // normal
+/// there is no fixed peak for hdr, so mse in linear space
+inline constexpr double kTexAutoBlockMseHdr = 0.0005;
+
+/// verify mode (<destination> <source> v): each texture is decompressed
+/// in memory right after compression and compared with the source;
+/// the run fails if any texture is below these thresholds
+inline constexpr double kTexVerifyMinPsnrLdr = 32.0;
+/// for hdr peak is the max value of the texture
+inline constexpr double kTexVerifyMinPsnrHdr = 30.0;
+inline constexpr double kTexVerifyMinSsim = 0.90;
+inline constexpr char kTexVerifyReportName[] = "verify_report.txt";
+
+/// ldr textures up to this many texels (icons, fonts, ui) are compressed
+/// in a batch: whole image per thread instead of all threads per image
+inline constexpr int kTexBatchMaxPixels = 128 * 128;
+
+/// virtual textures (option --virtual-maps): "map_" textures are split into
+/// tiles of every mip level (halved until it fits into one tile); each tile
+/// has kTexVirtualTileBorder texels of its neighbours (clamped at edges) on
+/// each side, so filtering never needs other tiles; stored tile size
+/// (120 + 2 * 4 = 128) should be divisible by kTexCompBlockX/Y;
+/// tiles start at multiples of kTexVirtualPageAlignment inside of the file,
+/// so the runtime reads each one by a single aligned (O_DIRECT) read
+inline constexpr int kTexVirtualTileSize = 120;
+inline constexpr int kTexVirtualTileBorder = 4;
+inline constexpr int kTexVirtualPageAlignment = 4096;
+/// page table beside the pages (<name>.vt); not an asset of its own
+inline constexpr char kTexVirtualIndexExtension[] = ".vtidx";
+
+/// signed distance fields of "font_" textures (option --font-sdf <size>):
+/// texels with red >= kTexFontSdfThreshold are inside of glyphs; 128 is
+/// the edge, 0/255 are kTexFontSdfSpread texels (of the downscaled
+/// texture) outside/inside of it
+inline constexpr int kTexFontSdfThreshold = 128;
+inline constexpr int kTexFontSdfSpread = 8;
+
+/// atlases (option --atlas): "font_" and other small ldr textures (not maps
+/// and noises) up to kTexAtlasMaxTextureSize per side are packed into
+/// power-of-two pages; each texture is surrounded by kTexAtlasPadding
+/// texels of its own edge, so bilinear filtering doesn't mix neighbours
+inline constexpr int kTexAtlasMaxTextureSize = 256;
+inline constexpr int kTexAtlasMinPageSize = 256;
+inline constexpr int kTexAtlasMaxPageSize = 2048;
+inline constexpr int kTexAtlasPadding = 4;
+inline constexpr char kTexAtlasFontName[] = "font_atlas";
+inline constexpr char kTexAtlasUiName[] = "ui_atlas";
+
+/// decode mode png (option --png-level N): zlib level, 0 is store-only
+inline constexpr int kPngCompLevel = 6;
+/// decode mode: astc is decompressed, encoded (png/hdr) and written by
+/// strips of whole block rows of about this many decoded bytes, each strip
+/// by one thread (see TextureProcessor::DecodeStrips())
+inline constexpr std::size_t kTexDecodeStripSize = 256 * 1024;
+
+/// animations of models (see src/AnimationCompression.h): keyframes are
+/// dropped while the rest reproduces every source key within the tolerance
+/// of its path (radians, scene units, scale, morph weight); rotations are
+/// stored as normalized shorts, translations snapped to kModelAnimTranslationStep
+inline constexpr float kModelAnimRotationTolerance = 0.001f;
+inline constexpr float kModelAnimTranslationTolerance = 0.0005f;
+inline constexpr float kModelAnimScaleTolerance = 0.0005f;
+inline constexpr float kModelAnimWeightsTolerance = 0.002f;
+inline constexpr float kModelAnimTranslationStep = 1.0f / 8192;
+/// the longest interpolated segment (keys), so checking it on every
+/// extension stays linear in the key count, not quadratic
+inline constexpr std::size_t kModelAnimMaxSegmentKeys = 128;
+
+/// completed source assets of the run inside the destination,
+/// for --resume (see src/RunJournal.h)
+inline constexpr char kJournalName[] = ".journal";
+/// processing time of every asset measured by earlier runs inside the
+/// destination, for longest-job-first order (see src/AssetTimings.h)
+inline constexpr char kTimingsName[] = ".timings";
+
+/// batched file I/O (see src/BatchIo.h): io_uring queue size, how many
+/// copies are in flight at once and their buffer (one per copy)
+inline constexpr unsigned kIoQueueDepth = 256;
+inline constexpr std::size_t kIoMaxCopiesInFlight = 64;
+inline constexpr std::size_t kIoCopyChunkSize = 256 * 1024;
+
+/// run report (option --report out.json): how many of the slowest assets listed
+inline constexpr int kReportSlowestAssetCount = 10;
+
 inline constexpr astcenc_type kTexLdrDataType = ASTCENC_TYPE_U8;
-inline constexpr astcenc_type kTexHdrDataType = ASTCENC_TYPE_F32;
+/// half precision is enough for hdr and halves memory & bandwidth of
+/// compression (see src/HalfFloat.h)
+inline constexpr astcenc_type kTexHdrDataType = ASTCENC_TYPE_F16;
 
 
 /// Wow, this is the first time I've used designated initialization.
@@ -0,0 +1,108 @@
+#include "AllocationCounter.h"
+
+#ifdef FAITHFUL_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> allocation_count{0};
+std::atomic<uint64_t> allocated_bytes{0};
+
+void* CountedAllocate(std::size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  /// malloc(0) may return nullptr, while operator new shouldn't
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void* CountedAllocate(std::size_t size, std::align_val_t alignment) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  auto align = static_cast<std::size_t>(alignment);
+  /// aligned_alloc requires size to be a multiple of alignment
+  std::size_t aligned_size = (size + align - 1) / align * align;
+#ifdef _MSC_VER
+  void* ptr = _aligned_malloc(aligned_size == 0 ? align : aligned_size, align);
+#else
+  void* ptr = std::aligned_alloc(align, aligned_size == 0 ? align : aligned_size);
+#endif
+  if (ptr) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void AlignedFree(void* ptr) {
+#ifdef _MSC_VER
+  _aligned_free(ptr);
+#else
+  std::free(ptr);
+#endif
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  return CountedAllocate(size);
+}
+void* operator new[](std::size_t size) {
+  return CountedAllocate(size);
+}
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return CountedAllocate(size, alignment);
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return CountedAllocate(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+void operator delete[](void* ptr) noexcept {
+  std::free(ptr);
+}
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+void operator delete[](void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+void operator delete(void* ptr, std::align_val_t) noexcept {
+  AlignedFree(ptr);
+}
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+  AlignedFree(ptr);
+}
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+  AlignedFree(ptr);
+}
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+  AlignedFree(ptr);
+}
+
+bool IsAllocationCountingEnabled() {
+  return true;
+}
+
+AllocationStats GetAllocationStats() {
+  return {allocation_count.load(std::memory_order_relaxed),
+          allocated_bytes.load(std::memory_order_relaxed)};
+}
+
+#else
+
+bool IsAllocationCountingEnabled() {
+  return false;
+}
+
+AllocationStats GetAllocationStats() {
+  return {0, 0};
+}
+
+#endif  // FAITHFUL_COUNT_ALLOCATIONS
@@ -0,0 +1,23 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_ALLOCATIONCOUNTER_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_ALLOCATIONCOUNTER_H
+
+#include <cstdint>
+
+/// Optional counting hook for global operator new (CMake option
+/// FAITHFUL_ASSET_PROCESSOR_COUNT_ALLOCATIONS), used by RunReport.
+/// Only C++ allocations are visible, malloc() inside stb/astcenc isn't.
+/// Counters are relaxed atomics, so hook is cheap but still not free -
+/// that's why it's off by default.
+
+struct AllocationStats {
+  uint64_t count;
+  uint64_t bytes;
+};
+
+/// false if built without the hook (then stats are always zero)
+bool IsAllocationCountingEnabled();
+
+/// totals since program start (frees aren't subtracted)
+AllocationStats GetAllocationStats();
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_ALLOCATIONCOUNTER_H
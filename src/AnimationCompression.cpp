@@ -0,0 +1,234 @@
+#include "AnimationCompression.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../config/AssetFormats.h"
+
+namespace {
+
+float Dot4(const float* a, const float* b) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+}
+
+void Normalize4(float* q) {
+  float length = std::sqrt(Dot4(q, q));
+  if (length > 0.0f) {
+    for (int c = 0; c < 4; ++c) {
+      q[c] /= length;
+    }
+  }
+}
+
+/// by the shortest path, as glTF viewers do
+void Slerp(const float* a, const float* b, float t, float* out) {
+  float cos_angle = Dot4(a, b);
+  float sign = 1.0f;
+  if (cos_angle < 0.0f) {
+    cos_angle = -cos_angle;
+    sign = -1.0f;
+  }
+  float weight_a = 1.0f - t;
+  float weight_b = t;
+  /// almost the same: sin(angle) is too small, nlerp is exact enough
+  if (cos_angle < 0.9995f) {
+    float angle = std::acos(cos_angle);
+    float sin_angle = std::sin(angle);
+    weight_a = std::sin((1.0f - t) * angle) / sin_angle;
+    weight_b = std::sin(t * angle) / sin_angle;
+  }
+  weight_b *= sign;
+  for (int c = 0; c < 4; ++c) {
+    out[c] = weight_a * a[c] + weight_b * b[c];
+  }
+  Normalize4(out);
+}
+
+float Difference(const AnimationTrack& track, const float* a, const float* b) {
+  switch (track.path) {
+    case AnimationPath::kRotation: {
+      /// from the chord between unit quaternions: acos() of a dot close
+      /// to 1 loses all precision (and quantized ones aren't unit)
+      float unit_a[4], unit_b[4];
+      std::copy_n(a, 4, unit_a);
+      std::copy_n(b, 4, unit_b);
+      Normalize4(unit_a);
+      Normalize4(unit_b);
+      float sign = Dot4(unit_a, unit_b) < 0.0f ? -1.0f : 1.0f;
+      float squared = 0.0f;
+      for (int c = 0; c < 4; ++c) {
+        float difference = unit_a[c] - sign * unit_b[c];
+        squared += difference * difference;
+      }
+      return 4.0f * std::asin(std::min(1.0f, std::sqrt(squared) * 0.5f));
+    }
+    case AnimationPath::kWeights: {
+      float difference = 0.0f;
+      for (int c = 0; c < track.components; ++c) {
+        difference = std::max(difference, std::abs(a[c] - b[c]));
+      }
+      return difference;
+    }
+    default: {
+      float squared = 0.0f;
+      for (int c = 0; c < track.components; ++c) {
+        squared += (a[c] - b[c]) * (a[c] - b[c]);
+      }
+      return std::sqrt(squared);
+    }
+  }
+}
+
+/// from the quantized keys first and last, at the time of key
+void Interpolate(const AnimationTrack& track, const std::vector<float>& values,
+                 std::size_t first, std::size_t last, std::size_t key,
+                 float* out) {
+  const float* a = values.data() + first * track.components;
+  const float* b = values.data() + last * track.components;
+  float duration = track.times[last] - track.times[first];
+  float t = duration > 0.0f
+                ? (track.times[key] - track.times[first]) / duration
+                : 0.0f;
+  if (track.step) {
+    std::copy_n(a, track.components, out);
+  } else if (track.path == AnimationPath::kRotation) {
+    Slerp(a, b, t, out);
+  } else {
+    for (int c = 0; c < track.components; ++c) {
+      out[c] = a[c] + (b[c] - a[c]) * t;
+    }
+  }
+}
+
+/// the largest error of keys between first and last, if only they are kept
+float SegmentError(const AnimationTrack& track,
+                   const std::vector<float>& quantized, std::size_t first,
+                   std::size_t last, std::vector<float>& scratch) {
+  float error = 0.0f;
+  for (std::size_t key = first + 1; key < last; ++key) {
+    Interpolate(track, quantized, first, last, key, scratch.data());
+    error = std::max(error, Difference(track, scratch.data(),
+                                       track.values.data() +
+                                           key * track.components));
+  }
+  return error;
+}
+
+}  // namespace
+
+int16_t QuantizeSnorm16(float value) {
+  return static_cast<int16_t>(
+      std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+float DequantizeSnorm16(int16_t value) {
+  return std::max(static_cast<float>(value) / 32767.0f, -1.0f);
+}
+
+AnimationTrackStats CompressTrack(AnimationTrack& track, float tolerance) {
+  std::size_t key_count = track.times.size();
+  auto components = static_cast<std::size_t>(track.components);
+  if (key_count == 0 || track.values.size() != key_count * components) {
+    return {key_count, key_count, 0.0f};
+  }
+  /// equivalent signs of neighbours, so quantized neighbours are close
+  if (track.path == AnimationPath::kRotation) {
+    for (std::size_t key = 0; key < key_count; ++key) {
+      float* q = track.values.data() + key * 4;
+      Normalize4(q);
+      if (key > 0 && Dot4(q - 4, q) < 0.0f) {
+        for (int c = 0; c < 4; ++c) {
+          q[c] = -q[c];
+        }
+      }
+    }
+  }
+  std::vector<float> quantized(track.values);
+  if (track.path == AnimationPath::kRotation) {
+    for (auto& value : quantized) {
+      value = DequantizeSnorm16(QuantizeSnorm16(value));
+    }
+  } else if (track.path == AnimationPath::kTranslation) {
+    constexpr float kStep = faithful::config::kModelAnimTranslationStep;
+    for (auto& value : quantized) {
+      value = std::round(value / kStep) * kStep;
+    }
+  }
+
+  std::vector<float> scratch(components);
+  std::vector<std::size_t> kept{0};
+  bool constant = true;
+  for (std::size_t key = 0; key < key_count && constant; ++key) {
+    constant = Difference(track, quantized.data(),
+                          track.values.data() + key * components) <= tolerance;
+  }
+  if (constant) {
+    /// the last key too (with the first value), so the times accessor
+    /// still ends at the end of the clip
+    if (key_count > 1) {
+      kept.push_back(key_count - 1);
+    }
+  } else {
+    constexpr std::size_t kMaxSegmentKeys =
+        faithful::config::kModelAnimMaxSegmentKeys;
+    for (std::size_t first = 0; first + 1 < key_count;) {
+      std::size_t last = first + 1;
+      if (track.step) {
+        /// the value of first holds until last, whatever last is, so only
+        /// the newly covered key has to be checked
+        while (last + 1 < key_count &&
+               Difference(track, quantized.data() + first * components,
+                          track.values.data() + last * components) <=
+                   tolerance) {
+          ++last;
+        }
+      } else {
+        /// the other end moves, so all keys in between are checked again
+        while (last + 1 < key_count && last + 1 - first < kMaxSegmentKeys &&
+               SegmentError(track, quantized, first, last + 1, scratch) <=
+                   tolerance) {
+          ++last;
+        }
+      }
+      kept.push_back(last);
+      first = last;
+    }
+  }
+
+  AnimationTrackStats stats{key_count, kept.size(), 0.0f};
+  if (constant) {
+    for (std::size_t key = 0; key < key_count; ++key) {
+      stats.max_error = std::max(
+          stats.max_error,
+          Difference(track, quantized.data(),
+                     track.values.data() + key * components));
+    }
+  } else {
+    for (std::size_t i = 0; i < kept.size(); ++i) {
+      std::size_t key = kept[i];
+      stats.max_error = std::max(
+          stats.max_error,
+          Difference(track, quantized.data() + key * components,
+                     track.values.data() + key * components));
+      if (i + 1 < kept.size()) {
+        stats.max_error = std::max(
+            stats.max_error,
+            SegmentError(track, quantized, key, kept[i + 1], scratch));
+      }
+    }
+  }
+
+  std::vector<float> times;
+  std::vector<float> values;
+  times.reserve(kept.size());
+  values.reserve(kept.size() * components);
+  for (auto key : kept) {
+    times.push_back(track.times[key]);
+    std::size_t source = constant ? 0 : key;
+    values.insert(values.end(), quantized.begin() + source * components,
+                  quantized.begin() + (source + 1) * components);
+  }
+  track.times = std::move(times);
+  track.values = std::move(values);
+  return stats;
+}
@@ -0,0 +1,47 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_ANIMATIONCOMPRESSION_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_ANIMATIONCOMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Keyframe reduction of glTF animation samplers (LINEAR and STEP):
+/// values are quantized first (rotations to normalized shorts, translations
+/// to the kModelAnimTranslationStep grid), then keys are dropped greedily
+/// while interpolation (slerp for rotations, lerp otherwise) of the kept
+/// ones stays within the tolerance of every source key in between.
+/// Independent of tinygltf, see ModelProcessor::CompressAnimations()
+
+enum class AnimationPath {
+  kTranslation,
+  kRotation,
+  kScale,
+  kWeights
+};
+
+/// keyframes of one sampler, whatever the accessors store
+struct AnimationTrack {
+  AnimationPath path;
+  /// values per key: 3, 4 (xyzw) or morph target count
+  int components;
+  bool step;
+  std::vector<float> times;
+  std::vector<float> values;
+};
+
+struct AnimationTrackStats {
+  std::size_t keys_before;
+  std::size_t keys_after;
+  /// of the result at source key times: radians for rotations,
+  /// distance for translations and scales, max difference for weights
+  float max_error;
+};
+
+/// in place
+AnimationTrackStats CompressTrack(AnimationTrack& track, float tolerance);
+
+/// glTF normalized SHORT: c / 32767, clamped to -1
+int16_t QuantizeSnorm16(float value);
+float DequantizeSnorm16(int16_t value);
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_ANIMATIONCOMPRESSION_H
@@ -1,68 +1,99 @@
 #include "AssetLoadingThreadPool.h"
 
-#include <exception>
-#include <iostream>
+#include <algorithm>
 
-AssetLoadingThreadPool::AssetLoadingThreadPool(int thread_number) {
+#include "Trace.h"
+
+AssetLoadingThreadPool::AssetLoadingThreadPool(int thread_number,
+                                               ThreadPinning pinning) {
   // subtracted by 1 because it's Main thread (see explanation in header)
   int actual_thread_number = std::max(1, thread_number) - 1;
-  if (actual_thread_number == 0) {
-    throw std::invalid_argument("AssetLoadingThreadPool has 0 worker threads");
-  }
   threads_ = std::vector<std::thread>(actual_thread_number);
   threads_task_ = {};
+  if (pinning != ThreadPinning::kNone) {
+    cpus_ = CpuTopology::Get().SelectCpus(
+        actual_thread_number + 1, pinning == ThreadPinning::kPhysicalCores);
+  }
 }
 
 void AssetLoadingThreadPool::Run() {
-  threads_left_ = 0;
-  stopped_ = false;
+  std::size_t start_generation;
+  {
+    std::lock_guard lock(mu_);
+    threads_left_ = 0;
+    stopped_ = false;
+    start_generation = generation_;
+  }
+  if (!cpus_.empty()) {
+    CpuTopology::PinCurrentThread(cpus_.back());
+  }
   for (std::size_t i = 0; i < threads_.size(); ++i) {
-    threads_[i] = std::thread([this, i](){
-      while (!stopped_) {
+    threads_[i] = std::thread([this, i, start_generation]() {
+      if (!cpus_.empty()) {
+        CpuTopology::PinCurrentThread(cpus_[i]);
+      }
+      std::size_t seen_generation = start_generation;
+      while (true) {
         {
-          std::unique_lock lock(mu_all_ready_);
-          thread_tasks_ready_.wait(lock, [this]() {
-            return static_cast<bool>(threads_task_);
+          std::unique_lock lock(mu_);
+          thread_tasks_ready_.wait(lock, [&]() {
+            return generation_ != seen_generation;
           });
+          seen_generation = generation_;
+          if (stopped_) {
+            return;
+          }
         }
-        WorkAndWaitAll(static_cast<int>(i));
+        WorkAndNotify(static_cast<int>(i));
       }
     });
   }
 }
 
 void AssetLoadingThreadPool::Stop() {
-  stopped_ = true;
-  // its like poison pill but allows thread to check was thread pool joined
-  // (see AssetLoadingThreadPool::Run() if (joined_) { break; })
-  threads_left_ = GetThreadNumber() - 1; // this thread don't work
-  threads_task_ = [](int){};
+  {
+    std::lock_guard lock(mu_);
+    stopped_ = true;
+    ++generation_; // wakes up everyone to see stopped_
+  }
   thread_tasks_ready_.notify_all();
   for (auto& thread : threads_) {
     thread.join();
   }
+  if (!cpus_.empty()) {
+    CpuTopology::Get().UnpinCurrentThread();
+  }
 }
 
 void AssetLoadingThreadPool::Execute(TaskType task) {
-  threads_left_ = GetThreadNumber();
-  threads_task_ = std::move(task);
+  {
+    std::lock_guard lock(mu_);
+    threads_left_ = GetThreadNumber();
+    threads_task_ = std::move(task);
+    ++generation_;
+  }
   thread_tasks_ready_.notify_all();
 
   // because threads_size() == all_threads - 1, where 1 is Calling thread
-  WorkAndWaitAll(static_cast<int>(threads_.size()));
+  WorkAndNotify(static_cast<int>(threads_.size()));
+
+  /// workers don't wait for each other, so only here we know that
+  /// the task isn't used anymore
+  TraceScope trace_scope("pool_wait");
+  std::unique_lock lock(mu_);
+  thread_tasks_completed_.wait(lock, [this]() {
+    return threads_left_ == 0;
+  });
+  threads_task_ = {};
 }
 
-void AssetLoadingThreadPool::WorkAndWaitAll(int thread_id) {
-  threads_task_(thread_id);
+void AssetLoadingThreadPool::WorkAndNotify(int thread_id) {
   {
-    std::unique_lock lock(mu_all_completed_);
-    if (--threads_left_ != 0) {
-      thread_tasks_completed_.wait(lock, [this]() {
-        return threads_left_ == 0;
-      });
-      return;
-    }
+    TraceScope trace_scope("pool_task");
+    threads_task_(thread_id);
+  }
+  std::lock_guard lock(mu_);
+  if (--threads_left_ == 0) {
+    thread_tasks_completed_.notify_all();
   }
-  threads_task_ = {}; // don't need mutex here - all other threads 100% wait
-  thread_tasks_completed_.notify_all();
 }
@@ -9,22 +9,40 @@
 
 #include "Function.h"
 
+#include "CpuTopology.h"
+
 /// This is "blocking" thread pool what means it blocks thread from which
 /// Execute() was called. So for AssetLoadingThreadPool(8) it
 /// generates only 7 threads, but inside the Execute() it utilizes all 8,
-/// because of caller thread
+/// because of caller thread (AssetLoadingThreadPool(1) has no workers at all)
 
-/// solely memory_order_seq_cst
+/// each Execute() starts a new "generation", workers wait for it to change,
+/// so no one can miss a task or run the same task twice
 
 /// can be Run() and Stop() multiple times (useful for testing,
 /// when you want to encode and then decode)
+
+/// by default there are as many threads as cpus the process may use
+/// (affinity mask & cgroup quota, see CpuTopology); with pinning each thread
+/// (caller too, until Stop()) is bound to its own cpu, so threads don't
+/// migrate between cores/sockets
+
+/// kCores - physical cores first, then SMT siblings;
+/// kPhysicalCores - SMT siblings are skipped
+enum class ThreadPinning {
+  kNone,
+  kCores,
+  kPhysicalCores
+};
+
 class AssetLoadingThreadPool {
  public:
   /// int param for thread_id
   using TaskType = folly::Function<void(int)>;
 
   explicit AssetLoadingThreadPool(
-      int thread_number = static_cast<int>(std::thread::hardware_concurrency()));
+      int thread_number = CpuTopology::Get().GetUsableCpuCount(),
+      ThreadPinning pinning = ThreadPinning::kNone);
 
   /// neither copyable nor movable because of std::mutex members
   AssetLoadingThreadPool(const AssetLoadingThreadPool& other) = delete;
@@ -43,25 +61,26 @@ class AssetLoadingThreadPool {
   }
 
  private:
-  void WorkAndWaitAll(int thread_id);
+  void WorkAndNotify(int thread_id);
 
   TaskType threads_task_;
 
   /// the difference between "ready" and "complete":
-  /// ready - all are ready for the next task
-  /// completed - all have completed their tasks
+  /// ready - new task (generation) is available
+  /// completed - all have completed their tasks (only caller waits for it)
 
   std::condition_variable thread_tasks_ready_;
   /// last thread who see threads_left_ == 0 -> notify_all()
   std::condition_variable thread_tasks_completed_;
 
-  std::mutex mu_all_ready_;
-  std::mutex mu_all_completed_;
+  /// guards threads_task_, generation_, threads_left_, stopped_
+  std::mutex mu_;
 
   std::vector<std::thread> threads_;
+  /// cpu per thread_id (the last one for the caller), empty if not pinned
+  std::vector<int> cpus_;
 
-  /// usage: condition (threads_left_ == 0)
-  /// in thread_tasks_ready_ waiting as a predicate stop_waiting
+  std::size_t generation_{0};
   int threads_left_{0};
   bool stopped_{false};
 };
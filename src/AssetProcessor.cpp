@@ -1,13 +1,24 @@
 #include "AssetProcessor.h"
 
 #include <algorithm>
+#include <chrono>
+#include <map>
 
-AssetProcessor::AssetProcessor(int thread_count)
-    : thread_pool_(std::max(1, thread_count)),
+#include "../config/AssetFormats.h"
+#include "AtomicFile.h"
+#include "RunReport.h"
+#include "Trace.h"
+
+AssetProcessor::AssetProcessor(int thread_count, ThreadPinning pinning)
+    : thread_pool_(std::max(1, thread_count), pinning),
+      batch_io_(thread_pool_),
       replace_request_(),
-      audio_processor_(replace_request_),
-      texture_processor_(thread_pool_, replace_request_),
-      model_processor_(texture_processor_, replace_request_) {}
+      audio_processor_(thread_pool_, batch_io_, replace_request_),
+      texture_processor_(thread_pool_, batch_io_, replace_request_),
+      model_processor_(thread_pool_, batch_io_, texture_processor_,
+                       replace_request_) {
+  texture_processor_.SetTimings(&timings_);
+}
 
 void AssetProcessor::Process(
     const std::filesystem::path& destination,
@@ -16,11 +27,13 @@ void AssetProcessor::Process(
   // important for debugging to reuse ReplaceRequest
   replace_request_.ClearFlags();
 
-  if (std::filesystem::exists(destination / "models") ||
-      std::filesystem::exists(destination / "music") ||
-      std::filesystem::exists(destination / "sounds") ||
-      std::filesystem::exists(destination / "noises") ||
-      std::filesystem::exists(destination / "maps")) {
+  bool hierarchy_exists = std::filesystem::exists(destination / "models") ||
+                          std::filesystem::exists(destination / "music") ||
+                          std::filesystem::exists(destination / "sounds") ||
+                          std::filesystem::exists(destination / "noises") ||
+                          std::filesystem::exists(destination / "maps");
+  /// interrupted run resumed on purpose, so nothing to ask
+  if (hierarchy_exists && !resume_) {
     if (!replace_request_(
             "Needed hierarchy {models, music, sounds, noises, maps} "
             "inside the destination path already exist."
@@ -29,12 +42,21 @@ void AssetProcessor::Process(
       return;
     }
   }
+  ReportStageScope analyze_stage("analyze");
   AssetsAnalyzer assets_analyzer(source, encode);
+  assets_analyzer.SelectShard(shard_index_, shard_count_);
+  analyze_stage.End();
 
   audio_processor_.SetDestinationDirectory(destination.string());
   model_processor_.SetDestinationDirectory(destination.string());
   texture_processor_.SetDestinationDirectory(destination.string());
 
+  /// leftovers of killed run, never published
+  AtomicFile::RemoveStaleTempFiles(destination);
+  journal_.Open(destination / faithful::config::kJournalName, encode,
+                resume_);
+  timings_.Load(destination / faithful::config::kTimingsName, encode);
+
   thread_pool_.Run();
   if (encode) {
     EncodeAssets(assets_analyzer);
@@ -42,28 +64,64 @@ void AssetProcessor::Process(
     DecodeAssets(assets_analyzer);
   }
   thread_pool_.Stop();
+  timings_.Save();
 }
 
 void AssetProcessor::EncodeAssets(AssetsAnalyzer& assets_analyzer) {
-  /// for music(.ogg) & sounds(.wav) just copy
-  auto music_to_process = assets_analyzer.GetMusicToProcess();
-  for (const auto& path : music_to_process) {
-    std::cout << "--> encoding: " << path << std::endl;
-    audio_processor_.EncodeMusic(path);
+  /// music(.ogg) is copied & sounds(.wav) encoded, all files of category
+  /// at once
+  ReportStageScope music_stage("music");
+  {
+    auto music_to_process = CollectNotCompleted(
+        assets_analyzer.GetMusicToProcess(), "encoding");
+    TraceScope trace_scope("encode_music");
+    for (const auto& path : audio_processor_.EncodeMusic(music_to_process)) {
+      journal_.Record(path);
+    }
   }
-  auto sounds_to_process = assets_analyzer.GetSoundsToProcess();
-  for (const auto& path : sounds_to_process) {
-    std::cout << "--> encoding: " << path << std::endl;
-    audio_processor_.EncodeSound(path);
+  music_stage.End();
+  ReportStageScope sounds_stage("sounds");
+  {
+    auto sounds_to_process = CollectNotCompleted(
+        assets_analyzer.GetSoundsToProcess(), "encoding");
+    TraceScope trace_scope("encode_sounds");
+    for (const auto& path :
+         audio_processor_.EncodeSounds(sounds_to_process)) {
+      journal_.Record(path);
+    }
   }
+  sounds_stage.End();
 
   /// models always before textures to not to process models textures twice,
   /// so then we just remove already processed (see below in this function)
-  auto& models_to_process = assets_analyzer.GetModelsToProcess();
+  std::vector<std::filesystem::path> models_to_process(
+      assets_analyzer.GetModelsToProcess().begin(),
+      assets_analyzer.GetModelsToProcess().end());
+  assets_analyzer.SortByCost(models_to_process, timings_);
+  std::set<std::string> skipped_model_images;
+  ReportStageScope models_stage("models");
   for (const auto& path : models_to_process) {
+    if (IsCompleted(path)) {
+      /// otherwise they would be processed as standalone textures
+      for (const auto& image : AssetsAnalyzer::ReadModelImages(path)) {
+        skipped_model_images.insert(image.string());
+      }
+      continue;
+    }
     std::cout << "--> encoding: " << path << std::endl;
-    model_processor_.Encode(path);
+    TraceScope trace_scope("encode_model", path);
+    ReportAssetScope report_scope("models", path);
+    auto start = std::chrono::steady_clock::now();
+    bool written = false;
+    if (model_processor_.Encode(path, &written)) {
+      journal_.Record(path);
+      /// declined replace request keeps the time of the run which wrote it
+      if (written) {
+        timings_.Record(path, std::chrono::steady_clock::now() - start);
+      }
+    }
   }
+  models_stage.End();
 
   /// remove already processed by model_processor_
   /// (if user_source_path had models textures located beyond the gltf file,
@@ -71,49 +129,183 @@ void AssetProcessor::EncodeAssets(AssetsAnalyzer& assets_analyzer) {
   /// so we avoiding this)
   const auto& all_textures_to_process = assets_analyzer.GetTexturesToProcess();
   auto processed_textures = model_processor_.GetProcessedTextures();
+  processed_textures.merge(skipped_model_images);
   std::vector<std::string> textures_to_process;
   std::set_difference(
       all_textures_to_process.begin(), all_textures_to_process.end(),
       processed_textures.begin(), processed_textures.end(),
       std::back_inserter(textures_to_process));
 
+  ReportStageScope textures_stage("textures");
+  /// small ones (icons, fonts, ui) are all encoded at once after the rest:
+  /// packed into atlases (if enabled) or compressed in a batch
+  std::map<std::string, std::vector<std::filesystem::path>> atlases;
+  std::vector<std::filesystem::path> batch_textures;
+  std::vector<std::filesystem::path> standalone_textures;
   for (const auto& path : textures_to_process) {
+    auto atlas_name = texture_processor_.GetAtlasName(path);
+    if (!atlas_name.empty()) {
+      atlases[atlas_name].emplace_back(path);
+      continue;
+    }
+    if (IsCompleted(path)) {
+      continue;
+    }
+    if (texture_processor_.IsBatchCandidate(path)) {
+      batch_textures.emplace_back(path);
+      continue;
+    }
+    standalone_textures.emplace_back(path);
+  }
+  assets_analyzer.SortByCost(standalone_textures, timings_);
+  for (const auto& path : standalone_textures) {
     std::cout << "--> encoding: " << path << std::endl;
-    texture_processor_.Encode(path);
+    TraceScope trace_scope("encode_texture", path);
+    ReportAssetScope report_scope("textures", path);
+    auto start = std::chrono::steady_clock::now();
+    bool written = false;
+    if (texture_processor_.Encode(path, &written)) {
+      journal_.Record(path);
+      if (written) {
+        timings_.Record(path, std::chrono::steady_clock::now() - start);
+      }
+    }
   }
+  for (const auto& [name, paths] : atlases) {
+    /// atlas is always rebuilt from all its textures
+    if (std::all_of(paths.begin(), paths.end(), [this](const auto& path) {
+          return journal_.IsCompleted(path);
+        })) {
+      std::cout << "--> skipped (completed): atlas " << name << std::endl;
+      continue;
+    }
+    std::cout << "--> encoding atlas: " << name << " (" << paths.size()
+              << " textures)" << std::endl;
+    TraceScope trace_scope("encode_atlas", name);
+    ReportAssetScope report_scope("atlases", name);
+    if (texture_processor_.EncodeAtlas(name, paths)) {
+      for (const auto& path : paths) {
+        journal_.Record(path);
+      }
+    }
+  }
+  if (!batch_textures.empty()) {
+    std::cout << "--> encoding batch of " << batch_textures.size()
+              << " small textures" << std::endl;
+    TraceScope trace_scope("encode_texture_batch");
+    /// taken one by one by threads, so the longest ones go first and
+    /// don't finish alone at the end
+    assets_analyzer.SortByCost(batch_textures, timings_);
+    for (const auto& path : texture_processor_.EncodeBatch(batch_textures)) {
+      journal_.Record(path);
+    }
+  }
+  textures_stage.End();
 }
 
 void AssetProcessor::DecodeAssets(AssetsAnalyzer& assets_analyzer) {
-  /// for music(.ogg) & sounds(.wav) just copy
-  auto music_to_process = assets_analyzer.GetMusicToProcess();
-  for (const auto& path : music_to_process) {
-    std::cout << "--> decoding: " << path << std::endl;
-    audio_processor_.DecodeMusic(path);
+  /// music(.ogg) is copied & sounds(.wav) decoded, all files of category
+  /// at once
+  ReportStageScope music_stage("music");
+  {
+    auto music_to_process = CollectNotCompleted(
+        assets_analyzer.GetMusicToProcess(), "decoding");
+    TraceScope trace_scope("decode_music");
+    for (const auto& path : audio_processor_.DecodeMusic(music_to_process)) {
+      journal_.Record(path);
+    }
   }
-  auto sounds_to_process = assets_analyzer.GetSoundsToProcess();
-  for (const auto& path : sounds_to_process) {
-    std::cout << "--> decoding: " << path << std::endl;
-    audio_processor_.DecodeSound(path);
+  music_stage.End();
+  ReportStageScope sounds_stage("sounds");
+  {
+    auto sounds_to_process = CollectNotCompleted(
+        assets_analyzer.GetSoundsToProcess(), "decoding");
+    TraceScope trace_scope("decode_sounds");
+    for (const auto& path :
+         audio_processor_.DecodeSounds(sounds_to_process)) {
+      journal_.Record(path);
+    }
   }
+  sounds_stage.End();
 
   /// it also handles models textures (textures located inside the "models/")
-  auto& models_to_process = assets_analyzer.GetModelsToProcess();
+  std::vector<std::filesystem::path> models_to_process(
+      assets_analyzer.GetModelsToProcess().begin(),
+      assets_analyzer.GetModelsToProcess().end());
+  assets_analyzer.SortByCost(models_to_process, timings_);
+  std::set<std::string> skipped_model_images;
+  ReportStageScope models_stage("models");
   for (const auto& path : models_to_process) {
+    if (IsCompleted(path)) {
+      /// otherwise they would be processed as standalone textures
+      for (const auto& image : AssetsAnalyzer::ReadModelImages(path)) {
+        skipped_model_images.insert(image.string());
+      }
+      continue;
+    }
     std::cout << "--> decoding: " << path << std::endl;
-    model_processor_.Decode(path);
+    TraceScope trace_scope("decode_model", path);
+    ReportAssetScope report_scope("models", path);
+    auto start = std::chrono::steady_clock::now();
+    bool written = false;
+    if (model_processor_.Decode(path, &written)) {
+      journal_.Record(path);
+      if (written) {
+        timings_.Record(path, std::chrono::steady_clock::now() - start);
+      }
+    }
   }
+  models_stage.End();
 
   /// remove already processed by model_processor_
   const auto& all_textures_to_process = assets_analyzer.GetTexturesToProcess();
   auto processed_textures = model_processor_.GetProcessedTextures();
+  processed_textures.merge(skipped_model_images);
   std::vector<std::string> textures_to_process;
   std::set_difference(
       all_textures_to_process.begin(), all_textures_to_process.end(),
       processed_textures.begin(), processed_textures.end(),
       std::back_inserter(textures_to_process));
 
-  for (const auto& path : textures_to_process) {
+  ReportStageScope textures_stage("textures");
+  std::vector<std::filesystem::path> sorted_textures(
+      textures_to_process.begin(), textures_to_process.end());
+  assets_analyzer.SortByCost(sorted_textures, timings_);
+  for (const auto& path : sorted_textures) {
+    if (IsCompleted(path)) {
+      continue;
+    }
     std::cout << "--> decoding: " << path << std::endl;
-    texture_processor_.Decode(path);
+    TraceScope trace_scope("decode_texture", path);
+    ReportAssetScope report_scope("textures", path);
+    auto start = std::chrono::steady_clock::now();
+    bool written = false;
+    if (texture_processor_.Decode(path, &written)) {
+      journal_.Record(path);
+      if (written) {
+        timings_.Record(path, std::chrono::steady_clock::now() - start);
+      }
+    }
+  }
+  textures_stage.End();
+}
+
+bool AssetProcessor::IsCompleted(const std::filesystem::path& path) const {
+  if (!journal_.IsCompleted(path)) {
+    return false;
+  }
+  std::cout << "--> skipped (completed): " << path << std::endl;
+  return true;
+}
+
+std::vector<std::filesystem::path> AssetProcessor::CollectNotCompleted(
+    const std::set<std::filesystem::path>& paths, const char* action) const {
+  std::vector<std::filesystem::path> not_completed;
+  for (const auto& path : paths) {
+    if (!IsCompleted(path)) {
+      std::cout << "--> " << action << ": " << path << std::endl;
+      not_completed.push_back(path);
+    }
   }
+  return not_completed;
 }
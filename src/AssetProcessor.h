@@ -2,11 +2,17 @@
 #define FAITHFUL_UTILS_ASSETPROCESSOR_ASSETPROCESSOR_H
 
 #include <filesystem>
+#include <set>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #include "AssetLoadingThreadPool.h"
 #include "AssetsAnalyzer.h"
+#include "BatchIo.h"
 #include "ReplaceRequest.h"
+#include "AssetTimings.h"
+#include "RunJournal.h"
 
 #include "AudioProcessor.h"
 #include "ModelProcessor.h"
@@ -15,7 +21,8 @@
 class AssetProcessor {
  public:
   explicit AssetProcessor(
-      int thread_count = static_cast<int>(std::thread::hardware_concurrency()));
+      int thread_count = CpuTopology::Get().GetUsableCpuCount(),
+      ThreadPinning pinning = ThreadPinning::kNone);
 
   /// neither movable nor copyable because of AssetLoadingThreadPool
   AssetProcessor(const AssetProcessor& other) = delete;
@@ -28,15 +35,81 @@ class AssetProcessor {
                const std::filesystem::path& source,
                bool encode);
 
+  void SetAutoBlockSize(bool enabled) {
+    texture_processor_.SetAutoBlockSize(enabled);
+  }
+
+  /// zlib level of decoded .png, 0 is store-only
+  void SetPngLevel(int level) {
+    texture_processor_.SetPngLevel(level);
+  }
+
+  /// pack small textures into atlases
+  void SetAtlas(bool enabled) {
+    texture_processor_.SetAtlas(enabled);
+  }
+
+  /// encode standalone textures for each profile instead of defaults
+  void SetProfiles(std::vector<TextureProcessor::EncodeProfile> profiles) {
+    texture_processor_.SetProfiles(std::move(profiles));
+  }
+
+  /// "font_" textures as distance fields of at most max_size (0 - disabled)
+  void SetFontSdf(int max_size) {
+    texture_processor_.SetFontSdf(max_size);
+  }
+
+  /// "map_" textures as tiled virtual textures
+  void SetVirtualMaps(bool enabled) {
+    texture_processor_.SetVirtualMaps(enabled);
+  }
+
+  /// process only a part of source (see AssetsAnalyzer::SelectShard())
+  void SetShard(int shard_index, int shard_count) {
+    shard_index_ = shard_index;
+    shard_count_ = shard_count;
+  }
+
+  /// skip assets completed by the previous (interrupted) run,
+  /// see RunJournal
+  void SetResume(bool enabled) {
+    resume_ = enabled;
+  }
+
+  /// verify mode: encode + in-memory decompression & quality metrics
+  void SetVerify(bool enabled) {
+    texture_processor_.SetVerify(enabled);
+  }
+
+  /// returns false if any texture failed verification
+  bool WriteVerifyReport(const std::filesystem::path& path) const {
+    return texture_processor_.WriteVerifyReport(path);
+  }
+
  private:
   void EncodeAssets(AssetsAnalyzer& assets_analyzer);
   void DecodeAssets(AssetsAnalyzer& assets_analyzer);
 
+  /// already in journal (prints it)
+  bool IsCompleted(const std::filesystem::path& path) const;
+  /// for batched processing, prints action for each of them
+  std::vector<std::filesystem::path> CollectNotCompleted(
+      const std::set<std::filesystem::path>& paths, const char* action) const;
+
   AssetLoadingThreadPool thread_pool_;
+  /// uses thread_pool_ if io_uring isn't available
+  BatchIo batch_io_;
   ReplaceRequest replace_request_;
   AudioProcessor audio_processor_;
   TextureProcessor texture_processor_;
   ModelProcessor model_processor_;
+  RunJournal journal_;
+  /// of earlier runs for longest-job-first order, updated by this one
+  AssetTimings timings_;
+
+  int shard_index_ = 0;
+  int shard_count_ = 1;
+  bool resume_ = false;
 };
 
 #endif  // FAITHFUL_UTILS_ASSETPROCESSOR_ASSETPROCESSOR_H
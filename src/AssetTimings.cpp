@@ -0,0 +1,87 @@
+#include "AssetTimings.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+
+#include "AtomicFile.h"
+
+namespace {
+
+std::string MakeKey(const std::filesystem::path& source) {
+  return std::filesystem::absolute(source).lexically_normal().string();
+}
+
+}  // namespace
+
+void AssetTimings::Load(const std::filesystem::path& path, bool encode) {
+  path_ = path;
+  header_ = encode ? "faithful timings e" : "faithful timings d";
+  entries_.clear();
+  std::ifstream file(path);
+  std::string line;
+  if (!std::getline(file, line) || line != header_) {
+    return;
+  }
+  while (std::getline(file, line)) {
+    std::istringstream stream(line);
+    Entry entry;
+    char separator1, separator2;
+    std::string source;
+    if (stream >> entry.size >> separator1 >> entry.nanoseconds >>
+            separator2 &&
+        separator1 == ';' && separator2 == ';' &&
+        std::getline(stream, source) && !source.empty()) {
+      entries_[source] = entry;
+    }
+  }
+}
+
+uint64_t AssetTimings::Find(const std::filesystem::path& source) const {
+  std::error_code error;
+  auto size = std::filesystem::file_size(source, error);
+  if (error) {
+    return 0;
+  }
+  std::lock_guard lock(mu_);
+  auto entry = entries_.find(MakeKey(source));
+  if (entry == entries_.end() || entry->second.size != size) {
+    return 0;
+  }
+  return entry->second.nanoseconds;
+}
+
+void AssetTimings::Record(const std::filesystem::path& source,
+                          std::chrono::steady_clock::duration time) {
+  std::error_code error;
+  auto size = std::filesystem::file_size(source, error);
+  if (error) {
+    return;
+  }
+  auto nanoseconds = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(time).count());
+  std::lock_guard lock(mu_);
+  entries_[MakeKey(source)] = {size, nanoseconds};
+}
+
+bool AssetTimings::Save() const {
+  if (path_.empty()) {
+    return true;
+  }
+  AtomicFile new_file(path_);
+  std::ofstream file(new_file.GetTempPath());
+  {
+    std::lock_guard lock(mu_);
+    file << header_ << '\n';
+    for (const auto& [source, entry] : entries_) {
+      file << entry.size << ';' << entry.nanoseconds << ';' << source << '\n';
+    }
+  }
+  file.close();
+  if (!file || !new_file.Commit()) {
+    std::cerr << "Warning: unable to write timings " << path_ << std::endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,51 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_ASSETTIMINGS_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_ASSETTIMINGS_H
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+
+/// Processing time of source assets measured by earlier runs
+/// (destination/.timings), for longest-job-first scheduling (see
+/// AssetsAnalyzer::SortByCost()). Each line is size;nanoseconds;absolute
+/// path of the source; an entry of a source of other size is ignored.
+/// Loaded at the start of the run and rewritten (AtomicFile) by Save(),
+/// new measurements replace old ones. Record() is thread-safe.
+class AssetTimings {
+ public:
+  AssetTimings() = default;
+
+  AssetTimings(const AssetTimings&) = delete;
+  AssetTimings& operator=(const AssetTimings&) = delete;
+
+  AssetTimings(AssetTimings&&) = delete;
+  AssetTimings& operator=(AssetTimings&&) = delete;
+
+  /// timings of the other mode (encode/decode) are dropped
+  void Load(const std::filesystem::path& path, bool encode);
+
+  /// nanoseconds, 0 if unknown
+  uint64_t Find(const std::filesystem::path& source) const;
+
+  void Record(const std::filesystem::path& source,
+              std::chrono::steady_clock::duration time);
+
+  bool Save() const;
+
+ private:
+  struct Entry {
+    uint64_t size;
+    uint64_t nanoseconds;
+  };
+
+  /// by absolute path
+  std::map<std::string, Entry> entries_;
+  std::filesystem::path path_;
+  std::string header_;
+  mutable std::mutex mu_;
+};
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_ASSETTIMINGS_H
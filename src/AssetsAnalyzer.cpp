@@ -1,13 +1,24 @@
 #include "AssetsAnalyzer.h"
 
+#include <algorithm>
+#include <cstring>
 #include <exception>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <string>
+#include <tuple>
+
+#include "rapidjson/document.h"
+#include "stb_image.h"
 
 #include "../config/AssetFormats.h"
 
 AssetsAnalyzer::AssetsAnalyzer(
     const std::filesystem::path& path, bool encode)
-    : encode_(encode) {
+    : source_root_(std::filesystem::is_directory(path) ? path
+                                                       : path.parent_path()),
+      encode_(encode) {
   AnalyzePath(path);
 }
 
@@ -98,3 +109,180 @@ AssetsAnalyzer::AssetCategory AssetsAnalyzer::DeduceAssetCategory(
   }
   return AssetCategory::kUnknown;
 }
+
+void AssetsAnalyzer::SelectShard(int shard_index, int shard_count) {
+  if (shard_count <= 1) {
+    return;
+  }
+  /// processed by ModelProcessor together with the model
+  std::set<std::filesystem::path> model_images;
+  std::map<std::filesystem::path, uint64_t> model_costs;
+  for (const auto& model : models_to_process_) {
+    uint64_t cost = EstimateCost(model, AssetCategory::kModel);
+    for (const auto& image : ReadModelImages(model)) {
+      model_images.insert(image);
+      cost += EstimateCost(image, AssetCategory::kTexture);
+    }
+    model_costs[model] = cost;
+  }
+
+  struct Job {
+    uint64_t cost;
+    uint64_t hash;
+    std::filesystem::path path;
+    std::set<std::filesystem::path>* assets;
+  };
+  std::vector<Job> jobs;
+  auto add_jobs = [&](std::set<std::filesystem::path>& assets,
+                      AssetCategory category) {
+    for (const auto& path : assets) {
+      uint64_t cost = category == AssetCategory::kModel
+                          ? model_costs[path]
+                          : EstimateCost(path, category);
+      jobs.push_back({cost, StableHash(path.lexically_relative(source_root_)
+                                           .generic_string()),
+                      path, &assets});
+    }
+  };
+  add_jobs(music_to_process_, AssetCategory::kMusic);
+  add_jobs(sounds_to_process_, AssetCategory::kSound);
+  add_jobs(models_to_process_, AssetCategory::kModel);
+  std::erase_if(textures_to_process_, [&](const std::filesystem::path& path) {
+    return model_images.contains(path.lexically_normal());
+  });
+  add_jobs(textures_to_process_, AssetCategory::kTexture);
+
+  /// the most expensive first (longest processing time first), so shards
+  /// end up with almost equal cost; hash only makes order independent
+  /// of file system, path compared if hashes collide
+  std::sort(jobs.begin(), jobs.end(), [](const Job& lhs, const Job& rhs) {
+    return std::tie(rhs.cost, lhs.hash, lhs.path) <
+           std::tie(lhs.cost, rhs.hash, rhs.path);
+  });
+  std::vector<uint64_t> shard_costs(shard_count, 0);
+  uint64_t total_cost = 0;
+  std::size_t kept_count = 0;
+  for (const auto& job : jobs) {
+    auto shard = static_cast<int>(
+        std::min_element(shard_costs.begin(), shard_costs.end()) -
+        shard_costs.begin());
+    shard_costs[shard] += job.cost;
+    total_cost += job.cost;
+    if (shard == shard_index) {
+      ++kept_count;
+    } else {
+      job.assets->erase(job.path);
+    }
+  }
+  std::cout << "shard " << shard_index << "/" << shard_count << ": "
+            << kept_count << " of " << jobs.size() << " assets, cost "
+            << shard_costs[shard_index] << " of " << total_cost << std::endl;
+}
+
+void AssetsAnalyzer::SortByCost(std::vector<std::filesystem::path>& paths,
+                                const AssetTimings& timings) const {
+  struct Job {
+    uint64_t time;
+    uint64_t cost;
+    std::filesystem::path path;
+  };
+  std::vector<Job> jobs;
+  jobs.reserve(paths.size());
+  /// nanoseconds per unit of estimated cost
+  uint64_t measured_time = 0;
+  uint64_t measured_cost = 0;
+  for (auto& path : paths) {
+    auto category = DeduceAssetCategory(path);
+    uint64_t cost = EstimateCost(path, category);
+    if (category == AssetCategory::kModel) {
+      for (const auto& image : ReadModelImages(path)) {
+        cost += EstimateCost(image, AssetCategory::kTexture);
+      }
+    }
+    uint64_t time = timings.Find(path);
+    if (time != 0) {
+      measured_time += time;
+      measured_cost += cost;
+    }
+    jobs.push_back({time, cost, std::move(path)});
+  }
+  double rate = measured_cost != 0 ? static_cast<double>(measured_time) /
+                                         static_cast<double>(measured_cost)
+                                   : 1.0;
+  for (auto& job : jobs) {
+    if (job.time == 0) {
+      job.time = static_cast<uint64_t>(static_cast<double>(job.cost) * rate);
+    }
+  }
+  std::sort(jobs.begin(), jobs.end(), [](const Job& lhs, const Job& rhs) {
+    return std::tie(rhs.time, lhs.path) < std::tie(lhs.time, rhs.path);
+  });
+  for (std::size_t i = 0; i < jobs.size(); ++i) {
+    paths[i] = std::move(jobs[i].path);
+  }
+}
+
+uint64_t AssetsAnalyzer::EstimateCost(const std::filesystem::path& path,
+                                      AssetCategory category) const {
+  /// compression time is proportional to texels, so decoded size of them
+  if (encode_ && category == AssetCategory::kTexture) {
+    int image_x, image_y, image_c;
+    if (stbi_info(path.string().c_str(), &image_x, &image_y, &image_c)) {
+      uint64_t texel_size = stbi_is_hdr(path.string().c_str()) ? 16 : 4;
+      return static_cast<uint64_t>(image_x) * image_y * texel_size;
+    }
+  }
+  std::error_code error;
+  auto file_size = std::filesystem::file_size(path, error);
+  return error ? 0 : file_size;
+}
+
+std::vector<std::filesystem::path> AssetsAnalyzer::ReadModelImages(
+    const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  /// glb: 12 bytes header, then the first chunk (length, type) is json;
+  /// only it is read, not binary chunks
+  char header[20];
+  std::string json;
+  if (file.read(header, sizeof(header)) &&
+      std::memcmp(header, "glTF", 4) == 0) {
+    uint32_t chunk_length;
+    std::memcpy(&chunk_length, header + 12, sizeof(chunk_length));
+    json.resize(chunk_length);
+    file.read(json.data(), chunk_length);
+    json.resize(static_cast<std::size_t>(file.gcount()));
+  } else {
+    file.clear();
+    file.seekg(0);
+    json.assign(std::istreambuf_iterator<char>(file),
+                std::istreambuf_iterator<char>());
+  }
+  rapidjson::Document document;
+  document.Parse(json.c_str());
+  std::vector<std::filesystem::path> images;
+  if (document.HasParseError() || !document.IsObject() ||
+      !document.HasMember("images") || !document["images"].IsArray()) {
+    return images;
+  }
+  for (const auto& image : document["images"].GetArray()) {
+    if (!image.IsObject() || !image.HasMember("uri") ||
+        !image["uri"].IsString()) {
+      continue;
+    }
+    std::string uri = image["uri"].GetString();
+    if (uri.starts_with("data:")) {
+      continue;
+    }
+    images.push_back((path.parent_path() / uri).lexically_normal());
+  }
+  return images;
+}
+
+uint64_t AssetsAnalyzer::StableHash(const std::string& value) {
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : value) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
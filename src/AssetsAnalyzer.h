@@ -1,10 +1,14 @@
 #ifndef FAITHFUL_UTILS_ASSETPROCESSOR_ASSETSANALYZER_H
 #define FAITHFUL_UTILS_ASSETPROCESSOR_ASSETSANALYZER_H
 
+#include <cstdint>
 #include <filesystem>
 #include <set>
+#include <string>
+#include <vector>
 
 #include "AssetLoadingThreadPool.h"
+#include "AssetTimings.h"
 #include "ReplaceRequest.h"
 
 /// Collects full paths of all assets, that should be processed.
@@ -35,6 +39,25 @@ class AssetsAnalyzer {
     return textures_to_process_;
   }
 
+  /// --shard i/N: keeps only assets of the shard_index. Assets are
+  /// sorted by estimated cost (texels, file size) and stable hash of the
+  /// path relative to source, then each one goes to the least loaded
+  /// shard, so every process computes the same split without any
+  /// coordination. Textures referenced by models go with their model.
+  void SelectShard(int shard_index, int shard_count);
+
+  /// longest job first: the most expensive first, by time measured by
+  /// earlier runs or, for new and changed assets, by estimated cost (see
+  /// SelectShard()) scaled to time by the rate of the measured ones among
+  /// paths; models include their images. Shards aren't split by timings,
+  /// because each shard has its own destination (and so timings)
+  void SortByCost(std::vector<std::filesystem::path>& paths,
+                  const AssetTimings& timings) const;
+
+  /// images of .gltf/.glb which are separate files (not embedded)
+  static std::vector<std::filesystem::path> ReadModelImages(
+      const std::filesystem::path& path);
+
  private:
   enum class AssetCategory {
     kMusic,
@@ -53,11 +76,19 @@ class AssetsAnalyzer {
 
   AssetCategory DeduceAssetCategory(const std::filesystem::path& path) const;
 
+  uint64_t EstimateCost(const std::filesystem::path& path,
+                        AssetCategory category) const;
+  /// FNV-1a, the same on every platform (unlike std::hash)
+  static uint64_t StableHash(const std::string& value);
+
   std::set<std::filesystem::path> music_to_process_;
   std::set<std::filesystem::path> sounds_to_process_;
   std::set<std::filesystem::path> models_to_process_;
   std::set<std::filesystem::path> textures_to_process_;
 
+  /// for StableHash of relative paths
+  std::filesystem::path source_root_;
+
   bool encode_;
 };
 
@@ -0,0 +1,178 @@
+#include "AssetsInfo.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#include "../config/AssetFormats.h"
+#include "AtomicFile.h"
+
+bool IsAssetFile(const std::filesystem::path& path, bool is_models_dir) {
+  /// info.txt itself & reports (e.g. verify_report.txt) aren't assets,
+  /// neither seek tables of music, page tables of virtual textures, journal
+  /// and temporary files (hidden ones)
+  if (path.extension() == ".txt" ||
+      path.extension() == faithful::config::kMusicSeekExtension ||
+      path.extension() == faithful::config::kTexVirtualIndexExtension ||
+      path.filename().string().starts_with('.')) {
+    return false;
+  }
+  /// only .gltf is listed, its .bin & textures are parts of it
+  return !is_models_dir || path.extension() == ".gltf";
+}
+
+std::set<std::string> CollectAssetsInfoNames(const std::filesystem::path& path,
+                                             bool is_models_dir) {
+  std::set<std::string> all_assets;
+  for (auto&& entry : std::filesystem::directory_iterator(path)) {
+    if (entry.is_regular_file() && IsAssetFile(entry.path(), is_models_dir)) {
+      all_assets.insert(entry.path().filename().string());
+    }
+  }
+  return all_assets;
+}
+
+namespace {
+
+void AppendAssetsInfo(const std::filesystem::path& path,
+                      const std::set<std::string>& all_assets,
+                      bool is_models_dir) {
+  std::filesystem::path assets_info_path{path / "info.txt"};
+  int last_id{0};
+  std::ofstream new_info_file;
+  std::vector<std::string> new_assets;
+  if (std::filesystem::exists(assets_info_path)) {
+    std::set<std::string> old_assets;
+    std::ifstream old_info_file(assets_info_path.c_str());
+    std::string line;
+    std::string field;
+    while (std::getline(old_info_file, line)) {
+      std::stringstream line_stream{line};
+      std::getline(line_stream, field, ';');
+      last_id = std::max(last_id, std::stoi(field));
+      std::getline(line_stream, field, ';');
+      old_assets.insert(field);
+    }
+    std::set_difference(all_assets.begin(), all_assets.end(),
+                        old_assets.begin(), old_assets.end(),
+                        std::back_inserter(new_assets));
+    if (new_assets.empty()) {
+      return;
+    }
+    new_info_file.open(assets_info_path.c_str(), std::ios::app);
+  } else {
+    new_info_file.open(assets_info_path.c_str());
+    std::copy(all_assets.begin(), all_assets.end(), std::back_inserter(new_assets));
+  }
+  for (const auto& asset : new_assets) {
+    std::string new_entry;
+    new_entry += std::to_string(++last_id);
+    new_entry += ';';
+    new_entry += asset;
+    new_entry += ';';
+    if (is_models_dir) {
+      /// type & sounds_id should be added by user manually
+      new_entry += ";;";
+    }
+    new_entry += '\n';
+    new_info_file.write(new_entry.data(), static_cast<long>(new_entry.size()));
+  }
+}
+
+/// everything after id;name; is replaced, so measured again asset gets
+/// new values; the file is rewritten only if something is changed
+void WriteLoudnessIntoAssetsInfo(const std::filesystem::path& path) {
+  auto loudness = ReadAssetsLoudness(path);
+  std::filesystem::path assets_info_path{path / "info.txt"};
+  if (loudness.empty() || !std::filesystem::exists(assets_info_path)) {
+    return;
+  }
+  std::ifstream old_info_file(assets_info_path.c_str());
+  std::string updated;
+  bool changed = false;
+  std::string line;
+  while (std::getline(old_info_file, line)) {
+    std::stringstream line_stream{line};
+    std::string id;
+    std::string name;
+    std::getline(line_stream, id, ';');
+    std::getline(line_stream, name, ';');
+    auto entry = loudness.find(name);
+    if (entry != loudness.end()) {
+      auto new_line = id + ';' + name + ';' + entry->second;
+      changed |= new_line != line;
+      line = std::move(new_line);
+    }
+    updated += line;
+    updated += '\n';
+  }
+  old_info_file.close();
+  if (!changed) {
+    return;
+  }
+  AtomicFile new_file(assets_info_path);
+  std::ofstream new_info_file(new_file.GetTempPath());
+  new_info_file.write(updated.data(), static_cast<long>(updated.size()));
+  new_info_file.close();
+  if (!new_info_file || !new_file.Commit()) {
+    std::cerr << "Warning: unable to write loudness into " << assets_info_path
+              << std::endl;
+  }
+}
+
+}  // namespace
+
+void UpdateAssetsInfo(const std::filesystem::path& path,
+                      const std::set<std::string>& all_assets,
+                      bool is_models_dir) {
+  AppendAssetsInfo(path, all_assets, is_models_dir);
+  if (!is_models_dir) {
+    WriteLoudnessIntoAssetsInfo(path);
+  }
+}
+
+void UpdateAssetsInfo(const std::filesystem::path& path, bool is_models_dir) {
+  if (!std::filesystem::exists(path)) {
+    return;
+  }
+  UpdateAssetsInfo(path, CollectAssetsInfoNames(path, is_models_dir),
+                   is_models_dir);
+}
+
+std::map<std::string, std::string> ReadAssetsLoudness(
+    const std::filesystem::path& path) {
+  std::map<std::string, std::string> loudness;
+  std::ifstream file(path / faithful::config::kAudioLoudnessName);
+  std::string line;
+  while (std::getline(file, line)) {
+    auto separator = line.find(';');
+    if (separator != std::string::npos && separator != 0) {
+      loudness[line.substr(0, separator)] = line.substr(separator + 1);
+    }
+  }
+  return loudness;
+}
+
+bool WriteAssetsLoudness(const std::filesystem::path& path,
+                         const std::map<std::string, std::string>& loudness) {
+  auto entries = ReadAssetsLoudness(path);
+  for (const auto& [name, fields] : loudness) {
+    entries[name] = fields;
+  }
+  auto loudness_path = path / faithful::config::kAudioLoudnessName;
+  AtomicFile new_file(loudness_path);
+  std::ofstream file(new_file.GetTempPath());
+  for (const auto& [name, fields] : entries) {
+    file << name << ';' << fields << '\n';
+  }
+  file.close();
+  if (!file || !new_file.Commit()) {
+    std::cerr << "Warning: unable to write loudness " << loudness_path
+              << std::endl;
+    return false;
+  }
+  return true;
+}
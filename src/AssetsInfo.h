@@ -0,0 +1,52 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_ASSETSINFO_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_ASSETSINFO_H
+
+#include <array>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+
+/// info.txt inside each destination category directory.
+/// by default all assets have such info: id;name;
+/// except models: id;name;type;sound_ids;
+/// and music & sounds: id;name;loudness;true_peak;loudness_range;
+/// (LUFS, dBTP, LU, see src/Loudness.h; empty if silent or not measured)
+/// ids are never reassigned: new assets are appended (sorted by name)
+/// with ids after the last used one
+
+/// category directories (relative to destination) with info.txt,
+/// except "models" which has slightly different info.txt
+inline constexpr std::array<std::string_view, 5> kAssetsInfoDirs{
+    "music", "sounds", "maps", "noises", ""};
+inline constexpr std::string_view kAssetsInfoModelsDir{"models"};
+
+/// whether the file (inside of a category directory) is an asset
+/// which gets an id in info.txt
+bool IsAssetFile(const std::filesystem::path& path, bool is_models_dir = false);
+
+/// names of assets inside of path (not recursive)
+std::set<std::string> CollectAssetsInfoNames(const std::filesystem::path& path,
+                                             bool is_models_dir = false);
+
+/// appends assets which aren't in path/info.txt yet; loudness of
+/// path/.loudness (faithful::config::kAudioLoudnessName) is written into
+/// lines of its assets
+void UpdateAssetsInfo(const std::filesystem::path& path,
+                      const std::set<std::string>& all_assets,
+                      bool is_models_dir = false);
+
+/// the same for all assets found inside of path
+void UpdateAssetsInfo(const std::filesystem::path& path,
+                      bool is_models_dir = false);
+
+/// name -> "loudness;true_peak;loudness_range;" of path/.loudness
+std::map<std::string, std::string> ReadAssetsLoudness(
+    const std::filesystem::path& path);
+
+/// replaces (or adds) entries of path/.loudness, the rest are kept
+bool WriteAssetsLoudness(const std::filesystem::path& path,
+                         const std::map<std::string, std::string>& loudness);
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_ASSETSINFO_H
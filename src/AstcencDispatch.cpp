@@ -0,0 +1,101 @@
+#include "AstcencDispatch.h"
+
+#ifdef FAITHFUL_ASTCENC_DISPATCH
+
+namespace astcenc_sse2 {
+extern const AstcencBackend kBackend;
+}  // namespace astcenc_sse2
+namespace astcenc_sse41 {
+extern const AstcencBackend kBackend;
+}  // namespace astcenc_sse41
+namespace astcenc_avx2 {
+extern const AstcencBackend kBackend;
+}  // namespace astcenc_avx2
+
+namespace {
+
+/// same requirements as astcenc checks at startup of its own builds
+const AstcencBackend& SelectBackend() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt") &&
+      __builtin_cpu_supports("f16c")) {
+    return astcenc_avx2::kBackend;
+  }
+  if (__builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("popcnt")) {
+    return astcenc_sse41::kBackend;
+  }
+  return astcenc_sse2::kBackend;
+}
+
+const AstcencBackend& Backend() {
+  static const AstcencBackend& backend = SelectBackend();
+  return backend;
+}
+
+}  // namespace
+
+const char* AstcencBackendName() {
+  return Backend().name;
+}
+
+astcenc_error astcenc_config_init(astcenc_profile profile,
+                                  unsigned int block_x, unsigned int block_y,
+                                  unsigned int block_z, float quality,
+                                  unsigned int flags, astcenc_config* config) {
+  return Backend().config_init(profile, block_x, block_y, block_z, quality,
+                               flags, config);
+}
+
+astcenc_error astcenc_context_alloc(const astcenc_config* config,
+                                    unsigned int thread_count,
+                                    astcenc_context** context) {
+  return Backend().context_alloc(config, thread_count, context);
+}
+
+astcenc_error astcenc_compress_image(astcenc_context* context,
+                                     astcenc_image* image,
+                                     const astcenc_swizzle* swizzle,
+                                     uint8_t* data_out, size_t data_len,
+                                     unsigned int thread_index) {
+  return Backend().compress_image(context, image, swizzle, data_out, data_len,
+                                  thread_index);
+}
+
+astcenc_error astcenc_compress_reset(astcenc_context* context) {
+  return Backend().compress_reset(context);
+}
+
+astcenc_error astcenc_decompress_image(astcenc_context* context,
+                                       const uint8_t* data, size_t data_len,
+                                       astcenc_image* image_out,
+                                       const astcenc_swizzle* swizzle,
+                                       unsigned int thread_index) {
+  return Backend().decompress_image(context, data, data_len, image_out,
+                                    swizzle, thread_index);
+}
+
+astcenc_error astcenc_decompress_reset(astcenc_context* context) {
+  return Backend().decompress_reset(context);
+}
+
+void astcenc_context_free(astcenc_context* context) {
+  Backend().context_free(context);
+}
+
+astcenc_error astcenc_get_block_info(astcenc_context* context,
+                                     const uint8_t data[16],
+                                     astcenc_block_info* info) {
+  return Backend().get_block_info(context, data, info);
+}
+
+const char* astcenc_get_error_string(astcenc_error status) {
+  return Backend().get_error_string(status);
+}
+
+#else
+
+const char* AstcencBackendName() {
+  return "native";
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_ASTCENCDISPATCH_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_ASTCENCDISPATCH_H
+
+#include "astcenc.h"
+
+/// Runtime choice of astc-encoder build on x86-64 (gcc/clang): the encoder
+/// is compiled for SSE2, SSE4.1 and AVX2, each copy in its own namespace
+/// (see src/AstcencVariant.h), and AstcencDispatch.cpp defines the global
+/// astcenc_*() functions of astcenc.h, which forward to the best variant
+/// that cpu supports. So the binary runs on any x86-64 agent, and callers
+/// (TextureProcessor) don't know about variants.
+/// Builds are invariant (ASTCENC_INVARIANCE), so every variant produces the
+/// same blocks. Elsewhere astcenc-native-static is linked directly.
+
+/// the part of astcenc.h used by the processor, per variant
+struct AstcencBackend {
+  const char* name;
+  astcenc_error (*config_init)(astcenc_profile profile, unsigned int block_x,
+                               unsigned int block_y, unsigned int block_z,
+                               float quality, unsigned int flags,
+                               astcenc_config* config);
+  astcenc_error (*context_alloc)(const astcenc_config* config,
+                                 unsigned int thread_count,
+                                 astcenc_context** context);
+  astcenc_error (*compress_image)(astcenc_context* context,
+                                  astcenc_image* image,
+                                  const astcenc_swizzle* swizzle,
+                                  uint8_t* data_out, size_t data_len,
+                                  unsigned int thread_index);
+  astcenc_error (*compress_reset)(astcenc_context* context);
+  astcenc_error (*decompress_image)(astcenc_context* context,
+                                    const uint8_t* data, size_t data_len,
+                                    astcenc_image* image_out,
+                                    const astcenc_swizzle* swizzle,
+                                    unsigned int thread_index);
+  astcenc_error (*decompress_reset)(astcenc_context* context);
+  void (*context_free)(astcenc_context* context);
+  astcenc_error (*get_block_info)(astcenc_context* context,
+                                  const uint8_t data[16],
+                                  astcenc_block_info* info);
+  const char* (*get_error_string)(astcenc_error status);
+};
+
+/// "avx2", "sse4.1", "sse2" or "native" (not dispatched)
+const char* AstcencBackendName();
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_ASTCENCDISPATCH_H
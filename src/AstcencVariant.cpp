@@ -0,0 +1,56 @@
+#include "AstcencVariant.h"
+
+#include "AstcencDispatch.h"
+
+/// the context is allocated by the variant, so it's always of its type
+namespace FAITHFUL_ASTCENC_VARIANT {
+
+namespace {
+
+astcenc_context* Context(::astcenc_context* context) {
+  return reinterpret_cast<astcenc_context*>(context);
+}
+
+}  // namespace
+
+extern const AstcencBackend kBackend;
+
+const AstcencBackend kBackend{
+    FAITHFUL_ASTCENC_VARIANT_NAME,
+    astcenc_config_init,
+    [](const astcenc_config* config, unsigned int thread_count,
+       ::astcenc_context** context) {
+      astcenc_context* variant_context = nullptr;
+      auto status =
+          astcenc_context_alloc(config, thread_count, &variant_context);
+      *context = reinterpret_cast<::astcenc_context*>(variant_context);
+      return status;
+    },
+    [](::astcenc_context* context, astcenc_image* image,
+       const astcenc_swizzle* swizzle, uint8_t* data_out, size_t data_len,
+       unsigned int thread_index) {
+      return astcenc_compress_image(Context(context), image, swizzle,
+                                    data_out, data_len, thread_index);
+    },
+    [](::astcenc_context* context) {
+      return astcenc_compress_reset(Context(context));
+    },
+    [](::astcenc_context* context, const uint8_t* data, size_t data_len,
+       astcenc_image* image_out, const astcenc_swizzle* swizzle,
+       unsigned int thread_index) {
+      return astcenc_decompress_image(Context(context), data, data_len,
+                                      image_out, swizzle, thread_index);
+    },
+    [](::astcenc_context* context) {
+      return astcenc_decompress_reset(Context(context));
+    },
+    [](::astcenc_context* context) {
+      astcenc_context_free(Context(context));
+    },
+    [](::astcenc_context* context, const uint8_t data[16],
+       astcenc_block_info* info) {
+      return astcenc_get_block_info(Context(context), data, info);
+    },
+    astcenc_get_error_string};
+
+}  // namespace FAITHFUL_ASTCENC_VARIANT
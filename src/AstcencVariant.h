@@ -0,0 +1,76 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_ASTCENCVARIANT_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_ASTCENCVARIANT_H
+
+/// Included first by every source of an astc-encoder variant, which is
+/// compiled with its ISA flags and FAITHFUL_ASTCENC_VARIANT namespace
+/// (see CMakeLists.txt and src/AstcencVariant.cpp.in).
+/// Standard headers and astcenc.h are included here, outside of the
+/// namespace, so their include guards keep them global when astcenc sources
+/// include them again: public types (astcenc_config, astcenc_image, ...)
+/// are shared by all variants, everything else is per variant.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cfenv>
+#include <cmath>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "astcenc.h"
+
+namespace FAITHFUL_ASTCENC_VARIANT {
+
+/// abs(vfloat4) etc. of the variant would hide abs(int) otherwise
+using std::abs;
+
+/// defined by astcenc_internal_entry.h, unrelated to global ::astcenc_context
+struct astcenc_context;
+
+/// the api of the variant, declared before astcenc_entry.cpp calls it,
+/// so it doesn't resolve to the global (dispatched) functions
+astcenc_error astcenc_config_init(astcenc_profile profile,
+                                  unsigned int block_x, unsigned int block_y,
+                                  unsigned int block_z, float quality,
+                                  unsigned int flags, astcenc_config* config);
+astcenc_error astcenc_context_alloc(const astcenc_config* config,
+                                    unsigned int thread_count,
+                                    astcenc_context** context);
+astcenc_error astcenc_compress_image(astcenc_context* context,
+                                     astcenc_image* image,
+                                     const astcenc_swizzle* swizzle,
+                                     uint8_t* data_out, size_t data_len,
+                                     unsigned int thread_index);
+astcenc_error astcenc_compress_reset(astcenc_context* context);
+astcenc_error astcenc_decompress_image(astcenc_context* context,
+                                       const uint8_t* data, size_t data_len,
+                                       astcenc_image* image_out,
+                                       const astcenc_swizzle* swizzle,
+                                       unsigned int thread_index);
+astcenc_error astcenc_decompress_reset(astcenc_context* context);
+void astcenc_context_free(astcenc_context* context);
+astcenc_error astcenc_get_block_info(astcenc_context* context,
+                                     const uint8_t data[16],
+                                     astcenc_block_info* info);
+const char* astcenc_get_error_string(astcenc_error status);
+
+}  // namespace FAITHFUL_ASTCENC_VARIANT
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_ASTCENCVARIANT_H
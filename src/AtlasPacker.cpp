@@ -0,0 +1,82 @@
+#include "AtlasPacker.h"
+
+#include <algorithm>
+
+AtlasPacker::AtlasPacker(int alignment, int min_page_size, int max_page_size)
+    : alignment_(alignment),
+      min_page_size_(min_page_size),
+      max_page_size_(max_page_size) {}
+
+AtlasPacker::Result AtlasPacker::Pack(const std::vector<Rect>& rects) const {
+  Result result;
+  result.placements.assign(rects.size(), {-1, 0, 0});
+
+  std::vector<int> order;
+  for (int i = 0; i < static_cast<int>(rects.size()); ++i) {
+    if (rects[i].width <= max_page_size_ && rects[i].height <= max_page_size_) {
+      order.push_back(i);
+    }
+  }
+  /// tallest first is what makes skyline packing tight;
+  /// stable, so equal rects keep the input order
+  std::stable_sort(order.begin(), order.end(), [&](int lhs, int rhs) {
+    if (rects[lhs].height != rects[rhs].height) {
+      return rects[lhs].height > rects[rhs].height;
+    }
+    return rects[lhs].width > rects[rhs].width;
+  });
+
+  while (!order.empty()) {
+    int page = static_cast<int>(result.page_sizes.size());
+    /// the smallest page for the rest; if even max page isn't enough,
+    /// it's filled and the rest goes to the next one
+    int page_size = min_page_size_;
+    auto placed = PackPage(rects, order, page_size, page);
+    while (placed.size() < order.size() && page_size < max_page_size_) {
+      page_size *= 2;
+      placed = PackPage(rects, order, page_size, page);
+    }
+    result.page_sizes.push_back(page_size);
+
+    std::vector<bool> is_placed(rects.size(), false);
+    for (const auto& [index, placement] : placed) {
+      result.placements[index] = placement;
+      is_placed[index] = true;
+    }
+    std::erase_if(order, [&](int index) { return is_placed[index]; });
+  }
+  return result;
+}
+
+std::vector<std::pair<int, AtlasPacker::Placement>> AtlasPacker::PackPage(
+    const std::vector<Rect>& rects, const std::vector<int>& order,
+    int page_size, int page) const {
+  /// in units of alignment: skyline is the height of each column
+  int columns = page_size / alignment_;
+  std::vector<int> skyline(columns, 0);
+  std::vector<std::pair<int, Placement>> placed;
+  for (int index : order) {
+    int width = (rects[index].width + alignment_ - 1) / alignment_;
+    int height = (rects[index].height + alignment_ - 1) / alignment_;
+    if (width > columns || height > columns) {
+      continue;
+    }
+    /// the lowest position, the leftmost of equal ones
+    int best_x = -1;
+    int best_y = columns;
+    for (int x = 0; x + width <= columns; ++x) {
+      int y = *std::max_element(skyline.begin() + x,
+                                skyline.begin() + x + width);
+      if (y + height <= columns && y < best_y) {
+        best_x = x;
+        best_y = y;
+      }
+    }
+    if (best_x < 0) {
+      continue;
+    }
+    std::fill_n(skyline.begin() + best_x, width, best_y + height);
+    placed.push_back({index, {page, best_x * alignment_, best_y * alignment_}});
+  }
+  return placed;
+}
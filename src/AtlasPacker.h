@@ -0,0 +1,49 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_ATLASPACKER_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_ATLASPACKER_H
+
+#include <utility>
+#include <vector>
+
+/// Skyline (bottom-left) packing of rectangles into square power-of-two
+/// pages. All positions are multiples of alignment (astc block size), so
+/// no block is shared by two rectangles.
+/// Deterministic: the same sizes in the same order give the same result,
+/// so unchanged atlases stay the same between builds.
+class AtlasPacker {
+ public:
+  struct Rect {
+    int width;
+    int height;
+  };
+
+  struct Placement {
+    /// -1 if rect is larger than max page
+    int page;
+    int x;
+    int y;
+  };
+
+  struct Result {
+    /// side of each page
+    std::vector<int> page_sizes;
+    /// in the order of the input rects
+    std::vector<Placement> placements;
+  };
+
+  AtlasPacker(int alignment, int min_page_size, int max_page_size);
+
+  Result Pack(const std::vector<Rect>& rects) const;
+
+ private:
+  /// places as many of rects (in the given order) as possible into one page;
+  /// returns placed indices with their placements
+  std::vector<std::pair<int, Placement>> PackPage(
+      const std::vector<Rect>& rects, const std::vector<int>& order,
+      int page_size, int page) const;
+
+  int alignment_;
+  int min_page_size_;
+  int max_page_size_;
+};
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_ATLASPACKER_H
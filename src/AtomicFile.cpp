@@ -0,0 +1,82 @@
+#include "AtomicFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+AtomicFile::AtomicFile(const std::filesystem::path& path) : path_(path) {
+  /// unique within the process, several writers may work in parallel
+  static std::atomic<uint64_t> counter{0};
+  auto id = counter.fetch_add(1, std::memory_order_relaxed);
+  auto filename = path.filename().string();
+  auto id_string = std::to_string(id);
+  std::string temp_name;
+  /// 2 dots & ".part"
+  temp_name.reserve(filename.size() + id_string.size() + 7);
+  temp_name += '.';
+  temp_name += filename;
+  temp_name += '.';
+  temp_name += id_string;
+  temp_name += ".part";
+  temp_path_ = path.parent_path() / temp_name;
+}
+
+AtomicFile::~AtomicFile() {
+  if (!committed_) {
+    std::error_code error;
+    std::filesystem::remove(temp_path_, error);
+  }
+}
+
+bool AtomicFile::Commit() {
+  std::error_code error;
+  std::filesystem::rename(temp_path_, path_, error);
+  if (error) {
+    std::cerr << "Error: failed to publish " << path_ << ": "
+              << error.message() << std::endl;
+    return false;
+  }
+  committed_ = true;
+  return true;
+}
+
+bool AtomicFile::IsTempPath(const std::filesystem::path& path) {
+  /// .<filename>.<n>.part
+  auto name = path.filename().string();
+  constexpr std::string_view kSuffix{".part"};
+  if (name.size() < 1 + 1 + 1 + 1 + kSuffix.size() ||
+      !name.starts_with('.') || !name.ends_with(kSuffix)) {
+    return false;
+  }
+  name.resize(name.size() - kSuffix.size());
+  auto dot = name.rfind('.');
+  /// neither filename nor id is empty
+  if (dot == std::string::npos || dot < 2 || dot + 1 == name.size()) {
+    return false;
+  }
+  return std::all_of(name.begin() + static_cast<std::ptrdiff_t>(dot) + 1,
+                     name.end(), [](char c) { return c >= '0' && c <= '9'; });
+}
+
+void AtomicFile::RemoveStaleTempFiles(const std::filesystem::path& path) {
+  if (!std::filesystem::is_directory(path)) {
+    return;
+  }
+  /// removing while iterating invalidates the iterator
+  std::vector<std::filesystem::path> stale;
+  for (const auto& entry :
+       std::filesystem::recursive_directory_iterator(path)) {
+    if (entry.is_regular_file() && IsTempPath(entry.path())) {
+      stale.push_back(entry.path());
+    }
+  }
+  for (const auto& stale_path : stale) {
+    std::error_code error;
+    std::filesystem::remove(stale_path, error);
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_ATOMICFILE_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_ATOMICFILE_H
+
+#include <filesystem>
+
+/// Output file written under a temporary name in the same directory
+/// (.<filename>.<n>.part) and renamed into the final path by Commit(),
+/// so killed process never leaves truncated asset under the final name.
+/// Not committed temporary file is removed by destructor; leftovers of
+/// killed runs are removed by RemoveStaleTempFiles().
+class AtomicFile {
+ public:
+  explicit AtomicFile(const std::filesystem::path& path);
+
+  ~AtomicFile();
+
+  AtomicFile(const AtomicFile&) = delete;
+  AtomicFile& operator=(const AtomicFile&) = delete;
+
+  AtomicFile(AtomicFile&&) = delete;
+  AtomicFile& operator=(AtomicFile&&) = delete;
+
+  /// where the data should be written
+  const std::filesystem::path& GetTempPath() const {
+    return temp_path_;
+  }
+
+  /// replaces the final file; returns false (and removes temporary file)
+  /// if rename failed
+  bool Commit();
+
+  /// temporary files (.<filename>.<n>.part, see above) inside path
+  /// (recursive); model staging directories are left to ModelProcessor
+  static bool IsTempPath(const std::filesystem::path& path);
+  static void RemoveStaleTempFiles(const std::filesystem::path& path);
+
+ private:
+  std::filesystem::path path_;
+  std::filesystem::path temp_path_;
+  bool committed_{false};
+};
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_ATOMICFILE_H
@@ -1,44 +1,615 @@
 #include "AudioProcessor.h"
 
-AudioProcessor::AudioProcessor(
-    ReplaceRequest& replace_request)
-    : replace_request_(replace_request) {}
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <system_error>
 
+#include "dr_wav.h"
+/// callbacks of the header are unused (ov_fopen)
+#define OV_EXCLUDE_STATIC_CALLBACKS
+#include "vorbis/vorbisfile.h"
 
-void AudioProcessor::EncodeMusic(const std::filesystem::path& path) {
-  std::string out_filename =
-      (music_destination_path_ / path.filename()).string();
-  if (std::filesystem::exists(out_filename)) {
-    std::string request{out_filename};
-    request += "\nalready exist. Do you want to replace it?";
-    if (!replace_request_(std::move(request))) {
-      return;
+#include "../config/AssetFormats.h"
+#include "AssetsInfo.h"
+#include "AtomicFile.h"
+#include "ImaAdpcm.h"
+#include "Loudness.h"
+#include "OggSeekIndex.h"
+#include "RunReport.h"
+#include "Trace.h"
+
+namespace {
+
+enum class SoundConversion {
+  kWritten,
+  /// nothing to convert, copied as is
+  kCopy,
+  kFailed
+};
+
+struct SoundResult {
+  SoundConversion conversion{SoundConversion::kFailed};
+  uint64_t bytes_out{0};
+  double wall_seconds{0.0};
+};
+
+void AppendLe(std::vector<uint8_t>& data, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    data.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+void AppendTag(std::vector<uint8_t>& data, const char* tag) {
+  data.insert(data.end(), tag, tag + 4);
+}
+
+/// RIFF header with fmt (and fact for compressed) chunk, without data
+std::vector<uint8_t> WavHeader(uint16_t format_tag, int channels,
+                               uint32_t sample_rate, uint32_t byte_rate,
+                               int block_align, int bits_per_sample,
+                               uint64_t frame_count, std::size_t data_size) {
+  bool adpcm = format_tag == DR_WAVE_FORMAT_DVI_ADPCM;
+  uint32_t fmt_size = adpcm ? 20 : 16;
+  uint32_t fact_size = adpcm ? 12 : 0;
+  std::vector<uint8_t> header;
+  /// RIFF, WAVE, chunk headers of fmt & data, then fmt and fact bodies
+  header.reserve(12 + 8 + fmt_size + fact_size + 8);
+  AppendTag(header, "RIFF");
+  AppendLe(header, static_cast<uint32_t>(4 + 8 + fmt_size + fact_size + 8 +
+                                         data_size),
+           4);
+  AppendTag(header, "WAVE");
+  AppendTag(header, "fmt ");
+  AppendLe(header, fmt_size, 4);
+  AppendLe(header, format_tag, 2);
+  AppendLe(header, static_cast<uint32_t>(channels), 2);
+  AppendLe(header, sample_rate, 4);
+  AppendLe(header, byte_rate, 4);
+  AppendLe(header, static_cast<uint32_t>(block_align), 2);
+  AppendLe(header, static_cast<uint32_t>(bits_per_sample), 2);
+  if (adpcm) {
+    /// extra bytes: frames per block
+    AppendLe(header, 2, 2);
+    AppendLe(header,
+             static_cast<uint32_t>(
+                 ImaAdpcmFramesPerBlock(block_align, channels)),
+             2);
+    /// the last block is padded, so the real length is here
+    AppendTag(header, "fact");
+    AppendLe(header, 4, 4);
+    AppendLe(header, static_cast<uint32_t>(frame_count), 4);
+  }
+  AppendTag(header, "data");
+  AppendLe(header, static_cast<uint32_t>(data_size), 4);
+  return header;
+}
+
+std::vector<uint8_t> ImaAdpcmWav(const std::vector<int16_t>& frames,
+                                 int channels, uint32_t sample_rate) {
+  int block_align = faithful::config::kSoundAdpcmBlockBytes * channels;
+  std::size_t frame_count = frames.size() / channels;
+  auto data = EncodeImaAdpcm(frames.data(), frame_count, channels,
+                             block_align);
+  auto byte_rate = static_cast<uint32_t>(
+      static_cast<uint64_t>(sample_rate) * block_align /
+      ImaAdpcmFramesPerBlock(block_align, channels));
+  auto file = WavHeader(DR_WAVE_FORMAT_DVI_ADPCM, channels, sample_rate,
+                        byte_rate, block_align, 4, frame_count, data.size());
+  file.insert(file.end(), data.begin(), data.end());
+  return file;
+}
+
+std::vector<uint8_t> PcmWav(const std::vector<int16_t>& frames, int channels,
+                            uint32_t sample_rate) {
+  std::size_t data_size = frames.size() * sizeof(int16_t);
+  auto file = WavHeader(DR_WAVE_FORMAT_PCM, channels, sample_rate,
+                        sample_rate * channels * 2, channels * 2, 16,
+                        frames.size() / channels, data_size);
+  for (auto sample : frames) {
+    AppendLe(file, static_cast<uint16_t>(sample), 2);
+  }
+  return file;
+}
+
+/// dr_wav uses the fact chunk only for MS ADPCM, so for IMA the padding of
+/// the last block would be decoded too
+drwav_uint64 ReadFactChunk(void* user_data, drwav_read_proc on_read,
+                           drwav_seek_proc, void* read_seek_user_data,
+                           const drwav_chunk_header* chunk_header,
+                           drwav_container container, const drwav_fmt*) {
+  if (container != drwav_container_riff ||
+      !drwav_fourcc_equal(chunk_header->id.fourcc, "fact") ||
+      chunk_header->sizeInBytes < 4) {
+    return 0;
+  }
+  uint8_t bytes[4];
+  if (on_read(read_seek_user_data, bytes, 4) != 4) {
+    return 0;
+  }
+  *static_cast<uint64_t*>(user_data) = drwav_bytes_to_u32(bytes);
+  return 4;
+}
+
+SoundResult ConvertSound(const std::filesystem::path& source,
+                         const std::filesystem::path& destination,
+                         bool encode) {
+  TraceScope trace_scope(encode ? "encode_sound" : "decode_sound", source);
+  auto start = std::chrono::steady_clock::now();
+  SoundResult result;
+  drwav wav;
+  uint64_t fact_frames = 0;
+  if (!drwav_init_file_ex(&wav, source.string().c_str(), ReadFactChunk,
+                          &fact_frames, 0, nullptr)) {
+    std::cerr << "Error: can't read sound " << source << std::endl;
+    return result;
+  }
+  bool adpcm = wav.translatedFormatTag == DR_WAVE_FORMAT_DVI_ADPCM ||
+               wav.translatedFormatTag == DR_WAVE_FORMAT_ADPCM;
+  /// most mixers (and dr_wav) decode ADPCM only up to stereo
+  if (encode ? adpcm || wav.channels > 2 : !adpcm) {
+    drwav_uninit(&wav);
+    result.conversion = SoundConversion::kCopy;
+    return result;
+  }
+  int channels = wav.channels;
+  uint32_t sample_rate = wav.sampleRate;
+  std::vector<int16_t> frames(wav.totalPCMFrameCount * channels);
+  auto frame_count =
+      drwav_read_pcm_frames_s16(&wav, wav.totalPCMFrameCount, frames.data());
+  drwav_uninit(&wav);
+  if (adpcm && fact_frames != 0) {
+    frame_count = std::min<uint64_t>(frame_count, fact_frames);
+  }
+  frames.resize(frame_count * channels);
+  trace_scope.SetBytesIn(frames.size() * sizeof(int16_t));
+
+  auto file = encode ? ImaAdpcmWav(frames, channels, sample_rate)
+                     : PcmWav(frames, channels, sample_rate);
+  AtomicFile atomic_file(destination);
+  std::ofstream out_file(atomic_file.GetTempPath(), std::ios::binary);
+  if (out_file.is_open()) {
+    out_file.write(reinterpret_cast<const char*>(file.data()),
+                   static_cast<std::streamsize>(file.size()));
+    out_file.close();
+  }
+  if (!out_file || !atomic_file.Commit()) {
+    std::cerr << "Error: failed to write " << destination << std::endl;
+    return result;
+  }
+  trace_scope.SetBytesOut(file.size());
+  result.conversion = SoundConversion::kWritten;
+  result.bytes_out = file.size();
+  result.wall_seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+/// interleaved chunks of kAudioDecompChunkSize frames into planar ones
+bool MeasureWav(const std::filesystem::path& path, Loudness& loudness) {
+  drwav wav;
+  uint64_t fact_frames = 0;
+  if (!drwav_init_file_ex(&wav, path.string().c_str(), ReadFactChunk,
+                          &fact_frames, 0, nullptr)) {
+    return false;
+  }
+  bool adpcm = wav.translatedFormatTag == DR_WAVE_FORMAT_DVI_ADPCM ||
+               wav.translatedFormatTag == DR_WAVE_FORMAT_ADPCM;
+  uint64_t frames_left = wav.totalPCMFrameCount;
+  if (adpcm && fact_frames != 0) {
+    frames_left = std::min<uint64_t>(frames_left, fact_frames);
+  }
+  int channels = wav.channels;
+  LoudnessMeter meter(channels, wav.sampleRate,
+                      LoudnessChannelWeights(channels, false));
+  constexpr std::size_t kChunk = faithful::config::kAudioDecompChunkSize;
+  std::vector<float> interleaved(kChunk * channels);
+  std::vector<std::vector<float>> planar(channels, std::vector<float>(kChunk));
+  std::vector<const float*> planes;
+  for (const auto& plane : planar) {
+    planes.push_back(plane.data());
+  }
+  while (frames_left != 0) {
+    auto count = drwav_read_pcm_frames_f32(
+        &wav, std::min<uint64_t>(kChunk, frames_left), interleaved.data());
+    if (count == 0) {
+      break;
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+      for (int c = 0; c < channels; ++c) {
+        planar[c][i] = interleaved[i * channels + c];
+      }
+    }
+    meter.Add(planes.data(), count);
+    frames_left -= count;
+  }
+  drwav_uninit(&wav);
+  loudness = meter.Result();
+  return true;
+}
+
+/// vorbis decodes into planar buffers already
+bool MeasureOgg(const std::filesystem::path& path, Loudness& loudness) {
+  OggVorbis_File file;
+  if (ov_fopen(path.string().c_str(), &file) != 0) {
+    return false;
+  }
+  int channels = ov_info(&file, -1)->channels;
+  LoudnessMeter meter(channels, ov_info(&file, -1)->rate,
+                      LoudnessChannelWeights(channels, true));
+  bool success = true;
+  for (;;) {
+    float** pcm;
+    int bitstream;
+    long count = ov_read_float(&file, &pcm,
+                               faithful::config::kAudioDecompChunkSize,
+                               &bitstream);
+    if (count == OV_HOLE) {
+      continue;
+    }
+    /// chained streams with other layout aren't supported
+    if (count < 0 || (count > 0 && ov_info(&file, bitstream)->channels !=
+                                       channels)) {
+      success = false;
+      break;
+    }
+    if (count == 0) {
+      break;
+    }
+    meter.Add(pcm, static_cast<std::size_t>(count));
+  }
+  ov_clear(&file);
+  loudness = meter.Result();
+  return success;
+}
+
+/// "loudness;true_peak;loudness_range;" of info.txt, silence is empty
+std::string FormatLoudness(const Loudness& loudness) {
+  std::ostringstream fields;
+  fields << std::fixed << std::setprecision(2);
+  for (double value :
+       {loudness.integrated, loudness.true_peak, loudness.range}) {
+    if (std::isfinite(value)) {
+      fields << value;
+    }
+    fields << ';';
+  }
+  return fields.str();
+}
+
+}  // namespace
+
+AudioProcessor::AudioProcessor(AssetLoadingThreadPool& thread_pool,
+                               BatchIo& batch_io,
+                               ReplaceRequest& replace_request)
+    : thread_pool_(thread_pool),
+      batch_io_(batch_io),
+      replace_request_(replace_request) {}
+
+std::vector<std::filesystem::path> AudioProcessor::EncodeMusic(
+    const std::vector<std::filesystem::path>& paths) {
+  auto written_paths =
+      CopyAtomically(paths, music_destination_path_, "music");
+  WriteSeekIndices(paths);
+  return written_paths;
+}
+
+std::vector<std::filesystem::path> AudioProcessor::EncodeSounds(
+    const std::vector<std::filesystem::path>& paths) {
+  if constexpr (faithful::config::kSoundsFormat ==
+                faithful::config::SoundFormat::kCopy) {
+    return CopyAtomically(paths, sounds_destination_path_, "sounds");
+  }
+  return ConvertSounds(paths, true);
+}
+
+std::vector<std::filesystem::path> AudioProcessor::DecodeMusic(
+    const std::vector<std::filesystem::path>& paths) {
+  return EncodeMusic(paths);
+}
+
+std::vector<std::filesystem::path> AudioProcessor::DecodeSounds(
+    const std::vector<std::filesystem::path>& paths) {
+  return ConvertSounds(paths, false);
+}
+
+std::vector<std::filesystem::path> AudioProcessor::CopyAtomically(
+    const std::vector<std::filesystem::path>& paths,
+    const std::filesystem::path& destination_path, const char* category) {
+  if (paths.empty()) {
+    return {};
+  }
+  auto start = std::chrono::steady_clock::now();
+  std::vector<BatchIo::FileStat> stats;
+  std::vector<std::filesystem::path> written_paths;
+  auto selected =
+      SelectToWrite(paths, destination_path, stats, written_paths);
+  std::vector<char> written(paths.size(), 0);
+  CopySelected(paths, selected, destination_path, stats, written,
+               written_paths);
+  MeasureLoudness(paths, written, stats, destination_path);
+
+  /// copies run concurrently, so each asset gets an equal share of the time
+  if (RunReport::IsEnabled()) {
+    double wall_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                      start).count() / paths.size();
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+      uint64_t bytes_out = written[i] ? stats[i].size : 0;
+      RunReport::RecordAsset(category, paths[i], wall_seconds, stats[i].size,
+                             bytes_out, 0);
     }
   }
-  std::filesystem::copy_file(
-      path, out_filename, std::filesystem::copy_options::update_existing);
+  return written_paths;
 }
 
-void AudioProcessor::EncodeSound(const std::filesystem::path& path) {
-  std::string out_filename =
-      (sounds_destination_path_ / path.filename()).string();
-  if (std::filesystem::exists(out_filename)) {
-    std::string request{out_filename};
-    request += "\nalready exist. Do you want to replace it?";
-    if (!replace_request_(std::move(request))) {
-      return;
+std::vector<std::filesystem::path> AudioProcessor::ConvertSounds(
+    const std::vector<std::filesystem::path>& paths, bool encode) {
+  if (paths.empty()) {
+    return {};
+  }
+  std::vector<BatchIo::FileStat> stats;
+  std::vector<std::filesystem::path> written_paths;
+  auto selected =
+      SelectToWrite(paths, sounds_destination_path_, stats, written_paths);
+  /// the biggest first, so no thread is left with a long one in the end
+  std::stable_sort(selected.begin(), selected.end(),
+                   [&stats](std::size_t a, std::size_t b) {
+                     return stats[a].size > stats[b].size;
+                   });
+
+  std::vector<SoundResult> results(paths.size());
+  std::atomic<std::size_t> next_sound{0};
+  thread_pool_.Execute([&](int) {
+    for (auto j = next_sound.fetch_add(1, std::memory_order_relaxed);
+         j < selected.size();
+         j = next_sound.fetch_add(1, std::memory_order_relaxed)) {
+      auto i = selected[j];
+      results[i] = ConvertSound(
+          paths[i], sounds_destination_path_ / paths[i].filename(), encode);
+    }
+  });
+
+  std::vector<std::size_t> copied;
+  std::vector<char> written(paths.size(), 0);
+  for (auto i : selected) {
+    if (results[i].conversion == SoundConversion::kCopy) {
+      copied.push_back(i);
+    } else if (results[i].conversion == SoundConversion::kWritten) {
+      written[i] = 1;
+      written_paths.push_back(paths[i]);
+    }
+  }
+  auto copy_start = std::chrono::steady_clock::now();
+  CopySelected(paths, copied, sounds_destination_path_, stats, written,
+               written_paths);
+  MeasureLoudness(paths, written, stats, sounds_destination_path_);
+
+  if (RunReport::IsEnabled()) {
+    double copy_seconds =
+        copied.empty()
+            ? 0.0
+            : std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                            copy_start).count() /
+                  copied.size();
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+      const auto& result = results[i];
+      bool converted = result.conversion == SoundConversion::kWritten;
+      uint64_t bytes_out = converted ? result.bytes_out
+                                     : (written[i] ? stats[i].size : 0);
+      RunReport::RecordAsset("sounds", paths[i],
+                             converted ? result.wall_seconds : copy_seconds,
+                             stats[i].size, bytes_out, 0);
     }
   }
-  std::filesystem::copy_file(
-      path, out_filename, std::filesystem::copy_options::update_existing);
+  return written_paths;
 }
 
-void AudioProcessor::DecodeMusic(const std::filesystem::path& path) {
-  EncodeMusic(path);
+std::vector<std::size_t> AudioProcessor::SelectToWrite(
+    const std::vector<std::filesystem::path>& paths,
+    const std::filesystem::path& destination_path,
+    std::vector<BatchIo::FileStat>& stats,
+    std::vector<std::filesystem::path>& written_paths) {
+  /// sources and destinations in one batch: [paths..., out_paths...]
+  std::vector<std::filesystem::path> stat_paths(paths);
+  for (const auto& path : paths) {
+    stat_paths.push_back(destination_path / path.filename());
+  }
+  {
+    TraceScope trace_scope("audio_stat");
+    stats = batch_io_.Stat(stat_paths);
+  }
+
+  std::vector<std::size_t> selected;
+  for (std::size_t i = 0; i < paths.size(); ++i) {
+    const auto& in_stat = stats[i];
+    const auto& out_stat = stats[paths.size() + i];
+    if (out_stat.exists) {
+      std::string request{stat_paths[paths.size() + i]};
+      request += "\nalready exist. Do you want to replace it?";
+      if (!replace_request_(std::move(request)) ||
+          out_stat.mtime >= in_stat.mtime) {
+        written_paths.push_back(paths[i]);
+        continue;
+      }
+    }
+    selected.push_back(i);
+  }
+  return selected;
 }
 
-void AudioProcessor::DecodeSound(const std::filesystem::path& path) {
-  EncodeSound(path);
+void AudioProcessor::CopySelected(
+    const std::vector<std::filesystem::path>& paths,
+    const std::vector<std::size_t>& selected,
+    const std::filesystem::path& destination_path,
+    const std::vector<BatchIo::FileStat>& stats, std::vector<char>& written,
+    std::vector<std::filesystem::path>& written_paths) {
+  if (selected.empty()) {
+    return;
+  }
+  /// AtomicFile isn't movable
+  std::vector<std::unique_ptr<AtomicFile>> atomic_files;
+  std::vector<BatchIo::CopyRequest> requests;
+  uint64_t bytes = 0;
+  for (auto i : selected) {
+    atomic_files.push_back(std::make_unique<AtomicFile>(
+        destination_path / paths[i].filename()));
+    requests.push_back({paths[i], atomic_files.back()->GetTempPath()});
+    bytes += stats[i].size;
+  }
+  std::vector<std::error_code> errors;
+  {
+    TraceScope trace_scope("audio_copy");
+    trace_scope.SetBytesIn(bytes);
+    trace_scope.SetBytesOut(bytes);
+    errors = batch_io_.Copy(requests);
+  }
+
+  for (std::size_t j = 0; j < selected.size(); ++j) {
+    auto i = selected[j];
+    if (errors[j]) {
+      std::cerr << "Error: failed to copy " << paths[i] << ": "
+                << errors[j].message() << std::endl;
+    } else if (atomic_files[j]->Commit()) {
+      written[i] = 1;
+      written_paths.push_back(paths[i]);
+    }
+  }
+}
+
+void AudioProcessor::MeasureLoudness(
+    const std::vector<std::filesystem::path>& paths,
+    const std::vector<char>& written,
+    const std::vector<BatchIo::FileStat>& stats,
+    const std::filesystem::path& destination_path) {
+  auto measured = ReadAssetsLoudness(destination_path);
+  std::vector<std::size_t> selected;
+  for (std::size_t i = 0; i < paths.size(); ++i) {
+    /// destination is there if just written or existed by the stat of
+    /// SelectToWrite() (failed writes leave the old one), so no stat here
+    bool existed = stats[paths.size() + i].exists;
+    if (written[i] ||
+        (existed && !measured.contains(paths[i].filename().string()))) {
+      selected.push_back(i);
+    }
+  }
+  if (selected.empty()) {
+    return;
+  }
+  /// the longest first, as for conversion
+  std::stable_sort(selected.begin(), selected.end(),
+                   [&stats](std::size_t a, std::size_t b) {
+                     return stats[a].size > stats[b].size;
+                   });
+
+  std::vector<Loudness> results(paths.size());
+  std::vector<char> succeeded(paths.size(), 0);
+  std::atomic<std::size_t> next_track{0};
+  thread_pool_.Execute([&](int) {
+    for (auto j = next_track.fetch_add(1, std::memory_order_relaxed);
+         j < selected.size();
+         j = next_track.fetch_add(1, std::memory_order_relaxed)) {
+      auto i = selected[j];
+      auto path = destination_path / paths[i].filename();
+      TraceScope trace_scope("loudness", path);
+      trace_scope.SetBytesIn(stats[i].size);
+      succeeded[i] = path.extension() == ".ogg"
+                         ? MeasureOgg(path, results[i])
+                         : MeasureWav(path, results[i]);
+    }
+  });
+
+  std::map<std::string, std::string> loudness;
+  for (auto i : selected) {
+    if (!succeeded[i]) {
+      std::cerr << "Warning: can't measure loudness of " << paths[i]
+                << std::endl;
+      continue;
+    }
+    loudness[paths[i].filename().string()] = FormatLoudness(results[i]);
+  }
+  if (!loudness.empty()) {
+    WriteAssetsLoudness(destination_path, loudness);
+  }
+}
+
+void AudioProcessor::WriteSeekIndices(
+    const std::vector<std::filesystem::path>& paths) {
+  /// tracks and their indices in one batch: [ogg..., indices...]
+  std::vector<std::filesystem::path> stat_paths;
+  for (const auto& path : paths) {
+    if (path.extension() == ".ogg") {
+      stat_paths.push_back(music_destination_path_ / path.filename());
+    }
+  }
+  auto track_count = stat_paths.size();
+  if (track_count == 0) {
+    return;
+  }
+  for (std::size_t i = 0; i < track_count; ++i) {
+    auto index_path = stat_paths[i];
+    index_path += faithful::config::kMusicSeekExtension;
+    stat_paths.push_back(std::move(index_path));
+  }
+  std::vector<BatchIo::FileStat> stats;
+  {
+    TraceScope trace_scope("seek_index_stat");
+    stats = batch_io_.Stat(stat_paths);
+  }
+
+  std::vector<std::pair<uint64_t, std::filesystem::path>> tracks;
+  for (std::size_t i = 0; i < track_count; ++i) {
+    const auto& track_stat = stats[i];
+    const auto& index_stat = stats[track_count + i];
+    if (!track_stat.exists ||
+        (index_stat.exists && index_stat.mtime >= track_stat.mtime)) {
+      continue;
+    }
+    tracks.emplace_back(track_stat.size, stat_paths[i]);
+  }
+  /// the longest first, as for conversion
+  std::stable_sort(tracks.begin(), tracks.end(),
+                   [](const auto& a, const auto& b) {
+                     return a.first > b.first;
+                   });
+
+  std::atomic<std::size_t> next_track{0};
+  thread_pool_.Execute([&](int) {
+    for (auto i = next_track.fetch_add(1, std::memory_order_relaxed);
+         i < tracks.size();
+         i = next_track.fetch_add(1, std::memory_order_relaxed)) {
+      const auto& [size, track] = tracks[i];
+      TraceScope trace_scope("seek_index", track);
+      trace_scope.SetBytesIn(size);
+      OggSeekIndex index;
+      if (!BuildOggSeekIndex(track, faithful::config::kMusicSeekIntervalMs,
+                             index)) {
+        continue;
+      }
+      auto data = SerializeOggSeekIndex(index);
+      auto index_path = track;
+      index_path += faithful::config::kMusicSeekExtension;
+      AtomicFile atomic_file(index_path);
+      std::ofstream out_file(atomic_file.GetTempPath(), std::ios::binary);
+      if (out_file.is_open()) {
+        out_file.write(reinterpret_cast<const char*>(data.data()),
+                       static_cast<std::streamsize>(data.size()));
+        out_file.close();
+      }
+      if (!out_file || !atomic_file.Commit()) {
+        std::cerr << "Error: failed to write " << index_path << std::endl;
+        continue;
+      }
+      trace_scope.SetBytesOut(data.size());
+    }
+  });
 }
 
 void AudioProcessor::SetDestinationDirectory(
@@ -2,18 +2,26 @@
 #define FAITHFUL_UTILS_ASSETPROCESSOR_AUDIOPROCESSOR_H
 
 #include <filesystem>
+#include <vector>
 
 #include "AssetLoadingThreadPool.h"
+#include "BatchIo.h"
 #include "ReplaceRequest.h"
 
-/// CURRENTLY just copy of .ogg & .wav into destination
+/// music (.ogg) is copied into destination; sounds (.wav) are encoded to
+/// IMA ADPCM (see src/ImaAdpcm.h and faithful::config::kSoundsFormat),
+/// each file by its own thread, and decoded back to 16-bit pcm.
+/// Loudness of every written track is measured (see src/Loudness.h) for
+/// info.txt of its category, music also gets seek table beside it
+/// (see src/OggSeekIndex.h)
 
 // TODO(dr_libs): mp3/flac/ogg/wav -> ogg/wav (depends on size)
 
 class AudioProcessor {
  public:
   AudioProcessor() = delete;
-  explicit AudioProcessor(ReplaceRequest& replace_request);
+  AudioProcessor(AssetLoadingThreadPool& thread_pool, BatchIo& batch_io,
+                 ReplaceRequest& replace_request);
 
   /// non-assignable because of member reference
   AudioProcessor(const AudioProcessor&) = delete;
@@ -22,14 +30,64 @@ class AudioProcessor {
   AudioProcessor(AudioProcessor&&) = default;
   AudioProcessor& operator=(AudioProcessor&&) = delete;
 
-  void EncodeMusic(const std::filesystem::path& path);
-  void EncodeSound(const std::filesystem::path& path);
-  void DecodeMusic(const std::filesystem::path& path);
-  void DecodeSound(const std::filesystem::path& path);
+  /// all files of the category at once: destinations are checked by one
+  /// batch (replace requests before any copy), then converted or copied;
+  /// return sources which are written or declined (not failed)
+  std::vector<std::filesystem::path> EncodeMusic(
+      const std::vector<std::filesystem::path>& paths);
+  std::vector<std::filesystem::path> EncodeSounds(
+      const std::vector<std::filesystem::path>& paths);
+  std::vector<std::filesystem::path> DecodeMusic(
+      const std::vector<std::filesystem::path>& paths);
+  std::vector<std::filesystem::path> DecodeSounds(
+      const std::vector<std::filesystem::path>& paths);
 
   void SetDestinationDirectory(const std::filesystem::path& path);
 
  private:
+  /// copied under temporary names, so destination is never truncated;
+  /// skipped if destination isn't older than source
+  std::vector<std::filesystem::path> CopyAtomically(
+      const std::vector<std::filesystem::path>& paths,
+      const std::filesystem::path& destination_path, const char* category);
+
+  /// encode: pcm -> IMA ADPCM, decode: ADPCM -> 16-bit pcm; the rest
+  /// (already in the target format, more than 2 channels) is copied
+  std::vector<std::filesystem::path> ConvertSounds(
+      const std::vector<std::filesystem::path>& paths, bool encode);
+
+  /// sources & destinations are stat by one batch (stats are
+  /// [paths..., destinations...]); returns indices of paths to write,
+  /// declined ones are added to written_paths
+  std::vector<std::size_t> SelectToWrite(
+      const std::vector<std::filesystem::path>& paths,
+      const std::filesystem::path& destination_path,
+      std::vector<BatchIo::FileStat>& stats,
+      std::vector<std::filesystem::path>& written_paths);
+
+  /// indices of paths; copied ones are marked in written
+  void CopySelected(const std::vector<std::filesystem::path>& paths,
+                    const std::vector<std::size_t>& selected,
+                    const std::filesystem::path& destination_path,
+                    const std::vector<BatchIo::FileStat>& stats,
+                    std::vector<char>& written,
+                    std::vector<std::filesystem::path>& written_paths);
+
+  /// EBU R128 loudness of written destinations (and of declined ones not
+  /// measured before) into destination_path/.loudness, each track by its
+  /// own thread; stats are of SelectToWrite()
+  void MeasureLoudness(const std::vector<std::filesystem::path>& paths,
+                       const std::vector<char>& written,
+                       const std::vector<BatchIo::FileStat>& stats,
+                       const std::filesystem::path& destination_path);
+
+  /// <track>.ogg.seek of music destinations which don't have up to date
+  /// one (written now, or declined and indexed before), each track by its
+  /// own thread; tracks and indices are checked by one BatchIo::Stat()
+  void WriteSeekIndices(const std::vector<std::filesystem::path>& paths);
+
+  AssetLoadingThreadPool& thread_pool_;
+  BatchIo& batch_io_;
   ReplaceRequest& replace_request_;
 
   std::filesystem::path sounds_destination_path_;
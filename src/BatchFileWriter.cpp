@@ -0,0 +1,82 @@
+#include "BatchFileWriter.h"
+
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+#include "AtomicFile.h"
+#include "Trace.h"
+
+BatchFileWriter::BatchFileWriter()
+    : thread_([this]() { Work(); }) {}
+
+BatchFileWriter::~BatchFileWriter() {
+  Finish();
+}
+
+void BatchFileWriter::Push(std::filesystem::path path,
+                           std::vector<uint8_t> data) {
+  {
+    std::unique_lock lock(mu_);
+    /// a single file bigger than limit still passes when the queue is empty
+    queue_not_full_.wait(lock, [&]() {
+      return queued_bytes_ == 0 ||
+             queued_bytes_ + data.size() <= kMaxQueuedBytes;
+    });
+    queued_bytes_ += data.size();
+    queue_.push_back({std::move(path), std::move(data)});
+  }
+  queue_not_empty_.notify_one();
+}
+
+std::vector<std::filesystem::path> BatchFileWriter::Finish() {
+  {
+    std::lock_guard lock(mu_);
+    finished_ = true;
+  }
+  queue_not_empty_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  return failed_paths_;
+}
+
+void BatchFileWriter::Work() {
+  while (true) {
+    File file;
+    {
+      std::unique_lock lock(mu_);
+      queue_not_empty_.wait(lock, [this]() {
+        return !queue_.empty() || finished_;
+      });
+      if (queue_.empty()) {
+        return;
+      }
+      file = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    TraceScope trace_scope("batch_write", file.path);
+    trace_scope.SetBytesOut(file.data.size());
+    AtomicFile atomic_file(file.path);
+    std::ofstream out_file(atomic_file.GetTempPath(), std::ios::binary);
+    if (out_file.is_open()) {
+      out_file.write(reinterpret_cast<const char*>(file.data.data()),
+                     static_cast<std::streamsize>(file.data.size()));
+      out_file.close();
+    }
+    bool failed = !out_file || !atomic_file.Commit();
+    if (failed) {
+      std::cerr << "Error: failed to write " << file.path << std::endl;
+    }
+
+    {
+      std::lock_guard lock(mu_);
+      queued_bytes_ -= file.data.size();
+      if (failed) {
+        failed_paths_.push_back(std::move(file.path));
+      }
+    }
+    queue_not_full_.notify_all();
+  }
+}
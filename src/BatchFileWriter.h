@@ -0,0 +1,59 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_BATCHFILEWRITER_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_BATCHFILEWRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Writes many small files on its own thread, so compressing threads
+/// don't wait for the file system (see TextureProcessor::EncodeBatch).
+/// Push() may be called from any thread; queued data is limited by
+/// kMaxQueuedBytes, after that Push() blocks until the writer catches up.
+class BatchFileWriter {
+ public:
+  BatchFileWriter();
+
+  /// waits for everything queued (same as Finish())
+  ~BatchFileWriter();
+
+  /// not copyable/movable because of the thread working with this
+  BatchFileWriter(const BatchFileWriter&) = delete;
+  BatchFileWriter& operator=(const BatchFileWriter&) = delete;
+
+  BatchFileWriter(BatchFileWriter&&) = delete;
+  BatchFileWriter& operator=(BatchFileWriter&&) = delete;
+
+  void Push(std::filesystem::path path, std::vector<uint8_t> data);
+
+  /// writes the rest and stops the thread;
+  /// returns files that couldn't be written
+  std::vector<std::filesystem::path> Finish();
+
+ private:
+  static constexpr std::size_t kMaxQueuedBytes = 64 * 1024 * 1024;
+
+  struct File {
+    std::filesystem::path path;
+    std::vector<uint8_t> data;
+  };
+
+  void Work();
+
+  std::deque<File> queue_;
+  std::size_t queued_bytes_{0};
+  bool finished_{false};
+  std::vector<std::filesystem::path> failed_paths_;
+
+  /// guards all above
+  std::mutex mu_;
+  std::condition_variable queue_not_empty_;
+  std::condition_variable queue_not_full_;
+
+  std::thread thread_;
+};
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_BATCHFILEWRITER_H
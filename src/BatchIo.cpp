@@ -0,0 +1,530 @@
+#include "BatchIo.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "../config/AssetFormats.h"
+
+#ifdef __linux__
+
+class BatchIo::Uring {
+ public:
+  /// nullptr if io_uring or any of used operations isn't supported
+  static std::unique_ptr<Uring> Create(unsigned entries);
+
+  ~Uring();
+
+  /// prepare(sqe) fills the next request (sqe is zeroed), returns false if
+  /// there is nothing to submit right now; complete(user_data, result)
+  /// handles one completion (result is -errno on error) and may make new
+  /// requests ready; returns when nothing is ready and nothing in flight
+  template <typename Prepare, typename Complete>
+  void Run(Prepare&& prepare, Complete&& complete);
+
+ private:
+  Uring() = default;
+
+  int fd_{-1};
+  void* ring_{MAP_FAILED};
+  std::size_t ring_size_{0};
+  io_uring_sqe* sqes_{nullptr};
+  std::size_t sqes_size_{0};
+
+  unsigned sq_entries_{0};
+  unsigned sq_mask_{0};
+  unsigned* sq_tail_{nullptr};
+  unsigned* sq_array_{nullptr};
+
+  unsigned cq_mask_{0};
+  unsigned* cq_head_{nullptr};
+  unsigned* cq_tail_{nullptr};
+  io_uring_cqe* cqes_{nullptr};
+};
+
+std::unique_ptr<BatchIo::Uring> BatchIo::Uring::Create(unsigned entries) {
+  io_uring_params params{};
+  std::unique_ptr<Uring> uring{new Uring};
+  uring->fd_ = static_cast<int>(
+      syscall(__NR_io_uring_setup, entries, &params));
+  /// ENOSYS (old kernel), EPERM (seccomp, io_uring_disabled sysctl)
+  if (uring->fd_ < 0) {
+    return nullptr;
+  }
+  /// both 5.4+, single mmap for both rings, no dropped completions
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP) ||
+      !(params.features & IORING_FEAT_NODROP)) {
+    return nullptr;
+  }
+
+  constexpr int kOpsCount = IORING_OP_LAST;
+  std::vector<uint8_t> probe_data(sizeof(io_uring_probe) +
+                                  kOpsCount * sizeof(io_uring_probe_op));
+  auto* probe = reinterpret_cast<io_uring_probe*>(probe_data.data());
+  if (syscall(__NR_io_uring_register, uring->fd_, IORING_REGISTER_PROBE,
+              probe, kOpsCount) < 0) {
+    return nullptr;
+  }
+  for (int op : {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ,
+                 IORING_OP_WRITE, IORING_OP_CLOSE}) {
+    if (op > probe->last_op ||
+        !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+      return nullptr;
+    }
+  }
+
+  uring->ring_size_ =
+      std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+               params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+  uring->ring_ = mmap(nullptr, uring->ring_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, uring->fd_,
+                      IORING_OFF_SQ_RING);
+  if (uring->ring_ == MAP_FAILED) {
+    return nullptr;
+  }
+  uring->sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = mmap(nullptr, uring->sqes_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, uring->fd_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    return nullptr;
+  }
+  uring->sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+  auto* ring = static_cast<uint8_t*>(uring->ring_);
+  uring->sq_entries_ = params.sq_entries;
+  uring->sq_mask_ = *reinterpret_cast<unsigned*>(ring + params.sq_off.ring_mask);
+  uring->sq_tail_ = reinterpret_cast<unsigned*>(ring + params.sq_off.tail);
+  uring->sq_array_ = reinterpret_cast<unsigned*>(ring + params.sq_off.array);
+  uring->cq_mask_ = *reinterpret_cast<unsigned*>(ring + params.cq_off.ring_mask);
+  uring->cq_head_ = reinterpret_cast<unsigned*>(ring + params.cq_off.head);
+  uring->cq_tail_ = reinterpret_cast<unsigned*>(ring + params.cq_off.tail);
+  uring->cqes_ = reinterpret_cast<io_uring_cqe*>(ring + params.cq_off.cqes);
+  return uring;
+}
+
+BatchIo::Uring::~Uring() {
+  if (sqes_) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (ring_ != MAP_FAILED) {
+    munmap(ring_, ring_size_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+template <typename Prepare, typename Complete>
+void BatchIo::Uring::Run(Prepare&& prepare, Complete&& complete) {
+  /// only this thread writes sq tail & cq head, kernel - the opposite ones
+  unsigned sq_tail = *sq_tail_;
+  unsigned queued = 0;
+  unsigned in_flight = 0;
+  while (true) {
+    /// completion queue is twice as big, so it never overflows
+    while (queued + in_flight < sq_entries_) {
+      unsigned index = sq_tail & sq_mask_;
+      io_uring_sqe* sqe = &sqes_[index];
+      std::memset(sqe, 0, sizeof(io_uring_sqe));
+      if (!prepare(sqe)) {
+        break;
+      }
+      sq_array_[index] = index;
+      ++sq_tail;
+      ++queued;
+    }
+    __atomic_store_n(sq_tail_, sq_tail, __ATOMIC_RELEASE);
+    if (queued == 0 && in_flight == 0) {
+      return;
+    }
+
+    int submitted = static_cast<int>(
+        syscall(__NR_io_uring_enter, fd_, queued, 1, IORING_ENTER_GETEVENTS,
+                nullptr, 0));
+    if (submitted >= 0) {
+      queued -= submitted;
+      in_flight += submitted;
+    } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      throw std::system_error(errno, std::generic_category(),
+                              "io_uring_enter failed");
+    }
+
+    unsigned cq_head = *cq_head_;
+    unsigned cq_tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; cq_head != cq_tail; ++cq_head) {
+      const io_uring_cqe& cqe = cqes_[cq_head & cq_mask_];
+      --in_flight;
+      complete(cqe.user_data, cqe.res);
+    }
+    __atomic_store_n(cq_head_, cq_head, __ATOMIC_RELEASE);
+  }
+}
+
+namespace {
+
+void PrepareOpen(io_uring_sqe* sqe, const char* path, int flags,
+                 mode_t mode) {
+  sqe->opcode = IORING_OP_OPENAT;
+  sqe->fd = AT_FDCWD;
+  sqe->addr = reinterpret_cast<uint64_t>(path);
+  sqe->len = mode;
+  sqe->open_flags = flags | O_CLOEXEC;
+}
+
+void PrepareStatx(io_uring_sqe* sqe, const char* path, struct statx* stat) {
+  sqe->opcode = IORING_OP_STATX;
+  sqe->fd = AT_FDCWD;
+  sqe->addr = reinterpret_cast<uint64_t>(path);
+  sqe->len = STATX_MODE | STATX_SIZE | STATX_MTIME;
+  sqe->off = reinterpret_cast<uint64_t>(stat);
+}
+
+void PrepareReadWrite(io_uring_sqe* sqe, uint8_t opcode, int fd,
+                      uint8_t* data, uint32_t size, uint64_t offset) {
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(data);
+  sqe->len = size;
+  sqe->off = offset;
+}
+
+void PrepareClose(io_uring_sqe* sqe, int fd) {
+  sqe->opcode = IORING_OP_CLOSE;
+  sqe->fd = fd;
+}
+
+BatchIo::FileStat ToFileStat(const struct statx& stat) {
+  return {true, stat.stx_size,
+          static_cast<int64_t>(stat.stx_mtime.tv_sec) * 1000000000 +
+              stat.stx_mtime.tv_nsec};
+}
+
+/// every copy goes through its stages asynchronously:
+/// open source + statx -> create destination -> (read -> write)* -> close,
+/// at most kIoMaxCopiesInFlight copies at once, each with own buffer
+class UringCopy {
+ public:
+  explicit UringCopy(const std::vector<BatchIo::CopyRequest>& requests)
+      : requests_(requests),
+        jobs_(requests.size()) {}
+
+  bool Prepare(io_uring_sqe* sqe) {
+    if (ready_.empty() && active_ < faithful::config::kIoMaxCopiesInFlight &&
+        next_job_ < jobs_.size()) {
+      ++active_;
+      Push(next_job_, kOpenFrom);
+      Push(next_job_, kStatFrom);
+      ++next_job_;
+    }
+    if (ready_.empty()) {
+      return false;
+    }
+    uint64_t user_data = ready_.front();
+    ready_.pop_front();
+    std::size_t index = user_data >> kOpBits;
+    Job& job = jobs_[index];
+    switch (static_cast<Op>(user_data & kOpMask)) {
+      case kOpenFrom:
+        PrepareOpen(sqe, requests_[index].from.c_str(), O_RDONLY, 0);
+        break;
+      case kStatFrom:
+        PrepareStatx(sqe, requests_[index].from.c_str(), &job.stat);
+        break;
+      case kOpenTo:
+        PrepareOpen(sqe, requests_[index].to.c_str(),
+                    O_WRONLY | O_CREAT | O_TRUNC, job.stat.stx_mode & 07777);
+        break;
+      case kRead:
+        PrepareReadWrite(sqe, IORING_OP_READ, job.from_fd, job.buffer.get(),
+                         job.buffer_size, job.offset);
+        break;
+      case kWrite:
+        PrepareReadWrite(sqe, IORING_OP_WRITE, job.to_fd,
+                         job.buffer.get() + job.written,
+                         job.chunk - job.written, job.offset + job.written);
+        break;
+      case kCloseFrom:
+        PrepareClose(sqe, job.from_fd);
+        break;
+      case kCloseTo:
+        PrepareClose(sqe, job.to_fd);
+        break;
+    }
+    sqe->user_data = user_data;
+    return true;
+  }
+
+  void Complete(uint64_t user_data, int result) {
+    std::size_t index = user_data >> kOpBits;
+    Job& job = jobs_[index];
+    --job.pending;
+    auto op = static_cast<Op>(user_data & kOpMask);
+    if (result < 0 && job.error == 0 && op != kCloseFrom) {
+      job.error = -result;
+    }
+    switch (op) {
+      case kOpenFrom:
+      case kStatFrom:
+        if (op == kOpenFrom && result >= 0) {
+          job.from_fd = result;
+        }
+        if (job.pending == 0) {
+          if (job.error != 0) {
+            Finish(index);
+          } else {
+            Push(index, kOpenTo);
+          }
+        }
+        break;
+      case kOpenTo:
+        if (result < 0) {
+          Finish(index);
+        } else {
+          job.to_fd = result;
+          ReadNext(index);
+        }
+        break;
+      case kRead:
+        /// 0 - file became shorter since statx, so the copy would be
+        /// silently truncated
+        if (result == 0 && job.error == 0) {
+          job.error = EIO;
+        }
+        if (result <= 0) {
+          Finish(index);
+        } else {
+          job.chunk = static_cast<uint32_t>(result);
+          job.written = 0;
+          Push(index, kWrite);
+        }
+        break;
+      case kWrite:
+        if (result < 0) {
+          Finish(index);
+          break;
+        }
+        job.written += static_cast<uint32_t>(result);
+        if (job.written < job.chunk) {
+          Push(index, kWrite);
+        } else {
+          job.offset += job.chunk;
+          ReadNext(index);
+        }
+        break;
+      case kCloseFrom:
+      case kCloseTo:
+        if (job.pending == 0) {
+          --active_;
+        }
+        break;
+    }
+  }
+
+  std::vector<std::error_code> GetErrors() const {
+    std::vector<std::error_code> errors(jobs_.size());
+    for (std::size_t i = 0; i < jobs_.size(); ++i) {
+      if (jobs_[i].error != 0) {
+        errors[i] = std::error_code(jobs_[i].error, std::generic_category());
+      }
+    }
+    return errors;
+  }
+
+ private:
+  enum Op : uint64_t {
+    kOpenFrom,
+    kStatFrom,
+    kOpenTo,
+    kRead,
+    kWrite,
+    kCloseFrom,
+    kCloseTo
+  };
+  static constexpr int kOpBits = 3;
+  static constexpr uint64_t kOpMask = (1 << kOpBits) - 1;
+
+  struct Job {
+    struct statx stat;
+    std::unique_ptr<uint8_t[]> buffer;
+    uint32_t buffer_size{0};
+    /// copied bytes
+    uint64_t offset{0};
+    /// read into buffer & written of it
+    uint32_t chunk{0};
+    uint32_t written{0};
+    int from_fd{-1};
+    int to_fd{-1};
+    /// ready or in flight
+    int pending{0};
+    /// the first errno
+    int error{0};
+  };
+
+  void Push(std::size_t index, Op op) {
+    ++jobs_[index].pending;
+    ready_.push_back((static_cast<uint64_t>(index) << kOpBits) | op);
+  }
+
+  void ReadNext(std::size_t index) {
+    Job& job = jobs_[index];
+    if (job.offset >= job.stat.stx_size) {
+      Finish(index);
+      return;
+    }
+    if (!job.buffer) {
+      job.buffer_size = static_cast<uint32_t>(
+          std::min<uint64_t>(job.stat.stx_size,
+                             faithful::config::kIoCopyChunkSize));
+      job.buffer = std::make_unique_for_overwrite<uint8_t[]>(job.buffer_size);
+    }
+    Push(index, kRead);
+  }
+
+  /// error of close() is reported only for destination (e.g. deferred
+  /// write error on network file systems)
+  void Finish(std::size_t index) {
+    Job& job = jobs_[index];
+    job.buffer.reset();
+    if (job.from_fd >= 0) {
+      Push(index, kCloseFrom);
+    }
+    if (job.to_fd >= 0) {
+      Push(index, kCloseTo);
+    }
+    if (job.pending == 0) {
+      --active_;
+    }
+  }
+
+  const std::vector<BatchIo::CopyRequest>& requests_;
+  std::vector<Job> jobs_;
+  /// user_data: job index << kOpBits | Op
+  std::deque<uint64_t> ready_;
+  std::size_t next_job_{0};
+  std::size_t active_{0};
+};
+
+}  // namespace
+
+#else
+
+class BatchIo::Uring {};
+
+#endif  // __linux__
+
+BatchIo::BatchIo(AssetLoadingThreadPool& thread_pool)
+    : thread_pool_(thread_pool) {
+#ifdef __linux__
+  uring_ = Uring::Create(faithful::config::kIoQueueDepth);
+#endif
+}
+
+BatchIo::~BatchIo() = default;
+
+std::vector<BatchIo::FileStat> BatchIo::Stat(
+    const std::vector<std::filesystem::path>& paths) {
+#ifdef __linux__
+  if (uring_) {
+    std::vector<struct statx> stats(paths.size());
+    std::vector<FileStat> results(paths.size());
+    std::size_t next = 0;
+    uring_->Run(
+        [&](io_uring_sqe* sqe) {
+          if (next == paths.size()) {
+            return false;
+          }
+          PrepareStatx(sqe, paths[next].c_str(), &stats[next]);
+          sqe->user_data = next++;
+          return true;
+        },
+        [&](uint64_t user_data, int result) {
+          if (result == 0) {
+            results[user_data] = ToFileStat(stats[user_data]);
+          }
+        });
+    return results;
+  }
+#endif
+  return StatWithPool(paths);
+}
+
+std::vector<std::error_code> BatchIo::Copy(
+    const std::vector<CopyRequest>& requests) {
+#ifdef __linux__
+  if (uring_) {
+    UringCopy copy(requests);
+    uring_->Run(
+        [&](io_uring_sqe* sqe) {
+          return copy.Prepare(sqe);
+        },
+        [&](uint64_t user_data, int result) {
+          copy.Complete(user_data, result);
+        });
+    return copy.GetErrors();
+  }
+#endif
+  return CopyWithPool(requests);
+}
+
+std::vector<BatchIo::FileStat> BatchIo::StatWithPool(
+    const std::vector<std::filesystem::path>& paths) {
+  std::vector<FileStat> results(paths.size());
+  std::atomic<std::size_t> next{0};
+  thread_pool_.Execute([&](int) {
+    for (auto i = next.fetch_add(1, std::memory_order_relaxed);
+         i < paths.size(); i = next.fetch_add(1, std::memory_order_relaxed)) {
+      std::error_code error;
+      auto status = std::filesystem::status(paths[i], error);
+      if (error || !std::filesystem::exists(status)) {
+        continue;
+      }
+      results[i].exists = true;
+      if (std::filesystem::is_regular_file(status)) {
+        results[i].size = std::filesystem::file_size(paths[i], error);
+      }
+      auto mtime = std::filesystem::last_write_time(paths[i], error);
+      results[i].mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             mtime.time_since_epoch())
+                             .count();
+    }
+  });
+  return results;
+}
+
+std::vector<std::error_code> BatchIo::CopyWithPool(
+    const std::vector<CopyRequest>& requests) {
+  std::vector<std::error_code> errors(requests.size());
+  std::atomic<std::size_t> next{0};
+  thread_pool_.Execute([&](int) {
+    for (auto i = next.fetch_add(1, std::memory_order_relaxed);
+         i < requests.size();
+         i = next.fetch_add(1, std::memory_order_relaxed)) {
+      /// like io_uring copy: source shorter than it was before the copy
+      /// is an error, not a truncated copy
+      auto size = std::filesystem::file_size(requests[i].from, errors[i]);
+      if (errors[i] ||
+          !std::filesystem::copy_file(
+              requests[i].from, requests[i].to,
+              std::filesystem::copy_options::overwrite_existing, errors[i])) {
+        continue;
+      }
+      std::error_code error;
+      if (std::filesystem::file_size(requests[i].to, error) < size) {
+        errors[i] = std::make_error_code(std::errc::io_error);
+      }
+    }
+  });
+  return errors;
+}
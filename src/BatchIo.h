@@ -0,0 +1,69 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_BATCHIO_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_BATCHIO_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "AssetLoadingThreadPool.h"
+
+/// File I/O of many small assets at once (stats of destinations, copies of
+/// music/sounds, merge of shards). Instead of blocking open, read, write,
+/// close & stat one after another on the main thread, the whole list is
+/// submitted through io_uring (raw syscalls, Linux 5.6+), so the kernel
+/// works on up to kIoQueueDepth requests at the same time.
+/// If io_uring isn't available (older kernel, forbidden by seccomp inside
+/// containers, not Linux) the same requests are spread over the thread pool
+/// with ordinary blocking calls, so it should be Run() during any call.
+class BatchIo {
+ public:
+  struct FileStat {
+    bool exists{false};
+    uint64_t size{0};
+    /// nanoseconds, only for comparison with each other
+    int64_t mtime{0};
+  };
+
+  struct CopyRequest {
+    std::filesystem::path from;
+    /// created (or truncated)
+    std::filesystem::path to;
+  };
+
+  explicit BatchIo(AssetLoadingThreadPool& thread_pool);
+  ~BatchIo();
+
+  /// non-copyable because of member reference & ring
+  BatchIo(const BatchIo&) = delete;
+  BatchIo& operator=(const BatchIo&) = delete;
+
+  BatchIo(BatchIo&&) = delete;
+  BatchIo& operator=(BatchIo&&) = delete;
+
+  bool IsUringEnabled() const {
+    return uring_ != nullptr;
+  }
+
+  /// in order of paths, not existing ones (or not accessible) have
+  /// exists == false
+  std::vector<FileStat> Stat(const std::vector<std::filesystem::path>& paths);
+
+  /// in order of requests, empty error_code for copied ones
+  std::vector<std::error_code> Copy(const std::vector<CopyRequest>& requests);
+
+ private:
+  /// mapped queues of io_uring, defined only on Linux
+  class Uring;
+
+  std::vector<FileStat> StatWithPool(
+      const std::vector<std::filesystem::path>& paths);
+  std::vector<std::error_code> CopyWithPool(
+      const std::vector<CopyRequest>& requests);
+
+  AssetLoadingThreadPool& thread_pool_;
+  std::unique_ptr<Uring> uring_;
+};
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_BATCHIO_H
@@ -0,0 +1,236 @@
+#include "CpuTopology.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+/// -1 if file doesn't exist or isn't an integer
+int ReadIntFile(const std::filesystem::path& path) {
+  std::ifstream file(path);
+  int value;
+  if (!(file >> value)) {
+    return -1;
+  }
+  return value;
+}
+
+/// cgroup v2 "cpu.max": "$MAX $PERIOD", where $MAX may be "max"
+double ReadCgroupV2Quota(const std::filesystem::path& path) {
+  std::ifstream file(path);
+  std::string max;
+  double period;
+  if (!(file >> max >> period) || max == "max" || period <= 0.0) {
+    return 0.0;
+  }
+  return std::strtod(max.c_str(), nullptr) / period;
+}
+
+/// cgroup v1: quota is -1 if not limited
+double ReadCgroupV1Quota(const std::filesystem::path& dir) {
+  std::ifstream quota_file(dir / "cpu.cfs_quota_us");
+  std::ifstream period_file(dir / "cpu.cfs_period_us");
+  double quota, period;
+  if (!(quota_file >> quota) || !(period_file >> period) ||
+      quota <= 0.0 || period <= 0.0) {
+    return 0.0;
+  }
+  return quota / period;
+}
+
+/// the smallest positive quota (nested cgroups limit each other)
+double MinQuota(double lhs, double rhs) {
+  if (lhs <= 0.0) {
+    return rhs;
+  }
+  if (rhs <= 0.0) {
+    return lhs;
+  }
+  return std::min(lhs, rhs);
+}
+#endif
+
+}  // namespace
+
+const CpuTopology& CpuTopology::Get() {
+  static const CpuTopology topology;
+  return topology;
+}
+
+CpuTopology::CpuTopology()
+    : fallback_cpu_count_(
+          std::max(1, static_cast<int>(std::thread::hardware_concurrency()))) {
+  DetectCpus();
+  DetectQuota();
+}
+
+void CpuTopology::DetectCpus() {
+#ifdef __linux__
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    return;
+  }
+  const std::filesystem::path sys_cpu{"/sys/devices/system/cpu"};
+  for (int id = 0; id < CPU_SETSIZE; ++id) {
+    if (!CPU_ISSET(id, &cpu_set)) {
+      continue;
+    }
+    auto cpu_dir = sys_cpu / ("cpu" + std::to_string(id));
+    /// if sysfs isn't available every cpu is a separate core
+    int package = std::max(0, ReadIntFile(cpu_dir / "topology/physical_package_id"));
+    int core = ReadIntFile(cpu_dir / "topology/core_id");
+    if (core < 0) {
+      core = id;
+    }
+    int node = 0;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(cpu_dir, error)) {
+      auto name = entry.path().filename().string();
+      if (name.size() > 4 && name.starts_with("node") &&
+          std::all_of(name.begin() + 4, name.end(), [](unsigned char c) {
+            return std::isdigit(c);
+          })) {
+        node = std::stoi(name.substr(4));
+        break;
+      }
+    }
+    cpus_.push_back({id, package, core, node});
+  }
+  std::sort(cpus_.begin(), cpus_.end(), [](const Cpu& lhs, const Cpu& rhs) {
+    return std::tie(lhs.node, lhs.package, lhs.core, lhs.id) <
+           std::tie(rhs.node, rhs.package, rhs.core, rhs.id);
+  });
+#endif
+}
+
+void CpuTopology::DetectQuota() {
+#ifdef __linux__
+  /// lines "hierarchy-id:controllers:path", for v2 it's "0::path"
+  std::ifstream cgroup_file("/proc/self/cgroup");
+  std::string line;
+  const std::filesystem::path cgroup_root{"/sys/fs/cgroup"};
+  while (std::getline(cgroup_file, line)) {
+    auto first = line.find(':');
+    auto second = line.find(':', first + 1);
+    if (first == std::string::npos || second == std::string::npos) {
+      continue;
+    }
+    std::string controllers = line.substr(first + 1, second - first - 1);
+    std::filesystem::path path{line.substr(second + 1)};
+    path = path.relative_path();
+
+    if (controllers.empty()) {
+      /// v2: every ancestor may have its own limit
+      for (auto dir = path;; dir = dir.parent_path()) {
+        quota_cpus_ = MinQuota(quota_cpus_,
+                               ReadCgroupV2Quota(cgroup_root / dir / "cpu.max"));
+        if (dir.empty()) {
+          break;
+        }
+      }
+    } else if (controllers == "cpu" || controllers.starts_with("cpu,") ||
+               controllers.find(",cpu,") != std::string::npos ||
+               controllers.ends_with(",cpu")) {
+      /// v1: inside of a container own cgroup is mounted as a root
+      for (const auto& mount : {cgroup_root / "cpu", cgroup_root / "cpu,cpuacct",
+                                cgroup_root / controllers}) {
+        quota_cpus_ = MinQuota(quota_cpus_, ReadCgroupV1Quota(mount / path));
+        quota_cpus_ = MinQuota(quota_cpus_, ReadCgroupV1Quota(mount));
+      }
+    }
+  }
+#endif
+}
+
+int CpuTopology::GetUsableCpuCount() const {
+  int cpu_count = cpus_.empty() ? fallback_cpu_count_
+                                : static_cast<int>(cpus_.size());
+  if (quota_cpus_ > 0.0) {
+    /// rounded down: more threads than quota are just throttled
+    cpu_count = std::min(cpu_count,
+                         static_cast<int>(std::floor(quota_cpus_)));
+  }
+  return std::max(1, cpu_count);
+}
+
+int CpuTopology::GetUsableCoreCount() const {
+  if (cpus_.empty()) {
+    return GetUsableCpuCount();
+  }
+  std::set<std::pair<int, int>> cores;
+  for (const auto& cpu : cpus_) {
+    cores.emplace(cpu.package, cpu.core);
+  }
+  return std::max(1, std::min(static_cast<int>(cores.size()),
+                              GetUsableCpuCount()));
+}
+
+std::vector<int> CpuTopology::SelectCpus(int thread_count, bool skip_smt) const {
+  if (cpus_.empty() || thread_count <= 0) {
+    return {};
+  }
+  /// cpus_ are sorted, so the first cpu of each core goes first
+  std::vector<int> primary;
+  std::vector<int> siblings;
+  std::set<std::pair<int, int>> seen_cores;
+  for (const auto& cpu : cpus_) {
+    if (seen_cores.emplace(cpu.package, cpu.core).second) {
+      primary.push_back(cpu.id);
+    } else {
+      siblings.push_back(cpu.id);
+    }
+  }
+  std::vector<int> order = primary;
+  if (!skip_smt) {
+    order.insert(order.end(), siblings.begin(), siblings.end());
+  }
+  /// more threads than cpus: they share cpus in the same order
+  std::vector<int> selected(thread_count);
+  for (int i = 0; i < thread_count; ++i) {
+    selected[i] = order[i % order.size()];
+  }
+  return selected;
+}
+
+bool CpuTopology::PinCurrentThread(int cpu) {
+#ifdef __linux__
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  return sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+bool CpuTopology::UnpinCurrentThread() const {
+#ifdef __linux__
+  if (cpus_.empty()) {
+    return false;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (const auto& cpu : cpus_) {
+    CPU_SET(cpu.id, &cpu_set);
+  }
+  return sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0;
+#else
+  return false;
+#endif
+}
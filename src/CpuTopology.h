@@ -0,0 +1,57 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_CPUTOPOLOGY_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_CPUTOPOLOGY_H
+
+#include <vector>
+
+/// Logical CPUs the process may actually use:
+/// - affinity mask (sched_getaffinity, e.g. taskset or cpuset);
+/// - cgroup cpu quota (v2 cpu.max, v1 cpu.cfs_quota_us), e.g. docker --cpus;
+/// grouped by physical cores and NUMA nodes (/sys/devices/system/cpu).
+/// Detected only on linux, elsewhere it's just hardware_concurrency()
+/// and threads can't be pinned.
+class CpuTopology {
+ public:
+  struct Cpu {
+    int id;
+    int package;
+    int core;
+    int node;
+  };
+
+  /// detected once (thread-safe)
+  static const CpuTopology& Get();
+
+  /// min(cpus from affinity mask, quota), at least 1
+  int GetUsableCpuCount() const;
+  /// the same, but SMT siblings are counted once
+  int GetUsableCoreCount() const;
+
+  bool IsPinningSupported() const {
+    return !cpus_.empty();
+  }
+
+  /// cpu for each of thread_count threads: first one cpu per physical core
+  /// (ordered by NUMA node, so a small pool stays on one socket),
+  /// then SMT siblings, unless skip_smt (then cores are reused);
+  /// empty if pinning isn't supported
+  std::vector<int> SelectCpus(int thread_count, bool skip_smt) const;
+
+  /// both return false if failed or not supported
+  static bool PinCurrentThread(int cpu);
+  /// back to all cpus from the process affinity mask
+  bool UnpinCurrentThread() const;
+
+ private:
+  CpuTopology();
+
+  void DetectCpus();
+  void DetectQuota();
+
+  /// cpus_ ordered by (node, package, core, id)
+  std::vector<Cpu> cpus_;
+  int fallback_cpu_count_;
+  /// 0 means no limit
+  double quota_cpus_{0.0};
+};
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_CPUTOPOLOGY_H
@@ -0,0 +1,49 @@
+#include "DistanceField.h"
+
+#include <limits>
+
+DistanceScratch::DistanceScratch(std::size_t size)
+    : values(size), vertices(size), boundaries(size + 1) {}
+
+void SquaredDistanceLine(float* line, std::size_t stride, int count,
+                         DistanceScratch& scratch) {
+  if (count <= 0) {
+    return;
+  }
+  float* f = scratch.values.data();
+  int* v = scratch.vertices.data();
+  double* z = scratch.boundaries.data();
+  for (int q = 0; q < count; ++q) {
+    f[q] = line[q * stride];
+  }
+  /// coordinates squared are beyond float precision on big images,
+  /// so intersections are in double
+  auto intersection = [f](int q, int p) {
+    return ((f[q] + static_cast<double>(q) * q) -
+            (f[p] + static_cast<double>(p) * p)) /
+           (2.0 * (q - p));
+  };
+  int k = 0;
+  v[0] = 0;
+  z[0] = -std::numeric_limits<double>::infinity();
+  z[1] = std::numeric_limits<double>::infinity();
+  for (int q = 1; q < count; ++q) {
+    double s = intersection(q, v[k]);
+    while (s <= z[k]) {
+      --k;
+      s = intersection(q, v[k]);
+    }
+    ++k;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = std::numeric_limits<double>::infinity();
+  }
+  k = 0;
+  for (int q = 0; q < count; ++q) {
+    while (z[k + 1] < q) {
+      ++k;
+    }
+    auto offset = static_cast<float>(q - v[k]);
+    line[q * stride] = offset * offset + f[v[k]];
+  }
+}
@@ -0,0 +1,30 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_DISTANCEFIELD_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_DISTANCEFIELD_H
+
+#include <cstddef>
+#include <vector>
+
+/// Squared euclidean distance transform of Felzenszwalb & Huttenlocher
+/// ("Distance Transforms of Sampled Functions"): linear time and separable,
+/// so the 2d transform is a pass over all columns and then over all rows,
+/// where every line is independent (split between threads by the caller,
+/// see TextureProcessor::MakeDistanceField()).
+/// Values are capped: the texel is either a feature (0) or at most cap
+/// away, which keeps results exact in float and doesn't change any
+/// distance below cap (larger ones come out as cap or more).
+
+/// per thread, for lines up to size texels
+struct DistanceScratch {
+  explicit DistanceScratch(std::size_t size);
+
+  std::vector<float> values;
+  /// parabolas of the lower envelope: vertices & boundaries between them
+  std::vector<int> vertices;
+  std::vector<double> boundaries;
+};
+
+/// count values which are stride apart, in place
+void SquaredDistanceLine(float* line, std::size_t stride, int count,
+                         DistanceScratch& scratch);
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_DISTANCEFIELD_H
@@ -0,0 +1,136 @@
+#include "HalfFloat.h"
+
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define FAITHFUL_HALF_FLOAT_F16C 1
+#endif
+
+namespace {
+
+/// memcpy instead of casts, because in and out may alias
+uint32_t FloatBits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+float BitsToFloat(uint32_t bits) {
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+uint16_t FloatToHalfScalar(float value) {
+  constexpr uint32_t kF32Infinity = 255u << 23;
+  /// 65536.0f, everything above (after rounding) is infinity
+  constexpr uint32_t kF16Overflow = (127u + 16) << 23;
+  /// adding it aligns denormal mantissa at the bottom, so fpu rounds it
+  constexpr uint32_t kDenormMagic = ((127u - 15) + (23 - 10) + 1) << 23;
+
+  uint32_t bits = FloatBits(value);
+  uint32_t sign = bits & 0x80000000u;
+  bits ^= sign;
+  uint16_t half;
+  if (bits >= kF16Overflow) {
+    half = bits > kF32Infinity ? 0x7E00 : 0x7C00; // nan stays nan
+  } else if (bits < (113u << 23)) { // denormal or zero
+    half = static_cast<uint16_t>(
+        FloatBits(BitsToFloat(bits) + BitsToFloat(kDenormMagic)) -
+        kDenormMagic);
+  } else {
+    uint32_t mantissa_odd = (bits >> 13) & 1;
+    /// rebias exponent and round, carry may overflow into infinity
+    bits += (static_cast<uint32_t>(15 - 127) << 23) + 0xFFF + mantissa_odd;
+    half = static_cast<uint16_t>(bits >> 13);
+  }
+  return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+float HalfToFloatScalar(uint16_t half) {
+  constexpr uint32_t kShiftedExponent = 0x7C00u << 13;
+  constexpr uint32_t kDenormMagic = 113u << 23;
+
+  uint32_t bits = (half & 0x7FFFu) << 13;
+  uint32_t exponent = bits & kShiftedExponent;
+  bits += (127u - 15) << 23;
+  if (exponent == kShiftedExponent) { // inf or nan
+    bits += (128u - 16) << 23;
+  } else if (exponent == 0) { // denormal or zero, renormalized by fpu
+    bits += 1u << 23;
+    bits = FloatBits(BitsToFloat(bits) - BitsToFloat(kDenormMagic));
+  }
+  bits |= static_cast<uint32_t>(half & 0x8000u) << 16;
+  return BitsToFloat(bits);
+}
+
+#ifdef FAITHFUL_HALF_FLOAT_F16C
+/// every 8 values are loaded before stored, so in place works
+__attribute__((target("avx,f16c")))
+std::size_t FloatToHalfF16c(const float* in, uint16_t* out,
+                            std::size_t count) {
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 values = _mm256_loadu_ps(in + i);
+    __m128i halves = _mm256_cvtps_ph(values, _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), halves);
+  }
+  return i;
+}
+
+__attribute__((target("avx,f16c")))
+std::size_t HalfToFloatF16c(const uint16_t* in, float* out,
+                            std::size_t count) {
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i halves =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(halves));
+  }
+  return i;
+}
+#endif
+
+} // namespace
+
+bool HasF16c() {
+#ifdef FAITHFUL_HALF_FLOAT_F16C
+  static const bool has_f16c =
+      __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  return has_f16c;
+#else
+  return false;
+#endif
+}
+
+void FloatToHalf(const float* in, uint16_t* out, std::size_t count) {
+  std::size_t i = 0;
+#ifdef FAITHFUL_HALF_FLOAT_F16C
+  if (HasF16c()) {
+    i = FloatToHalfF16c(in, out, count);
+  }
+#endif
+  for (; i < count; ++i) {
+    float value;
+    std::memcpy(&value, in + i, sizeof(value));
+    uint16_t half = FloatToHalfScalar(value);
+    std::memcpy(out + i, &half, sizeof(half));
+  }
+}
+
+void HalfToFloat(const uint16_t* in, float* out, std::size_t count) {
+  std::size_t i = 0;
+#ifdef FAITHFUL_HALF_FLOAT_F16C
+  if (HasF16c()) {
+    i = HalfToFloatF16c(in, out, count);
+  }
+#endif
+  for (; i < count; ++i) {
+    uint16_t half;
+    std::memcpy(&half, in + i, sizeof(half));
+    float value = HalfToFloatScalar(half);
+    std::memcpy(out + i, &value, sizeof(value));
+  }
+}
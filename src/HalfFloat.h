@@ -0,0 +1,22 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_HALFFLOAT_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_HALFFLOAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// Conversion between float32 and IEEE half (astcenc ASTCENC_TYPE_F16),
+/// round to nearest even. Kernels use F16C (8 values per instruction) if
+/// cpu supports it (checked at runtime, so no special build flags are
+/// needed), otherwise scalar fallback with the same results.
+
+/// out may be the same memory as in (converted in place)
+void FloatToHalf(const float* in, uint16_t* out, std::size_t count);
+
+/// in may point to the upper half of out buffer
+/// (reinterpret_cast<uint16_t*>(out) + count), so halves decoded there
+/// are expanded in place
+void HalfToFloat(const uint16_t* in, float* out, std::size_t count);
+
+bool HasF16c();
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_HALFFLOAT_H
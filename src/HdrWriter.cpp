@@ -0,0 +1,132 @@
+#include "HdrWriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "HalfFloat.h"
+
+namespace {
+
+constexpr int kComponents = 4;
+
+void LinearToRgbe(const float* linear, uint8_t* rgbe) {
+  float max_component = std::max(linear[0], std::max(linear[1], linear[2]));
+  if (max_component < 1e-32f) {
+    rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+    return;
+  }
+  int exponent;
+  /// the same float math as stb_image_write.h, so output is identical
+  float normalize = static_cast<float>(std::frexp(max_component, &exponent)) *
+                    256.0f / max_component;
+  rgbe[0] = static_cast<uint8_t>(linear[0] * normalize);
+  rgbe[1] = static_cast<uint8_t>(linear[1] * normalize);
+  rgbe[2] = static_cast<uint8_t>(linear[2] * normalize);
+  rgbe[3] = static_cast<uint8_t>(exponent + 128);
+}
+
+}  // namespace
+
+HdrWriter::HdrWriter(const std::filesystem::path& path, int width, int height)
+    : atomic_file_(path),
+      file_(atomic_file_.GetTempPath(), std::ios::binary),
+      width_(width) {
+  if (!file_.is_open()) {
+    return;
+  }
+  std::string header =
+      "#?RADIANCE\n# Written by FaithfulAssetProcessor\n"
+      "FORMAT=32-bit_rle_rgbe\nEXPOSURE=          1.0000000000000\n\n-Y ";
+  header += std::to_string(height) + " +X " + std::to_string(width) + "\n";
+  file_.write(header.data(), static_cast<std::streamsize>(header.size()));
+}
+
+void HdrWriter::EncodeStrip(const uint16_t* rgba, int, int row_count,
+                            Strip& strip) const {
+  std::size_t row_values = static_cast<std::size_t>(width_) * kComponents;
+  std::vector<float> row(row_values);
+  std::vector<uint8_t> scratch(static_cast<std::size_t>(width_) * 4);
+  strip.data.clear();
+  strip.data.reserve(row_count * (row_values + 4));
+  for (int r = 0; r < row_count; ++r) {
+    HalfToFloat(rgba + r * row_values, row.data(), row_values);
+    EncodeScanline(row.data(), scratch.data(), strip.data);
+  }
+  strip.failed = false;
+}
+
+void HdrWriter::EncodeScanline(const float* rgba, uint8_t* scratch,
+                               std::vector<uint8_t>& out) const {
+  int width = width_;
+  /// no RLE for too narrow or too wide images
+  if (width < 8 || width >= 32768) {
+    for (int x = 0; x < width; ++x) {
+      uint8_t rgbe[4];
+      LinearToRgbe(rgba + x * kComponents, rgbe);
+      out.insert(out.end(), rgbe, rgbe + 4);
+    }
+    return;
+  }
+  for (int x = 0; x < width; ++x) {
+    uint8_t rgbe[4];
+    LinearToRgbe(rgba + x * kComponents, rgbe);
+    for (int c = 0; c < 4; ++c) {
+      scratch[x + width * c] = rgbe[c];
+    }
+  }
+  const uint8_t scanline_header[4]{2, 2, static_cast<uint8_t>(width >> 8),
+                                   static_cast<uint8_t>(width & 0xFF)};
+  out.insert(out.end(), scanline_header, scanline_header + 4);
+
+  /// each component separately: dumps of up to 128 bytes and runs of
+  /// 3..127 equal bytes
+  for (int c = 0; c < 4; ++c) {
+    const uint8_t* component = scratch + width * c;
+    int x = 0;
+    while (x < width) {
+      int r = x;
+      while (r + 2 < width) {
+        if (component[r] == component[r + 1] &&
+            component[r] == component[r + 2]) {
+          break;
+        }
+        ++r;
+      }
+      if (r + 2 >= width) {
+        r = width;
+      }
+      while (x < r) {
+        int length = std::min(r - x, 128);
+        out.push_back(static_cast<uint8_t>(length));
+        out.insert(out.end(), component + x, component + x + length);
+        x += length;
+      }
+      if (r + 2 < width) {
+        while (r < width && component[r] == component[x]) {
+          ++r;
+        }
+        while (x < r) {
+          int length = std::min(r - x, 127);
+          out.push_back(static_cast<uint8_t>(length + 128));
+          out.push_back(component[x]);
+          x += length;
+        }
+      }
+    }
+  }
+}
+
+bool HdrWriter::WriteStrip(const Strip& strip) {
+  if (strip.failed) {
+    return false;
+  }
+  file_.write(reinterpret_cast<const char*>(strip.data.data()),
+              static_cast<std::streamsize>(strip.data.size()));
+  return static_cast<bool>(file_);
+}
+
+bool HdrWriter::Commit() {
+  file_.close();
+  return file_ && atomic_file_.Commit();
+}
@@ -0,0 +1,52 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_HDRWRITER_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_HDRWRITER_H
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "AtomicFile.h"
+
+/// Radiance .hdr (RGBE, new RLE) encoder for decode mode, fed by strips of
+/// rows as they are decompressed (see TextureProcessor::DecodeStrips()),
+/// so neither the whole image nor its float32 copy is in memory.
+/// Scanlines are encoded exactly as stbi_write_hdr does; each strip is
+/// encoded on its own by any thread, written in order.
+/// Written under temporary name and renamed by Commit() (see AtomicFile).
+class HdrWriter {
+ public:
+  /// astcenc ASTCENC_TYPE_F16
+  using Component = uint16_t;
+
+  struct Strip {
+    std::vector<uint8_t> data;
+    bool failed;
+  };
+
+  HdrWriter(const std::filesystem::path& path, int width, int height);
+
+  bool IsOpen() const {
+    return file_.is_open();
+  }
+
+  /// thread-safe; rgba half floats of row_count rows, alpha is dropped
+  void EncodeStrip(const uint16_t* rgba, int first_row, int row_count,
+                   Strip& strip) const;
+
+  /// in order of rows, one thread at a time
+  bool WriteStrip(const Strip& strip);
+
+  /// returns false if file can't be written
+  bool Commit();
+
+ private:
+  void EncodeScanline(const float* rgba, uint8_t* scratch,
+                      std::vector<uint8_t>& out) const;
+
+  AtomicFile atomic_file_;
+  std::ofstream file_;
+  int width_;
+};
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_HDRWRITER_H
@@ -0,0 +1,280 @@
+#include "ImaAdpcm.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+
+#include "../config/AssetFormats.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define FAITHFUL_IMA_ADPCM_AVX2 1
+#endif
+
+namespace {
+
+constexpr int kMaxStepIndex = 88;
+
+constexpr std::array<int, kMaxStepIndex + 1> kSteps = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,
+    19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+    337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+    876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+    5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+/// step index change after a nibble of this magnitude
+constexpr std::array<int, 8> kIndexAdjust = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+/// difference which decoder adds to (or subtracts from) the predictor
+inline int Difference(int step, int magnitude) {
+  return (step >> 3) + ((magnitude & 4) ? step : 0) +
+         ((magnitude & 2) ? step >> 1 : 0) + ((magnitude & 1) ? step >> 2 : 0);
+}
+
+/// the nearest of the truncated magnitude (of the reference encoder) and
+/// the next one: differences grow with magnitude, so no other is closer;
+/// predictor & index are updated the same way as by decoder
+inline int EncodeSample(int sample, int& predictor, int& index) {
+  int step = kSteps[index];
+  int delta = sample - predictor;
+  int sign = delta < 0 ? 8 : 0;
+  int rest = std::abs(delta);
+  int magnitude = rest >= step ? 4 : 0;
+  rest -= rest >= step ? step : 0;
+  magnitude |= rest >= (step >> 1) ? 2 : 0;
+  rest -= rest >= (step >> 1) ? step >> 1 : 0;
+  magnitude |= rest >= (step >> 2) ? 1 : 0;
+  int next = std::min(magnitude + 1, 7);
+
+  int direction = sign != 0 ? -1 : 1;
+  int low = std::clamp(predictor + direction * Difference(step, magnitude),
+                       -32768, 32767);
+  int high = std::clamp(predictor + direction * Difference(step, next),
+                        -32768, 32767);
+  bool take_next = std::abs(sample - high) < std::abs(sample - low);
+  magnitude = take_next ? next : magnitude;
+  predictor = take_next ? high : low;
+  index = std::clamp(index + kIndexAdjust[magnitude], 0, kMaxStepIndex);
+  return sign | magnitude;
+}
+
+constexpr int kCandidates = kMaxStepIndex + 1;
+
+/// squared errors of all candidates -> the smallest step on ties
+/// (e.g. silence)
+int BestCandidate(const int64_t* errors) {
+  return static_cast<int>(std::min_element(errors, errors + kCandidates) -
+                          errors);
+}
+
+/// step index of the block header for one channel: each candidate encodes
+/// frames [1, end) of the block in its own lane
+int SearchStepIndexScalar(const int16_t* block, int channels, int channel,
+                          std::size_t end) {
+  std::array<int, kCandidates> predictors;
+  std::array<int, kCandidates> indices;
+  std::array<int64_t, kCandidates> errors{};
+  predictors.fill(block[channel]);
+  for (int lane = 0; lane < kCandidates; ++lane) {
+    indices[lane] = lane;
+  }
+  for (std::size_t frame = 1; frame < end; ++frame) {
+    int sample = block[frame * channels + channel];
+    for (int lane = 0; lane < kCandidates; ++lane) {
+      EncodeSample(sample, predictors[lane], indices[lane]);
+      int64_t error = sample - predictors[lane];
+      errors[lane] += error * error;
+    }
+  }
+  return BestCandidate(errors.data());
+}
+
+#ifdef FAITHFUL_IMA_ADPCM_AVX2
+/// rest >= value ? taken : 0, per lane
+__attribute__((target("avx2")))
+inline __m256i TakeIfReaches(__m256i rest, __m256i value, __m256i taken) {
+  return _mm256_andnot_si256(_mm256_cmpgt_epi32(value, rest), taken);
+}
+
+/// value where magnitude has the bit, per lane
+__attribute__((target("avx2")))
+inline __m256i TakeIfBit(__m256i magnitude, int bit, __m256i value) {
+  const __m256i bits = _mm256_set1_epi32(bit);
+  return _mm256_and_si256(
+      _mm256_cmpeq_epi32(_mm256_and_si256(magnitude, bits), bits), value);
+}
+
+/// Difference() of 8 lanes
+__attribute__((target("avx2")))
+inline __m256i Difference(__m256i step, __m256i magnitude) {
+  return _mm256_add_epi32(
+      _mm256_add_epi32(_mm256_srai_epi32(step, 3),
+                       TakeIfBit(magnitude, 4, step)),
+      _mm256_add_epi32(TakeIfBit(magnitude, 2, _mm256_srai_epi32(step, 1)),
+                       TakeIfBit(magnitude, 1, _mm256_srai_epi32(step, 2))));
+}
+
+/// decoded sample, difference is negated by (x ^ -1) - (-1) in lanes
+/// where negative is all ones
+__attribute__((target("avx2")))
+inline __m256i Reconstruct(__m256i predictor, __m256i step,
+                           __m256i magnitude, __m256i negative) {
+  __m256i difference = _mm256_sub_epi32(
+      _mm256_xor_si256(Difference(step, magnitude), negative), negative);
+  return _mm256_max_epi32(
+      _mm256_min_epi32(_mm256_add_epi32(predictor, difference),
+                       _mm256_set1_epi32(32767)),
+      _mm256_set1_epi32(-32768));
+}
+
+/// the same integer math as EncodeSample() for 8 candidates per vector,
+/// so results don't depend on cpu; lanes past the last index repeat it
+__attribute__((target("avx2")))
+int SearchStepIndexAvx2(const int16_t* block, int channels, int channel,
+                        std::size_t end) {
+  constexpr int kVectors = (kCandidates + 7) / 8;
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i two = _mm256_set1_epi32(2);
+  const __m256i four = _mm256_set1_epi32(4);
+  const __m256i seven = _mm256_set1_epi32(7);
+  const __m256i max_index = _mm256_set1_epi32(kMaxStepIndex);
+  const __m256i adjust = _mm256_setr_epi32(
+      kIndexAdjust[0], kIndexAdjust[1], kIndexAdjust[2], kIndexAdjust[3],
+      kIndexAdjust[4], kIndexAdjust[5], kIndexAdjust[6], kIndexAdjust[7]);
+
+  __m256i predictors[kVectors];
+  __m256i indices[kVectors];
+  /// squares are up to 2^32, so 64-bit sums of even and odd lanes
+  __m256i errors_even[kVectors];
+  __m256i errors_odd[kVectors];
+  for (int v = 0; v < kVectors; ++v) {
+    predictors[v] = _mm256_set1_epi32(block[channel]);
+    indices[v] = _mm256_min_epi32(
+        _mm256_add_epi32(_mm256_set1_epi32(v * 8),
+                         _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)),
+        max_index);
+    errors_even[v] = zero;
+    errors_odd[v] = zero;
+  }
+  for (std::size_t frame = 1; frame < end; ++frame) {
+    const __m256i sample =
+        _mm256_set1_epi32(block[frame * channels + channel]);
+    for (int v = 0; v < kVectors; ++v) {
+      __m256i step = _mm256_i32gather_epi32(kSteps.data(), indices[v], 4);
+      __m256i delta = _mm256_sub_epi32(sample, predictors[v]);
+      __m256i negative = _mm256_cmpgt_epi32(zero, delta);
+      __m256i rest = _mm256_abs_epi32(delta);
+      __m256i magnitude = TakeIfReaches(rest, step, four);
+      rest = _mm256_sub_epi32(rest, TakeIfReaches(rest, step, step));
+      __m256i half = _mm256_srai_epi32(step, 1);
+      magnitude = _mm256_or_si256(magnitude, TakeIfReaches(rest, half, two));
+      rest = _mm256_sub_epi32(rest, TakeIfReaches(rest, half, half));
+      magnitude = _mm256_or_si256(
+          magnitude, TakeIfReaches(rest, _mm256_srai_epi32(step, 2), one));
+      __m256i next =
+          _mm256_min_epi32(_mm256_add_epi32(magnitude, one), seven);
+
+      __m256i low = Reconstruct(predictors[v], step, magnitude, negative);
+      __m256i high = Reconstruct(predictors[v], step, next, negative);
+      __m256i take_next = _mm256_cmpgt_epi32(
+          _mm256_abs_epi32(_mm256_sub_epi32(sample, low)),
+          _mm256_abs_epi32(_mm256_sub_epi32(sample, high)));
+      magnitude = _mm256_blendv_epi8(magnitude, next, take_next);
+      predictors[v] = _mm256_blendv_epi8(low, high, take_next);
+      indices[v] = _mm256_max_epi32(
+          _mm256_min_epi32(
+              _mm256_add_epi32(indices[v],
+                               _mm256_permutevar8x32_epi32(adjust, magnitude)),
+              max_index),
+          zero);
+
+      __m256i error = _mm256_sub_epi32(sample, predictors[v]);
+      __m256i odd = _mm256_srli_epi64(error, 32);
+      errors_even[v] =
+          _mm256_add_epi64(errors_even[v], _mm256_mul_epi32(error, error));
+      errors_odd[v] =
+          _mm256_add_epi64(errors_odd[v], _mm256_mul_epi32(odd, odd));
+    }
+  }
+  int64_t errors[kVectors * 8];
+  for (int v = 0; v < kVectors; ++v) {
+    int64_t even[4];
+    int64_t odd[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(even), errors_even[v]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(odd), errors_odd[v]);
+    for (int i = 0; i < 4; ++i) {
+      errors[v * 8 + i * 2] = even[i];
+      errors[v * 8 + i * 2 + 1] = odd[i];
+    }
+  }
+  return BestCandidate(errors);
+}
+
+bool HasAvx2() {
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2;
+}
+#endif
+
+int SearchStepIndex(const int16_t* block, int channels, int channel,
+                    std::size_t frame_count) {
+  std::size_t end = std::min<std::size_t>(
+      frame_count, 1 + faithful::config::kSoundAdpcmSearchFrames);
+#ifdef FAITHFUL_IMA_ADPCM_AVX2
+  if (HasAvx2()) {
+    return SearchStepIndexAvx2(block, channels, channel, end);
+  }
+#endif
+  return SearchStepIndexScalar(block, channels, channel, end);
+}
+
+}  // namespace
+
+int ImaAdpcmFramesPerBlock(int block_align, int channels) {
+  /// header: 4 bytes with the first frame, then 2 samples per byte
+  return (block_align / channels - 4) * 2 + 1;
+}
+
+std::vector<uint8_t> EncodeImaAdpcm(const int16_t* frames,
+                                    std::size_t frame_count, int channels,
+                                    int block_align) {
+  std::vector<uint8_t> blocks;
+  if (frame_count == 0 || channels <= 0) {
+    return blocks;
+  }
+  auto frames_per_block = static_cast<std::size_t>(
+      ImaAdpcmFramesPerBlock(block_align, channels));
+  auto stride = static_cast<std::size_t>(channels);
+  for (std::size_t start = 0; start < frame_count; start += frames_per_block) {
+    const int16_t* block = frames + start * stride;
+    std::size_t count = std::min(frames_per_block, frame_count - start);
+    /// per channel: 4 bytes of 8 samples, channels interleaved by them
+    std::size_t groups = (count - 1 + 7) / 8;
+    std::size_t offset = blocks.size();
+    blocks.resize(offset + stride * 4 * (1 + groups), 0);
+    for (int channel = 0; channel < channels; ++channel) {
+      int predictor = block[channel];
+      int index = SearchStepIndex(block, channels, channel, count);
+      uint8_t* header = blocks.data() + offset + channel * 4;
+      auto bits = static_cast<uint16_t>(predictor);
+      header[0] = static_cast<uint8_t>(bits & 0xFF);
+      header[1] = static_cast<uint8_t>(bits >> 8);
+      header[2] = static_cast<uint8_t>(index);
+      uint8_t* data = blocks.data() + offset + stride * 4 + channel * 4;
+      for (std::size_t sample = 0; sample < groups * 8; ++sample) {
+        std::size_t frame = std::min(sample + 1, count - 1);
+        int nibble = EncodeSample(block[frame * stride + channel], predictor,
+                                  index);
+        uint8_t& byte = data[(sample / 8) * stride * 4 + (sample % 8) / 2];
+        byte |= static_cast<uint8_t>(sample % 2 == 0 ? nibble : nibble << 4);
+      }
+    }
+  }
+  return blocks;
+}
@@ -0,0 +1,29 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_IMAADPCM_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_IMAADPCM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// IMA ADPCM encoder (.wav format tag 0x11, WAVE_FORMAT_IMA_ADPCM): 4 bits
+/// per sample, so 4:1 of 16-bit pcm, and decoding is a few additions per
+/// sample. Each block starts with an exact sample and step index per
+/// channel, so blocks are independent.
+/// Unlike the reference encoder, which truncates the difference, every
+/// nibble is the one with the nearest reconstruction, and the step index
+/// of each block header is searched: all 89 are tried at once on the first
+/// kSoundAdpcmSearchFrames of the block (8 candidates per AVX2 register when
+/// cpu has it, same result as scalar) and the one with the least squared
+/// error is kept.
+
+/// per block of block_align bytes
+int ImaAdpcmFramesPerBlock(int block_align, int channels);
+
+/// interleaved 16-bit frames into blocks of block_align bytes; the last
+/// block ends after the group of 8 samples with the last frame (the rest
+/// of the group repeats it), so the frame count should be stored beside
+std::vector<uint8_t> EncodeImaAdpcm(const int16_t* frames,
+                                    std::size_t frame_count, int channels,
+                                    int block_align);
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_IMAADPCM_H
@@ -0,0 +1,142 @@
+#include "ImageAnalysis.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FAITHFUL_IMAGE_ANALYSIS_SSE2 1
+#endif
+
+namespace {
+
+/// words checked between early exits
+constexpr std::size_t kExitCheckInterval = 1024;
+
+/// per 64-bit word: two u8 texels or one f16 texel
+struct TexelMasks {
+  /// shift of the word by one channel, so r^g and g^b land on r and g
+  int channel_bits;
+  uint64_t alpha;
+  uint64_t opaque_alpha;
+  /// r, g, b without sign bit of halves
+  uint64_t color;
+  /// r and g of each texel after shift: r^g, g^b
+  uint64_t gray;
+};
+
+constexpr TexelMasks kU8Masks{8, 0xFF000000FF000000ull, 0xFF000000FF000000ull,
+                              0x00FFFFFF00FFFFFFull, 0x0000FFFF0000FFFFull};
+constexpr TexelMasks kF16Masks{16, 0xFFFF000000000000ull,
+                               0x3C00000000000000ull, // 1.0
+                               0x00007FFF7FFF7FFFull, 0x00000000FFFFFFFFull};
+
+/// accumulated bits, which are zero while the trait is still true
+struct Differences {
+  uint64_t constant{0};
+  uint64_t opaque{0};
+  uint64_t grayscale{0};
+  uint64_t black{0};
+
+  bool AllFound() const {
+    return constant != 0 && opaque != 0 && grayscale != 0 && black != 0;
+  }
+};
+
+void AccumulateWord(uint64_t word, uint64_t first, const TexelMasks& masks,
+                    Differences& differences) {
+  differences.constant |= word ^ first;
+  differences.opaque |= (word & masks.alpha) ^ masks.opaque_alpha;
+  differences.grayscale |= (word ^ (word >> masks.channel_bits)) & masks.gray;
+  differences.black |= word & masks.color;
+}
+
+Differences AccumulateWords(const uint8_t* data, std::size_t word_count,
+                            uint64_t first, const TexelMasks& masks) {
+  Differences differences;
+  std::size_t i = 0;
+#ifdef FAITHFUL_IMAGE_ANALYSIS_SSE2
+  const __m128i first_v = _mm_set1_epi64x(static_cast<int64_t>(first));
+  const __m128i alpha_v = _mm_set1_epi64x(static_cast<int64_t>(masks.alpha));
+  const __m128i opaque_v =
+      _mm_set1_epi64x(static_cast<int64_t>(masks.opaque_alpha));
+  const __m128i color_v = _mm_set1_epi64x(static_cast<int64_t>(masks.color));
+  const __m128i gray_v = _mm_set1_epi64x(static_cast<int64_t>(masks.gray));
+  const __m128i shift = _mm_cvtsi32_si128(masks.channel_bits);
+  while (i + 2 <= word_count) {
+    __m128i constant = _mm_setzero_si128();
+    __m128i opaque = _mm_setzero_si128();
+    __m128i grayscale = _mm_setzero_si128();
+    __m128i black = _mm_setzero_si128();
+    std::size_t end = std::min(word_count & ~std::size_t{1},
+                               i + kExitCheckInterval);
+    for (; i < end; i += 2) {
+      __m128i v = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(data + i * sizeof(uint64_t)));
+      constant = _mm_or_si128(constant, _mm_xor_si128(v, first_v));
+      opaque = _mm_or_si128(
+          opaque, _mm_xor_si128(_mm_and_si128(v, alpha_v), opaque_v));
+      grayscale = _mm_or_si128(
+          grayscale,
+          _mm_and_si128(_mm_xor_si128(v, _mm_srl_epi64(v, shift)), gray_v));
+      black = _mm_or_si128(black, _mm_and_si128(v, color_v));
+    }
+    auto fold = [](__m128i v) {
+      uint64_t lanes[2];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), v);
+      return lanes[0] | lanes[1];
+    };
+    differences.constant |= fold(constant);
+    differences.opaque |= fold(opaque);
+    differences.grayscale |= fold(grayscale);
+    differences.black |= fold(black);
+    if (differences.AllFound()) {
+      return differences;
+    }
+  }
+#endif
+  for (; i < word_count; ++i) {
+    uint64_t word;
+    std::memcpy(&word, data + i * sizeof(uint64_t), sizeof(word));
+    AccumulateWord(word, first, masks, differences);
+    if (i % kExitCheckInterval == 0 && differences.AllFound()) {
+      break;
+    }
+  }
+  return differences;
+}
+
+ImageTraits ToTraits(const Differences& differences) {
+  return {differences.constant == 0, differences.opaque == 0,
+          differences.grayscale == 0, differences.black == 0};
+}
+
+}  // namespace
+
+ImageTraits AnalyzeImage(const uint8_t* data, std::size_t pixel_count) {
+  if (pixel_count == 0) {
+    return {true, true, true, true};
+  }
+  /// the first texel in both halves of the word
+  uint32_t texel;
+  std::memcpy(&texel, data, sizeof(texel));
+  uint64_t first = static_cast<uint64_t>(texel) << 32 | texel;
+  auto differences = AccumulateWords(data, pixel_count / 2, first, kU8Masks);
+  /// odd count: the last texel is checked twice
+  if (pixel_count % 2 != 0) {
+    std::memcpy(&texel, data + (pixel_count - 1) * 4, sizeof(texel));
+    AccumulateWord(static_cast<uint64_t>(texel) << 32 | texel, first,
+                   kU8Masks, differences);
+  }
+  return ToTraits(differences);
+}
+
+ImageTraits AnalyzeImage(const uint16_t* data, std::size_t pixel_count) {
+  if (pixel_count == 0) {
+    return {true, true, true, true};
+  }
+  uint64_t first;
+  std::memcpy(&first, data, sizeof(first));
+  return ToTraits(AccumulateWords(reinterpret_cast<const uint8_t*>(data),
+                                  pixel_count, first, kF16Masks));
+}
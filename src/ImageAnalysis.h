@@ -0,0 +1,31 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_IMAGEANALYSIS_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_IMAGEANALYSIS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// What the pixels of a decoded image allow to skip or simplify before
+/// compression (flat placeholders, opaque or grayscale textures).
+/// One pass over interleaved 4-channel (rgba) texels: 64-bit words are
+/// compared with bit masks, two per SSE2 register (always available
+/// on x86-64), other platforms use the same masks on scalar words.
+/// The pass stops early once nothing can be true anymore.
+
+struct ImageTraits {
+  /// all texels are equal
+  bool constant;
+  /// alpha is max (255 or half 1.0) everywhere
+  bool opaque;
+  /// r == g == b everywhere
+  bool grayscale;
+  /// r == g == b == 0 everywhere (alpha isn't checked)
+  bool black;
+};
+
+/// ldr, 8 bits per channel
+ImageTraits AnalyzeImage(const uint8_t* data, std::size_t pixel_count);
+
+/// hdr, half floats (ASTCENC_TYPE_F16); -0.0 is black too
+ImageTraits AnalyzeImage(const uint16_t* data, std::size_t pixel_count);
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_IMAGEANALYSIS_H
@@ -0,0 +1,67 @@
+#include "ImageDownscale.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+#include "HalfFloat.h"
+
+namespace {
+
+/// column pair of each output column, the last one repeated for odd width
+template <typename Sample>
+void AverageRows(const Sample* row0, const Sample* row1, int width,
+                 Sample* out, int out_width) {
+  for (int x = 0; x < out_width; ++x) {
+    auto x0 = static_cast<std::size_t>(2 * x) * 4;
+    auto x1 = static_cast<std::size_t>(std::min(2 * x + 1, width - 1)) * 4;
+    for (int c = 0; c < 4; ++c) {
+      if constexpr (std::is_same_v<Sample, uint8_t>) {
+        /// rounded to nearest
+        out[x * 4 + c] = static_cast<uint8_t>(
+            (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) /
+            4);
+      } else {
+        out[x * 4 + c] =
+            (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) *
+            0.25f;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+int HalvedSize(int size) {
+  return std::max(1, (size + 1) / 2);
+}
+
+void HalveRows(const uint8_t* in, int width, int height, astcenc_type type,
+               uint8_t* out, int first_row, int row_count) {
+  int out_width = HalvedSize(width);
+  auto in_row_values = static_cast<std::size_t>(width) * 4;
+  auto out_row_values = static_cast<std::size_t>(out_width) * 4;
+  if (type == ASTCENC_TYPE_U8) {
+    for (int y = first_row; y < first_row + row_count; ++y) {
+      int y1 = std::min(2 * y + 1, height - 1);
+      AverageRows(in + 2 * y * in_row_values, in + y1 * in_row_values, width,
+                  out + y * out_row_values, out_width);
+    }
+    return;
+  }
+  /// ASTCENC_TYPE_F16: two source rows and one output row in float32
+  auto halves_in = reinterpret_cast<const uint16_t*>(in);
+  auto halves_out = reinterpret_cast<uint16_t*>(out);
+  auto buffer = std::make_unique<float[]>(in_row_values * 2 + out_row_values);
+  float* row0 = buffer.get();
+  float* row1 = row0 + in_row_values;
+  float* row_out = row1 + in_row_values;
+  for (int y = first_row; y < first_row + row_count; ++y) {
+    int y1 = std::min(2 * y + 1, height - 1);
+    HalfToFloat(halves_in + 2 * y * in_row_values, row0, in_row_values);
+    HalfToFloat(halves_in + y1 * in_row_values, row1, in_row_values);
+    AverageRows(row0, row1, width, row_out, out_width);
+    FloatToHalf(row_out, halves_out + y * out_row_values, out_row_values);
+  }
+}
@@ -0,0 +1,22 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_IMAGEDOWNSCALE_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_IMAGEDOWNSCALE_H
+
+#include <cstdint>
+
+#include "astc-encoder/Source/astcenc.h"
+
+/// 2x2 box filter halving of interleaved rgba images (ASTCENC_TYPE_U8 or
+/// ASTCENC_TYPE_F16), for encode profiles with smaller max size (see
+/// TextureProcessor::SetProfiles()). For power-of-two textures each
+/// halving is the next mip level; odd sizes reuse the last row/column.
+/// ldr is averaged as stored (without srgb decoding), hdr in float32.
+
+/// width or height after one halving
+int HalvedSize(int size);
+
+/// rows [first_row, first_row + row_count) of the halved image,
+/// so the image can be split between threads
+void HalveRows(const uint8_t* in, int width, int height, astcenc_type type,
+               uint8_t* out, int first_row, int row_count);
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_IMAGEDOWNSCALE_H
@@ -0,0 +1,288 @@
+#include "ImageMetrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FAITHFUL_IMAGE_METRICS_SSE2 1
+#endif
+
+namespace {
+
+/// 32-bit lanes accumulate at most 4 * 255^2 per iteration, so we flush them
+/// into doubles long before overflow
+constexpr std::size_t kU8FlushInterval = 4096;
+/// float accumulators lose precision on big images, flush them more often
+constexpr std::size_t kF32FlushInterval = 1024;
+
+constexpr int kSsimWindowSize = 8;
+constexpr int kSsimWindowStride = 4;
+
+/// rgba of one pixel, so SSIM for all channels is computed at once
+struct Float4 {
+#ifdef FAITHFUL_IMAGE_METRICS_SSE2
+  __m128 v;
+
+  static Float4 Zero() {
+    return {_mm_setzero_ps()};
+  }
+  static Float4 Set(float x) {
+    return {_mm_set1_ps(x)};
+  }
+  static Float4 Load(const float* pixel) {
+    return {_mm_loadu_ps(pixel)};
+  }
+  static Float4 Load(const uint8_t* pixel) {
+    __m128i p = _mm_cvtsi32_si128(static_cast<int>(
+        pixel[0] | pixel[1] << 8 | pixel[2] << 16 |
+        static_cast<uint32_t>(pixel[3]) << 24));
+    const __m128i zero = _mm_setzero_si128();
+    p = _mm_unpacklo_epi16(_mm_unpacklo_epi8(p, zero), zero);
+    return {_mm_cvtepi32_ps(p)};
+  }
+  void Store(float* out) const {
+    _mm_storeu_ps(out, v);
+  }
+  Float4 operator+(Float4 other) const {
+    return {_mm_add_ps(v, other.v)};
+  }
+  Float4 operator-(Float4 other) const {
+    return {_mm_sub_ps(v, other.v)};
+  }
+  Float4 operator*(Float4 other) const {
+    return {_mm_mul_ps(v, other.v)};
+  }
+  Float4 operator/(Float4 other) const {
+    return {_mm_div_ps(v, other.v)};
+  }
+#else
+  float v[4];
+
+  static Float4 Zero() {
+    return {{0.0f, 0.0f, 0.0f, 0.0f}};
+  }
+  static Float4 Set(float x) {
+    return {{x, x, x, x}};
+  }
+  template <typename T>
+  static Float4 Load(const T* pixel) {
+    return {{static_cast<float>(pixel[0]), static_cast<float>(pixel[1]),
+             static_cast<float>(pixel[2]), static_cast<float>(pixel[3])}};
+  }
+  void Store(float* out) const {
+    std::copy_n(v, 4, out);
+  }
+  template <typename Op>
+  Float4 Apply(Float4 other, Op op) const {
+    return {{op(v[0], other.v[0]), op(v[1], other.v[1]),
+             op(v[2], other.v[2]), op(v[3], other.v[3])}};
+  }
+  Float4 operator+(Float4 other) const {
+    return Apply(other, [](float a, float b) { return a + b; });
+  }
+  Float4 operator-(Float4 other) const {
+    return Apply(other, [](float a, float b) { return a - b; });
+  }
+  Float4 operator*(Float4 other) const {
+    return Apply(other, [](float a, float b) { return a * b; });
+  }
+  Float4 operator/(Float4 other) const {
+    return Apply(other, [](float a, float b) { return a / b; });
+  }
+#endif
+};
+
+template <typename T>
+double StructuralSimilarityImpl(const T* lhs, const T* rhs,
+                                int width, int height,
+                                const std::array<bool, 4>& channel_mask,
+                                double dynamic_range) {
+  /// images smaller than a window are taken as one window
+  int window_x = std::min(width, kSsimWindowSize);
+  int window_y = std::min(height, kSsimWindowSize);
+  if (window_x <= 0 || window_y <= 0) {
+    return 1.0;
+  }
+  const float inv_n = 1.0f / static_cast<float>(window_x * window_y);
+  const Float4 c1 = Float4::Set(
+      static_cast<float>((0.01 * dynamic_range) * (0.01 * dynamic_range)));
+  const Float4 c2 = Float4::Set(
+      static_cast<float>((0.03 * dynamic_range) * (0.03 * dynamic_range)));
+  const Float4 two = Float4::Set(2.0f);
+  const Float4 inv_n4 = Float4::Set(inv_n);
+
+  std::array<double, 4> ssim_sums{};
+  std::size_t window_count = 0;
+  for (int y0 = 0; y0 + window_y <= height; y0 += kSsimWindowStride) {
+    for (int x0 = 0; x0 + window_x <= width; x0 += kSsimWindowStride) {
+      Float4 sum_x = Float4::Zero();
+      Float4 sum_y = Float4::Zero();
+      Float4 sum_xx = Float4::Zero();
+      Float4 sum_yy = Float4::Zero();
+      Float4 sum_xy = Float4::Zero();
+      for (int y = y0; y < y0 + window_y; ++y) {
+        std::size_t row = static_cast<std::size_t>(y) * width;
+        for (int x = x0; x < x0 + window_x; ++x) {
+          Float4 a = Float4::Load(lhs + (row + x) * 4);
+          Float4 b = Float4::Load(rhs + (row + x) * 4);
+          sum_x = sum_x + a;
+          sum_y = sum_y + b;
+          sum_xx = sum_xx + a * a;
+          sum_yy = sum_yy + b * b;
+          sum_xy = sum_xy + a * b;
+        }
+      }
+      Float4 mean_x = sum_x * inv_n4;
+      Float4 mean_y = sum_y * inv_n4;
+      Float4 var_x = sum_xx * inv_n4 - mean_x * mean_x;
+      Float4 var_y = sum_yy * inv_n4 - mean_y * mean_y;
+      Float4 covariance = sum_xy * inv_n4 - mean_x * mean_y;
+      Float4 ssim =
+          ((two * mean_x * mean_y + c1) * (two * covariance + c2)) /
+          ((mean_x * mean_x + mean_y * mean_y + c1) * (var_x + var_y + c2));
+      alignas(16) float lanes[4];
+      ssim.Store(lanes);
+      for (int c = 0; c < 4; ++c) {
+        ssim_sums[c] += lanes[c];
+      }
+      ++window_count;
+    }
+  }
+
+  double total = 0.0;
+  int channel_count = 0;
+  for (int c = 0; c < 4; ++c) {
+    if (channel_mask[c]) {
+      total += ssim_sums[c] / static_cast<double>(window_count);
+      ++channel_count;
+    }
+  }
+  return channel_count == 0 ? 1.0 : total / channel_count;
+}
+
+}  // namespace
+
+std::array<double, 4> SumSquaredErrors(const uint8_t* lhs, const uint8_t* rhs,
+                                       std::size_t pixel_count) {
+  std::array<double, 4> sums{};
+  std::size_t i = 0;
+#ifdef FAITHFUL_IMAGE_METRICS_SSE2
+  /// 4 pixels per iteration; after unpacking to 16 bit the squared difference
+  /// (<= 255^2) fits into unsigned 16 bit, so mullo is enough and then
+  /// we widen it to 32 bit lanes which are exactly r, g, b, a
+  const __m128i zero = _mm_setzero_si128();
+  while (i + 4 <= pixel_count) {
+    __m128i acc = _mm_setzero_si128();
+    std::size_t steps = 0;
+    for (; i + 4 <= pixel_count && steps < kU8FlushInterval; i += 4, ++steps) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + i * 4));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + i * 4));
+      __m128i d_lo = _mm_sub_epi16(_mm_unpacklo_epi8(a, zero),
+                                   _mm_unpacklo_epi8(b, zero));
+      __m128i d_hi = _mm_sub_epi16(_mm_unpackhi_epi8(a, zero),
+                                   _mm_unpackhi_epi8(b, zero));
+      __m128i sq_lo = _mm_mullo_epi16(d_lo, d_lo);
+      __m128i sq_hi = _mm_mullo_epi16(d_hi, d_hi);
+      acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(sq_lo, zero));
+      acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(sq_lo, zero));
+      acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(sq_hi, zero));
+      acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(sq_hi, zero));
+    }
+    alignas(16) uint32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    for (int c = 0; c < 4; ++c) {
+      sums[c] += lanes[c];
+    }
+  }
+#endif
+  for (; i < pixel_count; ++i) {
+    for (int c = 0; c < 4; ++c) {
+      int d = static_cast<int>(lhs[i * 4 + c]) - static_cast<int>(rhs[i * 4 + c]);
+      sums[c] += d * d;
+    }
+  }
+  return sums;
+}
+
+std::array<double, 4> SumSquaredErrors(const float* lhs, const float* rhs,
+                                       std::size_t pixel_count) {
+  std::array<double, 4> sums{};
+  std::size_t i = 0;
+#ifdef FAITHFUL_IMAGE_METRICS_SSE2
+  /// one pixel is exactly one __m128 (rgba)
+  while (i < pixel_count) {
+    __m128 acc = _mm_setzero_ps();
+    std::size_t steps = 0;
+    for (; i < pixel_count && steps < kF32FlushInterval; ++i, ++steps) {
+      __m128 d = _mm_sub_ps(_mm_loadu_ps(lhs + i * 4), _mm_loadu_ps(rhs + i * 4));
+      acc = _mm_add_ps(acc, _mm_mul_ps(d, d));
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, acc);
+    for (int c = 0; c < 4; ++c) {
+      sums[c] += lanes[c];
+    }
+  }
+#endif
+  for (; i < pixel_count; ++i) {
+    for (int c = 0; c < 4; ++c) {
+      double d = static_cast<double>(lhs[i * 4 + c]) - rhs[i * 4 + c];
+      sums[c] += d * d;
+    }
+  }
+  return sums;
+}
+
+double MeanSquaredError(const std::array<double, 4>& sum_squared_errors,
+                        std::size_t pixel_count,
+                        const std::array<bool, 4>& channel_mask) {
+  double sum = 0.0;
+  int channel_count = 0;
+  for (int c = 0; c < 4; ++c) {
+    if (channel_mask[c]) {
+      sum += sum_squared_errors[c];
+      ++channel_count;
+    }
+  }
+  if (channel_count == 0 || pixel_count == 0) {
+    return 0.0;
+  }
+  return sum / (static_cast<double>(pixel_count) * channel_count);
+}
+
+double PsnrFromMse(double mse, double peak) {
+  if (mse <= 0.0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return 10.0 * std::log10(peak * peak / mse);
+}
+
+double StructuralSimilarity(const uint8_t* lhs, const uint8_t* rhs,
+                            int width, int height,
+                            const std::array<bool, 4>& channel_mask) {
+  return StructuralSimilarityImpl(lhs, rhs, width, height,
+                                  channel_mask, 255.0);
+}
+
+double StructuralSimilarity(const float* lhs, const float* rhs,
+                            int width, int height,
+                            const std::array<bool, 4>& channel_mask,
+                            double dynamic_range) {
+  return StructuralSimilarityImpl(lhs, rhs, width, height,
+                                  channel_mask, dynamic_range);
+}
+
+float MaxChannelValue(const float* data, std::size_t pixel_count,
+                      const std::array<bool, 4>& channel_mask) {
+  float max_value = 0.0f;
+  for (std::size_t i = 0; i < pixel_count; ++i) {
+    for (int c = 0; c < 4; ++c) {
+      if (channel_mask[c]) {
+        max_value = std::max(max_value, data[i * 4 + c]);
+      }
+    }
+  }
+  return max_value;
+}
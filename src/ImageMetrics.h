@@ -0,0 +1,49 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_IMAGEMETRICS_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_IMAGEMETRICS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/// Error metrics between two images of the same size, both stored as
+/// interleaved 4-channel (rgba) pixels. Kernels are vectorized with SSE2
+/// (always available on x86-64), other platforms use scalar fallback.
+
+/// per-channel sum of squared differences
+std::array<double, 4> SumSquaredErrors(const uint8_t* lhs, const uint8_t* rhs,
+                                       std::size_t pixel_count);
+std::array<double, 4> SumSquaredErrors(const float* lhs, const float* rhs,
+                                       std::size_t pixel_count);
+
+/// averaged over channels set in channel_mask
+/// (we don't count channels which are constant after swizzle, e.g. "1" in rrr1)
+double MeanSquaredError(const std::array<double, 4>& sum_squared_errors,
+                        std::size_t pixel_count,
+                        const std::array<bool, 4>& channel_mask);
+
+/// returns +infinity for identical images (mse == 0)
+double PsnrFromMse(double mse, double peak);
+
+/// mean SSIM over 8x8 windows (stride 4) of channels set in channel_mask;
+/// all 4 channels computed at once, one pixel per SIMD register;
+/// dynamic_range is 255 for ldr and peak value for hdr
+double StructuralSimilarity(const uint8_t* lhs, const uint8_t* rhs,
+                            int width, int height,
+                            const std::array<bool, 4>& channel_mask);
+double StructuralSimilarity(const float* lhs, const float* rhs,
+                            int width, int height,
+                            const std::array<bool, 4>& channel_mask,
+                            double dynamic_range);
+
+/// max value among channels set in channel_mask, used as hdr peak
+float MaxChannelValue(const float* data, std::size_t pixel_count,
+                      const std::array<bool, 4>& channel_mask);
+
+/// all metrics used by verify mode (see TextureProcessor::VerifyEncodedData)
+struct ImageQuality {
+  double psnr;
+  std::array<double, 4> rmse;
+  double ssim;
+};
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_IMAGEMETRICS_H
@@ -0,0 +1,385 @@
+#include "Loudness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FAITHFUL_LOUDNESS_SSE2 1
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define FAITHFUL_LOUDNESS_AVX 1
+#endif
+
+namespace {
+
+/// per phase of the interpolation filter
+constexpr int kTruePeakTaps = 12;
+
+constexpr double kAbsoluteGate = -70.0;
+/// LU below the mean of blocks above the absolute gate
+constexpr double kIntegratedRelativeGate = -10.0;
+constexpr double kRangeRelativeGate = -20.0;
+/// in 100 ms blocks
+constexpr std::size_t kGatingBlocks = 4;
+constexpr std::size_t kShortTermBlocks = 30;
+
+double ToLufs(double energy) {
+  return -0.691 + 10.0 * std::log10(energy);
+}
+
+double FromLufs(double lufs) {
+  return std::pow(10.0, (lufs + 0.691) / 10.0);
+}
+
+/// mean of energies above threshold, 0 if none
+double MeanAbove(const std::vector<double>& energies, double threshold) {
+  double sum = 0.0;
+  std::size_t count = 0;
+  for (auto energy : energies) {
+    if (energy > threshold) {
+      sum += energy;
+      ++count;
+    }
+  }
+  return count == 0 ? 0.0 : sum / count;
+}
+
+/// the relative gate is below the mean of blocks above the absolute one
+double RelativeThreshold(const std::vector<double>& energies,
+                         double relative_gate) {
+  double absolute = FromLufs(kAbsoluteGate);
+  return std::max(absolute, MeanAbove(energies, absolute) *
+                                std::pow(10.0, relative_gate / 10.0));
+}
+
+/// shelf, then high pass
+struct KWeightingCoefficients {
+  double b0, b1, b2, a1, a2;
+  double hb0, hb1, hb2, ha1, ha2;
+};
+
+/// state: x1, x2, shelf y1, y2, high pass y1, y2; returns sum of squares
+/// of the output (scalar and sse2 do the same operations in the same order)
+double KWeight(const float* in, std::size_t count, double* state,
+               const KWeightingCoefficients& k) {
+  double x1 = state[0], x2 = state[1], s1 = state[2], s2 = state[3];
+  double y1 = state[4], y2 = state[5];
+  double sum = 0.0;
+  for (std::size_t i = 0; i < count; ++i) {
+    double x = in[i];
+    double s = k.b0 * x + k.b1 * x1 + k.b2 * x2 - k.a1 * s1 - k.a2 * s2;
+    double y = k.hb0 * s + k.hb1 * s1 + k.hb2 * s2 - k.ha1 * y1 - k.ha2 * y2;
+    x2 = x1;
+    x1 = x;
+    s2 = s1;
+    s1 = s;
+    y2 = y1;
+    y1 = y;
+    sum += y * y;
+  }
+  state[0] = x1, state[1] = x2, state[2] = s1, state[3] = s2;
+  state[4] = y1, state[5] = y2;
+  return sum;
+}
+
+#ifdef FAITHFUL_LOUDNESS_SSE2
+/// two channels in lanes of one register
+void KWeightPair(const float* in0, const float* in1, std::size_t count,
+                 double* state0, double* state1,
+                 const KWeightingCoefficients& k, double* sums) {
+  __m128d v[6];
+  for (int i = 0; i < 6; ++i) {
+    v[i] = _mm_set_pd(state1[i], state0[i]);
+  }
+  __m128d x1 = v[0], x2 = v[1], s1 = v[2], s2 = v[3], y1 = v[4], y2 = v[5];
+  __m128d b0 = _mm_set1_pd(k.b0), b1 = _mm_set1_pd(k.b1);
+  __m128d b2 = _mm_set1_pd(k.b2), a1 = _mm_set1_pd(k.a1);
+  __m128d a2 = _mm_set1_pd(k.a2), hb0 = _mm_set1_pd(k.hb0);
+  __m128d hb1 = _mm_set1_pd(k.hb1), hb2 = _mm_set1_pd(k.hb2);
+  __m128d ha1 = _mm_set1_pd(k.ha1), ha2 = _mm_set1_pd(k.ha2);
+  __m128d sum = _mm_setzero_pd();
+  for (std::size_t i = 0; i < count; ++i) {
+    __m128d x = _mm_set_pd(in1[i], in0[i]);
+    __m128d s = _mm_sub_pd(
+        _mm_sub_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(b0, x),
+                                         _mm_mul_pd(b1, x1)),
+                              _mm_mul_pd(b2, x2)),
+                   _mm_mul_pd(a1, s1)),
+        _mm_mul_pd(a2, s2));
+    __m128d y = _mm_sub_pd(
+        _mm_sub_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(hb0, s),
+                                         _mm_mul_pd(hb1, s1)),
+                              _mm_mul_pd(hb2, s2)),
+                   _mm_mul_pd(ha1, y1)),
+        _mm_mul_pd(ha2, y2));
+    x2 = x1;
+    x1 = x;
+    s2 = s1;
+    s1 = s;
+    y2 = y1;
+    y1 = y;
+    sum = _mm_add_pd(sum, _mm_mul_pd(y, y));
+  }
+  v[0] = x1, v[1] = x2, v[2] = s1, v[3] = s2, v[4] = y1, v[5] = y2;
+  for (int i = 0; i < 6; ++i) {
+    _mm_storel_pd(state0 + i, v[i]);
+    _mm_storeh_pd(state1 + i, v[i]);
+  }
+  _mm_storel_pd(sums, sum);
+  _mm_storeh_pd(sums + 1, sum);
+}
+#endif
+
+/// in: kTruePeakTaps - 1 previous samples, then count new ones;
+/// returns max |output| of the phase from output index first
+float PhasePeakScalar(const float* in, std::size_t first, std::size_t count,
+                      const float* taps) {
+  float peak = 0.0f;
+  for (std::size_t i = first; i < count; ++i) {
+    const float* last = in + kTruePeakTaps - 1 + i;
+    float value = 0.0f;
+    for (int k = 0; k < kTruePeakTaps; ++k) {
+      value += taps[k] * last[-k];
+    }
+    peak = std::max(peak, std::abs(value));
+  }
+  return peak;
+}
+
+#ifdef FAITHFUL_LOUDNESS_AVX
+/// 8 outputs at once, returns how many are done
+__attribute__((target("avx")))
+std::size_t PhasePeakAvx(const float* in, std::size_t count,
+                         const float* taps, float& peak) {
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  __m256 peaks = _mm256_setzero_ps();
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const float* last = in + kTruePeakTaps - 1 + i;
+    __m256 values = _mm256_setzero_ps();
+    for (int k = 0; k < kTruePeakTaps; ++k) {
+      values = _mm256_add_ps(values,
+                             _mm256_mul_ps(_mm256_set1_ps(taps[k]),
+                                           _mm256_loadu_ps(last - k)));
+    }
+    peaks = _mm256_max_ps(peaks, _mm256_andnot_ps(sign, values));
+  }
+  alignas(32) float lanes[8];
+  _mm256_store_ps(lanes, peaks);
+  peak = *std::max_element(lanes, lanes + 8);
+  return i;
+}
+
+bool HasAvx() {
+  static const bool has_avx = __builtin_cpu_supports("avx");
+  return has_avx;
+}
+#endif
+
+float PhasePeak(const float* in, std::size_t count, const float* taps) {
+  std::size_t i = 0;
+  float peak = 0.0f;
+#ifdef FAITHFUL_LOUDNESS_AVX
+  if (HasAvx()) {
+    i = PhasePeakAvx(in, count, taps, peak);
+  }
+#endif
+  return std::max(peak, PhasePeakScalar(in, i, count, taps));
+}
+
+}  // namespace
+
+std::vector<double> LoudnessChannelWeights(int channels, bool vorbis_order) {
+  std::vector<double> weights(channels, 1.0);
+  if (channels == 6) {
+    /// .wav: L R C LFE Ls Rs, vorbis: L C R Ls Rs LFE
+    weights = vorbis_order
+                  ? std::vector<double>{1.0, 1.0, 1.0, 1.41, 1.41, 0.0}
+                  : std::vector<double>{1.0, 1.0, 1.0, 0.0, 1.41, 1.41};
+  }
+  return weights;
+}
+
+LoudnessMeter::LoudnessMeter(int channels, uint32_t sample_rate,
+                             std::vector<double> channel_weights)
+    : channels_(channels),
+      weights_(std::move(channel_weights)),
+      states_(channels * 6, 0.0),
+      block_frames_(std::max<std::size_t>(1, (sample_rate + 5) / 10)),
+      block_sums_(channels, 0.0),
+      peak_inputs_(channels,
+                   std::vector<float>(kTruePeakTaps - 1, 0.0f)) {
+  /// BS.1770-4 filters, recalculated for the sample rate
+  double rate = sample_rate;
+  double k = std::tan(std::numbers::pi * 1681.974450955533 / rate);
+  double q = 0.7071752369554196;
+  double vh = std::pow(10.0, 3.999843853973347 / 20.0);
+  double vb = std::pow(vh, 0.4996667741545416);
+  double a0 = 1.0 + k / q + k * k;
+  shelf_ = {(vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0,
+            (vh - vb * k / q + k * k) / a0, 2.0 * (k * k - 1.0) / a0,
+            (1.0 - k / q + k * k) / a0};
+  k = std::tan(std::numbers::pi * 38.13547087602444 / rate);
+  q = 0.5003270373238773;
+  a0 = 1.0 + k / q + k * k;
+  high_pass_ = {1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0,
+                (1.0 - k / q + k * k) / a0};
+
+  /// at least 192 kHz after oversampling
+  oversampling_ = sample_rate < 96000 ? 4 : (sample_rate < 192000 ? 2 : 1);
+  /// windowed sinc (blackman) centered on a sample, so phase 0 passes
+  /// samples through and the rest are between them
+  int size = oversampling_ * kTruePeakTaps;
+  double center = size / 2;
+  std::vector<double> filter(size);
+  for (int n = 0; n < size; ++n) {
+    double t = (n - center) / oversampling_;
+    double sinc = t == 0.0 ? 1.0
+                           : std::sin(std::numbers::pi * t) /
+                                 (std::numbers::pi * t);
+    double w = std::numbers::pi * (n - center) / center;
+    filter[n] = sinc * (0.42 + 0.5 * std::cos(w) + 0.08 * std::cos(2 * w));
+  }
+  interpolation_.resize(size);
+  for (int phase = 0; phase < oversampling_; ++phase) {
+    double gain = 0.0;
+    for (int tap = 0; tap < kTruePeakTaps; ++tap) {
+      gain += filter[phase + tap * oversampling_];
+    }
+    for (int tap = 0; tap < kTruePeakTaps; ++tap) {
+      interpolation_[phase * kTruePeakTaps + tap] =
+          static_cast<float>(filter[phase + tap * oversampling_] / gain);
+    }
+  }
+}
+
+void LoudnessMeter::Add(const float* const* channels,
+                        std::size_t frame_count) {
+  AddPeak(channels, frame_count);
+  std::size_t done = 0;
+  while (done < frame_count) {
+    std::size_t count =
+        std::min(frame_count - done, block_frames_ - block_position_);
+    FilterBlock(channels, done, count);
+    done += count;
+    block_position_ += count;
+    total_frames_ += count;
+    if (block_position_ == block_frames_) {
+      double energy = 0.0;
+      for (int c = 0; c < channels_; ++c) {
+        energy += weights_[c] * block_sums_[c];
+        block_sums_[c] = 0.0;
+      }
+      total_energy_ += energy;
+      block_energies_.push_back(energy / block_frames_);
+      block_position_ = 0;
+    }
+  }
+}
+
+void LoudnessMeter::FilterBlock(const float* const* channels,
+                                std::size_t offset, std::size_t frame_count) {
+  KWeightingCoefficients k{shelf_.b0,     shelf_.b1,     shelf_.b2,
+                           shelf_.a1,     shelf_.a2,     high_pass_.b0,
+                           high_pass_.b1, high_pass_.b2, high_pass_.a1,
+                           high_pass_.a2};
+  int c = 0;
+#ifdef FAITHFUL_LOUDNESS_SSE2
+  for (; c + 2 <= channels_; c += 2) {
+    double sums[2];
+    KWeightPair(channels[c] + offset, channels[c + 1] + offset, frame_count,
+                &states_[c * 6], &states_[(c + 1) * 6], k, sums);
+    block_sums_[c] += sums[0];
+    block_sums_[c + 1] += sums[1];
+  }
+#endif
+  for (; c < channels_; ++c) {
+    block_sums_[c] +=
+        KWeight(channels[c] + offset, frame_count, &states_[c * 6], k);
+  }
+}
+
+void LoudnessMeter::AddPeak(const float* const* channels,
+                            std::size_t frame_count) {
+  for (int c = 0; c < channels_; ++c) {
+    /// the filter is delayed by half of its taps, so samples are checked
+    /// directly too (the last ones aren't interpolated yet)
+    for (std::size_t i = 0; i < frame_count; ++i) {
+      peak_ = std::max(peak_, std::abs(channels[c][i]));
+    }
+    if (oversampling_ == 1) {
+      continue;
+    }
+    auto& input = peak_inputs_[c];
+    input.insert(input.end(), channels[c], channels[c] + frame_count);
+    for (int phase = 1; phase < oversampling_; ++phase) {
+      peak_ = std::max(peak_, PhasePeak(input.data(), frame_count,
+                                        &interpolation_[phase *
+                                                        kTruePeakTaps]));
+    }
+    input.erase(input.begin(), input.end() - (kTruePeakTaps - 1));
+  }
+}
+
+Loudness LoudnessMeter::Result() const {
+  constexpr double kSilence = -std::numeric_limits<double>::infinity();
+  Loudness loudness;
+
+  std::vector<double> gating;
+  for (std::size_t i = 0; i + kGatingBlocks <= block_energies_.size();
+       ++i) {
+    double energy = 0.0;
+    for (std::size_t j = 0; j < kGatingBlocks; ++j) {
+      energy += block_energies_[i + j];
+    }
+    gating.push_back(energy / kGatingBlocks);
+  }
+  if (gating.empty() && total_frames_ != 0) {
+    double energy = total_energy_;
+    for (int c = 0; c < channels_; ++c) {
+      energy += weights_[c] * block_sums_[c];
+    }
+    gating.push_back(energy / total_frames_);
+  }
+  double integrated = MeanAbove(
+      gating, RelativeThreshold(gating, kIntegratedRelativeGate));
+  loudness.integrated = integrated > 0.0 ? ToLufs(integrated) : kSilence;
+
+  /// EBU Tech 3342: spread of short-term (3 s) loudness, 10th to 95th
+  /// percentile of gated values
+  std::vector<double> short_term;
+  for (std::size_t i = 0; i + kShortTermBlocks <= block_energies_.size();
+       ++i) {
+    double energy = 0.0;
+    for (std::size_t j = 0; j < kShortTermBlocks; ++j) {
+      energy += block_energies_[i + j];
+    }
+    short_term.push_back(energy / kShortTermBlocks);
+  }
+  {
+    double threshold = RelativeThreshold(short_term, kRangeRelativeGate);
+    std::vector<double> gated;
+    for (auto energy : short_term) {
+      if (energy > threshold) {
+        gated.push_back(ToLufs(energy));
+      }
+    }
+    if (!gated.empty()) {
+      std::sort(gated.begin(), gated.end());
+      auto percentile = [&gated](double p) {
+        return gated[static_cast<std::size_t>(
+            std::lround((gated.size() - 1) * p))];
+      };
+      loudness.range = percentile(0.95) - percentile(0.10);
+    }
+  }
+
+  loudness.true_peak = peak_ > 0.0f ? 20.0 * std::log10(peak_) : kSilence;
+  return loudness;
+}
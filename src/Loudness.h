@@ -0,0 +1,76 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_LOUDNESS_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_LOUDNESS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// EBU R128 loudness (ITU-R BS.1770-4, EBU Tech 3341/3342), so the game
+/// can normalize volume by a gain instead of scanning decoded audio.
+/// K-weighting (two biquads) runs on two channels at once (SSE2 lanes),
+/// true peak is the peak of 4x oversampled signal (48-tap polyphase filter,
+/// 8 outputs per AVX instruction if cpu has it); scalar fallback does the
+/// same operations in the same order.
+
+struct Loudness {
+  /// LUFS; -inf for silence
+  double integrated{0.0};
+  /// dBTP; -inf for silence
+  double true_peak{0.0};
+  /// LU, 0 for tracks shorter than 3 s
+  double range{0.0};
+};
+
+/// standard weights of channels (surround ones are +1.5 dB, LFE is
+/// ignored) for 5.1 in the order of .wav or of vorbis, the rest are 1
+std::vector<double> LoudnessChannelWeights(int channels, bool vorbis_order);
+
+/// audio is added in chunks of any size, so tracks are measured while
+/// decoded
+class LoudnessMeter {
+ public:
+  LoudnessMeter(int channels, uint32_t sample_rate,
+                std::vector<double> channel_weights);
+
+  /// planar: channels[c][0, frame_count)
+  void Add(const float* const* channels, std::size_t frame_count);
+
+  /// sounds shorter than one 400 ms block are measured as one block
+  Loudness Result() const;
+
+ private:
+  struct Biquad {
+    double b0, b1, b2, a1, a2;
+  };
+
+  void FilterBlock(const float* const* channels, std::size_t offset,
+                   std::size_t frame_count);
+  void AddPeak(const float* const* channels, std::size_t frame_count);
+
+  int channels_;
+  std::vector<double> weights_;
+  Biquad shelf_;
+  Biquad high_pass_;
+  /// per channel: x1, x2 of shelf, then y1, y2 of shelf (= x of high pass),
+  /// then y1, y2 of high pass
+  std::vector<double> states_;
+
+  std::size_t block_frames_;
+  std::size_t block_position_{0};
+  /// weighted mean squares of the current 100 ms block per channel
+  std::vector<double> block_sums_;
+  /// energy of each complete 100 ms block (gating blocks are 4 of them,
+  /// short-term - 30)
+  std::vector<double> block_energies_;
+  double total_energy_{0.0};
+  std::size_t total_frames_{0};
+
+  int oversampling_;
+  /// oversampling_ phases of kTruePeakTaps
+  std::vector<float> interpolation_;
+  /// per channel: last kTruePeakTaps - 1 samples, then the added chunk
+  std::vector<std::vector<float>> peak_inputs_;
+  float peak_{0.0f};
+};
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_LOUDNESS_H
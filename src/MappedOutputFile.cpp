@@ -0,0 +1,75 @@
+#include "MappedOutputFile.h"
+
+#include <fstream>
+#include <iostream>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+MappedOutputFile::MappedOutputFile(const std::filesystem::path& path,
+                                   std::size_t size)
+    : atomic_file_(path),
+      size_(size) {
+#ifdef __linux__
+  fd_ = open(atomic_file_.GetTempPath().c_str(),
+             O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  /// allocated up front, so full disk is an error here
+  /// and not SIGBUS on write into the mapping
+  if (fd_ != -1 && size_ > 0 && posix_fallocate(fd_, 0, size_) == 0) {
+    void* data = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      fd_, 0);
+    if (data != MAP_FAILED) {
+      data_ = static_cast<uint8_t*>(data);
+      return;
+    }
+  }
+  if (fd_ != -1) {
+    close(fd_);
+    fd_ = -1;
+  }
+#endif
+  buffer_ = std::make_unique<uint8_t[]>(size_);
+  data_ = buffer_.get();
+}
+
+MappedOutputFile::~MappedOutputFile() {
+  Unmap();
+}
+
+bool MappedOutputFile::Commit() {
+  if (!IsOpen()) {
+    return false;
+  }
+  if (IsMapped()) {
+    Unmap();
+  } else {
+    std::ofstream file(atomic_file_.GetTempPath(), std::ios::binary);
+    file.write(reinterpret_cast<const char*>(buffer_.get()),
+               static_cast<std::streamsize>(size_));
+    file.close();
+    buffer_.reset();
+    data_ = nullptr;
+    if (!file) {
+      std::cerr << "Error: failed to write " << atomic_file_.GetTempPath()
+                << std::endl;
+      return false;
+    }
+  }
+  return atomic_file_.Commit();
+}
+
+void MappedOutputFile::Unmap() {
+#ifdef __linux__
+  if (fd_ == -1) {
+    return;
+  }
+  /// dirty pages are written back by the kernel, as for write()
+  munmap(data_, size_);
+  close(fd_);
+  fd_ = -1;
+  data_ = nullptr;
+#endif
+}
@@ -0,0 +1,57 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_MAPPEDOUTPUTFILE_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_MAPPEDOUTPUTFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+#include "AtomicFile.h"
+
+/// Output file of known size, preallocated (fallocate) and mapped into
+/// memory, so data is produced right into the page cache without
+/// intermediate buffer and copy (e.g. astcenc output, see
+/// TextureProcessor::EncodeImpl). Written under temporary name and renamed
+/// by Commit() (see AtomicFile). Without mmap (not Linux) or if mapping
+/// fails, falls back to heap buffer written by Commit().
+class MappedOutputFile {
+ public:
+  MappedOutputFile(const std::filesystem::path& path, std::size_t size);
+
+  /// not committed file is removed
+  ~MappedOutputFile();
+
+  MappedOutputFile(const MappedOutputFile&) = delete;
+  MappedOutputFile& operator=(const MappedOutputFile&) = delete;
+
+  MappedOutputFile(MappedOutputFile&&) = delete;
+  MappedOutputFile& operator=(MappedOutputFile&&) = delete;
+
+  /// false if neither file nor fallback buffer can be created
+  bool IsOpen() const {
+    return data_ != nullptr;
+  }
+
+  /// size bytes, valid until Commit()
+  uint8_t* GetData() {
+    return data_;
+  }
+
+  bool IsMapped() const {
+    return fd_ != -1;
+  }
+
+  /// unmaps (or writes the buffer) and publishes the file
+  bool Commit();
+
+ private:
+  void Unmap();
+
+  AtomicFile atomic_file_;
+  std::size_t size_;
+  uint8_t* data_{nullptr};
+  int fd_{-1};
+  std::unique_ptr<uint8_t[]> buffer_;
+};
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_MAPPEDOUTPUTFILE_H
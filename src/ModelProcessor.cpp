@@ -1,8 +1,290 @@
 #include "ModelProcessor.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <system_error>
+#include <vector>
 
+#include "../config/AssetFormats.h"
 #include "../config/Paths.h"
+#include "AnimationCompression.h"
+#include "ImageAnalysis.h"
+#include "RunReport.h"
+#include "Trace.h"
+
+namespace {
+
+/// animation of gltfpack output, see ModelProcessor::CompressAnimations()
+struct ClipCompression {
+  /// per sampler; CUBICSPLINE and unsupported ones aren't compressed
+  std::vector<AnimationTrack> tracks;
+  std::vector<AnimationTrackStats> stats;
+  std::vector<bool> compressed;
+};
+
+/// values as floats (normalized integers as in glTF 2.0 "Animations");
+/// false for sparse and malformed ones
+bool ReadAccessor(const tinygltf::Model& model, int accessor_id,
+                  std::vector<float>& values) {
+  if (accessor_id < 0 ||
+      accessor_id >= static_cast<int>(model.accessors.size())) {
+    return false;
+  }
+  const auto& accessor = model.accessors[accessor_id];
+  if (accessor.sparse.isSparse || accessor.bufferView < 0 ||
+      accessor.bufferView >= static_cast<int>(model.bufferViews.size())) {
+    return false;
+  }
+  const auto& view = model.bufferViews[accessor.bufferView];
+  if (view.buffer < 0 || view.buffer >= static_cast<int>(model.buffers.size())) {
+    return false;
+  }
+  const auto& data = model.buffers[view.buffer].data;
+  int components = tinygltf::GetNumComponentsInType(accessor.type);
+  int component_size =
+      tinygltf::GetComponentSizeInBytes(accessor.componentType);
+  if (components <= 0 || component_size <= 0) {
+    return false;
+  }
+  std::size_t element_size =
+      static_cast<std::size_t>(components) * component_size;
+  std::size_t stride = view.byteStride != 0 ? view.byteStride : element_size;
+  std::size_t begin = view.byteOffset + accessor.byteOffset;
+  if (accessor.count > 0 &&
+      begin + stride * (accessor.count - 1) + element_size > data.size()) {
+    return false;
+  }
+  values.resize(accessor.count * components);
+  for (std::size_t i = 0; i < accessor.count; ++i) {
+    for (int c = 0; c < components; ++c) {
+      const unsigned char* in =
+          data.data() + begin + i * stride + c * component_size;
+      float& value = values[i * components + c];
+      switch (accessor.componentType) {
+        case TINYGLTF_COMPONENT_TYPE_FLOAT:
+          std::memcpy(&value, in, sizeof(value));
+          break;
+        case TINYGLTF_COMPONENT_TYPE_BYTE:
+          value = std::max(static_cast<int8_t>(*in) / 127.0f, -1.0f);
+          break;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+          value = *in / 255.0f;
+          break;
+        case TINYGLTF_COMPONENT_TYPE_SHORT: {
+          int16_t sample;
+          std::memcpy(&sample, in, sizeof(sample));
+          value = DequantizeSnorm16(sample);
+          break;
+        }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+          uint16_t sample;
+          std::memcpy(&sample, in, sizeof(sample));
+          value = sample / 65535.0f;
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+float ProvideAnimationTolerance(AnimationPath path) {
+  switch (path) {
+    case AnimationPath::kTranslation:
+      return faithful::config::kModelAnimTranslationTolerance;
+    case AnimationPath::kRotation:
+      return faithful::config::kModelAnimRotationTolerance;
+    case AnimationPath::kScale:
+      return faithful::config::kModelAnimScaleTolerance;
+    default:
+      return faithful::config::kModelAnimWeightsTolerance;
+  }
+}
+
+/// only reads the model, so clips may be compressed in parallel
+ClipCompression CompressClip(const tinygltf::Model& model,
+                             const tinygltf::Animation& animation) {
+  ClipCompression clip;
+  std::size_t sampler_count = animation.samplers.size();
+  clip.tracks.resize(sampler_count);
+  clip.stats.resize(sampler_count);
+  clip.compressed.resize(sampler_count, false);
+  /// path is known only from channels
+  std::vector<int> paths(sampler_count, -1);
+  for (const auto& channel : animation.channels) {
+    if (channel.sampler < 0 ||
+        channel.sampler >= static_cast<int>(sampler_count) ||
+        paths[channel.sampler] != -1) {
+      continue;
+    }
+    if (channel.target_path == "translation") {
+      paths[channel.sampler] = static_cast<int>(AnimationPath::kTranslation);
+    } else if (channel.target_path == "rotation") {
+      paths[channel.sampler] = static_cast<int>(AnimationPath::kRotation);
+    } else if (channel.target_path == "scale") {
+      paths[channel.sampler] = static_cast<int>(AnimationPath::kScale);
+    } else if (channel.target_path == "weights") {
+      paths[channel.sampler] = static_cast<int>(AnimationPath::kWeights);
+    }
+  }
+  for (std::size_t i = 0; i < sampler_count; ++i) {
+    const auto& sampler = animation.samplers[i];
+    if (paths[i] == -1 || sampler.interpolation == "CUBICSPLINE") {
+      continue;
+    }
+    auto& track = clip.tracks[i];
+    track.path = static_cast<AnimationPath>(paths[i]);
+    track.step = sampler.interpolation == "STEP";
+    if (!ReadAccessor(model, sampler.input, track.times) ||
+        !ReadAccessor(model, sampler.output, track.values) ||
+        track.times.empty() ||
+        track.values.size() % track.times.size() != 0) {
+      continue;
+    }
+    track.components =
+        static_cast<int>(track.values.size() / track.times.size());
+    if ((track.path == AnimationPath::kRotation && track.components != 4) ||
+        ((track.path == AnimationPath::kTranslation ||
+          track.path == AnimationPath::kScale) && track.components != 3)) {
+      continue;
+    }
+    clip.stats[i] = CompressTrack(track, ProvideAnimationTolerance(track.path));
+    clip.compressed[i] = true;
+  }
+  return clip;
+}
+
+/// with buffer views left without accessors and images; all references are
+/// remapped and buffers compacted (views 4-byte aligned, enough for
+/// any component type)
+void RemoveAccessors(tinygltf::Model& model, const std::vector<bool>& removed) {
+  std::vector<int> accessor_ids(model.accessors.size(), -1);
+  std::vector<tinygltf::Accessor> accessors;
+  for (std::size_t i = 0; i < model.accessors.size(); ++i) {
+    if (!removed[i]) {
+      accessor_ids[i] = static_cast<int>(accessors.size());
+      accessors.push_back(std::move(model.accessors[i]));
+    }
+  }
+  model.accessors = std::move(accessors);
+  auto remap_accessor = [&accessor_ids](int& id) {
+    if (id >= 0 && id < static_cast<int>(accessor_ids.size())) {
+      id = accessor_ids[id];
+    }
+  };
+  for (auto& mesh : model.meshes) {
+    for (auto& primitive : mesh.primitives) {
+      remap_accessor(primitive.indices);
+      for (auto& attribute : primitive.attributes) {
+        remap_accessor(attribute.second);
+      }
+      for (auto& target : primitive.targets) {
+        for (auto& attribute : target) {
+          remap_accessor(attribute.second);
+        }
+      }
+    }
+  }
+  for (auto& skin : model.skins) {
+    remap_accessor(skin.inverseBindMatrices);
+  }
+  for (auto& animation : model.animations) {
+    for (auto& sampler : animation.samplers) {
+      remap_accessor(sampler.input);
+      remap_accessor(sampler.output);
+    }
+  }
+
+  std::vector<bool> view_used(model.bufferViews.size(), false);
+  auto mark_view = [&view_used](int id) {
+    if (id >= 0 && id < static_cast<int>(view_used.size())) {
+      view_used[id] = true;
+    }
+  };
+  for (const auto& accessor : model.accessors) {
+    mark_view(accessor.bufferView);
+    if (accessor.sparse.isSparse) {
+      mark_view(accessor.sparse.indices.bufferView);
+      mark_view(accessor.sparse.values.bufferView);
+    }
+  }
+  for (const auto& image : model.images) {
+    mark_view(image.bufferView);
+  }
+  std::vector<int> view_ids(model.bufferViews.size(), -1);
+  std::vector<tinygltf::BufferView> views;
+  for (std::size_t i = 0; i < model.bufferViews.size(); ++i) {
+    if (view_used[i]) {
+      view_ids[i] = static_cast<int>(views.size());
+      views.push_back(std::move(model.bufferViews[i]));
+    }
+  }
+  model.bufferViews = std::move(views);
+  auto remap_view = [&view_ids](int& id) {
+    if (id >= 0 && id < static_cast<int>(view_ids.size())) {
+      id = view_ids[id];
+    }
+  };
+  for (auto& accessor : model.accessors) {
+    remap_view(accessor.bufferView);
+    if (accessor.sparse.isSparse) {
+      remap_view(accessor.sparse.indices.bufferView);
+      remap_view(accessor.sparse.values.bufferView);
+    }
+  }
+  for (auto& image : model.images) {
+    remap_view(image.bufferView);
+  }
+
+  for (std::size_t b = 0; b < model.buffers.size(); ++b) {
+    std::vector<tinygltf::BufferView*> buffer_views;
+    for (auto& view : model.bufferViews) {
+      if (view.buffer == static_cast<int>(b)) {
+        buffer_views.push_back(&view);
+      }
+    }
+    std::sort(buffer_views.begin(), buffer_views.end(),
+              [](const auto* a, const auto* b) {
+                return a->byteOffset < b->byteOffset;
+              });
+    auto& data = model.buffers[b].data;
+    std::vector<unsigned char> compacted;
+    compacted.reserve(data.size());
+    for (auto* view : buffer_views) {
+      compacted.resize((compacted.size() + 3) & ~std::size_t{3});
+      auto begin = data.begin() + view->byteOffset;
+      view->byteOffset = compacted.size();
+      compacted.insert(compacted.end(), begin, begin + view->byteLength);
+    }
+    data = std::move(compacted);
+  }
+}
+
+/// at the 4-byte aligned end of data (offset in the same view)
+int AppendAccessor(tinygltf::Model& model, std::vector<unsigned char>& data,
+                   int view_id, const void* values, std::size_t size,
+                   int component_type, bool normalized, int type,
+                   std::size_t count) {
+  data.resize((data.size() + 3) & ~std::size_t{3});
+  tinygltf::Accessor accessor;
+  accessor.bufferView = view_id;
+  accessor.byteOffset = data.size();
+  accessor.componentType = component_type;
+  accessor.normalized = normalized;
+  accessor.type = type;
+  accessor.count = count;
+  auto bytes = static_cast<const unsigned char*>(values);
+  data.insert(data.end(), bytes, bytes + size);
+  model.accessors.push_back(std::move(accessor));
+  return static_cast<int>(model.accessors.size() - 1);
+}
+
+}  // namespace
 
 bool TinygltfLoadTextureStub(tinygltf::Image *image, const int image_idx,
                              std::string *err, std::string *warn, int req_width,
@@ -15,9 +297,12 @@ bool TinygltfLoadTextureStub(tinygltf::Image *image, const int image_idx,
 }
 
 ModelProcessor::ModelProcessor(
+    AssetLoadingThreadPool& thread_pool, BatchIo& batch_io,
     TextureProcessor& texture_processor,
     ReplaceRequest& replace_request)
-    : texture_processor_(texture_processor),
+    : thread_pool_(thread_pool),
+      batch_io_(batch_io),
+      texture_processor_(texture_processor),
       replace_request_(replace_request) {
   /// force 4-channel loading, mandatory for astc
   loader_.SetPreserveImageChannels(true);
@@ -26,38 +311,83 @@ ModelProcessor::ModelProcessor(
   loader_.SetImageWriter(nullptr, nullptr);
 }
 
-void ModelProcessor::Encode(const std::filesystem::path& path) {
+bool ModelProcessor::Encode(const std::filesystem::path& path,
+                            bool* written) {
   std::string out_filename =
       (models_destination_path_ / path.filename().
                                   replace_extension(".gltf")).string();
   cur_model_path_ = path;
   loader_.SetImageLoader(&tinygltf::LoadImageData, nullptr);
+  auto staging_path = ProvideStagingPath();
+  bool success = false;
+  if (written) {
+    *written = false;
+  }
   try {
     Read();
-    CompressTextures();
-    Write(out_filename);
-    OptimizeModel(out_filename);
+    success = CompressTextures();
+    /// gltfpack reads tinygltf output and writes into another directory,
+    /// not in place
+    auto unpacked_path = staging_path / "unpacked" /
+                         std::filesystem::path(out_filename).filename();
+    auto packed_path = staging_path /
+                       std::filesystem::path(out_filename).filename();
+    std::filesystem::create_directories(unpacked_path.parent_path());
+    if (Write(out_filename, unpacked_path)) {
+      OptimizeModel(unpacked_path, packed_path);
+      if (!model_->animations.empty()) {
+        CompressAnimations(packed_path);
+      }
+      Publish(staging_path);
+      ReportWrittenBytes(out_filename);
+      if (written) {
+        *written = true;
+      }
+    }
   } catch (const std::exception& e) {
     std::cerr << "Error at ModelProcessor::Encode: " << e.what() << std::endl;
+    success = false;
   }
+  std::error_code error;
+  std::filesystem::remove_all(staging_path, error);
+  return success;
 }
-void ModelProcessor::Decode(const std::filesystem::path& path) {
+bool ModelProcessor::Decode(const std::filesystem::path& path,
+                            bool* written) {
   /// extension already ".astc"
   std::string out_filename =
       (models_destination_path_ / path.filename()).string();
   cur_model_path_ = path;
   loader_.SetImageLoader(TinygltfLoadTextureStub, nullptr);
+  auto staging_path = ProvideStagingPath();
+  bool success = false;
+  if (written) {
+    *written = false;
+  }
   try {
     Read();
-    DecompressTextures();
-    Write(out_filename);
+    success = DecompressTextures();
+    if (Write(out_filename,
+              staging_path / std::filesystem::path(out_filename).filename())) {
+      Publish(staging_path);
+      ReportWrittenBytes(out_filename);
+      if (written) {
+        *written = true;
+      }
+    }
   } catch (const std::exception& e) {
     std::cerr << "Error at ModelProcessor::Decode: " << e.what() << std::endl;
+    success = false;
   }
+  std::error_code error;
+  std::filesystem::remove_all(staging_path, error);
+  return success;
 }
 
 void ModelProcessor::Read() {
   model_ = std::make_unique<tinygltf::Model>();
+  TraceScope trace_scope("gltf_parse", cur_model_path_);
+  trace_scope.SetBytesInFromFile(cur_model_path_);
   bool ret;
   if (cur_model_path_.extension() == ".glb") {
     ret = loader_.LoadBinaryFromFile(model_.get(), &error_string_,
@@ -77,29 +407,94 @@ void ModelProcessor::Read() {
   if (!ret) {
     throw std::runtime_error("failed to load GLTF file");
   }
+  /// .gltf itself reported by AssetProcessor
+  if (RunReport::IsEnabled()) {
+    for (const auto& buffer : model_->buffers) {
+      if (!buffer.uri.empty() && !tinygltf::IsDataURI(buffer.uri)) {
+        RunReport::AddBytesInFromFile(cur_model_path_.parent_path() / buffer.uri);
+      }
+    }
+    for (const auto& image : model_->images) {
+      if (!image.uri.empty() && !tinygltf::IsDataURI(image.uri)) {
+        RunReport::AddBytesInFromFile(cur_model_path_.parent_path() / image.uri);
+      }
+    }
+  }
 }
 
-void ModelProcessor::Write(const std::string& destination) {
+void ModelProcessor::ReportWrittenBytes(const std::string& destination) const {
+  if (!RunReport::IsEnabled()) {
+    return;
+  }
+  /// textures are reported by TextureProcessor; buffers are written either
+  /// by tinygltf (with their uri) or by gltfpack (<name>.bin)
+  std::filesystem::path gltf_path{destination};
+  std::set<std::filesystem::path> written{
+      gltf_path, std::filesystem::path(gltf_path).replace_extension(".bin")};
+  for (const auto& buffer : model_->buffers) {
+    if (!buffer.uri.empty() && !tinygltf::IsDataURI(buffer.uri)) {
+      written.insert(gltf_path.parent_path() / buffer.uri);
+    }
+  }
+  for (const auto& path : written) {
+    RunReport::AddBytesOutFromFile(path);
+  }
+}
+
+bool ModelProcessor::Write(const std::string& destination,
+                           const std::filesystem::path& path) {
   /// it may seems logical to request replace before loading,
   /// but then textures related only to model and located externally
   /// to the model and also located inside the provided user's assets directory
   /// still would be processed. So we still need to open model to see
   /// what textures are used
-  if (std::filesystem::exists(destination)) {
+  if (batch_io_.Stat({destination}).front().exists) {
     std::string request{destination};
     request += "\nalready exist. Do you want to replace it?";
     if (!replace_request_(std::move(request))) {
-      return;
+      return false;
     }
   }
-  bool ret = loader_.WriteGltfSceneToFile(model_.get(), destination,
+  TraceScope trace_scope("gltf_write", destination);
+  bool ret = loader_.WriteGltfSceneToFile(model_.get(), path.string(),
                                          false, false, true, false);
   if (!ret) {
     throw std::runtime_error("failed to write GLTF file");
   }
+  trace_scope.SetBytesOutFromFile(path);
+  return true;
 }
 
-void ModelProcessor::CompressTextures() {
+std::filesystem::path ModelProcessor::ProvideStagingPath() const {
+  std::string staging_name{"."};
+  staging_name += cur_model_path_.stem().string();
+  staging_name += ".part";
+  auto staging_path = models_destination_path_ / staging_name;
+  std::filesystem::remove_all(staging_path);
+  std::filesystem::create_directories(staging_path);
+  return staging_path;
+}
+
+void ModelProcessor::Publish(const std::filesystem::path& staging_path) const {
+  std::vector<std::filesystem::path> files;
+  for (const auto& entry :
+       std::filesystem::directory_iterator(staging_path)) {
+    if (entry.is_regular_file()) {
+      files.push_back(entry.path());
+    }
+  }
+  /// .gltf is the last one, so it never refers to missing buffers
+  std::stable_partition(files.begin(), files.end(), [](const auto& file) {
+    return file.extension() != ".gltf";
+  });
+  for (const auto& file : files) {
+    std::filesystem::rename(file, models_destination_path_ / file.filename());
+  }
+}
+
+bool ModelProcessor::CompressTextures() {
+  bool success = true;
+  std::vector<int> black_emissive_images;
   for (std::size_t i = 0; i < model_->images.size(); ++i) {
     tinygltf::Image& image = model_->images[i];
     if (!image.uri.empty()) {
@@ -107,6 +502,21 @@ void ModelProcessor::CompressTextures() {
                                    .lexically_normal());
     }
     auto model_texture_config = ProvideEncodeTextureConfig(static_cast<int>(i));
+    /// emission = factor * texture, so black texture adds nothing
+    if (model_texture_config.category ==
+            TextureProcessor::TextureCategory::kLdrRgb &&
+        AnalyzeImage(image.image.data(),
+                     static_cast<std::size_t>(image.width) * image.height)
+            .black) {
+      ClearEmissiveImage(static_cast<int>(i));
+      /// the same image may be used by other slots too (e.g. as albedo),
+      /// then it's kept and encoded for them
+      if (!IsImageUsed(static_cast<int>(i))) {
+        black_emissive_images.push_back(static_cast<int>(i));
+        continue;
+      }
+      model_texture_config = ProvideEncodeTextureConfig(static_cast<int>(i));
+    }
 
     // forced 4 channels (see ctor)
     int total_len = image.width * image.height * 4;
@@ -119,13 +529,82 @@ void ModelProcessor::CompressTextures() {
     image.mimeType.clear();
     image.name.clear();
 
-    texture_processor_.Encode(
+    success &= texture_processor_.Encode(
         model_texture_config.out_path, std::move(image_data),
         image.width, image.height, model_texture_config.category);
   }
+  /// from the last one, so ids of the rest stay valid
+  for (auto it = black_emissive_images.rbegin();
+       it != black_emissive_images.rend(); ++it) {
+    RemoveImage(*it);
+  }
+  return success;
+}
+
+void ModelProcessor::ClearEmissiveImage(int image_id) {
+  for (auto& material : model_->materials) {
+    if (IsTextureOfImage(material.emissiveTexture.index, image_id)) {
+      material.emissiveTexture.index = -1;
+      material.emissiveFactor = {0.0, 0.0, 0.0};
+    }
+  }
+}
+
+bool ModelProcessor::IsImageUsed(int image_id) const {
+  for (const auto& material : model_->materials) {
+    const auto& pbr = material.pbrMetallicRoughness;
+    for (int index : {pbr.baseColorTexture.index,
+                      pbr.metallicRoughnessTexture.index,
+                      material.normalTexture.index,
+                      material.occlusionTexture.index,
+                      material.emissiveTexture.index}) {
+      if (IsTextureOfImage(index, image_id)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool ModelProcessor::IsTextureOfImage(int texture_id, int image_id) const {
+  return texture_id >= 0 &&
+         texture_id < static_cast<int>(model_->textures.size()) &&
+         model_->textures[texture_id].source == image_id;
+}
+
+void ModelProcessor::RemoveImage(int image_id) {
+  /// new index of each texture, -1 for removed ones
+  std::vector<int> texture_ids;
+  std::vector<tinygltf::Texture> textures;
+  for (auto& texture : model_->textures) {
+    if (texture.source == image_id) {
+      texture_ids.push_back(-1);
+      continue;
+    }
+    if (texture.source > image_id) {
+      --texture.source;
+    }
+    texture_ids.push_back(static_cast<int>(textures.size()));
+    textures.push_back(std::move(texture));
+  }
+  model_->textures = std::move(textures);
+  auto remap = [&texture_ids](int& index) {
+    if (index >= 0 && index < static_cast<int>(texture_ids.size())) {
+      index = texture_ids[index];
+    }
+  };
+  for (auto& material : model_->materials) {
+    remap(material.pbrMetallicRoughness.baseColorTexture.index);
+    remap(material.pbrMetallicRoughness.metallicRoughnessTexture.index);
+    remap(material.normalTexture.index);
+    remap(material.occlusionTexture.index);
+    remap(material.emissiveTexture.index);
+  }
+  model_->images.erase(model_->images.begin() + image_id);
 }
 
-void ModelProcessor::DecompressTextures() {
+bool ModelProcessor::DecompressTextures() {
+  bool success = true;
   for (auto& image : model_->images) {
     auto texture_path = (cur_model_path_.parent_path() / image.uri);
     processed_images_.insert(texture_path.string());
@@ -135,10 +614,11 @@ void ModelProcessor::DecompressTextures() {
 
     image.uri = std::filesystem::path(image.uri)
                     .replace_extension(".png").string();
-    texture_processor_.Decode(
+    success &= texture_processor_.Decode(
         texture_path, model_texture_config.out_path,
         model_texture_config.category);
   }
+  return success;
 }
 
 ModelProcessor::ModelTextureConfig ModelProcessor::ProvideEncodeTextureConfig(
@@ -185,22 +665,174 @@ ModelProcessor::ModelTextureConfig ModelProcessor::ProvideDecodeTextureConfig(
   return {out_path, category};
 }
 
-void ModelProcessor::OptimizeModel(const std::string& destination) {
+void ModelProcessor::OptimizeModel(const std::filesystem::path& in_path,
+                                   const std::filesystem::path& out_path) {
   std::string command;
   command.reserve(std::strlen(FAITHFUL_ASSET_PROCESSOR_GLTFPACK_PATH) +
-                  destination.size() * 2 + 17); // 17 for flags, whitespaces
+                  in_path.native().size() + out_path.native().size() +
+                  17); // 17 for flags, whitespaces
   command = FAITHFUL_ASSET_PROCESSOR_GLTFPACK_PATH;
   /// no changes for textures, no quantization
   /// (requires extension, while tinygltf don't support it)
   command += " -tr -noq -i ";
-  command += destination;
+  command += in_path.string();
   command += " -o ";
-  command += destination;
-  if (std::system(command.c_str()) != 0) {
+  command += out_path.string();
+  TraceScope trace_scope("gltfpack", out_path);
+  trace_scope.SetBytesInFromFile(in_path);
+  int status = std::system(command.c_str());
+  trace_scope.SetBytesOutFromFile(out_path);
+  if (status != 0) {
     throw std::runtime_error("unable to optimize model");
   }
 }
 
+void ModelProcessor::CompressAnimations(const std::filesystem::path& path) {
+  TraceScope trace_scope("gltf_animations", path);
+  trace_scope.SetBytesInFromFile(path);
+  tinygltf::Model model;
+  /// textures of the model are already in models/, not beside path
+  loader_.SetImageLoader(TinygltfLoadTextureStub, nullptr);
+  std::string error, warning;
+  if (!loader_.LoadASCIIFromFile(&model, &error, &warning, path.string())) {
+    throw std::runtime_error("failed to load gltfpack output: " + error);
+  }
+  if (model.animations.empty()) {
+    return;
+  }
+
+  std::vector<ClipCompression> clips(model.animations.size());
+  std::atomic<std::size_t> next_clip{0};
+  thread_pool_.Execute([&](int) {
+    for (auto i = next_clip.fetch_add(1, std::memory_order_relaxed);
+         i < clips.size();
+         i = next_clip.fetch_add(1, std::memory_order_relaxed)) {
+      clips[i] = CompressClip(model, model.animations[i]);
+    }
+  });
+
+  /// accessors of compressed samplers, unless still used by anything else
+  std::vector<bool> removed(model.accessors.size(), false);
+  std::vector<bool> kept(model.accessors.size(), false);
+  auto mark = [](std::vector<bool>& marks, int id) {
+    if (id >= 0 && id < static_cast<int>(marks.size())) {
+      marks[id] = true;
+    }
+  };
+  for (std::size_t a = 0; a < clips.size(); ++a) {
+    const auto& samplers = model.animations[a].samplers;
+    for (std::size_t s = 0; s < samplers.size(); ++s) {
+      auto& marks = clips[a].compressed[s] ? removed : kept;
+      mark(marks, samplers[s].input);
+      mark(marks, samplers[s].output);
+    }
+  }
+  for (const auto& mesh : model.meshes) {
+    for (const auto& primitive : mesh.primitives) {
+      mark(kept, primitive.indices);
+      for (const auto& attribute : primitive.attributes) {
+        mark(kept, attribute.second);
+      }
+      for (const auto& target : primitive.targets) {
+        for (const auto& attribute : target) {
+          mark(kept, attribute.second);
+        }
+      }
+    }
+  }
+  for (const auto& skin : model.skins) {
+    mark(kept, skin.inverseBindMatrices);
+  }
+  std::size_t bytes_before = 0;
+  for (std::size_t i = 0; i < removed.size(); ++i) {
+    removed[i] = removed[i] && !kept[i];
+    if (removed[i]) {
+      const auto& accessor = model.accessors[i];
+      bytes_before += accessor.count *
+                      tinygltf::GetNumComponentsInType(accessor.type) *
+                      tinygltf::GetComponentSizeInBytes(accessor.componentType);
+    }
+  }
+  RemoveAccessors(model, removed);
+
+  /// one view at the end of the first buffer for all new accessors
+  if (model.buffers.empty()) {
+    model.buffers.emplace_back();
+    model.buffers.back().uri = path.stem().string() + ".bin";
+  }
+  auto& buffer_data = model.buffers[0].data;
+  buffer_data.resize((buffer_data.size() + 3) & ~std::size_t{3});
+  int view_id = static_cast<int>(model.bufferViews.size());
+  std::vector<unsigned char> data;
+  std::size_t keys_before = 0;
+  std::size_t keys_after = 0;
+  float max_errors[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  for (std::size_t a = 0; a < clips.size(); ++a) {
+    auto& samplers = model.animations[a].samplers;
+    for (std::size_t s = 0; s < samplers.size(); ++s) {
+      if (!clips[a].compressed[s]) {
+        continue;
+      }
+      const auto& track = clips[a].tracks[s];
+      const auto& stats = clips[a].stats[s];
+      keys_before += stats.keys_before;
+      keys_after += stats.keys_after;
+      auto& max_error = max_errors[static_cast<int>(track.path)];
+      max_error = std::max(max_error, stats.max_error);
+
+      samplers[s].input = AppendAccessor(
+          model, data, view_id, track.times.data(),
+          track.times.size() * sizeof(float), TINYGLTF_COMPONENT_TYPE_FLOAT,
+          false, TINYGLTF_TYPE_SCALAR, track.times.size());
+      /// required for sampler inputs
+      model.accessors.back().minValues = {track.times.front()};
+      model.accessors.back().maxValues = {track.times.back()};
+      if (track.path == AnimationPath::kRotation) {
+        std::vector<int16_t> quantized(track.values.size());
+        std::transform(track.values.begin(), track.values.end(),
+                       quantized.begin(), QuantizeSnorm16);
+        samplers[s].output = AppendAccessor(
+            model, data, view_id, quantized.data(),
+            quantized.size() * sizeof(int16_t), TINYGLTF_COMPONENT_TYPE_SHORT,
+            true, TINYGLTF_TYPE_VEC4, track.times.size());
+      } else {
+        bool vector = track.path != AnimationPath::kWeights;
+        samplers[s].output = AppendAccessor(
+            model, data, view_id, track.values.data(),
+            track.values.size() * sizeof(float), TINYGLTF_COMPONENT_TYPE_FLOAT,
+            false, vector ? TINYGLTF_TYPE_VEC3 : TINYGLTF_TYPE_SCALAR,
+            vector ? track.times.size() : track.values.size());
+      }
+    }
+  }
+  tinygltf::BufferView view;
+  view.buffer = 0;
+  view.byteOffset = buffer_data.size();
+  view.byteLength = data.size();
+  model.bufferViews.push_back(std::move(view));
+  buffer_data.insert(buffer_data.end(), data.begin(), data.end());
+
+  std::cout << "    animations: " << clips.size() << " clips, keyframes "
+            << keys_before << " -> " << keys_after << ", bytes "
+            << bytes_before << " -> " << data.size()
+            << ", max error: rotation "
+            << max_errors[static_cast<int>(AnimationPath::kRotation)] *
+                   180.0f / 3.14159265f
+            << " deg, translation "
+            << max_errors[static_cast<int>(AnimationPath::kTranslation)]
+            << ", scale "
+            << max_errors[static_cast<int>(AnimationPath::kScale)]
+            << ", weights "
+            << max_errors[static_cast<int>(AnimationPath::kWeights)]
+            << std::endl;
+
+  if (!loader_.WriteGltfSceneToFile(&model, path.string(),
+                                    false, false, true, false)) {
+    throw std::runtime_error("failed to write GLTF file");
+  }
+  trace_scope.SetBytesOutFromFile(path);
+}
+
 void ModelProcessor::SetDestinationDirectory(
     const std::filesystem::path& path) {
   models_destination_path_ = path / "models";
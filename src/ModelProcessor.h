@@ -9,6 +9,8 @@
 
 #include "tiny_gltf.h"
 
+#include "AssetLoadingThreadPool.h"
+#include "BatchIo.h"
 #include "TextureProcessor.h"
 #include "ReplaceRequest.h"
 
@@ -22,7 +24,8 @@ bool TinygltfLoadTextureStub(tinygltf::Image *image, const int image_idx,
 class ModelProcessor {
  public:
   ModelProcessor() = delete;
-  ModelProcessor(TextureProcessor& texture_processor,
+  ModelProcessor(AssetLoadingThreadPool& thread_pool, BatchIo& batch_io,
+                 TextureProcessor& texture_processor,
                  ReplaceRequest& replace_request);
 
   /// only move-constructable because of std::unique_ptr and member reference
@@ -32,8 +35,12 @@ class ModelProcessor {
   ModelProcessor(ModelProcessor&&) = default;
   ModelProcessor& operator=(ModelProcessor&&) = delete;
 
-  void Encode(const std::filesystem::path& path);
-  void Decode(const std::filesystem::path& path);
+  /// outputs (.gltf, buffers) are written into models/.<name>.part/ and
+  /// moved into models/ when complete; return false if model or any of
+  /// its textures wasn't written (declined replace request isn't a failure);
+  /// written (if not nullptr) tells whether the .gltf was actually written
+  bool Encode(const std::filesystem::path& path, bool* written = nullptr);
+  bool Decode(const std::filesystem::path& path, bool* written = nullptr);
 
   void SetDestinationDirectory(const std::filesystem::path& path);
 
@@ -47,17 +54,54 @@ class ModelProcessor {
      TextureProcessor::TextureCategory category;
    };
   void Read();
-  void Write(const std::string& destination);
-
-  void CompressTextures();
-  void DecompressTextures();
+  /// replace request is made for destination, but written into path;
+  /// returns false if replace declined
+  bool Write(const std::string& destination,
+             const std::filesystem::path& path);
+
+  /// empty staging directory of the current model
+  std::filesystem::path ProvideStagingPath() const;
+  /// moves all files of staging_path into models/, .gltf last
+  void Publish(const std::filesystem::path& staging_path) const;
+
+  /// for RunReport: .gltf + its buffers
+  void ReportWrittenBytes(const std::string& destination) const;
+
+  /// all-black emissive textures are dropped (see RemoveImage()), unless
+  /// the image is used by other slots as well
+  bool CompressTextures();
+  bool DecompressTextures();
+
+  /// with its textures; texture references of materials are reindexed
+  /// (-1 for removed ones)
+  void RemoveImage(int image_id);
+
+  /// emissive slots which use image_id are cleared with their factors
+  void ClearEmissiveImage(int image_id);
+  /// by any slot of any material
+  bool IsImageUsed(int image_id) const;
+  bool IsTextureOfImage(int texture_id, int image_id) const;
 
   ModelTextureConfig ProvideEncodeTextureConfig(int model_image_id);
 
   /// filename stem as an input parameter
   ModelTextureConfig ProvideDecodeTextureConfig(std::string_view path);
 
-  static void OptimizeModel(const std::string& path);
+  static void OptimizeModel(const std::filesystem::path& in_path,
+                            const std::filesystem::path& out_path);
+
+  /// in place, for gltfpack output (it resamples all keyframes at 30 Hz, so
+  /// reduction before it would be undone): LINEAR and STEP samplers are
+  /// reduced and quantized (see AnimationCompression.h), animations in
+  /// parallel; their old accessors are removed and buffers compacted;
+  /// prints keyframes, bytes and the largest error
+  void CompressAnimations(const std::filesystem::path& path);
+
+  /// for animations, textures use it through texture_processor_
+  AssetLoadingThreadPool& thread_pool_;
+
+  /// existence of destination (Write())
+  BatchIo& batch_io_;
 
   /// in case if texture embedded, we directly ask texture processor to process
   TextureProcessor& texture_processor_;
@@ -0,0 +1,142 @@
+#include "OggSeekIndex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+constexpr std::size_t kPageHeaderSize = 27;
+/// 1, "vorbis", version, channels, sample rate
+constexpr std::size_t kIdentificationSize = 16;
+/// identification, comment & setup
+constexpr uint64_t kHeaderPackets = 3;
+/// pages are read one by one, but from memory
+constexpr std::size_t kScanBufferSize = 1 << 20;
+/// granule of a page on which no packet ends
+constexpr uint64_t kNoGranule = ~uint64_t{0};
+
+uint64_t ReadLe(const uint8_t* data, int bytes) {
+  uint64_t value = 0;
+  for (int i = bytes - 1; i >= 0; --i) {
+    value = (value << 8) | data[i];
+  }
+  return value;
+}
+
+void AppendLe(std::vector<uint8_t>& data, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    data.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+}  // namespace
+
+bool BuildOggSeekIndex(const std::filesystem::path& path, int interval_ms,
+                       OggSeekIndex& index) {
+  index = OggSeekIndex{};
+  std::vector<char> buffer(kScanBufferSize);
+  std::ifstream file;
+  /// before open, otherwise it may be ignored
+  file.rdbuf()->pubsetbuf(buffer.data(),
+                          static_cast<std::streamsize>(buffer.size()));
+  file.open(path, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Error: can't read " << path << std::endl;
+    return false;
+  }
+
+  uint64_t offset = 0;
+  uint64_t packets = 0;
+  uint32_t serial = 0;
+  uint64_t interval = 0;
+  uint64_t next_entry = 0;
+  uint8_t header[kPageHeaderSize];
+  uint8_t lacing[255];
+  while (file.read(reinterpret_cast<char*>(header), kPageHeaderSize)) {
+    int segments = header[26];
+    if (std::memcmp(header, "OggS", 4) != 0 || header[4] != 0 ||
+        !file.read(reinterpret_cast<char*>(lacing), segments)) {
+      std::cerr << "Error: broken ogg page at " << offset << " of " << path
+                << std::endl;
+      return false;
+    }
+    uint64_t granule = ReadLe(header + 6, 8);
+    auto page_serial = static_cast<uint32_t>(ReadLe(header + 14, 4));
+    uint64_t body = 0;
+    uint64_t packets_ended = 0;
+    for (int i = 0; i < segments; ++i) {
+      body += lacing[i];
+      packets_ended += lacing[i] < 255 ? 1 : 0;
+    }
+
+    uint64_t skip = body;
+    if (offset == 0) {
+      /// the identification header is alone on the first page
+      uint8_t identification[kIdentificationSize];
+      if (body < kIdentificationSize ||
+          !file.read(reinterpret_cast<char*>(identification),
+                     kIdentificationSize) ||
+          identification[0] != 1 ||
+          std::memcmp(identification + 1, "vorbis", 6) != 0) {
+        std::cerr << "Error: " << path << " isn't ogg vorbis" << std::endl;
+        return false;
+      }
+      serial = page_serial;
+      index.sample_rate =
+          static_cast<uint32_t>(ReadLe(identification + 12, 4));
+      interval = std::max<uint64_t>(
+          1, static_cast<uint64_t>(index.sample_rate) * interval_ms / 1000);
+      skip -= kIdentificationSize;
+    } else if (page_serial != serial) {
+      std::cerr << "Error: chained or multiplexed ogg streams aren't "
+                   "supported: "
+                << path << std::endl;
+      return false;
+    }
+
+    /// an audio page which starts a new packet (not continued one) and
+    /// ends at least one
+    bool continued = (header[5] & 1) != 0;
+    if (packets >= kHeaderPackets && !continued && granule != kNoGranule &&
+        granule >= next_entry) {
+      index.entries.push_back({granule, offset});
+      next_entry = granule + interval;
+    }
+
+    if (!file.ignore(static_cast<std::streamsize>(skip)) ||
+        static_cast<uint64_t>(file.gcount()) != skip) {
+      std::cerr << "Error: truncated ogg page at " << offset << " of "
+                << path << std::endl;
+      return false;
+    }
+    if (granule != kNoGranule) {
+      index.total_granule = granule;
+    }
+    packets += packets_ended;
+    offset += kPageHeaderSize + segments + body;
+  }
+  if (file.gcount() != 0 || index.sample_rate == 0) {
+    std::cerr << "Error: truncated ogg " << path << std::endl;
+    return false;
+  }
+  index.file_size = offset;
+  return true;
+}
+
+std::vector<uint8_t> SerializeOggSeekIndex(const OggSeekIndex& index) {
+  std::vector<uint8_t> data;
+  data.reserve(28 + index.entries.size() * 16);
+  /// "FSK1"
+  AppendLe(data, 0x314B5346, 4);
+  AppendLe(data, index.sample_rate, 4);
+  AppendLe(data, index.total_granule, 8);
+  AppendLe(data, index.file_size, 8);
+  AppendLe(data, index.entries.size(), 4);
+  for (const auto& entry : index.entries) {
+    AppendLe(data, entry.granule, 8);
+    AppendLe(data, entry.offset, 8);
+  }
+  return data;
+}
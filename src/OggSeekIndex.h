@@ -0,0 +1,44 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_OGGSEEKINDEX_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_OGGSEEKINDEX_H
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+/// Seek table of .ogg (Vorbis) music, so the game jumps to a loop point or
+/// section by one read instead of bisection of vorbisfile (many small reads
+/// on the streaming thread). Built by one linear scan of page headers
+/// (bodies are skipped), an entry is taken at the first page boundary after
+/// each interval of audio.
+///
+/// File (<name>.ogg.seek beside the track, little endian):
+///   "FSK1", u32 sample rate, u64 granule of the last page (length in
+///   samples), u64 .ogg size, u32 entry count,
+///   entries: u64 granule, u64 offset
+/// where offset is the beginning of a page which starts a new packet and
+/// granule is the one of that page. Decoding from offset (its first packet
+/// only primes the decoder) gives every sample from granule on, so a target
+/// is reached from the last entry with granule <= target (targets before
+/// the first entry - from the beginning); samples before the target are
+/// decoded & dropped as usual, ov_raw_seek() + ov_pcm_tell() tell where
+/// they start.
+
+struct OggSeekEntry {
+  uint64_t granule;
+  uint64_t offset;
+};
+
+struct OggSeekIndex {
+  uint32_t sample_rate{0};
+  uint64_t total_granule{0};
+  uint64_t file_size{0};
+  std::vector<OggSeekEntry> entries;
+};
+
+/// false (with error message) for not ogg, not vorbis or chained streams
+bool BuildOggSeekIndex(const std::filesystem::path& path, int interval_ms,
+                       OggSeekIndex& index);
+
+std::vector<uint8_t> SerializeOggSeekIndex(const OggSeekIndex& index);
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_OGGSEEKINDEX_H
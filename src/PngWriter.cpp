@@ -0,0 +1,236 @@
+#include "PngWriter.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <fstream>
+
+#include <zlib.h>
+
+
+namespace {
+
+constexpr int kBytesPerPixel = 4;
+
+enum PngFilter : uint8_t {
+  kFilterNone = 0,
+  kFilterSub = 1,
+  kFilterUp = 2,
+  kFilterAverage = 3,
+  kFilterPaeth = 4
+};
+
+/// all filters: out[i] = row[i] - prediction(left, up, up_left), where
+/// out of bounds neighbours are 0; plain loops over bytes without
+/// dependencies between iterations, so they're vectorized
+
+void FilterSub(const uint8_t* row, std::size_t size, uint8_t* out) {
+  for (std::size_t i = 0; i < kBytesPerPixel; ++i) {
+    out[i] = row[i];
+  }
+  for (std::size_t i = kBytesPerPixel; i < size; ++i) {
+    out[i] = static_cast<uint8_t>(row[i] - row[i - kBytesPerPixel]);
+  }
+}
+
+void FilterUp(const uint8_t* row, const uint8_t* prior, std::size_t size,
+              uint8_t* out) {
+  for (std::size_t i = 0; i < size; ++i) {
+    out[i] = static_cast<uint8_t>(row[i] - prior[i]);
+  }
+}
+
+void FilterAverage(const uint8_t* row, const uint8_t* prior, std::size_t size,
+                   uint8_t* out) {
+  for (std::size_t i = 0; i < kBytesPerPixel; ++i) {
+    out[i] = static_cast<uint8_t>(row[i] - (prior[i] >> 1));
+  }
+  for (std::size_t i = kBytesPerPixel; i < size; ++i) {
+    out[i] = static_cast<uint8_t>(
+        row[i] - ((row[i - kBytesPerPixel] + prior[i]) >> 1));
+  }
+}
+
+void FilterPaeth(const uint8_t* row, const uint8_t* prior, std::size_t size,
+                 uint8_t* out) {
+  /// a = 0 and c = 0, so predictor is just b
+  for (std::size_t i = 0; i < kBytesPerPixel; ++i) {
+    out[i] = static_cast<uint8_t>(row[i] - prior[i]);
+  }
+  for (std::size_t i = kBytesPerPixel; i < size; ++i) {
+    int a = row[i - kBytesPerPixel];
+    int b = prior[i];
+    int c = prior[i - kBytesPerPixel];
+    int pa = std::abs(b - c);
+    int pb = std::abs(a - c);
+    int pc = std::abs(a + b - 2 * c);
+    int prediction = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+    out[i] = static_cast<uint8_t>(row[i] - prediction);
+  }
+}
+
+/// filtered bytes as signed, smaller is (usually) better compressed
+uint32_t FilterCost(const uint8_t* filtered, std::size_t size) {
+  uint32_t cost = 0;
+  for (std::size_t i = 0; i < size; ++i) {
+    cost += static_cast<uint32_t>(std::abs(static_cast<int8_t>(filtered[i])));
+  }
+  return cost;
+}
+
+void WriteUint32(uint8_t* out, uint32_t value) {
+  out[0] = static_cast<uint8_t>(value >> 24);
+  out[1] = static_cast<uint8_t>(value >> 16);
+  out[2] = static_cast<uint8_t>(value >> 8);
+  out[3] = static_cast<uint8_t>(value);
+}
+
+void WriteChunk(std::ofstream& file, const char* type,
+                const uint8_t* data, std::size_t size) {
+  uint8_t length[4];
+  WriteUint32(length, static_cast<uint32_t>(size));
+  auto crc = crc32(0, reinterpret_cast<const Bytef*>(type), 4);
+  /// crc32() with Z_NULL returns initial value (IEND has no data)
+  if (size != 0) {
+    crc = crc32(crc, data, static_cast<uInt>(size));
+  }
+  uint8_t crc_bytes[4];
+  WriteUint32(crc_bytes, static_cast<uint32_t>(crc));
+  file.write(reinterpret_cast<const char*>(length), 4);
+  file.write(type, 4);
+  file.write(reinterpret_cast<const char*>(data),
+             static_cast<std::streamsize>(size));
+  file.write(reinterpret_cast<const char*>(crc_bytes), 4);
+}
+
+}  // namespace
+
+PngWriter::PngWriter(const std::filesystem::path& path, int width,
+                     int height, int level)
+    : atomic_file_(path),
+      file_(atomic_file_.GetTempPath(), std::ios::binary),
+      width_(width),
+      height_(height),
+      level_(std::clamp(level, 0, 9)),
+      adler_(static_cast<uint32_t>(adler32(0, nullptr, 0))) {
+  if (!file_.is_open()) {
+    return;
+  }
+  constexpr uint8_t kSignature[8]{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  file_.write(reinterpret_cast<const char*>(kSignature), sizeof(kSignature));
+
+  uint8_t header[13];
+  WriteUint32(header, static_cast<uint32_t>(width_));
+  WriteUint32(header + 4, static_cast<uint32_t>(height_));
+  header[8] = 8; // bit depth
+  header[9] = 6; // rgba
+  header[10] = 0; // deflate
+  header[11] = 0; // adaptive filtering
+  header[12] = 0; // no interlace
+  WriteChunk(file_, "IHDR", header, sizeof(header));
+
+  /// IDAT chunks are just concatenated by decoder, so zlib header,
+  /// strips and adler32 are written as they are
+  const uint8_t zlib_header[2]{
+      0x78, static_cast<uint8_t>(level_ < 2   ? 0x01
+                                 : level_ < 6 ? 0x5E
+                                 : level_ == 6 ? 0x9C : 0xDA)};
+  WriteChunk(file_, "IDAT", zlib_header, sizeof(zlib_header));
+}
+
+void PngWriter::FilterRows(const uint8_t* rgba, int first_row, int row_count,
+                           uint8_t* filtered) const {
+  std::size_t stride = static_cast<std::size_t>(width_) * kBytesPerPixel;
+  /// the first image row has "zero" prior row
+  std::vector<uint8_t> zero_row(stride, 0);
+  std::array<std::vector<uint8_t>, 5> candidates;
+  if (level_ != 0) {
+    for (auto& candidate : candidates) {
+      candidate.resize(stride);
+    }
+  }
+  for (int r = 0; r < row_count; ++r) {
+    const uint8_t* row = rgba + r * stride;
+    uint8_t* out = filtered + r * (stride + 1);
+    if (level_ == 0) {
+      out[0] = kFilterNone;
+      std::copy_n(row, stride, out + 1);
+      continue;
+    }
+    /// previous row belongs to another strip
+    bool has_prior = r != 0 || first_row == 0;
+    const uint8_t* prior = r == 0 ? zero_row.data() : row - stride;
+    std::copy_n(row, stride, candidates[kFilterNone].data());
+    FilterSub(row, stride, candidates[kFilterSub].data());
+    if (has_prior) {
+      FilterUp(row, prior, stride, candidates[kFilterUp].data());
+      FilterAverage(row, prior, stride, candidates[kFilterAverage].data());
+      FilterPaeth(row, prior, stride, candidates[kFilterPaeth].data());
+    }
+
+    std::size_t best = kFilterNone;
+    uint32_t best_cost = FilterCost(candidates[kFilterNone].data(), stride);
+    std::size_t last_filter = has_prior ? kFilterPaeth : kFilterSub;
+    for (std::size_t filter = kFilterSub; filter <= last_filter; ++filter) {
+      uint32_t cost = FilterCost(candidates[filter].data(), stride);
+      if (cost < best_cost) {
+        best = filter;
+        best_cost = cost;
+      }
+    }
+    out[0] = static_cast<uint8_t>(best);
+    std::copy_n(candidates[best].data(), stride, out + 1);
+  }
+}
+
+void PngWriter::EncodeStrip(const uint8_t* rgba, int first_row, int row_count,
+                            Strip& strip) const {
+  std::size_t stride = static_cast<std::size_t>(width_) * kBytesPerPixel;
+  strip.filtered_size = (stride + 1) * row_count;
+  std::vector<uint8_t> filtered(strip.filtered_size);
+  FilterRows(rgba, first_row, row_count, filtered.data());
+  strip.adler = static_cast<uint32_t>(adler32(
+      adler32(0, nullptr, 0), filtered.data(),
+      static_cast<uInt>(filtered.size())));
+
+  z_stream stream{};
+  /// raw deflate: zlib header and adler32 are written once for all strips
+  if (deflateInit2(&stream, level_, Z_DEFLATED, -MAX_WBITS, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    strip.failed = true;
+    return;
+  }
+  /// + empty stored block of sync flush
+  strip.deflated.resize(deflateBound(&stream, filtered.size()) + 16);
+  stream.next_in = filtered.data();
+  stream.avail_in = static_cast<uInt>(filtered.size());
+  stream.next_out = strip.deflated.data();
+  stream.avail_out = static_cast<uInt>(strip.deflated.size());
+  /// sync flush ends the strip on a byte boundary without final block,
+  /// so the next strip can be appended right after it
+  bool last = first_row + row_count == height_;
+  int status = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+  strip.failed = last ? status != Z_STREAM_END
+                      : status != Z_OK || stream.avail_in != 0;
+  strip.deflated.resize(stream.total_out);
+  deflateEnd(&stream);
+}
+
+bool PngWriter::WriteStrip(const Strip& strip) {
+  if (strip.failed) {
+    return false;
+  }
+  adler_ = static_cast<uint32_t>(adler32_combine(
+      adler_, strip.adler, static_cast<z_off_t>(strip.filtered_size)));
+  WriteChunk(file_, "IDAT", strip.deflated.data(), strip.deflated.size());
+  return static_cast<bool>(file_);
+}
+
+bool PngWriter::Commit() {
+  uint8_t zlib_trailer[4];
+  WriteUint32(zlib_trailer, adler_);
+  WriteChunk(file_, "IDAT", zlib_trailer, sizeof(zlib_trailer));
+  WriteChunk(file_, "IEND", nullptr, 0);
+  file_.close();
+  return file_ && atomic_file_.Commit();
+}
@@ -0,0 +1,65 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_PNGWRITER_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_PNGWRITER_H
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "AtomicFile.h"
+
+/// 8-bit RGBA png encoder for decode mode, fed by strips of rows as they
+/// are decompressed (see TextureProcessor::DecodeStrips()), so the whole
+/// image is never in memory (stbi_write_png needs it and is single-threaded):
+/// - each strip is filtered and deflated on its own by any thread (like
+///   pigz): raw deflate ended with Z_SYNC_FLUSH, so strips are just
+///   concatenated into one zlib stream, adler32 is combined when they're
+///   written;
+/// - filter of each row is chosen by the minimal sum of absolute
+///   differences, loops are written so compiler vectorizes them; the first
+///   row of a strip doesn't know its previous row, so it's None or Sub;
+/// - level 0 is store-only without filtering (fast dumps for QA).
+/// Written under temporary name and renamed by Commit() (see AtomicFile).
+class PngWriter {
+ public:
+  using Component = uint8_t;
+
+  struct Strip {
+    std::vector<uint8_t> deflated;
+    uint32_t adler;
+    std::size_t filtered_size;
+    bool failed;
+  };
+
+  /// zlib level [0; 9]
+  PngWriter(const std::filesystem::path& path, int width, int height,
+            int level);
+
+  bool IsOpen() const {
+    return file_.is_open();
+  }
+
+  /// thread-safe; rgba of row_count rows starting from first_row
+  void EncodeStrip(const uint8_t* rgba, int first_row, int row_count,
+                   Strip& strip) const;
+
+  /// in order of rows, one thread at a time
+  bool WriteStrip(const Strip& strip);
+
+  /// returns false if file can't be written
+  bool Commit();
+
+ private:
+  void FilterRows(const uint8_t* rgba, int first_row, int row_count,
+                  uint8_t* filtered) const;
+
+  AtomicFile atomic_file_;
+  std::ofstream file_;
+  int width_;
+  int height_;
+  int level_;
+  /// of all written strips
+  uint32_t adler_;
+};
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_PNGWRITER_H
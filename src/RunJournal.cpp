@@ -0,0 +1,77 @@
+#include "RunJournal.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+
+#include "AtomicFile.h"
+
+void RunJournal::Open(const std::filesystem::path& path, bool encode,
+                      bool resume) {
+  const std::string header = encode ? "faithful journal e"
+                                    : "faithful journal d";
+  completed_.clear();
+  if (resume) {
+    std::ifstream old_file(path);
+    std::string line;
+    if (std::getline(old_file, line) && line == header) {
+      while (std::getline(old_file, line)) {
+        /// torn line of killed run has no trailing ';'
+        if (!line.empty() && line.back() == ';') {
+          completed_.insert(line);
+        }
+      }
+    } else if (old_file.is_open()) {
+      std::cerr << "Warning: journal " << path
+                << " is of the other mode, starting over" << std::endl;
+    }
+  }
+  /// rewritten without torn lines, then only appended
+  {
+    AtomicFile new_file(path);
+    std::ofstream file(new_file.GetTempPath());
+    file << header << '\n';
+    for (const auto& entry : completed_) {
+      file << entry << '\n';
+    }
+    file.close();
+    if (!file || !new_file.Commit()) {
+      throw std::runtime_error("unable to write journal");
+    }
+  }
+  file_.open(path, std::ios::app);
+  if (resume) {
+    std::cout << "resuming: " << completed_.size()
+              << " assets already completed" << std::endl;
+  }
+}
+
+bool RunJournal::IsCompleted(const std::filesystem::path& source) const {
+  auto entry = MakeEntry(source);
+  return !entry.empty() && completed_.contains(entry);
+}
+
+void RunJournal::Record(const std::filesystem::path& source) {
+  auto entry = MakeEntry(source);
+  if (entry.empty()) {
+    return;
+  }
+  std::lock_guard lock(mu_);
+  /// flushed, so it survives the kill of the process
+  file_ << entry << '\n' << std::flush;
+}
+
+std::string RunJournal::MakeEntry(const std::filesystem::path& source) {
+  std::error_code error;
+  auto size = std::filesystem::file_size(source, error);
+  if (error) {
+    return {};
+  }
+  auto mtime = std::filesystem::last_write_time(source, error);
+  if (error) {
+    return {};
+  }
+  return std::to_string(size) + ";" +
+         std::to_string(mtime.time_since_epoch().count()) + ";" +
+         std::filesystem::absolute(source).lexically_normal().string() + ";";
+}
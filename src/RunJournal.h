@@ -0,0 +1,46 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_RUNJOURNAL_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_RUNJOURNAL_H
+
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <string>
+
+/// Append-only list of completed source assets (destination/.journal),
+/// so interrupted run can be continued by --resume instead of starting over.
+/// Each line is size;mtime;absolute path of the source, written only after
+/// all outputs of the asset are published (see AtomicFile), so changed
+/// sources and torn last line after kill are just processed again.
+/// Record() is thread-safe.
+class RunJournal {
+ public:
+  RunJournal() = default;
+
+  RunJournal(const RunJournal&) = delete;
+  RunJournal& operator=(const RunJournal&) = delete;
+
+  RunJournal(RunJournal&&) = delete;
+  RunJournal& operator=(RunJournal&&) = delete;
+
+  /// without resume (or if journal is of the other mode) starts a new one
+  void Open(const std::filesystem::path& path, bool encode, bool resume);
+
+  bool IsCompleted(const std::filesystem::path& source) const;
+
+  void Record(const std::filesystem::path& source);
+
+  std::size_t GetCompletedCount() const {
+    return completed_.size();
+  }
+
+ private:
+  /// empty if source doesn't exist
+  static std::string MakeEntry(const std::filesystem::path& source);
+
+  std::set<std::string> completed_;
+  std::ofstream file_;
+  std::mutex mu_;
+};
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_RUNJOURNAL_H
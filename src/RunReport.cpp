@@ -0,0 +1,341 @@
+#include "RunReport.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "rapidjson/ostreamwrapper.h"
+#include "rapidjson/prettywriter.h"
+
+#include "../config/AssetFormats.h"
+#include "AstcencDispatch.h"
+
+namespace {
+
+struct StageRecord {
+  double wall_seconds{0.0};
+  double cpu_seconds{0.0};
+  uint64_t allocation_count{0};
+  uint64_t allocated_bytes{0};
+};
+
+struct AssetRecord {
+  std::string path;
+  const char* category;
+  double wall_seconds;
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+  uint64_t pixels;
+};
+
+struct CategoryRecord {
+  uint64_t count{0};
+  uint64_t bytes_in{0};
+  uint64_t bytes_out{0};
+  uint64_t pixels{0};
+  double wall_seconds{0.0};
+};
+
+/// only main thread (stages are opened/closed by AssetProcessor)
+double run_start_wall_seconds;
+double run_start_cpu_seconds;
+std::map<std::string, StageRecord> stages;
+std::vector<std::string> stages_order;
+
+/// also by pool workers (RecordAsset), read in Write() when they're done
+std::mutex assets_mutex;
+std::vector<AssetRecord> assets;
+
+double CompressionRatio(uint64_t bytes_in, uint64_t bytes_out) {
+  return bytes_out == 0 ? 0.0 : static_cast<double>(bytes_in) / bytes_out;
+}
+
+double Megapixels(uint64_t pixels) {
+  return static_cast<double>(pixels) / 1e6;
+}
+
+}  // namespace
+
+std::atomic<bool> RunReport::enabled_{false};
+std::atomic<uint64_t> RunReport::asset_bytes_in_{0};
+std::atomic<uint64_t> RunReport::asset_bytes_out_{0};
+std::atomic<uint64_t> RunReport::asset_pixels_{0};
+
+void RunReport::Enable() {
+  auto times = MeasureProcessTimes();
+  run_start_wall_seconds = times.wall_seconds;
+  run_start_cpu_seconds = times.cpu_seconds;
+  enabled_.store(true, std::memory_order_relaxed);
+}
+
+void RunReport::AddBytesInFromFile(const std::filesystem::path& path) {
+  if (IsEnabled()) {
+    std::error_code error;
+    auto file_size = std::filesystem::file_size(path, error);
+    asset_bytes_in_.fetch_add(error ? 0 : file_size, std::memory_order_relaxed);
+  }
+}
+
+void RunReport::AddBytesOutFromFile(const std::filesystem::path& path) {
+  if (IsEnabled()) {
+    std::error_code error;
+    auto file_size = std::filesystem::file_size(path, error);
+    asset_bytes_out_.fetch_add(error ? 0 : file_size, std::memory_order_relaxed);
+  }
+}
+
+void RunReport::RecordAsset(const char* category,
+                            const std::filesystem::path& path,
+                            double wall_seconds, uint64_t bytes_in,
+                            uint64_t bytes_out, uint64_t pixels) {
+  if (!IsEnabled()) {
+    return;
+  }
+  std::lock_guard lock(assets_mutex);
+  assets.push_back({path.string(), category, wall_seconds,
+                    bytes_in, bytes_out, pixels});
+}
+
+double RunReport::NowSeconds() {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+RunReport::ProcessTimes RunReport::MeasureProcessTimes() {
+  double wall_seconds = NowSeconds();
+#ifdef _WIN32
+  FILETIME creation_time, exit_time, kernel_time, user_time;
+  ::GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time,
+                    &kernel_time, &user_time);
+  auto to_seconds = [](const FILETIME& time) {
+    /// 100 ns units
+    return static_cast<double>(
+        static_cast<uint64_t>(time.dwHighDateTime) << 32 |
+        time.dwLowDateTime) * 1e-7;
+  };
+  return {wall_seconds, to_seconds(kernel_time) + to_seconds(user_time)};
+#else
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  auto to_seconds = [](const timeval& time) {
+    return static_cast<double>(time.tv_sec) +
+           static_cast<double>(time.tv_usec) * 1e-6;
+  };
+  return {wall_seconds, to_seconds(usage.ru_utime) + to_seconds(usage.ru_stime)};
+#endif
+}
+
+uint64_t RunReport::GetPeakRss() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters{};
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    return 0;
+  }
+  return counters.PeakWorkingSetSize;
+#else
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return static_cast<uint64_t>(usage.ru_maxrss); // bytes
+#else
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // kilobytes
+#endif
+#endif
+}
+
+bool RunReport::Write(const std::filesystem::path& path, bool encode) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    std::cerr << "Error: failed to create run report: " << path << std::endl;
+    return false;
+  }
+
+  std::map<std::string, CategoryRecord> categories;
+  CategoryRecord total;
+  for (const auto& asset : assets) {
+    for (auto* record : {&categories[asset.category], &total}) {
+      ++record->count;
+      record->bytes_in += asset.bytes_in;
+      record->bytes_out += asset.bytes_out;
+      record->pixels += asset.pixels;
+      record->wall_seconds += asset.wall_seconds;
+    }
+  }
+  auto end_times = MeasureProcessTimes();
+
+  rapidjson::OStreamWrapper stream(file);
+  rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(stream);
+  auto write_bytes = [&](const CategoryRecord& record) {
+    writer.Key("count");
+    writer.Uint64(record.count);
+    writer.Key("bytes_in");
+    writer.Uint64(record.bytes_in);
+    writer.Key("bytes_out");
+    writer.Uint64(record.bytes_out);
+    /// in/out, so for encoding bigger is better
+    writer.Key("compression_ratio");
+    writer.Double(CompressionRatio(record.bytes_in, record.bytes_out));
+  };
+
+  writer.StartObject();
+  writer.Key("mode");
+  writer.String(encode ? "encode" : "decode");
+  writer.Key("wall_time_s");
+  writer.Double(end_times.wall_seconds - run_start_wall_seconds);
+  writer.Key("cpu_time_s");
+  writer.Double(end_times.cpu_seconds - run_start_cpu_seconds);
+  writer.Key("peak_rss_bytes");
+  writer.Uint64(GetPeakRss());
+  writer.Key("allocation_counting");
+  writer.Bool(IsAllocationCountingEnabled());
+  /// which astcenc build encoded textures on this agent
+  writer.Key("astcenc_backend");
+  writer.String(AstcencBackendName());
+
+  writer.Key("total");
+  writer.StartObject();
+  write_bytes(total);
+  writer.EndObject();
+
+  writer.Key("categories");
+  writer.StartObject();
+  for (const auto& [name, category] : categories) {
+    writer.Key(name.c_str());
+    writer.StartObject();
+    write_bytes(category);
+    if (category.pixels != 0) {
+      writer.Key("megapixels");
+      writer.Double(Megapixels(category.pixels));
+      writer.Key("megapixels_per_second");
+      writer.Double(category.wall_seconds > 0.0
+                        ? Megapixels(category.pixels) / category.wall_seconds
+                        : 0.0);
+    }
+    writer.EndObject();
+  }
+  writer.EndObject();
+
+  writer.Key("stages");
+  writer.StartObject();
+  for (const auto& name : stages_order) {
+    const auto& stage = stages[name];
+    writer.Key(name.c_str());
+    writer.StartObject();
+    writer.Key("wall_time_s");
+    writer.Double(stage.wall_seconds);
+    writer.Key("cpu_time_s");
+    writer.Double(stage.cpu_seconds);
+    if (IsAllocationCountingEnabled()) {
+      writer.Key("allocations");
+      writer.Uint64(stage.allocation_count);
+      writer.Key("allocated_bytes");
+      writer.Uint64(stage.allocated_bytes);
+    }
+    writer.EndObject();
+  }
+  writer.EndObject();
+
+  std::vector<const AssetRecord*> slowest;
+  for (const auto& asset : assets) {
+    slowest.push_back(&asset);
+  }
+  std::size_t slowest_count = std::min(
+      slowest.size(),
+      static_cast<std::size_t>(faithful::config::kReportSlowestAssetCount));
+  std::partial_sort(slowest.begin(), slowest.begin() + slowest_count,
+                    slowest.end(), [](const auto* lhs, const auto* rhs) {
+                      return lhs->wall_seconds > rhs->wall_seconds;
+                    });
+  writer.Key("slowest");
+  writer.StartArray();
+  for (std::size_t i = 0; i < slowest_count; ++i) {
+    const auto& asset = *slowest[i];
+    writer.StartObject();
+    writer.Key("path");
+    writer.String(asset.path.c_str());
+    writer.Key("category");
+    writer.String(asset.category);
+    writer.Key("wall_time_s");
+    writer.Double(asset.wall_seconds);
+    writer.Key("bytes_in");
+    writer.Uint64(asset.bytes_in);
+    writer.Key("bytes_out");
+    writer.Uint64(asset.bytes_out);
+    if (asset.pixels != 0) {
+      writer.Key("megapixels");
+      writer.Double(Megapixels(asset.pixels));
+    }
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.EndObject();
+  return file.good();
+}
+
+ReportStageScope::ReportStageScope(const char* name)
+    : name_(name),
+      active_(RunReport::IsEnabled()) {
+  if (active_) {
+    start_times_ = RunReport::MeasureProcessTimes();
+    start_allocations_ = GetAllocationStats();
+  }
+}
+
+void ReportStageScope::End() {
+  if (!active_) {
+    return;
+  }
+  active_ = false;
+  auto end_times = RunReport::MeasureProcessTimes();
+  auto end_allocations = GetAllocationStats();
+  auto found = stages.find(name_);
+  if (found == stages.end()) {
+    stages_order.emplace_back(name_);
+    found = stages.emplace(name_, StageRecord{}).first;
+  }
+  auto& stage = found->second;
+  stage.wall_seconds += end_times.wall_seconds - start_times_.wall_seconds;
+  stage.cpu_seconds += end_times.cpu_seconds - start_times_.cpu_seconds;
+  stage.allocation_count += end_allocations.count - start_allocations_.count;
+  stage.allocated_bytes += end_allocations.bytes - start_allocations_.bytes;
+}
+
+ReportAssetScope::ReportAssetScope(const char* category,
+                                   const std::filesystem::path& path)
+    : category_(category),
+      active_(RunReport::IsEnabled()) {
+  if (active_) {
+    path_ = path;
+    RunReport::asset_bytes_in_.store(0, std::memory_order_relaxed);
+    RunReport::asset_bytes_out_.store(0, std::memory_order_relaxed);
+    RunReport::asset_pixels_.store(0, std::memory_order_relaxed);
+    RunReport::AddBytesInFromFile(path);
+    start_seconds_ = RunReport::NowSeconds();
+  }
+}
+
+ReportAssetScope::~ReportAssetScope() {
+  if (!active_) {
+    return;
+  }
+  std::lock_guard lock(assets_mutex);
+  assets.push_back({
+      path_.string(), category_,
+      RunReport::NowSeconds() - start_seconds_,
+      RunReport::asset_bytes_in_.load(std::memory_order_relaxed),
+      RunReport::asset_bytes_out_.load(std::memory_order_relaxed),
+      RunReport::asset_pixels_.load(std::memory_order_relaxed)});
+}
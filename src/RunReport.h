@@ -0,0 +1,121 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_RUNREPORT_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_RUNREPORT_H
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+
+#include "AllocationCounter.h"
+
+/// Machine-readable summary of a run (--report out.json):
+/// per-category counts, input/output bytes, compression ratio, megapixels/s,
+/// wall & cpu time and allocations per stage, peak RSS and the slowest assets
+
+/// AssetProcessor opens stages (one per asset category + analyzing) and
+/// asset scopes, while processors only report what they've written/decoded
+/// via AddBytesIn/Out() and AddPixels(), which are attributed to the current
+/// asset; these are atomic, so may be called by pool workers
+
+/// when disabled all calls are one relaxed atomic load and a branch
+class RunReport {
+ public:
+  /// should be called before any work (run time is measured from here)
+  static void Enable();
+
+  static bool IsEnabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /// additional input (e.g. external .bin and images of .gltf)
+  static void AddBytesIn(uint64_t bytes) {
+    if (IsEnabled()) {
+      asset_bytes_in_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+  }
+  static void AddBytesOut(uint64_t bytes) {
+    if (IsEnabled()) {
+      asset_bytes_out_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+  }
+  /// file size (0 if it doesn't exist), queried only when report is enabled
+  static void AddBytesInFromFile(const std::filesystem::path& path);
+  static void AddBytesOutFromFile(const std::filesystem::path& path);
+
+  /// compressed/decompressed texels
+  static void AddPixels(uint64_t pixels) {
+    if (IsEnabled()) {
+      asset_pixels_.fetch_add(pixels, std::memory_order_relaxed);
+    }
+  }
+
+  /// the whole asset at once, for assets processed outside of
+  /// ReportAssetScope (e.g. batched textures); thread-safe
+  static void RecordAsset(const char* category,
+                          const std::filesystem::path& path,
+                          double wall_seconds, uint64_t bytes_in,
+                          uint64_t bytes_out, uint64_t pixels);
+
+  /// should be called after processing (when all stages are closed);
+  /// returns false if file can't be written
+  static bool Write(const std::filesystem::path& path, bool encode);
+
+ private:
+  friend class ReportStageScope;
+  friend class ReportAssetScope;
+
+  struct ProcessTimes {
+    double wall_seconds;
+    double cpu_seconds;
+  };
+
+  static ProcessTimes MeasureProcessTimes();
+  static double NowSeconds();
+  static uint64_t GetPeakRss();
+
+  static std::atomic<bool> enabled_;
+
+  static std::atomic<uint64_t> asset_bytes_in_;
+  static std::atomic<uint64_t> asset_bytes_out_;
+  static std::atomic<uint64_t> asset_pixels_;
+};
+
+/// stages aren't nested, name should be a string literal
+class ReportStageScope {
+ public:
+  explicit ReportStageScope(const char* name);
+  ~ReportStageScope() {
+    if (active_) {
+      End();
+    }
+  }
+
+  ReportStageScope(const ReportStageScope&) = delete;
+  ReportStageScope& operator=(const ReportStageScope&) = delete;
+
+  /// closes stage earlier than dtor
+  void End();
+
+ private:
+  const char* name_;
+  RunReport::ProcessTimes start_times_;
+  AllocationStats start_allocations_;
+  bool active_;
+};
+
+/// one asset of the given category (string literal), only from main thread
+class ReportAssetScope {
+ public:
+  ReportAssetScope(const char* category, const std::filesystem::path& path);
+  ~ReportAssetScope();
+
+  ReportAssetScope(const ReportAssetScope&) = delete;
+  ReportAssetScope& operator=(const ReportAssetScope&) = delete;
+
+ private:
+  const char* category_;
+  std::filesystem::path path_;
+  double start_seconds_;
+  bool active_;
+};
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_RUNREPORT_H
@@ -0,0 +1,129 @@
+#include "ShardMerger.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../config/AssetFormats.h"
+#include "AssetsInfo.h"
+#include "AtomicFile.h"
+
+ShardMerger::ShardMerger(const std::filesystem::path& destination)
+    : destination_(destination),
+      batch_io_(thread_pool_) {}
+
+bool ShardMerger::Merge(const std::filesystem::path& shards_root) {
+  std::vector<std::filesystem::path> shard_dirs;
+  std::error_code error;
+  for (const auto& entry :
+       std::filesystem::directory_iterator(shards_root, error)) {
+    /// destination may be inside of shards_root too
+    if (entry.is_directory() &&
+        !std::filesystem::equivalent(entry.path(), destination_, error)) {
+      shard_dirs.push_back(entry.path());
+    }
+  }
+  if (shard_dirs.empty()) {
+    std::cerr << "Error: no shard outputs found in " << shards_root
+              << std::endl;
+    return false;
+  }
+  std::sort(shard_dirs.begin(), shard_dirs.end());
+
+  /// relative to destination
+  std::set<std::filesystem::path> merged_files;
+  std::vector<std::filesystem::path> copied_files;
+  std::vector<std::unique_ptr<AtomicFile>> atomic_files;
+  std::vector<BatchIo::CopyRequest> requests;
+  /// category directory -> asset names for info.txt
+  std::map<std::string, std::set<std::string>> assets;
+  std::ofstream verify_report;
+  /// category directory -> loudness entries, the first shard wins too
+  std::map<std::string, std::map<std::string, std::string>> loudness;
+  for (const auto& shard_dir : shard_dirs) {
+    std::cout << "--> merging: " << shard_dir << std::endl;
+    for (const auto& entry :
+         std::filesystem::recursive_directory_iterator(shard_dir)) {
+      if (!entry.is_regular_file()) {
+        continue;
+      }
+      auto relative_path = entry.path().lexically_relative(shard_dir);
+      auto filename = relative_path.filename().string();
+      if (filename == faithful::config::kAudioLoudnessName) {
+        loudness[relative_path.parent_path().generic_string()].merge(
+            ReadAssetsLoudness(entry.path().parent_path()));
+        continue;
+      }
+      /// written below from the merged list; journals and temporary files
+      /// of shards are hidden
+      if (filename == "info.txt" || filename.starts_with('.')) {
+        continue;
+      }
+      if (filename == faithful::config::kTexVerifyReportName) {
+        if (!verify_report.is_open()) {
+          verify_report.open(destination_ / relative_path);
+        }
+        verify_report << std::ifstream(entry.path()).rdbuf();
+        continue;
+      }
+      if (!merged_files.insert(relative_path).second) {
+        std::cerr << "Warning: " << relative_path
+                  << " is produced by several shards, the first is kept"
+                  << std::endl;
+        continue;
+      }
+      auto destination_path = destination_ / relative_path;
+      std::filesystem::create_directories(destination_path.parent_path());
+      atomic_files.push_back(std::make_unique<AtomicFile>(destination_path));
+      requests.push_back({entry.path(), atomic_files.back()->GetTempPath()});
+      copied_files.push_back(std::move(relative_path));
+    }
+  }
+
+  /// all files at once (see BatchIo), published when everything is copied
+  thread_pool_.Run();
+  auto errors = batch_io_.Copy(requests);
+  thread_pool_.Stop();
+  bool success = true;
+  for (std::size_t i = 0; i < requests.size(); ++i) {
+    if (errors[i] || !atomic_files[i]->Commit()) {
+      std::cerr << "Error: failed to copy " << requests[i].from << ": "
+                << errors[i].message() << std::endl;
+      success = false;
+      continue;
+    }
+    const auto& relative_path = copied_files[i];
+    auto category = relative_path.parent_path().generic_string();
+    if (IsAssetFile(relative_path, category == kAssetsInfoModelsDir)) {
+      assets[category].insert(relative_path.filename().string());
+    }
+  }
+
+  for (const auto& [category, entries] : loudness) {
+    std::filesystem::create_directories(destination_ / category);
+    if (!WriteAssetsLoudness(destination_ / category, entries)) {
+      success = false;
+    }
+  }
+  for (auto dir : kAssetsInfoDirs) {
+    std::filesystem::create_directories(destination_ / dir);
+    UpdateAssetsInfo(destination_ / dir, assets[std::string(dir)]);
+  }
+  std::filesystem::create_directories(destination_ / kAssetsInfoModelsDir);
+  UpdateAssetsInfo(destination_ / kAssetsInfoModelsDir,
+                   assets[std::string(kAssetsInfoModelsDir)], true);
+  /// texture directories of encode profiles (<profile>/, <profile>/maps...)
+  for (const auto& [category, names] : assets) {
+    if (category != kAssetsInfoModelsDir &&
+        std::find(kAssetsInfoDirs.begin(), kAssetsInfoDirs.end(), category) ==
+            kAssetsInfoDirs.end()) {
+      UpdateAssetsInfo(destination_ / category, names);
+    }
+  }
+  return success;
+}
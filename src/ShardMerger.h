@@ -0,0 +1,34 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_SHARDMERGER_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_SHARDMERGER_H
+
+#include <filesystem>
+
+#include "AssetLoadingThreadPool.h"
+#include "BatchIo.h"
+
+/// Combines outputs of sharded runs (--shard i/N, each with own destination)
+/// into one destination (<destination> <shards_root> m):
+/// - every subdirectory of shards_root is an output of one shard, they're
+///   merged in order of names, so if two shards have the same file,
+///   the first one is kept (and reported);
+/// - info.txt of each category is updated once from the merged list
+///   (without rescanning destination), so ids don't depend on which
+///   shard produced an asset;
+/// - verify reports and loudness of audio (see AudioProcessor) of shards
+///   are concatenated;
+/// - files are copied by one batch (see BatchIo).
+class ShardMerger {
+ public:
+  explicit ShardMerger(const std::filesystem::path& destination);
+
+  /// returns false if there are no shards or some file can't be copied
+  bool Merge(const std::filesystem::path& shards_root);
+
+ private:
+  std::filesystem::path destination_;
+  /// only for BatchIo without io_uring
+  AssetLoadingThreadPool thread_pool_;
+  BatchIo batch_io_;
+};
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_SHARDMERGER_H
@@ -1,19 +1,44 @@
 #include "TextureProcessor.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <exception>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <type_traits>
 
 #include "stb_image.h"
-#include "stb_image_write.h"
 
 #include "../config/AssetFormats.h"
+#include "AtlasPacker.h"
+#include "AtomicFile.h"
+#include "DistanceField.h"
+#include "HalfFloat.h"
+#include "ImageDownscale.h"
+#include "ImageMetrics.h"
+#include "MappedOutputFile.h"
+#include "RunReport.h"
+#include "Trace.h"
 
 TextureProcessor::TextureProcessor(
     AssetLoadingThreadPool& thread_pool,
+    BatchIo& batch_io,
     ReplaceRequest& replace_request)
     : thread_pool_(thread_pool),
-      replace_request_(replace_request) {
+      batch_io_(batch_io),
+      replace_request_(replace_request),
+      png_level_(faithful::config::kPngCompLevel),
+      batch_contexts_(thread_pool.GetThreadNumber()) {
   InitContexts();
 }
 
@@ -22,48 +47,106 @@ TextureProcessor::~TextureProcessor() {
 }
 
 void TextureProcessor::InitContexts() {
-  InitContext(faithful::config::kTextureConfigLdr, context_ldr_);
-  InitContext(faithful::config::kTextureConfigHdr, context_hdr_);
-  InitContext(faithful::config::kTextureConfigLdrNormal,
-              context_ldr_normal_);
-  InitContext(faithful::config::kTextureConfigLdrAlphaPerceptual,
-              context_ldr_alpha_perceptual_);
+  /// default block size is always used (at least as a fallback), so it's
+  /// cheaper to create them once here
+  for (const auto* config : {&faithful::config::kTextureConfigLdr,
+                             &faithful::config::kTextureConfigHdr,
+                             &faithful::config::kTextureConfigLdrNormal,
+                             &faithful::config::kTextureConfigLdrAlphaPerceptual}) {
+    ProvideContext(*config, faithful::config::kTexCompBlockX,
+                   faithful::config::kTexCompBlockY,
+                   faithful::config::kTexCompQuality);
+  }
 }
 
-void TextureProcessor::InitContext(astcenc_config config,
-                                   astcenc_context*& context) {
+astcenc_context* TextureProcessor::InitContext(const astcenc_config& config,
+                                               int block_x, int block_y,
+                                               float quality,
+                                               int thread_count) {
   auto config_copy = config;
   astcenc_error status = astcenc_config_init(
-      config.profile, config.block_x,
-      config.block_y, config.block_z,
-      faithful::config::kTexCompQuality, config.flags, &config_copy);
+      config.profile, block_x, block_y, faithful::config::kTexCompBlockZ,
+      quality, config.flags, &config_copy);
   if (status != ASTCENC_SUCCESS) {
     std::string error_string{"TextureProcessor::InitContext astcenc_config_init:\n"};
     error_string += astcenc_get_error_string(status);
     throw std::runtime_error(error_string);
   }
+  astcenc_context* context;
   status = astcenc_context_alloc(
-      &config_copy, thread_pool_.GetThreadNumber(), &context);
+      &config_copy, thread_count, &context);
   if (status != ASTCENC_SUCCESS) {
     std::string error_string{"TextureProcessor::InitContext astcenc_context_alloc:\n"};
     error_string += astcenc_get_error_string(status);
     throw std::runtime_error(error_string);
   }
+  return context;
+}
+
+astcenc_context* TextureProcessor::ProvideContext(const astcenc_config& config,
+                                                  int block_x, int block_y,
+                                                  float quality) {
+  ContextKey key{config.profile, config.flags, block_x, block_y, quality};
+  auto found = contexts_.find(key);
+  if (found != contexts_.end()) {
+    return found->second;
+  }
+  auto context = InitContext(config, block_x, block_y, quality,
+                             thread_pool_.GetThreadNumber());
+  contexts_.emplace(key, context);
+  return context;
+}
+
+astcenc_context* TextureProcessor::ProvideBatchContext(
+    const astcenc_config& config, int thread_id, int block_x, int block_y) {
+  ContextKey key{config.profile, config.flags, block_x, block_y,
+                 faithful::config::kTexCompQuality};
+  auto& contexts = batch_contexts_[thread_id];
+  auto found = contexts.find(key);
+  if (found != contexts.end()) {
+    return found->second;
+  }
+  auto context = InitContext(config, block_x, block_y,
+                             faithful::config::kTexCompQuality, 1);
+  contexts.emplace(key, context);
+  return context;
 }
 
 void TextureProcessor::DeInitContexts() {
-  astcenc_context_free(context_ldr_);
-  astcenc_context_free(context_hdr_);
-  astcenc_context_free(context_ldr_normal_);
-  astcenc_context_free(context_ldr_alpha_perceptual_);
+  for (auto& [key, context] : contexts_) {
+    astcenc_context_free(context);
+  }
+  contexts_.clear();
+  for (auto& contexts : batch_contexts_) {
+    for (auto& [key, context] : contexts) {
+      astcenc_context_free(context);
+    }
+    contexts.clear();
+  }
 }
 
-void TextureProcessor::Encode(const std::filesystem::path& path) {
+bool TextureProcessor::Encode(const std::filesystem::path& path,
+                              bool* written) {
   auto texture_config = ProvideEncodeTextureConfig(path);
-  if (!MakeReplaceRequest(texture_config.out_path)) {
-    return;
+  auto profile_configs = ProvideProfileTextureConfigs(texture_config);
+  /// all destinations of profiles by one stat
+  std::vector<std::filesystem::path> out_paths;
+  for (const auto& out_config : profile_configs) {
+    out_paths.push_back(out_config.out_path);
+  }
+  auto out_stats = batch_io_.Stat(out_paths);
+  std::vector<TextureConfig> out_configs;
+  for (std::size_t i = 0; i < profile_configs.size(); ++i) {
+    if (MakeReplaceRequest(out_paths[i], out_stats[i].exists)) {
+      out_configs.push_back(std::move(profile_configs[i]));
+    }
+  }
+  if (written) {
+    *written = !out_configs.empty();
+  }
+  if (out_configs.empty()) {
+    return true;
   }
-  astcenc_compress_reset(texture_config.context);
   /// We add the prefix "hdr_" to the file {actual_name}.hdr to distinguish
   /// between LDR and HDR textures during decompression (ASTC header doesn't
   /// provide this information). However, it's possible that the user has
@@ -77,21 +160,25 @@ void TextureProcessor::Encode(const std::filesystem::path& path) {
         << R"(" because it has the prefix "hdr_" for an LDR texture.)"
         << "\nPlease rename it (\"hdr_\" is used in decompression as a hint)."
         << std::endl;
-    return;
+    return false;
   }
 
   int image_x, image_y, image_c;
 
   /// RAII
   std::unique_ptr<uint8_t[]> image_data_ptr_uint8;
-  std::unique_ptr<float[]> image_data_ptr_float;
+  std::unique_ptr<uint16_t, void (*)(void*)> image_data_ptr_half{nullptr,
+                                                                 std::free};
 
   /// astcenc_image requires l-value ref, so std::unique_ptr::get() doesn't work
-  float* image_data_ptr_float_ptr;
+  uint16_t* image_data_ptr_half_ptr;
   uint8_t* image_data_ptr_uint8_ptr;
 
   void** image_data_ptr;
 
+  TraceScope trace_scope("stbi_load", path);
+  trace_scope.SetBytesInFromFile(path);
+
   /// force 4 component (astc requirement)
   if (texture_config.category != TextureCategory::kHdrRgb) {
     auto image_data = static_cast<uint8_t*>(stbi_load(
@@ -99,7 +186,7 @@ void TextureProcessor::Encode(const std::filesystem::path& path) {
     if (!image_data) {
       std::cerr << "Error: stb_image texture loading failed: " << path
                 << std::endl;
-      return;
+      return false;
     }
     image_data_ptr_uint8 = std::unique_ptr<uint8_t[]>(image_data);
     image_data_ptr_uint8_ptr = image_data_ptr_uint8.get();
@@ -110,55 +197,528 @@ void TextureProcessor::Encode(const std::filesystem::path& path) {
     if (!image_data) {
       std::cerr << "Error: stb_image texture loading failed: " << path
                 << std::endl;
-      return;
+      return false;
+    }
+    /// astcenc takes half floats directly (kTexHdrDataType), so pixels are
+    /// converted in place and the upper half of the buffer is released:
+    /// compression reads 8 instead of 16 bytes per texel
+    std::size_t value_count = static_cast<std::size_t>(image_x) * image_y * 4;
+    auto half_data = reinterpret_cast<uint16_t*>(image_data);
+    {
+      TraceScope convert_scope("f32_to_f16", path);
+      FloatToHalf(image_data, half_data, value_count);
     }
-    image_data_ptr_float = std::unique_ptr<float[]>(image_data);
-    image_data_ptr_float_ptr = image_data_ptr_float.get();
-    image_data_ptr = reinterpret_cast<void**>(&image_data_ptr_float_ptr);
+    if (auto shrunk = std::realloc(image_data, value_count * sizeof(uint16_t))) {
+      half_data = static_cast<uint16_t*>(shrunk);
+    }
+    image_data_ptr_half.reset(half_data);
+    image_data_ptr_half_ptr = image_data_ptr_half.get();
+    image_data_ptr = reinterpret_cast<void**>(&image_data_ptr_half_ptr);
   }
 
-  int comp_len = CalculateCompLen(image_x, image_y);
-  auto comp_data = std::make_unique<uint8_t[]>(comp_len);
+  trace_scope.SetBytesOut(static_cast<uint64_t>(image_x) * image_y *
+                          TexelSize(texture_config.type));
+  trace_scope.End();
 
   astcenc_image image {
       static_cast<unsigned int>(image_x), static_cast<unsigned int>(image_y),
       1, texture_config.type, image_data_ptr
   };
-  // no need to make it atomic, only "fail"-thread write;
-  // order doesn't matter, need only true/false
-  bool encode_success = true;
-  thread_pool_.Execute(
-      [&, comp_len, comp_data_get = comp_data.get()](int thread_id) {
-        astcenc_error status = astcenc_compress_image(
-            texture_config.context, &image, &texture_config.swizzle,
-            comp_data_get, comp_len, thread_id);
-        if (status != ASTCENC_SUCCESS) {
-          encode_success = false;
+  /// glyph sheet is replaced by its (downscaled) distance field
+  std::unique_ptr<uint8_t[]> sdf_data;
+  void* sdf_data_ptr;
+  std::vector<std::unique_ptr<uint8_t[]>> sdf_mips;
+  std::vector<void*> sdf_mip_pointers;
+  if (font_sdf_size_ > 0 && HasFontPrefix(path)) {
+    /// spread is given in texels of the downscaled texture
+    int spread = faithful::config::kTexFontSdfSpread;
+    for (int size = std::max(image_x, image_y); size > font_sdf_size_;
+         size = HalvedSize(size)) {
+      spread *= 2;
+    }
+    {
+      TraceScope sdf_scope("font_sdf", path);
+      sdf_data = MakeDistanceField(image, spread);
+    }
+    image_data_ptr_uint8.reset();
+    sdf_data_ptr = sdf_data.get();
+    image.data = &sdf_data_ptr;
+    image = DownscaleToFit(image, font_sdf_size_, sdf_mips, sdf_mip_pointers);
+  }
+
+  /// decoded once for all profiles
+  std::vector<std::unique_ptr<uint8_t[]>> mips;
+  std::vector<void*> mip_pointers;
+  bool success = true;
+  for (const auto& out_config : out_configs) {
+    auto out_image =
+        DownscaleToFit(image, out_config.max_size, mips, mip_pointers);
+    if (virtual_maps_ && HasMapPrefix(path)) {
+      success &= EncodeVirtual(out_config.out_path, out_image, out_config);
+    } else {
+      success &= EncodeImpl(out_config.out_path, out_image, out_config);
+    }
+  }
+  return success;
+}
+
+std::unique_ptr<uint8_t[]> TextureProcessor::MakeDistanceField(
+    const astcenc_image& image, int spread) {
+  int image_x = static_cast<int>(image.dim_x);
+  int image_y = static_cast<int>(image.dim_y);
+  std::size_t pixel_count = static_cast<std::size_t>(image_x) * image_y;
+  auto texels = static_cast<const uint8_t*>(image.data[0]);
+  auto is_inside = [texels](std::size_t i) {
+    return texels[i * 4] >= faithful::config::kTexFontSdfThreshold;
+  };
+  /// distances beyond spread are clamped anyway (see DistanceField.h)
+  auto cap = static_cast<float>((spread + 1) * (spread + 1));
+  auto grid = std::make_unique_for_overwrite<float[]>(pixel_count);
+  auto sdf = std::make_unique_for_overwrite<uint8_t[]>(pixel_count * 4);
+
+  /// lines are taken by chunks, see DownscaleToFit()
+  constexpr int kLineChunk = 16;
+  auto for_each_line = [this](int line_count, const auto& process) {
+    std::atomic<int> next_line{0};
+    thread_pool_.Execute([&](int) {
+      for (int line = next_line.fetch_add(kLineChunk, std::memory_order_relaxed);
+           line < line_count;
+           line = next_line.fetch_add(kLineChunk, std::memory_order_relaxed)) {
+        process(line, std::min(line + kLineChunk, line_count));
+      }
+    });
+  };
+  /// distance to the nearest texel of the other side, so inside == true
+  /// fills texels inside of glyphs and inside == false the rest
+  for (bool inside : {false, true}) {
+    for_each_line(image_y, [&](int first, int last) {
+      for (std::size_t i = static_cast<std::size_t>(first) * image_x;
+           i < static_cast<std::size_t>(last) * image_x; ++i) {
+        grid[i] = is_inside(i) == inside ? cap : 0.0f;
+      }
+    });
+    for_each_line(image_x, [&](int first, int last) {
+      DistanceScratch scratch(image_y);
+      for (int x = first; x < last; ++x) {
+        SquaredDistanceLine(grid.get() + x, image_x, image_y, scratch);
+      }
+    });
+    for_each_line(image_y, [&](int first, int last) {
+      DistanceScratch scratch(image_x);
+      for (int y = first; y < last; ++y) {
+        std::size_t row = static_cast<std::size_t>(y) * image_x;
+        SquaredDistanceLine(grid.get() + row, 1, image_x, scratch);
+        for (std::size_t i = row; i < row + image_x; ++i) {
+          if (is_inside(i) != inside) {
+            continue;
+          }
+          /// the edge is half a texel away from texel centers
+          float distance = std::sqrt(grid[i]) - 0.5f;
+          float value = 0.5f + (inside ? distance : -distance) / (2.0f * spread);
+          auto sample = static_cast<uint8_t>(
+              std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+          sdf[i * 4] = sdf[i * 4 + 1] = sdf[i * 4 + 2] = sample;
+          sdf[i * 4 + 3] = 255;
+        }
+      }
+    });
+  }
+  return sdf;
+}
+
+std::vector<TextureProcessor::TextureConfig>
+TextureProcessor::ProvideProfileTextureConfigs(
+    const TextureConfig& texture_config) const {
+  if (profiles_.empty()) {
+    return {texture_config};
+  }
+  auto relative_path = std::filesystem::path(texture_config.out_path)
+                           .lexically_relative(default_destination_path_);
+  std::vector<TextureConfig> out_configs;
+  for (const auto& profile : profiles_) {
+    auto& out_config = out_configs.emplace_back(texture_config);
+    out_config.out_path =
+        (default_destination_path_ / profile.name / relative_path).string();
+    out_config.block_x = profile.block_x;
+    out_config.block_y = profile.block_y;
+    out_config.quality = profile.quality;
+    out_config.max_size = profile.max_size;
+  }
+  return out_configs;
+}
+
+astcenc_image TextureProcessor::DownscaleToFit(
+    const astcenc_image& image, int max_size,
+    std::vector<std::unique_ptr<uint8_t[]>>& mips,
+    std::vector<void*>& mip_pointers) {
+  astcenc_image level = image;
+  if (max_size <= 0) {
+    return level;
+  }
+  std::size_t mip = 0;
+  while (static_cast<int>(level.dim_x) > max_size ||
+         static_cast<int>(level.dim_y) > max_size) {
+    int image_x = static_cast<int>(level.dim_x);
+    int image_y = static_cast<int>(level.dim_y);
+    int halved_x = HalvedSize(image_x);
+    int halved_y = HalvedSize(image_y);
+    if (mip == mips.size()) {
+      TraceScope trace_scope("downscale");
+      auto halved = std::make_unique_for_overwrite<uint8_t[]>(
+          static_cast<std::size_t>(halved_x) * halved_y *
+          TexelSize(level.data_type));
+      /// rows are taken by chunks, see EncodeBatch()
+      constexpr int kRowChunk = 16;
+      std::atomic<int> next_row{0};
+      auto in_data = static_cast<const uint8_t*>(level.data[0]);
+      thread_pool_.Execute([&](int) {
+        for (int row = next_row.fetch_add(kRowChunk, std::memory_order_relaxed);
+             row < halved_y;
+             row = next_row.fetch_add(kRowChunk, std::memory_order_relaxed)) {
+          HalveRows(in_data, image_x, image_y, level.data_type, halved.get(),
+                    row, std::min(kRowChunk, halved_y - row));
         }
       });
+      mip_pointers.push_back(halved.get());
+      mips.push_back(std::move(halved));
+    }
+    level.dim_x = static_cast<unsigned int>(halved_x);
+    level.dim_y = static_cast<unsigned int>(halved_y);
+    level.data = &mip_pointers[mip];
+    ++mip;
+  }
+  return level;
+}
 
-  if (!encode_success) {
-    std::cerr << "Error: texture compression failed for: "
-              << path << std::endl;
-    return;
+bool TextureProcessor::IsBatchCandidate(
+    const std::filesystem::path& path) const {
+  if (auto_block_size_ || verify_ || !profiles_.empty() ||
+      HasHdrExtension(path) || (virtual_maps_ && HasMapPrefix(path)) ||
+      (font_sdf_size_ > 0 && HasFontPrefix(path))) {
+    return false;
+  }
+  /// only the header is read
+  int image_x, image_y, image_c;
+  if (!stbi_info(path.string().c_str(), &image_x, &image_y, &image_c)) {
+    return false;
   }
+  return static_cast<int64_t>(image_x) * image_y <=
+         faithful::config::kTexBatchMaxPixels;
+}
 
-  WriteEncodedData(texture_config.out_path, image_x, image_y,
-                   comp_len, std::move(comp_data));
+std::vector<std::filesystem::path> TextureProcessor::EncodeBatch(
+    const std::vector<std::filesystem::path>& paths) {
+  /// replace requests are interactive, so they're made before the workers
+  std::vector<TextureConfig> texture_configs;
+  std::vector<std::filesystem::path> out_paths;
+  for (const auto& path : paths) {
+    texture_configs.push_back(ProvideEncodeTextureConfig(path));
+    out_paths.push_back(texture_configs.back().out_path);
+  }
+  std::vector<BatchIo::FileStat> out_stats;
+  {
+    TraceScope trace_scope("batch_stat");
+    out_stats = batch_io_.Stat(out_paths);
+  }
+
+  std::vector<std::filesystem::path> batch_paths;
+  std::vector<TextureConfig> batch_configs;
+  std::vector<std::filesystem::path> written_paths;
+  for (std::size_t i = 0; i < paths.size(); ++i) {
+    const auto& path = paths[i];
+    auto& texture_config = texture_configs[i];
+    if (!MakeReplaceRequest(texture_config.out_path, out_stats[i].exists)) {
+      written_paths.push_back(path);
+      continue;
+    }
+    /// see Encode()
+    if (HasHdrPrefix(path)) {
+      std::cerr
+          << "Skipped: \"" << path
+          << R"(" because it has the prefix "hdr_" for an LDR texture.)"
+          << "\nPlease rename it (\"hdr_\" is used in decompression as a hint)."
+          << std::endl;
+      continue;
+    }
+    batch_paths.push_back(path);
+    batch_configs.push_back(std::move(texture_config));
+  }
+
+  BatchFileWriter writer;
+  /// images differ in size, so they're taken one by one instead of
+  /// splitting them evenly between threads
+  std::atomic<std::size_t> next_image{0};
+  /// each element is written only by its own worker
+  std::vector<char> encoded(batch_paths.size(), 0);
+  thread_pool_.Execute([&](int thread_id) {
+    for (auto i = next_image.fetch_add(1, std::memory_order_relaxed);
+         i < batch_paths.size();
+         i = next_image.fetch_add(1, std::memory_order_relaxed)) {
+      auto start = std::chrono::steady_clock::now();
+      encoded[i] = EncodeBatchImage(batch_paths[i], batch_configs[i],
+                                    thread_id, writer);
+      if (encoded[i] && timings_) {
+        timings_->Record(batch_paths[i],
+                         std::chrono::steady_clock::now() - start);
+      }
+    }
+  });
+  auto failed_paths = writer.Finish();
+  for (std::size_t i = 0; i < batch_paths.size(); ++i) {
+    if (encoded[i] &&
+        std::find(failed_paths.begin(), failed_paths.end(),
+                  batch_configs[i].out_path) == failed_paths.end()) {
+      written_paths.push_back(batch_paths[i]);
+    }
+  }
+  return written_paths;
 }
 
-void TextureProcessor::Encode(const std::filesystem::path& out_path,
+bool TextureProcessor::EncodeBatchImage(const std::filesystem::path& path,
+                                        const TextureConfig& texture_config,
+                                        int thread_id, BatchFileWriter& writer) {
+  TraceScope trace_scope("batch_encode", path);
+  bool report = RunReport::IsEnabled();
+  auto start = report ? std::chrono::steady_clock::now()
+                      : std::chrono::steady_clock::time_point{};
+
+  int image_x, image_y, image_c;
+  /// force 4 component (astc requirement)
+  std::unique_ptr<stbi_uc, void (*)(void*)> image_data{
+      stbi_load(path.string().c_str(), &image_x, &image_y, &image_c, 4),
+      stbi_image_free};
+  if (!image_data) {
+    std::cerr << "Error: stb_image texture loading failed: " << path
+              << std::endl;
+    return false;
+  }
+
+  /// astcenc_image requires l-value ref, so std::unique_ptr::get() doesn't work
+  auto image_data_ptr = reinterpret_cast<void*>(image_data.get());
+  astcenc_image image {
+      static_cast<unsigned int>(image_x), static_cast<unsigned int>(image_y),
+      1, texture_config.type, &image_data_ptr
+  };
+  /// see EncodeImpl()
+  auto traits = AnalyzeTexels(image);
+  int block_x = faithful::config::kTexCompBlockX;
+  int block_y = faithful::config::kTexCompBlockY;
+  if (traits.constant) {
+    block_x = faithful::config::kTexConstantBlockX;
+    block_y = faithful::config::kTexConstantBlockY;
+  }
+  int comp_len = CalculateCompLen(image_x, image_y, block_x, block_y);
+  std::vector<uint8_t> file_data(sizeof(AstcHeader) + comp_len);
+  auto header = MakeAstcHeader(image_x, image_y, block_x, block_y);
+  std::copy_n(reinterpret_cast<const uint8_t*>(&header), sizeof(AstcHeader),
+              file_data.data());
+
+  if (traits.constant) {
+    FillVoidExtent(image, texture_config.swizzle,
+                   file_data.data() + sizeof(AstcHeader), comp_len);
+  } else {
+    auto analyzed_config = ProvideAnalyzedTextureConfig(texture_config, traits);
+    /// single-thread context is reset by astcenc_compress_image() itself
+    astcenc_context* context;
+    try {
+      context = ProvideBatchContext(analyzed_config.astc_config, thread_id,
+                                    block_x, block_y);
+    } catch (const std::exception& e) {
+      /// can't be rethrown from the pool worker
+      std::cerr << "Error: " << e.what() << std::endl;
+      return false;
+    }
+    astcenc_error status = astcenc_compress_image(
+        context, &image, &analyzed_config.swizzle,
+        file_data.data() + sizeof(AstcHeader), comp_len, 0);
+    if (status != ASTCENC_SUCCESS) {
+      std::cerr << "Error: texture compression failed for: "
+                << texture_config.out_path << std::endl;
+      return false;
+    }
+  }
+
+  uint64_t pixels = static_cast<uint64_t>(image_x) * image_y;
+  uint64_t bytes_out = file_data.size();
+  trace_scope.SetBytesOut(bytes_out);
+  writer.Push(texture_config.out_path, std::move(file_data));
+  if (report) {
+    std::error_code error;
+    auto bytes_in = std::filesystem::file_size(path, error);
+    RunReport::RecordAsset(
+        "textures", path,
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count(),
+        error ? 0 : bytes_in, bytes_out, pixels);
+  }
+  return true;
+}
+
+std::string TextureProcessor::GetAtlasName(
+    const std::filesystem::path& path) const {
+  if (!atlas_ || HasMapPrefix(path) || HasNoisePrefix(path) ||
+      HasHdrPrefix(path) || HasHdrExtension(path) ||
+      (font_sdf_size_ > 0 && HasFontPrefix(path))) {
+    return {};
+  }
+  /// only the header is read
+  int image_x, image_y, image_c;
+  if (!stbi_info(path.string().c_str(), &image_x, &image_y, &image_c) ||
+      image_x > faithful::config::kTexAtlasMaxTextureSize ||
+      image_y > faithful::config::kTexAtlasMaxTextureSize) {
+    return {};
+  }
+  return HasFontPrefix(path) ? faithful::config::kTexAtlasFontName
+                             : faithful::config::kTexAtlasUiName;
+}
+
+bool TextureProcessor::EncodeAtlas(const std::string& name,
+                                   std::vector<std::filesystem::path> paths) {
+  constexpr int kPadding = faithful::config::kTexAtlasPadding;
+  /// textures start at block boundary and there are 2 * kPadding texels
+  /// between any two of them, so no block (up to 8x8) covers both
+  static_assert(kPadding % faithful::config::kTexCompBlockX == 0 &&
+                kPadding % faithful::config::kTexCompBlockY == 0);
+  static_assert(2 * kPadding + 1 >= 8);
+
+  auto table_path = default_destination_path_ / (name + ".atlas");
+  if (!MakeReplaceRequest(table_path)) {
+    return true;
+  }
+  /// sorted, so the same set of textures always gives the same atlas
+  std::sort(paths.begin(), paths.end(), [](const auto& lhs, const auto& rhs) {
+    if (lhs.filename() != rhs.filename()) {
+      return lhs.filename() < rhs.filename();
+    }
+    return lhs < rhs;
+  });
+
+  struct AtlasImage {
+    int width{0};
+    int height{0};
+    std::unique_ptr<stbi_uc, void (*)(void*)> data{nullptr, stbi_image_free};
+  };
+  std::vector<AtlasImage> images(paths.size());
+  std::atomic<std::size_t> next_image{0};
+  thread_pool_.Execute([&](int) {
+    for (auto i = next_image.fetch_add(1, std::memory_order_relaxed);
+         i < paths.size();
+         i = next_image.fetch_add(1, std::memory_order_relaxed)) {
+      TraceScope trace_scope("stbi_load", paths[i]);
+      trace_scope.SetBytesInFromFile(paths[i]);
+      int image_c;
+      /// force 4 component (astc requirement)
+      images[i].data.reset(stbi_load(paths[i].string().c_str(),
+                                     &images[i].width, &images[i].height,
+                                     &image_c, 4));
+    }
+  });
+
+  bool success = true;
+  std::vector<std::size_t> loaded;
+  std::vector<AtlasPacker::Rect> rects;
+  for (std::size_t i = 0; i < paths.size(); ++i) {
+    if (!images[i].data) {
+      std::cerr << "Error: stb_image texture loading failed: " << paths[i]
+                << std::endl;
+      success = false;
+      continue;
+    }
+    RunReport::AddBytesInFromFile(paths[i]);
+    loaded.push_back(i);
+    rects.push_back({images[i].width + 2 * kPadding,
+                     images[i].height + 2 * kPadding});
+  }
+  if (loaded.empty()) {
+    return false;
+  }
+
+  AtlasPacker packer(faithful::config::kTexCompBlockX,
+                     faithful::config::kTexAtlasMinPageSize,
+                     faithful::config::kTexAtlasMaxPageSize);
+  auto packed = packer.Pack(rects);
+
+  /// profile & swizzle of the category (font or other)
+  auto texture_config = ProvideEncodeTextureConfig(paths[loaded.front()]);
+  for (std::size_t page = 0; page < packed.page_sizes.size(); ++page) {
+    int page_size = packed.page_sizes[page];
+    std::vector<uint8_t> page_data(
+        static_cast<std::size_t>(page_size) * page_size * 4, 0);
+    for (std::size_t r = 0; r < loaded.size(); ++r) {
+      const auto& placement = packed.placements[r];
+      if (placement.page != static_cast<int>(page)) {
+        continue;
+      }
+      const auto& image = images[loaded[r]];
+      /// padding repeats the edge texels
+      for (int y = -kPadding; y < image.height + kPadding; ++y) {
+        int source_y = std::clamp(y, 0, image.height - 1);
+        for (int x = -kPadding; x < image.width + kPadding; ++x) {
+          int source_x = std::clamp(x, 0, image.width - 1);
+          std::copy_n(
+              image.data.get() +
+                  (static_cast<std::size_t>(source_y) * image.width + source_x) * 4,
+              4,
+              page_data.data() +
+                  (static_cast<std::size_t>(placement.y + kPadding + y) *
+                       page_size + placement.x + kPadding + x) * 4);
+        }
+      }
+    }
+
+    auto page_path = default_destination_path_ /
+                     (name + "_" + std::to_string(page) + ".astc");
+    if (!MakeReplaceRequest(page_path)) {
+      continue;
+    }
+    /// astcenc_image requires l-value ref, so data() doesn't work
+    auto page_data_ptr = reinterpret_cast<void*>(page_data.data());
+    astcenc_image page_image {
+        static_cast<unsigned int>(page_size),
+        static_cast<unsigned int>(page_size),
+        1, texture_config.type, &page_data_ptr
+    };
+    success &= EncodeImpl(page_path, page_image, texture_config);
+  }
+
+  std::vector<AtlasEntry> entries;
+  for (std::size_t r = 0; r < loaded.size(); ++r) {
+    const auto& placement = packed.placements[r];
+    const auto& image = images[loaded[r]];
+    AtlasEntry entry{};
+    auto entry_name = paths[loaded[r]].stem().string();
+    if (entry_name.size() >= sizeof(entry.name)) {
+      std::cerr << "Warning: atlas entry name is truncated: " << entry_name
+                << std::endl;
+    }
+    std::copy_n(entry_name.begin(),
+                std::min(entry_name.size(), sizeof(entry.name) - 1),
+                entry.name);
+    int page_size = packed.page_sizes[placement.page];
+    entry.page = static_cast<uint32_t>(placement.page);
+    entry.x = static_cast<uint16_t>(placement.x + kPadding);
+    entry.y = static_cast<uint16_t>(placement.y + kPadding);
+    entry.width = static_cast<uint16_t>(image.width);
+    entry.height = static_cast<uint16_t>(image.height);
+    entry.uv[0] = static_cast<float>(entry.x) / page_size;
+    entry.uv[1] = static_cast<float>(entry.y) / page_size;
+    entry.uv[2] = static_cast<float>(entry.x + entry.width) / page_size;
+    entry.uv[3] = static_cast<float>(entry.y + entry.height) / page_size;
+    entries.push_back(entry);
+  }
+  success &= WriteAtlasTable(
+      table_path, static_cast<int>(packed.page_sizes.size()), entries);
+  return success;
+}
+
+bool TextureProcessor::Encode(const std::filesystem::path& out_path,
                               std::unique_ptr<uint8_t[]> image_data,
                               int width, int height,
                               TextureCategory category) {
   auto texture_config = ProvideEncodeTextureConfig(category);
   if (!MakeReplaceRequest(out_path)) {
-    return;
+    return true;
   }
-  astcenc_compress_reset(texture_config.context);
-
-  int comp_len = CalculateCompLen(width, height);
-  auto comp_data = std::make_unique<uint8_t[]>(comp_len);
 
   /// astcenc_image requires l-value ref, so std::unique_ptr::get() doesn't work
   auto data_ptr = reinterpret_cast<void*>(image_data.get());
@@ -167,45 +727,684 @@ void TextureProcessor::Encode(const std::filesystem::path& out_path,
       static_cast<unsigned int>(width), static_cast<unsigned int>(height),
       1, texture_config.type, reinterpret_cast<void**>(&data_ptr)
   };
+  return EncodeImpl(out_path, image, texture_config);
+}
+
+bool TextureProcessor::EncodeImpl(const std::filesystem::path& out_path,
+                                  const astcenc_image& image,
+                                  const TextureConfig& texture_config) {
+  ImageTraits traits;
+  {
+    TraceScope trace_scope("analyze", out_path);
+    traits = AnalyzeTexels(image);
+  }
+  if (traits.constant) {
+    return EncodeConstant(out_path, image, texture_config);
+  }
+  return CompressImpl(out_path, image,
+                      ProvideAnalyzedTextureConfig(texture_config, traits));
+}
+
+bool TextureProcessor::EncodeVirtual(const std::filesystem::path& out_path,
+                                     const astcenc_image& image,
+                                     const TextureConfig& texture_config) {
+  constexpr int kTileSize = faithful::config::kTexVirtualTileSize;
+  constexpr int kStoredSize =
+      kTileSize + 2 * faithful::config::kTexVirtualTileBorder;
+  constexpr int kBlockX = faithful::config::kTexCompBlockX;
+  constexpr int kBlockY = faithful::config::kTexCompBlockY;
+  static_assert(kStoredSize % kBlockX == 0 && kStoredSize % kBlockY == 0,
+                "tile with borders should consist of whole blocks");
+  constexpr int kAlignment = faithful::config::kTexVirtualPageAlignment;
+
+  /// the whole pyramid, the last level is a single tile
+  std::vector<std::unique_ptr<uint8_t[]>> mips;
+  std::vector<void*> mip_pointers;
+  {
+    TraceScope trace_scope("virtual_mips", out_path);
+    DownscaleToFit(image, kTileSize, mips, mip_pointers);
+  }
+  std::vector<astcenc_image> levels{image};
+  for (auto& mip_pointer : mip_pointers) {
+    const auto& previous = levels.back();
+    levels.push_back({
+        static_cast<unsigned int>(HalvedSize(static_cast<int>(previous.dim_x))),
+        static_cast<unsigned int>(HalvedSize(static_cast<int>(previous.dim_y))),
+        1, image.data_type, &mip_pointer
+    });
+  }
+
+  struct Tile {
+    int level;
+    int x;
+    int y;
+    /// first texel, if the tile is constant
+    std::array<uint8_t, 8> color;
+    bool constant;
+  };
+  std::vector<Tile> tiles;
+  std::vector<VirtualTextureLevel> level_infos;
+  for (int level = 0; level < static_cast<int>(levels.size()); ++level) {
+    VirtualTextureLevel info{
+        levels[level].dim_x, levels[level].dim_y,
+        (levels[level].dim_x + kTileSize - 1) / kTileSize,
+        (levels[level].dim_y + kTileSize - 1) / kTileSize};
+    for (int y = 0; y < static_cast<int>(info.tiles_y); ++y) {
+      for (int x = 0; x < static_cast<int>(info.tiles_x); ++x) {
+        tiles.push_back({level, x, y, {}, false});
+      }
+    }
+    level_infos.push_back(info);
+  }
+
+  int texel_size = TexelSize(image.data_type);
+  std::size_t tile_bytes =
+      static_cast<std::size_t>(kStoredSize) * kStoredSize * texel_size;
+  /// tiles are taken one by one, see EncodeBatch()
+  std::atomic<std::size_t> next_tile{0};
+  {
+    TraceScope trace_scope("virtual_analyze", out_path);
+    thread_pool_.Execute([&](int) {
+      auto tile_data = std::make_unique_for_overwrite<uint8_t[]>(tile_bytes);
+      void* tile_data_ptr = tile_data.get();
+      astcenc_image tile_image{kStoredSize, kStoredSize, 1, image.data_type,
+                               &tile_data_ptr};
+      for (auto i = next_tile.fetch_add(1, std::memory_order_relaxed);
+           i < tiles.size();
+           i = next_tile.fetch_add(1, std::memory_order_relaxed)) {
+        auto& tile = tiles[i];
+        ExtractTile(levels[tile.level], tile.x, tile.y, tile_data.get());
+        tile.constant = AnalyzeTexels(tile_image).constant;
+        std::copy_n(tile_data.get(), texel_size, tile.color.begin());
+      }
+    });
+  }
+
+  /// constant tiles of the same color share a page
+  std::vector<uint32_t> page_ids;
+  std::vector<std::size_t> page_tiles;
+  std::map<std::array<uint8_t, 8>, uint32_t> constant_pages;
+  for (std::size_t i = 0; i < tiles.size(); ++i) {
+    auto page_id = static_cast<uint32_t>(page_tiles.size());
+    if (tiles[i].constant) {
+      auto [found, inserted] = constant_pages.emplace(tiles[i].color, page_id);
+      if (!inserted) {
+        page_ids.push_back(found->second);
+        continue;
+      }
+    }
+    page_ids.push_back(page_id);
+    page_tiles.push_back(i);
+  }
+
+  int comp_len = CalculateCompLen(kStoredSize, kStoredSize, kBlockX, kBlockY);
+  std::size_t page_size =
+      (static_cast<std::size_t>(comp_len) + kAlignment - 1) / kAlignment *
+      kAlignment;
+  MappedOutputFile out_file(out_path, page_tiles.size() * page_size);
+  if (!out_file.IsOpen()) {
+    std::cerr << "Error: failed to create " << out_path << std::endl;
+    return false;
+  }
 
   // no need to make it atomic, only "fail"-thread write;
   // order doesn't matter, need only true/false
   bool encode_success = true;
-  thread_pool_.Execute(
-      [&, comp_len, comp_data_get = comp_data.get()](int thread_id) {
+  std::atomic<std::size_t> next_page{0};
+  {
+    TraceScope trace_scope("virtual_compress", out_path);
+    trace_scope.SetBytesOut(page_tiles.size() * page_size);
+    thread_pool_.Execute([&](int thread_id) {
+      auto tile_data = std::make_unique_for_overwrite<uint8_t[]>(tile_bytes);
+      void* tile_data_ptr = tile_data.get();
+      astcenc_image tile_image{kStoredSize, kStoredSize, 1, image.data_type,
+                               &tile_data_ptr};
+      for (auto page = next_page.fetch_add(1, std::memory_order_relaxed);
+           page < page_tiles.size();
+           page = next_page.fetch_add(1, std::memory_order_relaxed)) {
+        const auto& tile = tiles[page_tiles[page]];
+        ExtractTile(levels[tile.level], tile.x, tile.y, tile_data.get());
+        /// padding up to page_size stays zero (fallocate or zeroed buffer)
+        uint8_t* comp_data = out_file.GetData() + page * page_size;
+        if (tile.constant) {
+          FillVoidExtent(tile_image, texture_config.swizzle, comp_data,
+                         comp_len);
+          continue;
+        }
+        astcenc_context* context;
+        try {
+          context = ProvideBatchContext(texture_config.astc_config, thread_id,
+                                        kBlockX, kBlockY);
+        } catch (const std::exception& e) {
+          /// can't be rethrown from the pool worker
+          std::cerr << "Error: " << e.what() << std::endl;
+          encode_success = false;
+          return;
+        }
         astcenc_error status = astcenc_compress_image(
-            texture_config.context, &image, &texture_config.swizzle,
-            comp_data_get, comp_len, thread_id);
+            context, &tile_image, &texture_config.swizzle, comp_data,
+            comp_len, 0);
         if (status != ASTCENC_SUCCESS) {
           encode_success = false;
         }
-      });
+      }
+    });
+  }
+  if (!encode_success) {
+    std::cerr << "Error: texture compression failed for: " << out_path
+              << std::endl;
+    return false;
+  }
+  RunReport::AddPixels(static_cast<uint64_t>(page_tiles.size()) *
+                       kStoredSize * kStoredSize);
+  if (!out_file.Commit()) {
+    std::cerr << "Error: failed to write " << out_path << std::endl;
+    return false;
+  }
+  RunReport::AddBytesOut(page_tiles.size() * page_size);
+
+  VirtualTextureHeader header{};
+  header.magic[0] = 'F';
+  header.magic[1] = 'V';
+  header.magic[2] = 'T';
+  header.magic[3] = 'X';
+  header.width = image.dim_x;
+  header.height = image.dim_y;
+  header.tile_size = static_cast<uint16_t>(kTileSize);
+  header.tile_border =
+      static_cast<uint16_t>(faithful::config::kTexVirtualTileBorder);
+  header.block_x = static_cast<uint8_t>(kBlockX);
+  header.block_y = static_cast<uint8_t>(kBlockY);
+  header.level_count = static_cast<uint16_t>(level_infos.size());
+  header.page_size = static_cast<uint32_t>(page_size);
+  header.page_count = static_cast<uint32_t>(page_tiles.size());
+  auto index_path = std::filesystem::path(out_path).replace_extension(
+      faithful::config::kTexVirtualIndexExtension);
+  /// after pages, so the table never refers to missing ones
+  return WriteVirtualIndex(index_path, header, level_infos, page_ids);
+}
+
+bool TextureProcessor::EncodeConstant(const std::filesystem::path& out_path,
+                                      const astcenc_image& image,
+                                      const TextureConfig& texture_config) {
+  int block_x = texture_config.block_x;
+  int block_y = texture_config.block_y;
+  if (block_x == 0) {
+    block_x = faithful::config::kTexConstantBlockX;
+    block_y = faithful::config::kTexConstantBlockY;
+  }
+  int image_x = static_cast<int>(image.dim_x);
+  int image_y = static_cast<int>(image.dim_y);
+  int comp_len = CalculateCompLen(image_x, image_y, block_x, block_y);
+  MappedOutputFile out_file(out_path, sizeof(AstcHeader) + comp_len);
+  if (!out_file.IsOpen()) {
+    std::cerr << "Error: failed to create " << out_path << std::endl;
+    return false;
+  }
+  auto header = MakeAstcHeader(image_x, image_y, block_x, block_y);
+  std::memcpy(out_file.GetData(), &header, sizeof(AstcHeader));
+  uint8_t* comp_data = out_file.GetData() + sizeof(AstcHeader);
+  FillVoidExtent(image, texture_config.swizzle, comp_data, comp_len);
+  RunReport::AddPixels(static_cast<uint64_t>(image_x) * image_y);
+
+  if (verify_) {
+    TraceScope trace_scope("verify", out_path);
+    auto context = ProvideContext(texture_config.astc_config, block_x,
+                                  block_y, texture_config.quality);
+    VerifyEncodedData(out_path, image, texture_config, context,
+                      comp_data, comp_len);
+  }
+
+  return WriteEncodedData(out_file, out_path, comp_len);
+}
+
+TextureProcessor::TextureConfig TextureProcessor::ProvideAnalyzedTextureConfig(
+    const TextureConfig& texture_config, const ImageTraits& traits) {
+  auto category = texture_config.category;
+  /// emissive alpha isn't used anyway (rgb1)
+  bool is_opaque = traits.opaque || category == TextureCategory::kLdrRgb;
+  if ((category != TextureCategory::kLdrRgba &&
+       category != TextureCategory::kLdrRgb) ||
+      !is_opaque ||
+      (category == TextureCategory::kLdrRgb && !traits.grayscale)) {
+    return texture_config;
+  }
+  /// astcenc flags (e.g. perceptual weighting) stay the same
+  if (traits.grayscale) {
+    return {texture_config.out_path, faithful::config::kTextureSwizzleRrr1,
+            texture_config.astc_config, TextureCategory::kLdrR,
+            texture_config.type, texture_config.block_x,
+            texture_config.block_y, texture_config.quality,
+            texture_config.max_size};
+  }
+  return {texture_config.out_path, faithful::config::kTextureSwizzleRgb1,
+          texture_config.astc_config, TextureCategory::kLdrRgb,
+          texture_config.type, texture_config.block_x,
+          texture_config.block_y, texture_config.quality,
+          texture_config.max_size};
+}
+
+bool TextureProcessor::CompressImpl(const std::filesystem::path& out_path,
+                                    const astcenc_image& image,
+                                    const TextureConfig& texture_config) {
+  int block_x = texture_config.block_x;
+  int block_y = texture_config.block_y;
+  if (block_x == 0) {
+    block_x = faithful::config::kTexCompBlockX;
+    block_y = faithful::config::kTexCompBlockY;
+    if (auto_block_size_) {
+      TraceScope trace_scope("select_block_size", out_path);
+      std::tie(block_x, block_y) = SelectBlockSize(image, texture_config);
+    }
+  }
+  auto context = ProvideContext(texture_config.astc_config, block_x, block_y,
+                                texture_config.quality);
+  astcenc_compress_reset(context);
+
+  int image_x = static_cast<int>(image.dim_x);
+  int image_y = static_cast<int>(image.dim_y);
+  int comp_len = CalculateCompLen(image_x, image_y, block_x, block_y);
+  /// size is known, so astcenc compresses right into the mapped output
+  /// file after its header, without own buffer and copy
+  MappedOutputFile out_file(out_path, sizeof(AstcHeader) + comp_len);
+  if (!out_file.IsOpen()) {
+    std::cerr << "Error: failed to create " << out_path << std::endl;
+    return false;
+  }
+  auto header = MakeAstcHeader(image_x, image_y, block_x, block_y);
+  std::memcpy(out_file.GetData(), &header, sizeof(AstcHeader));
+  uint8_t* comp_data = out_file.GetData() + sizeof(AstcHeader);
+
+  // no need to make it atomic, only "fail"-thread write;
+  // order doesn't matter, need only true/false
+  bool encode_success = true;
+  {
+    TraceScope trace_scope("astcenc_compress", out_path);
+    trace_scope.SetBytesIn(static_cast<uint64_t>(image_x) * image_y *
+                           TexelSize(image.data_type));
+    trace_scope.SetBytesOut(comp_len);
+    thread_pool_.Execute(
+        [&, comp_len, comp_data_get = comp_data](int thread_id) {
+          astcenc_error status = astcenc_compress_image(
+              context, const_cast<astcenc_image*>(&image),
+              &texture_config.swizzle, comp_data_get, comp_len, thread_id);
+          if (status != ASTCENC_SUCCESS) {
+            encode_success = false;
+          }
+        });
+  }
 
   if (!encode_success) {
     std::cerr << "Error: texture compression failed for: "
               << out_path << std::endl;
-    return;
+    return false;
+  }
+  RunReport::AddPixels(static_cast<uint64_t>(image_x) * image_y);
+
+  if (verify_) {
+    TraceScope trace_scope("verify", out_path);
+    VerifyEncodedData(out_path, image, texture_config, context,
+                      comp_data, comp_len);
   }
 
-  WriteEncodedData(out_path, width, height, comp_len, std::move(comp_data));
+  return WriteEncodedData(out_file, out_path, comp_len);
 }
 
-void TextureProcessor::WriteEncodedData(
-    const std::filesystem::path& filename, int image_x, int image_y,
-    int comp_data_size, std::unique_ptr<uint8_t[]> comp_data) {
-  std::ofstream out_file(filename, std::ios::binary);
-  if (!out_file.is_open()) {
-    std::cerr << "Error: failed to create file for encoded data" << std::endl;
+void TextureProcessor::VerifyEncodedData(
+    const std::filesystem::path& out_path, const astcenc_image& image,
+    const TextureConfig& texture_config, astcenc_context* context,
+    const uint8_t* comp_data, int comp_len) {
+  int image_x = static_cast<int>(image.dim_x);
+  int image_y = static_cast<int>(image.dim_y);
+  std::size_t pixel_count = static_cast<std::size_t>(image_x) * image_y;
+  std::size_t image_size = pixel_count * TexelSize(image.data_type);
+  /// metrics are computed in float32 for hdr, so half floats are placed
+  /// into the upper half of buffers and expanded in place
+  bool is_half = image.data_type == ASTCENC_TYPE_F16;
+  std::size_t buffer_size = is_half ? image_size * 2 : image_size;
+
+  auto decoded_data = std::make_unique<uint8_t[]>(buffer_size);
+  auto decoded_data_ptr =
+      reinterpret_cast<void*>(decoded_data.get() + buffer_size - image_size);
+  astcenc_image decoded {
+      image.dim_x, image.dim_y, 1, image.data_type, &decoded_data_ptr
+  };
+  astcenc_decompress_reset(context);
+  // no need to make it atomic, only "fail"-thread write;
+  // order doesn't matter, need only true/false
+  bool decode_success = true;
+  thread_pool_.Execute([&](int thread_id) {
+    astcenc_error status = astcenc_decompress_image(
+        context, comp_data, comp_len, &decoded,
+        &faithful::config::kTextureSwizzleRgba, thread_id);
+    if (status != ASTCENC_SUCCESS) {
+      decode_success = false;
+    }
+  });
+
+  VerifyResult result{out_path.filename().string(), texture_config.category,
+                      {}, false};
+  if (!decode_success) {
+    std::cerr << "Error: verification decompression failed for: "
+              << out_path << std::endl;
+    verify_results_.push_back(std::move(result));
     return;
   }
+
+  /// identity swizzle on decompression, so compare with swizzled source
+  auto reference = std::make_unique<uint8_t[]>(buffer_size);
+  auto reference_texels = reference.get() + buffer_size - image_size;
+  std::copy_n(static_cast<const uint8_t*>(image.data[0]), image_size,
+              reference_texels);
+  ApplySwizzle(reference_texels, pixel_count, image.data_type,
+               texture_config.swizzle);
+  if (is_half) {
+    auto value_count = pixel_count * 4;
+    HalfToFloat(static_cast<const uint16_t*>(decoded_data_ptr),
+                reinterpret_cast<float*>(decoded_data.get()), value_count);
+    HalfToFloat(reinterpret_cast<const uint16_t*>(reference_texels),
+                reinterpret_cast<float*>(reference.get()), value_count);
+  }
+
+  std::array<bool, 4> channel_mask{
+      texture_config.swizzle.r < ASTCENC_SWZ_0,
+      texture_config.swizzle.g < ASTCENC_SWZ_0,
+      texture_config.swizzle.b < ASTCENC_SWZ_0,
+      texture_config.swizzle.a < ASTCENC_SWZ_0};
+  std::array<double, 4> errors;
+  double peak;
+  double min_psnr;
+  if (is_half) {
+    auto decoded_float = reinterpret_cast<const float*>(decoded_data.get());
+    auto reference_float = reinterpret_cast<const float*>(reference.get());
+    errors = SumSquaredErrors(decoded_float, reference_float, pixel_count);
+    peak = std::max(1.0f, MaxChannelValue(reference_float, pixel_count,
+                                          channel_mask));
+    result.quality.ssim = StructuralSimilarity(
+        decoded_float, reference_float, image_x, image_y, channel_mask, peak);
+    min_psnr = faithful::config::kTexVerifyMinPsnrHdr;
+  } else {
+    errors = SumSquaredErrors(decoded_data.get(), reference.get(), pixel_count);
+    peak = 255.0;
+    result.quality.ssim = StructuralSimilarity(
+        decoded_data.get(), reference.get(), image_x, image_y, channel_mask);
+    min_psnr = faithful::config::kTexVerifyMinPsnrLdr;
+  }
+  for (int c = 0; c < 4; ++c) {
+    result.quality.rmse[c] = std::sqrt(errors[c] / pixel_count);
+  }
+  result.quality.psnr = PsnrFromMse(
+      MeanSquaredError(errors, pixel_count, channel_mask), peak);
+  result.passed = result.quality.psnr >= min_psnr &&
+                  result.quality.ssim >= faithful::config::kTexVerifyMinSsim;
+  if (!result.passed) {
+    std::cerr << "Warning: texture failed verification: " << out_path
+              << " (psnr " << result.quality.psnr << ", ssim "
+              << result.quality.ssim << ")" << std::endl;
+  }
+  verify_results_.push_back(std::move(result));
+}
+
+bool TextureProcessor::WriteVerifyReport(
+    const std::filesystem::path& path) const {
+  std::ofstream report(path);
+  if (!report.is_open()) {
+    std::cerr << "Error: failed to create verify report: " << path << std::endl;
+    return false;
+  }
+  bool all_passed = true;
+  for (const auto& result : verify_results_) {
+    report << result.name << ';' << result.quality.psnr << ';'
+           << result.quality.rmse[0] << ';' << result.quality.rmse[1] << ';'
+           << result.quality.rmse[2] << ';' << result.quality.rmse[3] << ';'
+           << result.quality.ssim << ';'
+           << (result.passed ? "ok" : "FAILED") << ";\n";
+    all_passed = all_passed && result.passed;
+  }
+  return all_passed;
+}
+
+std::pair<int, int> TextureProcessor::SelectBlockSize(
+    const astcenc_image& image, const TextureConfig& texture_config) {
+  constexpr int kTileSize = faithful::config::kTexAutoBlockTileSize;
+  static_assert([]() {
+    for (const auto& [block_x, block_y] : faithful::config::kTexAutoBlockSizes) {
+      if (kTileSize % block_x != 0 || kTileSize % block_y != 0) {
+        return false;
+      }
+    }
+    return true;
+  }(), "kTexAutoBlockTileSize should be divisible by all block sizes");
+
+  const auto& candidates = faithful::config::kTexAutoBlockSizes;
+  int image_x = static_cast<int>(image.dim_x);
+  int image_y = static_cast<int>(image.dim_y);
+  int texel_size = TexelSize(image.data_type);
+  auto image_data = static_cast<const uint8_t*>(image.data[0]);
+
+  /// the tiles are stacked vertically into one sample image, so it's
+  /// still compressed by all threads at once; small images are taken as is
+  int tile_x = image_x;
+  int tile_y = image_y;
+  int grid_x = 1;
+  int grid_y = 1;
+  if (image_x > kTileSize && image_y > kTileSize) {
+    tile_x = tile_y = kTileSize;
+    grid_x = std::min(image_x / kTileSize, faithful::config::kTexAutoBlockTileGrid);
+    grid_y = std::min(image_y / kTileSize, faithful::config::kTexAutoBlockTileGrid);
+  }
+  int tile_count = grid_x * grid_y;
+  std::size_t row_size = static_cast<std::size_t>(tile_x) * texel_size;
+  std::size_t sample_size = row_size * tile_y * tile_count;
+
+  auto sample_data = std::make_unique<uint8_t[]>(sample_size);
+  for (int tile = 0; tile < tile_count; ++tile) {
+    /// evenly spread over the image (centers of grid cells)
+    int column = tile % grid_x;
+    int row = tile / grid_x;
+    int x0 = (image_x - tile_x) * (2 * column + 1) / (2 * grid_x);
+    int y0 = (image_y - tile_y) * (2 * row + 1) / (2 * grid_y);
+    for (int y = 0; y < tile_y; ++y) {
+      std::copy_n(image_data + (static_cast<std::size_t>(y0 + y) * image_x + x0)
+                      * texel_size,
+                  row_size,
+                  sample_data.get() + (static_cast<std::size_t>(tile) * tile_y + y)
+                      * row_size);
+    }
+  }
+
+  /// compressed data decoded with identity swizzle should match the
+  /// swizzled source, so we compare with it
+  auto reference = std::make_unique<uint8_t[]>(sample_size);
+  std::copy_n(sample_data.get(), sample_size, reference.get());
+  ApplySwizzle(reference.get(),
+               static_cast<std::size_t>(tile_x) * tile_y * tile_count,
+               image.data_type, texture_config.swizzle);
+
+  auto sample_data_ptr = reinterpret_cast<void*>(sample_data.get());
+  astcenc_image sample {
+      static_cast<unsigned int>(tile_x),
+      static_cast<unsigned int>(tile_y * tile_count),
+      1, image.data_type, &sample_data_ptr
+  };
+
+  /// from the largest block; the smallest is a fallback, so never tested
+  for (std::size_t i = candidates.size() - 1; i > 0; --i) {
+    auto [block_x, block_y] = candidates[i];
+    if (IsBlockSizeAcceptable(sample, reference, texture_config,
+                              block_x, block_y)) {
+      return {block_x, block_y};
+    }
+  }
+  return {candidates[0][0], candidates[0][1]};
+}
+
+bool TextureProcessor::IsBlockSizeAcceptable(
+    const astcenc_image& sample, const std::unique_ptr<uint8_t[]>& reference,
+    const TextureConfig& texture_config, int block_x, int block_y) {
+  auto context = ProvideContext(texture_config.astc_config, block_x, block_y,
+                                texture_config.quality);
+  int sample_x = static_cast<int>(sample.dim_x);
+  int sample_y = static_cast<int>(sample.dim_y);
+  std::size_t pixel_count = static_cast<std::size_t>(sample_x) * sample_y;
+
+  int comp_len = CalculateCompLen(sample_x, sample_y, block_x, block_y);
+  auto comp_data = std::make_unique<uint8_t[]>(comp_len);
+  auto decoded_data = std::make_unique<uint8_t[]>(
+      pixel_count * TexelSize(sample.data_type));
+  auto decoded_data_ptr = reinterpret_cast<void*>(decoded_data.get());
+  astcenc_image decoded {
+      sample.dim_x, sample.dim_y, 1, sample.data_type, &decoded_data_ptr
+  };
+
+  astcenc_compress_reset(context);
+  astcenc_decompress_reset(context);
+  // no need to make it atomic, only "fail"-thread write;
+  // order doesn't matter, need only true/false
+  bool success = true;
+  thread_pool_.Execute([&](int thread_id) {
+    astcenc_error status = astcenc_compress_image(
+        context, const_cast<astcenc_image*>(&sample), &texture_config.swizzle,
+        comp_data.get(), comp_len, thread_id);
+    if (status != ASTCENC_SUCCESS) {
+      success = false;
+    }
+  });
+  if (!success) {
+    return false;
+  }
+  thread_pool_.Execute([&](int thread_id) {
+    astcenc_error status = astcenc_decompress_image(
+        context, comp_data.get(), comp_len, &decoded,
+        &faithful::config::kTextureSwizzleRgba, thread_id);
+    if (status != ASTCENC_SUCCESS) {
+      success = false;
+    }
+  });
+  astcenc_compress_reset(context);
+  astcenc_decompress_reset(context);
+  if (!success) {
+    return false;
+  }
+
+  std::array<bool, 4> channel_mask{
+      texture_config.swizzle.r < ASTCENC_SWZ_0,
+      texture_config.swizzle.g < ASTCENC_SWZ_0,
+      texture_config.swizzle.b < ASTCENC_SWZ_0,
+      texture_config.swizzle.a < ASTCENC_SWZ_0};
+  if (sample.data_type == ASTCENC_TYPE_F16) {
+    auto errors = SumSquaredErrors(
+        HalvesToFloats(decoded_data.get(), pixel_count).get(),
+        HalvesToFloats(reference.get(), pixel_count).get(), pixel_count);
+    return MeanSquaredError(errors, pixel_count, channel_mask) <=
+           faithful::config::kTexAutoBlockMseHdr;
+  }
+  auto errors = SumSquaredErrors(decoded_data.get(), reference.get(),
+                                 pixel_count);
+  double psnr = PsnrFromMse(
+      MeanSquaredError(errors, pixel_count, channel_mask), 255.0);
+  switch (texture_config.category) {
+    case TextureCategory::kLdrR:
+      return psnr >= faithful::config::kTexAutoBlockPsnrR;
+    case TextureCategory::kLdrGb:
+      return psnr >= faithful::config::kTexAutoBlockPsnrGb;
+    case TextureCategory::kLdrRgb:
+      return psnr >= faithful::config::kTexAutoBlockPsnrRgb;
+    case TextureCategory::kLdrRgba:
+      return psnr >= faithful::config::kTexAutoBlockPsnrRgba;
+    case TextureCategory::kLdrRgNmap:
+      return psnr >= faithful::config::kTexAutoBlockPsnrRgNmap;
+    case TextureCategory::kHdrRgb:
+      break;
+  }
+  return false;
+}
+
+void TextureProcessor::ApplySwizzle(uint8_t* data, std::size_t pixel_count,
+                                    astcenc_type type,
+                                    const astcenc_swizzle& swizzle) {
+  const astcenc_swz components[4]{swizzle.r, swizzle.g, swizzle.b, swizzle.a};
+  auto apply = [&](auto* pixels, auto one) {
+    using T = std::remove_pointer_t<decltype(pixels)>;
+    for (std::size_t i = 0; i < pixel_count; ++i) {
+      T* pixel = pixels + i * 4;
+      T source[4]{pixel[0], pixel[1], pixel[2], pixel[3]};
+      for (int c = 0; c < 4; ++c) {
+        switch (components[c]) {
+          case ASTCENC_SWZ_0:
+            pixel[c] = T{0};
+            break;
+          case ASTCENC_SWZ_1:
+            pixel[c] = one;
+            break;
+          case ASTCENC_SWZ_Z: // only for decompression
+            break;
+          default:
+            pixel[c] = source[components[c]];
+        }
+      }
+    }
+  };
+  if (type == ASTCENC_TYPE_F16) {
+    apply(reinterpret_cast<uint16_t*>(data), uint16_t{0x3C00}); // 1.0
+  } else if (type == ASTCENC_TYPE_F32) {
+    apply(reinterpret_cast<float*>(data), 1.0f);
+  } else {
+    apply(data, uint8_t{255});
+  }
+}
+
+ImageTraits TextureProcessor::AnalyzeTexels(const astcenc_image& image) {
+  std::size_t pixel_count = static_cast<std::size_t>(image.dim_x) * image.dim_y;
+  if (image.data_type == ASTCENC_TYPE_F16) {
+    return AnalyzeImage(static_cast<const uint16_t*>(image.data[0]),
+                        pixel_count);
+  }
+  return AnalyzeImage(static_cast<const uint8_t*>(image.data[0]),
+                      pixel_count);
+}
+
+void TextureProcessor::FillVoidExtent(const astcenc_image& image,
+                                      const astcenc_swizzle& swizzle,
+                                      uint8_t* comp_data, int comp_len) {
+  bool is_half = image.data_type == ASTCENC_TYPE_F16;
+  uint8_t texel[8];
+  std::memcpy(texel, image.data[0], is_half ? 8 : 4);
+  ApplySwizzle(texel, 1, image.data_type, swizzle);
+
+  /// block mode 0x1FC, dynamic range bit (1 - hdr), reserved bits and
+  /// all-ones extent coordinates (constant for the whole texture),
+  /// then 4 x 16-bit color; little-endian
+  uint64_t mode = is_half ? 0xFFFFFFFFFFFFFFFCull : 0xFFFFFFFFFFFFFDFCull;
+  uint8_t block[16];
+  for (int i = 0; i < 8; ++i) {
+    block[i] = static_cast<uint8_t>(mode >> (8 * i));
+  }
+  for (int c = 0; c < 4; ++c) {
+    uint16_t value;
+    if (is_half) {
+      std::memcpy(&value, texel + c * sizeof(uint16_t), sizeof(value));
+    } else {
+      value = static_cast<uint16_t>(texel[c] * 257); // unorm8 -> unorm16
+    }
+    block[8 + c * 2] = static_cast<uint8_t>(value);
+    block[9 + c * 2] = static_cast<uint8_t>(value >> 8);
+  }
+  for (int offset = 0; offset < comp_len; offset += sizeof(block)) {
+    std::memcpy(comp_data + offset, block, sizeof(block));
+  }
+}
+
+AstcHeader TextureProcessor::MakeAstcHeader(int image_x, int image_y,
+                                            int block_x, int block_y) {
   AstcHeader header{};
   header.magic[0] = 0x13;
   header.magic[1] = 0xAB;
   header.magic[2] = 0xA1;
   header.magic[3] = 0x5C;
 
-  header.block_x = faithful::config::kTexCompBlockX;
-  header.block_y = faithful::config::kTexCompBlockY;
+  header.block_x = static_cast<uint8_t>(block_x);
+  header.block_y = static_cast<uint8_t>(block_y);
   header.block_z = 1;
 
   header.dim_x[2] = static_cast<uint8_t>(image_x >> 16);
@@ -219,104 +1418,344 @@ void TextureProcessor::WriteEncodedData(
   header.dim_z[0] = 1;
   header.dim_z[1] = 0;
   header.dim_z[2] = 0;
+  return header;
+}
+
+bool TextureProcessor::WriteEncodedData(MappedOutputFile& out_file,
+                                        const std::filesystem::path& filename,
+                                        int comp_data_size) {
+  TraceScope trace_scope("write_astc", filename);
+  trace_scope.SetBytesIn(comp_data_size);
+  trace_scope.SetBytesOut(sizeof(AstcHeader) + comp_data_size);
+  if (!out_file.Commit()) {
+    std::cerr << "Error: failed to write " << filename << std::endl;
+    return false;
+  }
+  RunReport::AddBytesOut(sizeof(AstcHeader) + comp_data_size);
+  return true;
+}
 
-  out_file.write(reinterpret_cast<const char*>(&header), sizeof(AstcHeader));
-  out_file.write(reinterpret_cast<const char*>(comp_data.get()), comp_data_size);
+void TextureProcessor::ExtractTile(const astcenc_image& level, int tile_x,
+                                   int tile_y, uint8_t* out) {
+  constexpr int kBorder = faithful::config::kTexVirtualTileBorder;
+  constexpr int kStoredSize =
+      faithful::config::kTexVirtualTileSize + 2 * kBorder;
+  int level_x = static_cast<int>(level.dim_x);
+  int level_y = static_cast<int>(level.dim_y);
+  int texel_size = TexelSize(level.data_type);
+  auto level_data = static_cast<const uint8_t*>(level.data[0]);
+  int x0 = tile_x * faithful::config::kTexVirtualTileSize - kBorder;
+  int y0 = tile_y * faithful::config::kTexVirtualTileSize - kBorder;
+  /// [inner_begin, inner_end) are inside of the level, so copied at once;
+  /// edge texels are repeated outside of it
+  int inner_begin = std::clamp(-x0, 0, kStoredSize);
+  int inner_end = std::clamp(level_x - x0, inner_begin, kStoredSize);
+  for (int y = 0; y < kStoredSize; ++y) {
+    auto row = level_data + static_cast<std::size_t>(
+                                std::clamp(y0 + y, 0, level_y - 1)) *
+                                level_x * texel_size;
+    uint8_t* out_row =
+        out + static_cast<std::size_t>(y) * kStoredSize * texel_size;
+    for (int x = 0; x < inner_begin; ++x) {
+      std::copy_n(row, texel_size, out_row + x * texel_size);
+    }
+    std::copy_n(row + static_cast<std::size_t>(x0 + inner_begin) * texel_size,
+                (inner_end - inner_begin) * texel_size,
+                out_row + inner_begin * texel_size);
+    auto last = row + static_cast<std::size_t>(level_x - 1) * texel_size;
+    for (int x = inner_end; x < kStoredSize; ++x) {
+      std::copy_n(last, texel_size, out_row + x * texel_size);
+    }
+  }
 }
 
-void TextureProcessor::Decode(const std::filesystem::path& path) {
+bool TextureProcessor::WriteVirtualIndex(
+    const std::filesystem::path& filename, const VirtualTextureHeader& header,
+    const std::vector<VirtualTextureLevel>& levels,
+    const std::vector<uint32_t>& page_ids) {
+  TraceScope trace_scope("write_virtual_index", filename);
+  std::size_t index_size = sizeof(VirtualTextureHeader) +
+                           levels.size() * sizeof(VirtualTextureLevel) +
+                           page_ids.size() * sizeof(uint32_t);
+  trace_scope.SetBytesOut(index_size);
+  AtomicFile atomic_file(filename);
+  std::ofstream out_file(atomic_file.GetTempPath(), std::ios::binary);
+  if (!out_file.is_open()) {
+    std::cerr << "Error: failed to create virtual texture index: "
+              << filename << std::endl;
+    return false;
+  }
+  out_file.write(reinterpret_cast<const char*>(&header),
+                 sizeof(VirtualTextureHeader));
+  out_file.write(reinterpret_cast<const char*>(levels.data()),
+                 static_cast<std::streamsize>(levels.size() *
+                                              sizeof(VirtualTextureLevel)));
+  out_file.write(reinterpret_cast<const char*>(page_ids.data()),
+                 static_cast<std::streamsize>(page_ids.size() *
+                                              sizeof(uint32_t)));
+  out_file.close();
+  if (!out_file || !atomic_file.Commit()) {
+    std::cerr << "Error: failed to write " << filename << std::endl;
+    return false;
+  }
+  RunReport::AddBytesOut(index_size);
+  return true;
+}
+
+bool TextureProcessor::WriteAtlasTable(const std::filesystem::path& filename,
+                                       int page_count,
+                                       const std::vector<AtlasEntry>& entries) {
+  TraceScope trace_scope("write_atlas", filename);
+  std::size_t table_size = sizeof(AtlasHeader) +
+                           entries.size() * sizeof(AtlasEntry);
+  trace_scope.SetBytesOut(table_size);
+  AtomicFile atomic_file(filename);
+  std::ofstream out_file(atomic_file.GetTempPath(), std::ios::binary);
+  if (!out_file.is_open()) {
+    std::cerr << "Error: failed to create atlas table: " << filename
+              << std::endl;
+    return false;
+  }
+  AtlasHeader header{};
+  header.magic[0] = 'F';
+  header.magic[1] = 'A';
+  header.magic[2] = 'T';
+  header.magic[3] = 'L';
+  header.page_count = static_cast<uint32_t>(page_count);
+  header.entry_count = static_cast<uint32_t>(entries.size());
+
+  out_file.write(reinterpret_cast<const char*>(&header), sizeof(AtlasHeader));
+  out_file.write(reinterpret_cast<const char*>(entries.data()),
+                 static_cast<std::streamsize>(entries.size() * sizeof(AtlasEntry)));
+  out_file.close();
+  if (!out_file || !atomic_file.Commit()) {
+    std::cerr << "Error: failed to write " << filename << std::endl;
+    return false;
+  }
+  RunReport::AddBytesOut(table_size);
+  return true;
+}
+
+bool TextureProcessor::Decode(const std::filesystem::path& path,
+                              bool* written) {
   auto texture_config = ProvideDecodeTextureConfig(path);
-  DecodeImpl(path, std::move(texture_config));
+  return DecodeImpl(path, std::move(texture_config), written);
 }
 
-void TextureProcessor::Decode(const std::filesystem::path& in_path,
+bool TextureProcessor::Decode(const std::filesystem::path& in_path,
                               const std::filesystem::path& out_path,
                               TextureCategory category) {
   auto texture_config = ProvideDecodeTextureConfig(category);
   texture_config.out_path = out_path;
-  DecodeImpl(in_path, std::move(texture_config));
+  return DecodeImpl(in_path, std::move(texture_config));
 }
 
-void TextureProcessor::DecodeImpl(
+bool TextureProcessor::DecodeImpl(
     const std::filesystem::path& path,
-    TextureProcessor::TextureConfig texture_config) {
-  if (!MakeReplaceRequest(texture_config.out_path)) {
-    return;
+    TextureProcessor::TextureConfig texture_config, bool* written) {
+  bool replace = MakeReplaceRequest(texture_config.out_path);
+  if (written) {
+    *written = replace;
   }
-  astcenc_decompress_reset(texture_config.context);
-
-  int image_x, image_y, comp_len;
+  if (!replace) {
+    return true;
+  }
+  int image_x, image_y, block_x, block_y, comp_len;
   std::unique_ptr<uint8_t[]> comp_data;
-  if (!ReadAstcFile(path, image_x, image_y, comp_len, comp_data)) {
-    return;
+  {
+    TraceScope trace_scope("read_astc", path);
+    if (!ReadAstcFile(path, image_x, image_y, block_x, block_y,
+                      comp_len, comp_data)) {
+      return false;
+    }
+    trace_scope.SetBytesIn(sizeof(AstcHeader) + comp_len);
+    trace_scope.SetBytesOut(comp_len);
   }
-
-  // for float (hdr) just x4 size, anyway casting to void* further
-  std::unique_ptr<uint8_t[]> image_data;
-  /// 4 channels
-  if (texture_config.category == TextureCategory::kHdrRgb) {
-    /// *4 because of float32
-    image_data = std::make_unique<uint8_t[]>(image_x * image_y * 4 * 4);
+  bool hdr = texture_config.category == TextureCategory::kHdrRgb;
+  TraceScope trace_scope(hdr ? "decode_hdr" : "decode_png", path);
+  trace_scope.SetBytesIn(comp_len);
+  bool decode_success;
+  if (hdr) {
+    HdrWriter writer(texture_config.out_path, image_x, image_y);
+    decode_success = DecodeStrips(path, writer, comp_data.get(), image_x,
+                                  image_y, block_x, block_y, texture_config);
   } else {
-    image_data = std::make_unique<uint8_t[]>(image_x * image_y * 4);
+    PngWriter writer(texture_config.out_path, image_x, image_y, png_level_);
+    decode_success = DecodeStrips(path, writer, comp_data.get(), image_x,
+                                  image_y, block_x, block_y, texture_config);
+  }
+  if (!decode_success) {
+    return false;
   }
+  RunReport::AddPixels(static_cast<uint64_t>(image_x) * image_y);
+  trace_scope.SetBytesOutFromFile(texture_config.out_path);
+  RunReport::AddBytesOutFromFile(texture_config.out_path);
+  return true;
+}
 
-  astcenc_image image {
-      static_cast<unsigned int>(image_x), static_cast<unsigned int>(image_y),
-      1, texture_config.type, reinterpret_cast<void**>(&image_data)
-  };
+template <typename Writer>
+bool TextureProcessor::DecodeStrips(const std::filesystem::path& path,
+                                    Writer& writer, const uint8_t* comp_data,
+                                    int image_x, int image_y,
+                                    int block_x, int block_y,
+                                    const TextureConfig& texture_config) {
+  if (!writer.IsOpen()) {
+    std::cerr << "Error: failed to create " << texture_config.out_path
+              << std::endl;
+    return false;
+  }
+  std::size_t row_size = static_cast<std::size_t>(image_x) *
+                         TexelSize(texture_config.type);
+  int strip_block_rows = static_cast<int>(std::max<std::size_t>(
+      1, faithful::config::kTexDecodeStripSize / (row_size * block_y)));
+  int strip_rows = strip_block_rows * block_y;
+  int strip_count = (image_y + strip_rows - 1) / strip_rows;
+  /// astc blocks are stored by rows, so strip is a continuous range
+  std::size_t strip_comp_len = static_cast<std::size_t>(
+      CalculateCompLen(image_x, strip_rows, block_x, block_y));
 
-  // no need to make it atomic, only "fail"-thread write;
-  // order doesn't matter, need only true/false
-  bool decode_success = true;
-  thread_pool_.Execute(
-      [&, comp_len, comp_data_get = comp_data.get()](int thread_id) {
+  /// strip i is kept in slots[i % slots.size()] until it's written
+  std::vector<typename Writer::Strip> slots(2 * thread_pool_.GetThreadNumber());
+  std::vector<char> encoded(slots.size(), 0);
+  std::mutex mu;
+  std::condition_variable slot_released;
+  /// guarded by mu
+  int next_write = 0;
+  bool writing = false;
+  bool failed = false;
+
+  std::atomic<int> next_strip{0};
+  thread_pool_.Execute([&](int thread_id) {
+    astcenc_context* context;
+    try {
+      context = ProvideBatchContext(texture_config.astc_config, thread_id,
+                                    block_x, block_y);
+    } catch (const std::exception& e) {
+      /// can't be rethrown from the pool worker
+      std::cerr << "Error: " << e.what() << std::endl;
+      std::lock_guard lock(mu);
+      failed = true;
+      slot_released.notify_all();
+      return;
+    }
+    std::vector<typename Writer::Component> decoded(
+        static_cast<std::size_t>(strip_rows) * image_x * 4);
+    for (int i = next_strip.fetch_add(1, std::memory_order_relaxed);
+         i < strip_count; i = next_strip.fetch_add(1, std::memory_order_relaxed)) {
+      {
+        std::unique_lock lock(mu);
+        slot_released.wait(lock, [&]() {
+          return failed ||
+                 i < next_write + static_cast<int>(slots.size());
+        });
+        if (failed) {
+          return;
+        }
+      }
+      auto& slot = slots[i % slots.size()];
+      int first_row = i * strip_rows;
+      int row_count = std::min(strip_rows, image_y - first_row);
+      {
+        TraceScope trace_scope("decode_strip", path);
+        auto decoded_ptr = reinterpret_cast<void*>(decoded.data());
+        astcenc_image image {
+            static_cast<unsigned int>(image_x),
+            static_cast<unsigned int>(row_count),
+            1, texture_config.type, &decoded_ptr
+        };
         astcenc_error status = astcenc_decompress_image(
-            texture_config.context, comp_data_get, comp_len,
-            &image, &texture_config.swizzle, thread_id);
+            context, comp_data + i * strip_comp_len,
+            CalculateCompLen(image_x, row_count, block_x, block_y),
+            &image, &texture_config.swizzle, 0);
         if (status != ASTCENC_SUCCESS) {
-          decode_success = false;
+          std::cerr << "Error: texture decompression failed for: " << path
+                    << std::endl;
+          std::lock_guard lock(mu);
+          failed = true;
+          slot_released.notify_all();
+          return;
         }
-      });
+        writer.EncodeStrip(decoded.data(), first_row, row_count, slot);
+        trace_scope.SetBytesOut(row_size * row_count);
+      }
 
-  if (!decode_success) {
-    std::cerr << "Error: texture decompression failed for: "
-              << path << std::endl;
-    return;
+      /// whoever has the next strip writes all consecutive encoded ones,
+      /// others continue with their strips meanwhile
+      std::unique_lock lock(mu);
+      encoded[i % slots.size()] = 1;
+      if (writing) {
+        continue;
+      }
+      writing = true;
+      while (!failed && encoded[next_write % slots.size()]) {
+        auto& next_slot = slots[next_write % slots.size()];
+        lock.unlock();
+        bool written = writer.WriteStrip(next_slot);
+        lock.lock();
+        if (!written) {
+          std::cerr << "Error: failed to write " << texture_config.out_path
+                    << std::endl;
+          failed = true;
+        }
+        encoded[next_write % slots.size()] = 0;
+        ++next_write;
+        slot_released.notify_all();
+      }
+      writing = false;
+    }
+  });
+  if (failed || next_write != strip_count) {
+    return false;
   }
+  TraceScope trace_scope("write_commit", texture_config.out_path);
+  return writer.Commit();
+}
 
-  WriteDecodedData(texture_config.out_path, image_x, image_y,
-                   texture_config.category, std::move(image_data));
+std::unique_ptr<float[]> TextureProcessor::HalvesToFloats(
+    const uint8_t* data, std::size_t pixel_count) {
+  auto floats = std::make_unique<float[]>(pixel_count * 4);
+  HalfToFloat(reinterpret_cast<const uint16_t*>(data), floats.get(),
+              pixel_count * 4);
+  return floats;
 }
 
-void TextureProcessor::WriteDecodedData(
-    const std::filesystem::path& filename, int image_x, int image_y,
-    TextureCategory category, std::unique_ptr<uint8_t[]> image_data) {
-  if (category != TextureCategory::kHdrRgb) {
-    if (!stbi_write_png(filename.c_str(), image_x, image_y, 4,
-                        image_data.get(), 4 * image_x)) {
-      std::cerr << "Error: stb_image_write failed to save texture" << std::endl;
-    }
-  } else {
-    if (!stbi_write_hdr(filename.c_str(), image_x, image_y, 4,
-                        reinterpret_cast<const float*>(image_data.get()))) {
-      std::cerr << "Error: stb_image_write failed to save texture" << std::endl;
-    }
+int TextureProcessor::CalculateCompLen(int image_x, int image_y,
+                                       int block_x, int block_y) {
+  int block_count_x = (image_x + block_x - 1) / block_x;
+  int block_count_y = (image_y + block_y - 1) / block_y;
+  return block_count_x * block_count_y * 16;
+}
+
+int TextureProcessor::TexelSize(astcenc_type type) {
+  switch (type) {
+    case ASTCENC_TYPE_U8:
+      return 4;
+    case ASTCENC_TYPE_F16:
+      return 4 * 2;
+    case ASTCENC_TYPE_F32:
+      return 4 * 4;
   }
+  return 4;
 }
 
-int TextureProcessor::CalculateCompLen(int image_x, int image_y) {
-  int block_count_x =
-      (image_x + faithful::config::kTexCompBlockX - 1)
-      / faithful::config::kTexCompBlockX;
-  int block_count_y =
-      (image_y + faithful::config::kTexCompBlockY - 1)
-      / faithful::config::kTexCompBlockY;
-  return block_count_x * block_count_y * 16;
+bool TextureProcessor::IsValidBlockSize(int block_x, int block_y,
+                                        int block_z) {
+  /// all 2d block footprints allowed by ASTC specification
+  static constexpr std::array<std::array<int, 2>, 14> kValidBlockSizes = {{
+      {4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6},
+      {8, 8}, {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12}
+  }};
+  if (block_z != 1) {
+    return false;
+  }
+  return std::find(kValidBlockSizes.begin(), kValidBlockSizes.end(),
+                   std::array<int, 2>{block_x, block_y}) !=
+         kValidBlockSizes.end();
 }
 
 bool TextureProcessor::ReadAstcFile(const std::string& path, int& width,
-                                    int& height, int& comp_len,
+                                    int& height, int& block_x, int& block_y,
+                                    int& comp_len,
                                     std::unique_ptr<uint8_t[]>& comp_data) {
   std::ifstream file(path, std::ios::binary);
   if (!file.is_open()) {
@@ -337,20 +1776,24 @@ bool TextureProcessor::ReadAstcFile(const std::string& path, int& width,
     return false;
   }
 
-  if (header.block_x != faithful::config::kTexCompBlockX ||
-      header.block_y != faithful::config::kTexCompBlockY ||
-      header.block_z != 1) {
-    std::cerr << "Error: file compressed by another astcenc is not supported: "
-              << path << std::endl;
+  if (!IsValidBlockSize(header.block_x, header.block_y, header.block_z)) {
+    std::cerr << "Error: invalid ASTC block size: " << path << std::endl;
+    return false;
+  }
+  /// astcenc is built with ASTCENC_BLOCK_MAX_TEXELS (see external/CMakeLists.txt)
+  if (header.block_x * header.block_y > faithful::config::kTexMaxBlockTexels) {
+    std::cerr << "Error: ASTC block size " << int{header.block_x} << "x"
+              << int{header.block_y} << " is not supported: " << path
+              << std::endl;
     return false;
   }
+  block_x = header.block_x;
+  block_y = header.block_y;
 
-  // we don't care about block sizes, because currently all textures compressed
-  // with the same configs (see Faithful/config/AssetFormats.h)
   width = header.dim_x[0] | header.dim_x[1] << 8 | header.dim_x[2] << 16;
   height = header.dim_y[0] | header.dim_y[1] << 8 | header.dim_y[2] << 16;
 
-  comp_len = CalculateCompLen(width, height);
+  comp_len = CalculateCompLen(width, height, block_x, block_y);
   comp_data = std::make_unique<uint8_t[]>(comp_len);
   file.read(reinterpret_cast<char*>(comp_data.get()), comp_len);
   return true;
@@ -364,16 +1807,71 @@ void TextureProcessor::SetDestinationDirectory(
   std::filesystem::create_directories(default_destination_path_);
   std::filesystem::create_directories(maps_destination_path_);
   std::filesystem::create_directories(noises_destination_path_);
+  for (const auto& profile : profiles_) {
+    std::filesystem::create_directories(path / profile.name / "maps");
+    std::filesystem::create_directories(path / profile.name / "noises");
+  }
+}
+
+bool TextureProcessor::ParseProfile(std::string_view text,
+                                    EncodeProfile& profile) {
+  std::vector<std::string> fields;
+  for (std::size_t begin = 0;;) {
+    auto end = text.find(':', begin);
+    fields.emplace_back(text.substr(begin, end - begin));
+    if (end == std::string_view::npos) {
+      break;
+    }
+    begin = end + 1;
+  }
+  if (fields.size() < 3 || fields.size() > 4) {
+    return false;
+  }
+  /// the name is a directory next to the category ones
+  profile.name = fields[0];
+  if (profile.name.empty() || profile.name.starts_with('.') ||
+      profile.name.find_first_of("/\\") != std::string::npos ||
+      profile.name == "maps" || profile.name == "noises" ||
+      profile.name == "models" || profile.name == "music" ||
+      profile.name == "sounds") {
+    return false;
+  }
+  if (fields[1] == "default") {
+    profile.block_x = profile.block_y = 0;
+  } else if (std::sscanf(fields[1].c_str(), "%dx%d", &profile.block_x,
+                         &profile.block_y) != 2 ||
+             !IsValidBlockSize(profile.block_x, profile.block_y, 1) ||
+             profile.block_x * profile.block_y >
+                 faithful::config::kTexMaxBlockTexels) {
+    return false;
+  }
+  char* end;
+  profile.quality = std::strtof(fields[2].c_str(), &end);
+  if (*end != '\0' || end == fields[2].c_str() || !(profile.quality >= 0.0f) ||
+      profile.quality > 100.0f) {
+    return false;
+  }
+  profile.max_size = 0;
+  if (fields.size() == 4) {
+    profile.max_size = static_cast<int>(std::strtol(fields[3].c_str(), &end, 10));
+    if (*end != '\0' || end == fields[3].c_str() || profile.max_size < 0) {
+      return false;
+    }
+  }
+  return true;
 }
 
 TextureProcessor::TextureConfig TextureProcessor::ProvideEncodeTextureConfig(
     const std::filesystem::path& path) {
   std::string out_filename = path.filename().replace_extension(".astc").string();
   if (HasMapPrefix(path)) {
+    if (virtual_maps_) {
+      out_filename = path.filename().replace_extension(".vt").string();
+    }
     return {
         (maps_destination_path_ / std::move(out_filename)).string(),
         faithful::config::kTextureSwizzleRrr1,
-        context_ldr_,
+        faithful::config::kTextureConfigLdr,
         TextureCategory::kLdrR,
         faithful::config::kTexLdrDataType
     };
@@ -381,7 +1879,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideEncodeTextureConfig(
     return {
         (noises_destination_path_ / std::move(out_filename)).string(),
         faithful::config::kTextureSwizzleRrr1,
-        context_ldr_,
+        faithful::config::kTextureConfigLdr,
         TextureCategory::kLdrR,
         faithful::config::kTexLdrDataType
     };
@@ -389,7 +1887,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideEncodeTextureConfig(
     return {
         (default_destination_path_ / std::move(out_filename)).string(),
         faithful::config::kTextureSwizzleRrr1,
-        context_ldr_,
+        faithful::config::kTextureConfigLdr,
         TextureCategory::kLdrR,
         faithful::config::kTexLdrDataType
     };
@@ -398,7 +1896,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideEncodeTextureConfig(
     return {
         (default_destination_path_ / std::move(out_filename)).string(),
         faithful::config::kTextureSwizzleRgb1,
-        context_hdr_,
+        faithful::config::kTextureConfigHdr,
         TextureCategory::kHdrRgb,
         faithful::config::kTexHdrDataType
     };
@@ -406,7 +1904,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideEncodeTextureConfig(
     return {
         (default_destination_path_ / std::move(out_filename)).string(),
         faithful::config::kTextureSwizzleRgba,
-        context_ldr_alpha_perceptual_,
+        faithful::config::kTextureConfigLdrAlphaPerceptual,
         TextureCategory::kLdrRgba,
         faithful::config::kTexLdrDataType
     };
@@ -420,7 +1918,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideEncodeTextureConfig(
       return {
           "",
           faithful::config::kTextureSwizzleRrr1,
-          context_ldr_,
+          faithful::config::kTextureConfigLdr,
           category,
           faithful::config::kTexLdrDataType
       };
@@ -428,7 +1926,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideEncodeTextureConfig(
       return {
           "",
           faithful::config::kTextureSwizzleGggb,
-          context_ldr_,
+          faithful::config::kTextureConfigLdr,
           category,
           faithful::config::kTexLdrDataType
       };
@@ -436,7 +1934,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideEncodeTextureConfig(
       return {
           "",
           faithful::config::kTextureSwizzleRgb1,
-          context_ldr_,
+          faithful::config::kTextureConfigLdr,
           category,
           faithful::config::kTexLdrDataType
       };
@@ -444,7 +1942,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideEncodeTextureConfig(
       return {
           "",
           faithful::config::kTextureSwizzleRgba,
-          context_ldr_alpha_perceptual_,
+          faithful::config::kTextureConfigLdrAlphaPerceptual,
           category,
           faithful::config::kTexLdrDataType
       };
@@ -452,7 +1950,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideEncodeTextureConfig(
       return {
           "",
           faithful::config::kTextureSwizzleRrrg,
-          context_ldr_normal_,
+          faithful::config::kTextureConfigLdrNormal,
           category,
           faithful::config::kTexLdrDataType
       };
@@ -460,7 +1958,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideEncodeTextureConfig(
       return {
           "",
           faithful::config::kTextureSwizzleRgb1,
-          context_hdr_,
+          faithful::config::kTextureConfigHdr,
           category,
           faithful::config::kTexHdrDataType
       };
@@ -474,7 +1972,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideDecodeTextureConfig(
     return {
         (maps_destination_path_ / std::move(out_filename)).string(),
         faithful::config::kTextureSwizzleRrr1,
-        context_ldr_,
+        faithful::config::kTextureConfigLdr,
         TextureCategory::kLdrR,
         faithful::config::kTexLdrDataType
     };
@@ -482,7 +1980,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideDecodeTextureConfig(
     return {
         (noises_destination_path_ / std::move(out_filename)).string(),
         faithful::config::kTextureSwizzleRrr1,
-        context_ldr_,
+        faithful::config::kTextureConfigLdr,
         TextureCategory::kLdrR,
         faithful::config::kTexLdrDataType
     };
@@ -490,7 +1988,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideDecodeTextureConfig(
     return {
         (default_destination_path_ / std::move(out_filename)).string(),
         faithful::config::kTextureSwizzleRrr1,
-        context_ldr_,
+        faithful::config::kTextureConfigLdr,
         TextureCategory::kLdrR,
         faithful::config::kTexLdrDataType
     };
@@ -500,7 +1998,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideDecodeTextureConfig(
     return {
         (default_destination_path_ / std::move(out_filename)).string(),
         faithful::config::kTextureSwizzleRgb1,
-        context_hdr_,
+        faithful::config::kTextureConfigHdr,
         TextureCategory::kHdrRgb,
         faithful::config::kTexHdrDataType
     };
@@ -508,7 +2006,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideDecodeTextureConfig(
     return {
         (default_destination_path_ / std::move(out_filename)).string(),
         faithful::config::kTextureSwizzleRgba,
-        context_ldr_,
+        faithful::config::kTextureConfigLdr,
         TextureCategory::kLdrRgba,
         faithful::config::kTexLdrDataType
     };
@@ -524,7 +2022,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideDecodeTextureConfig(
       return {
           "",
           faithful::config::kTextureSwizzleRgba,
-          context_ldr_,
+          faithful::config::kTextureConfigLdr,
           category,
           faithful::config::kTexLdrDataType
       };
@@ -532,7 +2030,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideDecodeTextureConfig(
       return {
           "",
           faithful::config::kTextureSwizzle0ra1,
-          context_ldr_,
+          faithful::config::kTextureConfigLdr,
           category,
           faithful::config::kTexLdrDataType
       };
@@ -540,7 +2038,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideDecodeTextureConfig(
       return {
           "",
           faithful::config::kTextureSwizzleRgba,
-          context_ldr_,
+          faithful::config::kTextureConfigLdr,
           category,
           faithful::config::kTexLdrDataType
       };
@@ -548,7 +2046,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideDecodeTextureConfig(
       return {
           "",
           faithful::config::kTextureSwizzleRaz1,
-          context_ldr_,
+          faithful::config::kTextureConfigLdr,
           category,
           faithful::config::kTexLdrDataType
       };
@@ -556,7 +2054,7 @@ TextureProcessor::TextureConfig TextureProcessor::ProvideDecodeTextureConfig(
       return {
           "",
           faithful::config::kTextureSwizzleRgba,
-          context_hdr_,
+          faithful::config::kTextureConfigHdr,
           category,
           faithful::config::kTexHdrDataType
       };
@@ -589,7 +2087,13 @@ bool TextureProcessor::HasHdrExtension(const std::filesystem::path& path) {
 
 bool TextureProcessor::MakeReplaceRequest(
     const std::filesystem::path& filename) {
-  if (std::filesystem::exists(filename)) {
+  return MakeReplaceRequest(filename,
+                            batch_io_.Stat({filename}).front().exists);
+}
+
+bool TextureProcessor::MakeReplaceRequest(
+    const std::filesystem::path& filename, bool exists) {
+  if (exists) {
     std::string request{filename};
     request += "\nalready exist. Do you want to replace it?";
     if (!replace_request_(std::move(request))) {
@@ -1,13 +1,27 @@
 #ifndef FAITHFUL_UTILS_ASSETPROCESSOR_TEXTUREPROCESSOR_H
 #define FAITHFUL_UTILS_ASSETPROCESSOR_TEXTUREPROCESSOR_H
 
+#include <compare>
 #include <filesystem>
+#include <map>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include "astc-encoder/Source/astcenc.h"
 
+#include "../config/AssetFormats.h"
 #include "AssetLoadingThreadPool.h"
+#include "AssetTimings.h"
+#include "BatchFileWriter.h"
+#include "BatchIo.h"
+#include "HdrWriter.h"
+#include "ImageAnalysis.h"
+#include "ImageMetrics.h"
+#include "MappedOutputFile.h"
+#include "PngWriter.h"
 #include "ReplaceRequest.h"
 
 struct AstcHeader {
@@ -20,6 +34,51 @@ struct AstcHeader {
   uint8_t dim_z[3];
 };
 
+/// uv rect table of an atlas (<name>.atlas), so it can be loaded by one read:
+/// AtlasHeader and then entry_count of AtlasEntry sorted by name;
+/// pages are <name>_<page>.astc
+struct AtlasHeader {
+  uint8_t magic[4]; // format identifier
+  uint32_t page_count;
+  uint32_t entry_count;
+};
+
+struct AtlasEntry {
+  char name[48]; // source filename without extension, null-terminated
+  uint32_t page;
+  uint16_t x; // texels, without padding
+  uint16_t y;
+  uint16_t width;
+  uint16_t height;
+  float uv[4]; // u0, v0, u1, v1
+};
+
+/// page table of a virtual texture (<name>.vtidx), so it can be loaded by
+/// one read: VirtualTextureHeader, level_count of VirtualTextureLevel (from
+/// the biggest one), then page ids (uint32_t) of tiles_y * tiles_x tiles
+/// of each level, row by row; page p of <name>.vt is ASTC blocks (without
+/// header) of one tile at p * page_size, identical constant tiles share
+/// the same page
+struct VirtualTextureHeader {
+  uint8_t magic[4]; // format identifier
+  uint32_t width; // of level 0
+  uint32_t height;
+  uint16_t tile_size; // texels, without border
+  uint16_t tile_border; // texels on each side
+  uint8_t block_x;
+  uint8_t block_y;
+  uint16_t level_count;
+  uint32_t page_size; // bytes, multiple of kTexVirtualPageAlignment
+  uint32_t page_count;
+};
+
+struct VirtualTextureLevel {
+  uint32_t width;
+  uint32_t height;
+  uint32_t tiles_x;
+  uint32_t tiles_y;
+};
+
 class TextureProcessor {
  public:
   enum class TextureCategory {
@@ -31,8 +90,29 @@ class TextureProcessor {
     kHdrRgb
   };
 
+  struct VerifyResult {
+    std::string name;
+    TextureCategory category;
+    ImageQuality quality;
+    bool passed;
+  };
+
+  /// one more output of each standalone texture (--profile), e.g. for
+  /// another platform: written into <destination>/<name>/ with the same
+  /// hierarchy (maps/, noises/)
+  struct EncodeProfile {
+    std::string name;
+    /// 0 - the same as without profiles (default or auto block size)
+    int block_x{0};
+    int block_y{0};
+    /// astcenc quality, 0 (fastest) - 100 (exhaustive)
+    float quality{0.0f};
+    /// downscaled by halving until both sides fit, 0 - no limit
+    int max_size{0};
+  };
+
   TextureProcessor() = delete;
-  TextureProcessor(AssetLoadingThreadPool& thread_pool,
+  TextureProcessor(AssetLoadingThreadPool& thread_pool, BatchIo& batch_io,
                    ReplaceRequest& replace_request);
 
   /// non-assignable because of member reference
@@ -44,51 +124,261 @@ class TextureProcessor {
 
   ~TextureProcessor();
 
-  void Encode(const std::filesystem::path& path);
+  /// all Encode*()/Decode() return false if texture wasn't written
+  /// (declined replace request isn't a failure); written (if not nullptr)
+  /// tells whether it was actually written, not declined
+  bool Encode(const std::filesystem::path& path, bool* written = nullptr);
 
   /// used by ModelProcessor
-  void Encode(const std::filesystem::path& out_path,
+  bool Encode(const std::filesystem::path& out_path,
               std::unique_ptr<uint8_t[]> image_data,
               int width, int height,
               TextureCategory category);
 
-  void Decode(const std::filesystem::path& path);
+  /// small ldr texture (see kTexBatchMaxPixels) which is cheaper to encode
+  /// by EncodeBatch(); never with auto block size or verify, because
+  /// they need the whole thread pool per texture, nor with profiles
+  bool IsBatchCandidate(const std::filesystem::path& path) const;
+
+  /// each thread compresses whole images on its own single-thread context,
+  /// so there is one thread_pool_.Execute() for all of them instead of one
+  /// per image; existing destinations are found by one BatchIo::Stat(),
+  /// files are written by BatchFileWriter;
+  /// paths must be IsBatchCandidate() ones, it doesn't check it (others
+  /// go through Encode());
+  /// returns paths which are done: written or declined by replace request
+  /// (failed ones and ones with "hdr_" prefix aren't)
+  std::vector<std::filesystem::path> EncodeBatch(
+      const std::vector<std::filesystem::path>& paths);
+
+  /// name of the atlas for small "font_" and other ldr textures
+  /// (see kTexAtlas* in config/AssetFormats.h), empty if it isn't packed
+  std::string GetAtlasName(const std::filesystem::path& path) const;
+
+  /// packs textures into pages, compresses each page once
+  /// and writes uv rect table
+  bool EncodeAtlas(const std::string& name,
+                   std::vector<std::filesystem::path> paths);
+
+  bool Decode(const std::filesystem::path& path, bool* written = nullptr);
 
   /// used by ModelProcessor
-  void Decode(const std::filesystem::path& in_path,
+  bool Decode(const std::filesystem::path& in_path,
               const std::filesystem::path& out_path,
               TextureCategory category);
 
   void SetDestinationDirectory(const std::filesystem::path& path);
 
+  /// try several block sizes on a sample of the image and take the largest
+  /// which is still good enough (see kTexAutoBlock* in config/AssetFormats.h)
+  void SetAutoBlockSize(bool enabled) {
+    auto_block_size_ = enabled;
+  }
+
+  /// decompress each encoded texture in memory and compare with the source
+  void SetVerify(bool enabled) {
+    verify_ = enabled;
+  }
+
+  /// EncodeBatch() records time of each texture (nullptr - not measured)
+  void SetTimings(AssetTimings* timings) {
+    timings_ = timings;
+  }
+
+  /// zlib level of decoded .png, 0 is store-only
+  void SetPngLevel(int level) {
+    png_level_ = level;
+  }
+
+  /// pack small textures into atlases (see GetAtlasName())
+  void SetAtlas(bool enabled) {
+    atlas_ = enabled;
+  }
+
+  /// "font_" textures are converted into signed distance fields and halved
+  /// until they fit into max_size (0 - disabled), see MakeDistanceField()
+  void SetFontSdf(int max_size) {
+    font_sdf_size_ = max_size;
+  }
+
+  /// write "map_" textures as virtual textures (.vt pages + .vtidx page
+  /// table) instead of single .astc, see EncodeVirtual()
+  void SetVirtualMaps(bool enabled) {
+    virtual_maps_ = enabled;
+  }
+
+  /// instead of the default output, each standalone texture is loaded once
+  /// and encoded for every profile one after another (each compression
+  /// uses the whole thread pool); textures of models, atlases keep default
+  void SetProfiles(std::vector<EncodeProfile> profiles) {
+    profiles_ = std::move(profiles);
+  }
+
+  const std::vector<EncodeProfile>& GetProfiles() const {
+    return profiles_;
+  }
+
+  /// <name>:<block>:<quality>[:<max_size>], e.g. "mobile:6x6:60:1024",
+  /// block is WxH or "default"; returns false if it's malformed
+  static bool ParseProfile(std::string_view text, EncodeProfile& profile);
+
+  const std::vector<VerifyResult>& GetVerifyResults() const {
+    return verify_results_;
+  }
+
+  /// one line per texture: name;psnr;rmse_r;rmse_g;rmse_b;rmse_a;ssim;status;
+  /// returns false if at least one texture failed verification
+  bool WriteVerifyReport(const std::filesystem::path& path) const;
+
  private:
   struct TextureConfig {
     std::string out_path;
     astcenc_swizzle swizzle;
-    astcenc_context*& context;
+    /// profile & flags; block size is chosen per texture
+    const astcenc_config& astc_config;
     TextureCategory category;
     astcenc_type type;
+    /// of the encode profile, see EncodeProfile
+    int block_x{0};
+    int block_y{0};
+    float quality{faithful::config::kTexCompQuality};
+    int max_size{0};
+  };
+
+  /// contexts are created lazily for each used block size & quality
+  struct ContextKey {
+    astcenc_profile profile;
+    unsigned int flags;
+    int block_x;
+    int block_y;
+    float quality;
+
+    auto operator<=>(const ContextKey&) const = default;
   };
 
   void InitContexts();
   void DeInitContexts();
 
-  void InitContext(astcenc_config config, astcenc_context*& context);
+  astcenc_context* InitContext(const astcenc_config& config,
+                               int block_x, int block_y, float quality,
+                               int thread_count);
+  astcenc_context* ProvideContext(const astcenc_config& config,
+                                  int block_x, int block_y, float quality);
+  /// single-thread context of the thread_id (for EncodeBatch,
+  /// DecodeStrips)
+  astcenc_context* ProvideBatchContext(const astcenc_config& config,
+                                       int thread_id,
+                                       int block_x, int block_y);
 
+  /// single file, existence by BatchIo::Stat() too
   bool MakeReplaceRequest(const std::filesystem::path& filename);
+  /// when existence is already known (batch stat)
+  bool MakeReplaceRequest(const std::filesystem::path& filename, bool exists);
+
+  /// rrr1 distance field of the glyph mask (red channel) at full resolution,
+  /// spread in its texels; exact euclidean distances to the nearest texel
+  /// of the other side by two transforms (outside, then inside) of one
+  /// float grid, columns and then rows split between pool threads
+  std::unique_ptr<uint8_t[]> MakeDistanceField(const astcenc_image& image,
+                                               int spread);
+
+  /// output config of each profile (the only default one without them)
+  std::vector<TextureConfig> ProvideProfileTextureConfigs(
+      const TextureConfig& texture_config) const;
+
+  /// halves image (in parallel) until it fits into max_size, levels are
+  /// cached in mips, so profiles with different max_size share them;
+  /// returns image itself if it already fits
+  astcenc_image DownscaleToFit(const astcenc_image& image, int max_size,
+                               std::vector<std::unique_ptr<uint8_t[]>>& mips,
+                               std::vector<void*>& mip_pointers);
 
-  void DecodeImpl(const std::filesystem::path& path,
-                  TextureConfig texture_config);
+  /// pixels are analyzed first: constant image is written as void-extent
+  /// blocks, the rest is compressed with ProvideAnalyzedTextureConfig()
+  bool EncodeImpl(const std::filesystem::path& out_path,
+                  const astcenc_image& image,
+                  const TextureConfig& texture_config);
+  /// tiles of all mip levels: analyzed (constant ones share a page of
+  /// void-extent blocks), then compressed in parallel, each thread on its
+  /// own single-thread context right into the mapped .vt at the tile's page
+  bool EncodeVirtual(const std::filesystem::path& out_path,
+                     const astcenc_image& image,
+                     const TextureConfig& texture_config);
+  bool EncodeConstant(const std::filesystem::path& out_path,
+                      const astcenc_image& image,
+                      const TextureConfig& texture_config);
+  bool CompressImpl(const std::filesystem::path& out_path,
+                    const astcenc_image& image,
+                    const TextureConfig& texture_config);
 
-  static void WriteEncodedData(const std::filesystem::path& filename,
-                               int image_x, int image_y, int comp_data_size,
-                               std::unique_ptr<uint8_t[]> comp_data);
-  static void WriteDecodedData(const std::filesystem::path& filename,
-                               int image_x,
-                               int image_y, TextureCategory category,
-                               std::unique_ptr<uint8_t[]> image_data);
+  /// opaque rgba is compressed as rgb1, opaque grayscale (or grayscale
+  /// emissive) as rrr1; other categories have special channels, so they
+  /// are returned as is
+  TextureConfig ProvideAnalyzedTextureConfig(
+      const TextureConfig& texture_config, const ImageTraits& traits);
+  bool DecodeImpl(const std::filesystem::path& path,
+                  TextureConfig texture_config, bool* written = nullptr);
 
-  static int CalculateCompLen(int image_x, int image_y);
+  bool EncodeBatchImage(const std::filesystem::path& path,
+                        const TextureConfig& texture_config,
+                        int thread_id, BatchFileWriter& writer);
+
+  void VerifyEncodedData(const std::filesystem::path& out_path,
+                         const astcenc_image& image,
+                         const TextureConfig& texture_config,
+                         astcenc_context* context,
+                         const uint8_t* comp_data, int comp_len);
+
+  std::pair<int, int> SelectBlockSize(const astcenc_image& image,
+                                      const TextureConfig& texture_config);
+  bool IsBlockSizeAcceptable(const astcenc_image& sample,
+                             const std::unique_ptr<uint8_t[]>& reference,
+                             const TextureConfig& texture_config,
+                             int block_x, int block_y);
+
+  static AstcHeader MakeAstcHeader(int image_x, int image_y,
+                                   int block_x, int block_y);
+  static ImageTraits AnalyzeTexels(const astcenc_image& image);
+  /// comp_len bytes of void-extent blocks with the (swizzled) first texel;
+  /// unorm16 color for ldr, half floats for hdr
+  static void FillVoidExtent(const astcenc_image& image,
+                             const astcenc_swizzle& swizzle,
+                             uint8_t* comp_data, int comp_len);
+  /// publishes the file, header and data are already inside
+  static bool WriteEncodedData(MappedOutputFile& out_file,
+                               const std::filesystem::path& filename,
+                               int comp_data_size);
+  /// tile with borders (clamped at edges) of the level
+  static void ExtractTile(const astcenc_image& level, int tile_x, int tile_y,
+                          uint8_t* out);
+  static bool WriteVirtualIndex(const std::filesystem::path& filename,
+                                const VirtualTextureHeader& header,
+                                const std::vector<VirtualTextureLevel>& levels,
+                                const std::vector<uint32_t>& page_ids);
+  static bool WriteAtlasTable(const std::filesystem::path& filename,
+                              int page_count,
+                              const std::vector<AtlasEntry>& entries);
+  /// block rows are decompressed by strips (about kTexDecodeStripSize
+  /// bytes) and handed to writer (PngWriter or HdrWriter) right away:
+  /// each thread decompresses & encodes whole strips on its own
+  /// single-thread context, the one which finished the next strip in order
+  /// writes it; no more than 2 strips per thread are kept, so memory depends
+  /// only on width, not on height
+  template <typename Writer>
+  bool DecodeStrips(const std::filesystem::path& path, Writer& writer,
+                    const uint8_t* comp_data, int image_x, int image_y,
+                    int block_x, int block_y,
+                    const TextureConfig& texture_config);
+
+  /// hdr (ASTCENC_TYPE_F16) texels for ImageMetrics
+  static std::unique_ptr<float[]> HalvesToFloats(const uint8_t* data,
+                                                 std::size_t pixel_count);
+  static int CalculateCompLen(int image_x, int image_y,
+                              int block_x, int block_y);
+  static int TexelSize(astcenc_type type);
+  static bool IsValidBlockSize(int block_x, int block_y, int block_z);
+  static void ApplySwizzle(uint8_t* data, std::size_t pixel_count,
+                           astcenc_type type, const astcenc_swizzle& swizzle);
 
   TextureConfig ProvideEncodeTextureConfig(const std::filesystem::path& path);
   TextureConfig ProvideEncodeTextureConfig(TextureCategory category);
@@ -96,7 +386,8 @@ class TextureProcessor {
   TextureConfig ProvideDecodeTextureConfig(TextureCategory category);
 
   static bool ReadAstcFile(const std::string& path, int& width, int& height,
-                           int& comp_len, std::unique_ptr<uint8_t[]>& comp_data);
+                           int& block_x, int& block_y, int& comp_len,
+                           std::unique_ptr<uint8_t[]>& comp_data);
 
   static bool HasMapPrefix(const std::filesystem::path& path);
   static bool HasNoisePrefix(const std::filesystem::path& path);
@@ -105,12 +396,24 @@ class TextureProcessor {
   static bool HasHdrExtension(const std::filesystem::path& path);
 
   AssetLoadingThreadPool& thread_pool_;
+  BatchIo& batch_io_;
   ReplaceRequest& replace_request_;
+  /// zlib level of PngWriter
+  int png_level_;
+
+  std::map<ContextKey, astcenc_context*> contexts_;
+  /// per thread_id, allocated by that thread, so its working buffers
+  /// are local to the thread's NUMA node
+  std::vector<std::map<ContextKey, astcenc_context*>> batch_contexts_;
 
-  astcenc_context* context_ldr_ = nullptr;
-  astcenc_context* context_hdr_ = nullptr;
-  astcenc_context* context_ldr_normal_ = nullptr;
-  astcenc_context* context_ldr_alpha_perceptual_ = nullptr;
+  bool auto_block_size_{false};
+  bool verify_{false};
+  bool atlas_{false};
+  bool virtual_maps_{false};
+  int font_sdf_size_{0};
+  AssetTimings* timings_{nullptr};
+  std::vector<EncodeProfile> profiles_;
+  std::vector<VerifyResult> verify_results_;
 
   std::filesystem::path default_destination_path_;
   std::filesystem::path maps_destination_path_;
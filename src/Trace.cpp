@@ -0,0 +1,198 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "rapidjson/ostreamwrapper.h"
+#include "rapidjson/writer.h"
+
+namespace {
+
+/// ~7 mb per thread (only when tracing is enabled)
+constexpr std::size_t kEventsPerThread = 1 << 16;
+
+struct ThreadBuffer {
+  int thread_id;
+  /// total number of recorded events, ring position is recorded % size
+  std::size_t recorded{0};
+  std::unique_ptr<TraceEvent[]> events;
+};
+
+/// buffers outlive their threads, so they're owned here
+std::mutex buffers_mutex;
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+thread_local ThreadBuffer* thread_buffer = nullptr;
+
+ThreadBuffer* ProvideThreadBuffer() {
+  if (!thread_buffer) {
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->events = std::make_unique<TraceEvent[]>(kEventsPerThread);
+    std::lock_guard lock(buffers_mutex);
+    buffer->thread_id = static_cast<int>(buffers.size());
+    thread_buffer = buffer.get();
+    buffers.push_back(std::move(buffer));
+  }
+  return thread_buffer;
+}
+
+}  // namespace
+
+std::atomic<bool> Trace::enabled_{false};
+
+void Trace::Enable() {
+  ProvideThreadBuffer();
+  enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Trace::Record(const TraceEvent& event) {
+  auto buffer = ProvideThreadBuffer();
+  buffer->events[buffer->recorded % kEventsPerThread] = event;
+  ++buffer->recorded;
+}
+
+bool Trace::Write(const std::filesystem::path& path) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    std::cerr << "Error: failed to create trace file: " << path << std::endl;
+    return false;
+  }
+  std::lock_guard lock(buffers_mutex);
+
+  /// timestamps relative to the first event, so they're easier to read
+  int64_t time_base = std::numeric_limits<int64_t>::max();
+  std::size_t lost_events = 0;
+  for (const auto& buffer : buffers) {
+    std::size_t count = std::min(buffer->recorded, kEventsPerThread);
+    for (std::size_t i = 0; i < count; ++i) {
+      time_base = std::min(time_base, buffer->events[i].start_us);
+    }
+    lost_events += buffer->recorded - count;
+  }
+
+  rapidjson::OStreamWrapper stream(file);
+  rapidjson::Writer<rapidjson::OStreamWrapper> writer(stream);
+  writer.StartObject();
+  writer.Key("displayTimeUnit");
+  writer.String("ms");
+  writer.Key("traceEvents");
+  writer.StartArray();
+  for (const auto& buffer : buffers) {
+    writer.StartObject();
+    writer.Key("name");
+    writer.String("thread_name");
+    writer.Key("ph");
+    writer.String("M");
+    writer.Key("pid");
+    writer.Int(1);
+    writer.Key("tid");
+    writer.Int(buffer->thread_id);
+    writer.Key("args");
+    writer.StartObject();
+    writer.Key("name");
+    /// registered by Enable()
+    std::string thread_name = buffer->thread_id == 0
+        ? "main" : "thread " + std::to_string(buffer->thread_id);
+    writer.String(thread_name.c_str());
+    writer.EndObject();
+    writer.EndObject();
+
+    /// from the oldest to the newest
+    std::size_t count = std::min(buffer->recorded, kEventsPerThread);
+    std::size_t first = buffer->recorded - count;
+    for (std::size_t i = first; i < buffer->recorded; ++i) {
+      const auto& event = buffer->events[i % kEventsPerThread];
+      writer.StartObject();
+      writer.Key("name");
+      writer.String(event.name);
+      writer.Key("cat");
+      writer.String("faithful");
+      writer.Key("ph");
+      writer.String("X");
+      writer.Key("ts");
+      writer.Int64(event.start_us - time_base);
+      writer.Key("dur");
+      writer.Int64(event.duration_us);
+      writer.Key("pid");
+      writer.Int(1);
+      writer.Key("tid");
+      writer.Int(buffer->thread_id);
+      writer.Key("args");
+      writer.StartObject();
+      if (event.asset[0] != '\0') {
+        writer.Key("asset");
+        writer.String(event.asset);
+      }
+      writer.Key("bytes_in");
+      writer.Uint64(event.bytes_in);
+      writer.Key("bytes_out");
+      writer.Uint64(event.bytes_out);
+      writer.EndObject();
+      writer.EndObject();
+    }
+  }
+  writer.EndArray();
+  writer.EndObject();
+
+  if (lost_events != 0) {
+    std::cerr << "Warning: trace buffers overflowed, " << lost_events
+              << " oldest events lost" << std::endl;
+  }
+  return file.good();
+}
+
+TraceScope::TraceScope(const char* name)
+    : active_(Trace::IsEnabled()) {
+  if (active_) {
+    event_.name = name;
+    event_.asset[0] = '\0';
+    event_.bytes_in = 0;
+    event_.bytes_out = 0;
+    event_.start_us = Trace::NowUs();
+  }
+}
+
+TraceScope::TraceScope(const char* name, const std::filesystem::path& asset)
+    : active_(Trace::IsEnabled()) {
+  if (active_) {
+    event_.name = name;
+    /// only name, full path is too long for trace viewers
+    auto filename = asset.filename().string();
+    std::size_t length = std::min(filename.size(), TraceEvent::kMaxAssetLength);
+    std::memcpy(event_.asset, filename.data(), length);
+    event_.asset[length] = '\0';
+    event_.bytes_in = 0;
+    event_.bytes_out = 0;
+    event_.start_us = Trace::NowUs();
+  }
+}
+
+void TraceScope::SetBytesInFromFile(const std::filesystem::path& path) {
+  if (active_) {
+    std::error_code error;
+    auto file_size = std::filesystem::file_size(path, error);
+    event_.bytes_in = error ? 0 : file_size;
+  }
+}
+
+void TraceScope::SetBytesOutFromFile(const std::filesystem::path& path) {
+  if (active_) {
+    std::error_code error;
+    auto file_size = std::filesystem::file_size(path, error);
+    event_.bytes_out = error ? 0 : file_size;
+  }
+}
+
+void TraceScope::End() {
+  if (active_) {
+    event_.duration_us = Trace::NowUs() - event_.start_us;
+    Trace::Record(event_);
+    active_ = false;
+  }
+}
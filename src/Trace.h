@@ -0,0 +1,94 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_TRACE_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+
+/// Scoped trace markers written as Chrome trace-event json (--trace out.json),
+/// can be opened by chrome://tracing or ui.perfetto.dev
+
+/// each thread records into its own fixed-size ring buffer (no locks, except
+/// the first event of a thread), so when it's full the oldest events are lost;
+/// buffers are kept until Write(), so it's safe to record from pool workers
+/// which are joined by AssetLoadingThreadPool::Stop()
+
+/// name must be a string literal, asset is truncated
+struct TraceEvent {
+  static constexpr std::size_t kMaxAssetLength = 63;
+  const char* name;
+  char asset[kMaxAssetLength + 1];
+  int64_t start_us;
+  int64_t duration_us;
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+};
+
+/// when disabled TraceScope costs one relaxed atomic load and a branch
+class Trace {
+ public:
+  /// should be called from the main thread before any work
+  /// (so its events are on the first track)
+  static void Enable();
+
+  static bool IsEnabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /// all recording threads must be finished (or at least idle);
+  /// returns false if file can't be written
+  static bool Write(const std::filesystem::path& path);
+
+ private:
+  friend class TraceScope;
+
+  static void Record(const TraceEvent& event);
+
+  static int64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  static std::atomic<bool> enabled_;
+};
+
+/// records the time between ctor and dtor as one complete ("X") event
+class TraceScope {
+ public:
+  explicit TraceScope(const char* name);
+  TraceScope(const char* name, const std::filesystem::path& asset);
+
+  ~TraceScope() {
+    if (active_) {
+      End();
+    }
+  }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+  bool IsActive() const {
+    return active_;
+  }
+
+  /// records event earlier than dtor (e.g. when scope is a whole function)
+  void End();
+
+  void SetBytesIn(uint64_t bytes) {
+    event_.bytes_in = bytes;
+  }
+  void SetBytesOut(uint64_t bytes) {
+    event_.bytes_out = bytes;
+  }
+
+  /// file size (0 if it doesn't exist), queried only when tracing is enabled
+  void SetBytesInFromFile(const std::filesystem::path& path);
+  void SetBytesOutFromFile(const std::filesystem::path& path);
+
+ private:
+  TraceEvent event_;
+  bool active_;
+};
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_TRACE_H
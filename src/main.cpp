@@ -11,120 +11,228 @@
  * */
 
 #include <algorithm>
-#include <fstream>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
-#include <set>
-#include <sstream>
+#include <string_view>
+#include <vector>
 
 #include "AssetProcessor.h"
+#include "AssetsInfo.h"
+#include "CpuTopology.h"
+#include "RunReport.h"
+#include "ShardMerger.h"
+#include "Trace.h"
 #include "../config/AssetFormats.h"
 
-/// by default all assets have such info: id;name;
-/// except models: id;name;type;sound_ids;
-void UpdateAssetsInfo(const std::filesystem::path& path,
-                      bool is_models_dir = false) {
-  if (!std::filesystem::exists(path)) {
-    return;
-  }
-  std::filesystem::path assets_info_path{path / "info.txt"};
-  std::set<std::string> all_assets;
-  for (auto&& entry : std::filesystem::directory_iterator(path)) {
-    if (entry.is_regular_file()) {
-      if (is_models_dir) {
-        if (entry.path().extension() != ".gltf") {
-          continue;
-        }
-      }
-      all_assets.insert(entry.path().filename().string());
-    }
-  }
-  int last_id{0};
-  std::ofstream new_info_file;
-  std::vector<std::string> new_assets;
-  if (std::filesystem::exists(assets_info_path)) {
-    std::set<std::string> old_assets;
-    std::ifstream old_info_file(assets_info_path.c_str());
-    std::string line;
-    std::string field;
-    while (std::getline(old_info_file, line)) {
-      std::stringstream line_stream{line};
-      std::getline(line_stream, field, ';');
-      last_id = std::max(last_id, std::stoi(field));
-      std::getline(line_stream, field, ';');
-      old_assets.insert(field);
-    }
-    std::set_difference(all_assets.begin(), all_assets.end(),
-                        old_assets.begin(), old_assets.end(),
-                        std::back_inserter(new_assets));
-    if (new_assets.empty()) {
-      return;
-    }
-    new_info_file.open(assets_info_path.c_str(), std::ios::app);
-  } else {
-    new_info_file.open(assets_info_path.c_str());
-    std::move(all_assets.begin(), all_assets.end(), std::back_inserter(new_assets));
-  }
-  for (const auto& asset : new_assets) {
-    std::string new_entry;
-    new_entry += std::to_string(++last_id);
-    new_entry += ';';
-    new_entry += asset;
-    new_entry += ';';
-    if (is_models_dir) {
-      /// type & sounds_id should be added by user manually
-      new_entry += ";;";
-    }
-    new_entry += '\n';
-    new_info_file.write(new_entry.data(), static_cast<long>(new_entry.size()));
-  }
+void PrintUsage() {
+  std::cout << "Incorrect program's arguments!"
+            << "\nfor encode: <destination> <source> e [options]"
+            << "\nfor decode: <destination> <source> d [options]"
+            << "\nfor encode with verification: <destination> <source> v [options]"
+            << "\nfor merge of shard outputs: <destination> <shards_root> m"
+            << "\noptions:"
+            << "\n  --auto-block  choose ASTC block size per texture"
+            << "\n  --atlas  pack small font/ui textures into atlases"
+            << "\n  --virtual-maps  write map_ textures as tiled virtual textures"
+            << "\n  --font-sdf <max_size>  write font_ textures as distance fields"
+            << "\n  --png-level <0-9>  zlib level of decoded png (0 - store only)"
+            << "\n  --trace <out.json>  write per-stage Chrome trace events"
+            << "\n  --report <out.json>  write run summary (sizes, times, memory)"
+            << "\n  --threads <N>  thread count (by default all usable cpus)"
+            << "\n  --pin  bind each thread to its own cpu"
+            << "\n  --pin-physical  the same, but skip SMT siblings"
+            << "\n  --shard <i/N>  process only i-th of N parts of source"
+            << "\n  --resume  continue interrupted run (skip completed assets)"
+            << "\n  --profile <name:block:quality[:max_size]>  encode textures"
+            << "\n      into <destination>/<name> (repeatable), block is WxH"
+            << "\n      or default, e.g. --profile mobile:6x6:60:1024"
+            << std::endl;
 }
 
 int main(int argc, char** argv) {
   static_assert(sizeof(float) == 4); // (need for hdr files) just in case ;)
 
-  if (argc != 4) {
-    std::cout << "Incorrect program's arguments!"
-              << "\nfor encode: <destination> <source> e"
-              << "\nfor decode: <destination> <source> d"
-              << std::endl;
+  if (argc < 4) {
+    PrintUsage();
     return 1;
   }
   std::filesystem::path destination{argv[1]};
   std::filesystem::path source{argv[2]};
+  if (destination == source) {
+    std::cerr << "source can't be equal to destination" << std::endl;
+    return 3;
+  }
+
+  if (argv[3][0] == 'm') {
+    if (argc != 4) {
+      PrintUsage();
+      return 2;
+    }
+    try {
+      return ShardMerger(destination).Merge(source) ? 0 : 6;
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return 4;
+    }
+  }
+
   bool encode;
+  bool verify = false;
   if (argv[3][0] == 'e') {
     encode = true;
   } else if (argv[3][0] == 'd') {
     encode = false;
+  } else if (argv[3][0] == 'v') {
+    encode = true;
+    verify = true;
   } else {
-    std::cout << "Incorrect program's arguments!"
-              << "\nfor encode: <destination> <source> e"
-              << "\nfor decode: <destination> <source> d"
-              << std::endl;
+    PrintUsage();
     return 2;
   }
 
-  if (destination == source) {
-    std::cerr << "source can't be equal to destination" << std::endl;
-    return 3;
+  bool auto_block_size = false;
+  bool atlas = false;
+  bool virtual_maps = false;
+  int font_sdf_size = 0;
+  int png_level = faithful::config::kPngCompLevel;
+  std::filesystem::path trace_path;
+  std::filesystem::path report_path;
+  int thread_count = 0;
+  ThreadPinning pinning = ThreadPinning::kNone;
+  int shard_index = 0;
+  int shard_count = 1;
+  bool resume = false;
+  std::vector<TextureProcessor::EncodeProfile> profiles;
+  for (int i = 4; i < argc; ++i) {
+    std::string_view option{argv[i]};
+    if (option == "--auto-block") {
+      auto_block_size = true;
+    } else if (option == "--atlas") {
+      atlas = true;
+    } else if (option == "--virtual-maps") {
+      virtual_maps = true;
+    } else if (option == "--font-sdf" && i + 1 < argc) {
+      font_sdf_size = std::max(1, std::atoi(argv[++i]));
+    } else if (option == "--png-level" && i + 1 < argc) {
+      png_level = std::clamp(std::atoi(argv[++i]), 0, 9);
+    } else if (option == "--trace" && i + 1 < argc) {
+      trace_path = argv[++i];
+    } else if (option == "--report" && i + 1 < argc) {
+      report_path = argv[++i];
+    } else if (option == "--threads" && i + 1 < argc) {
+      thread_count = std::max(1, std::atoi(argv[++i]));
+    } else if (option == "--pin") {
+      pinning = ThreadPinning::kCores;
+    } else if (option == "--pin-physical") {
+      pinning = ThreadPinning::kPhysicalCores;
+    } else if (option == "--resume") {
+      resume = true;
+    } else if (option == "--shard" && i + 1 < argc) {
+      if (std::sscanf(argv[++i], "%d/%d", &shard_index, &shard_count) != 2 ||
+          shard_index < 0 || shard_index >= shard_count) {
+        std::cerr << "Incorrect shard: " << argv[i] << std::endl;
+        PrintUsage();
+        return 2;
+      }
+    } else if (option == "--profile" && i + 1 < argc) {
+      TextureProcessor::EncodeProfile profile;
+      if (!TextureProcessor::ParseProfile(argv[++i], profile) ||
+          std::any_of(profiles.begin(), profiles.end(),
+                      [&](const auto& other) {
+                        return other.name == profile.name;
+                      })) {
+        std::cerr << "Incorrect profile: " << argv[i] << std::endl;
+        PrintUsage();
+        return 2;
+      }
+      profiles.push_back(std::move(profile));
+    } else {
+      std::cerr << "Unknown option: " << option << std::endl;
+      PrintUsage();
+      return 2;
+    }
+  }
+
+  /// every shard would write its own atlas with the same name
+  if (atlas && shard_count > 1) {
+    std::cerr << "--atlas can't be combined with --shard" << std::endl;
+    return 2;
+  }
+  /// atlas pages would need their own packing per max size
+  if (atlas && !profiles.empty()) {
+    std::cerr << "--atlas can't be combined with --profile" << std::endl;
+    return 2;
+  }
+
+  if (!trace_path.empty()) {
+    Trace::Enable();
+  }
+  if (!report_path.empty()) {
+    RunReport::Enable();
+  }
+
+  /// cpus from affinity mask, limited by cgroup quota
+  if (thread_count == 0) {
+    const auto& topology = CpuTopology::Get();
+    thread_count = pinning == ThreadPinning::kPhysicalCores
+                       ? topology.GetUsableCoreCount()
+                       : topology.GetUsableCpuCount();
   }
 
-  AssetProcessor processor_encoder(faithful::config::kMaxHardwareThread);
+  AssetProcessor processor_encoder(thread_count, pinning);
+  processor_encoder.SetAutoBlockSize(auto_block_size);
+  processor_encoder.SetAtlas(atlas);
+  processor_encoder.SetVirtualMaps(virtual_maps);
+  processor_encoder.SetFontSdf(font_sdf_size);
+  processor_encoder.SetPngLevel(png_level);
+  processor_encoder.SetVerify(verify);
+  processor_encoder.SetShard(shard_index, shard_count);
+  processor_encoder.SetResume(resume);
+  processor_encoder.SetProfiles(profiles);
+  bool process_failed = false;
   try {
     processor_encoder.Process(destination, source, encode);
   } catch (const std::exception& e) {
     std::cerr << e.what() << std::endl;
+    process_failed = true;
+  }
+
+  /// even for failed run, it's when trace is needed the most
+  if (!trace_path.empty()) {
+    Trace::Write(trace_path);
+  }
+  if (!report_path.empty()) {
+    RunReport::Write(report_path, encode);
+  }
+  if (process_failed) {
     return 4;
   }
 
-  UpdateAssetsInfo(destination / "music");
-  UpdateAssetsInfo(destination / "sounds");
-  UpdateAssetsInfo(destination / "maps");
-  UpdateAssetsInfo(destination / "noises");
-  UpdateAssetsInfo(destination);
+  /// shards don't assign ids, it's done once by merge
+  if (shard_count == 1) {
+    for (auto dir : kAssetsInfoDirs) {
+      UpdateAssetsInfo(destination / dir);
+    }
+    /// models has slightly different file
+    UpdateAssetsInfo(destination / kAssetsInfoModelsDir, true);
+    /// the same texture directories inside of each profile
+    for (const auto& profile : profiles) {
+      for (auto dir : kAssetsInfoDirs) {
+        if (std::filesystem::is_directory(destination / profile.name / dir)) {
+          UpdateAssetsInfo(destination / profile.name / dir);
+        }
+      }
+    }
+  }
 
-  /// models has slightly different file
-  UpdateAssetsInfo(destination / "models", true);
+  if (verify) {
+    auto report_path = destination / faithful::config::kTexVerifyReportName;
+    if (!processor_encoder.WriteVerifyReport(report_path)) {
+      std::cerr << "Verification failed, see " << report_path << std::endl;
+      return 5;
+    }
+  }
 
   return 0;
 }
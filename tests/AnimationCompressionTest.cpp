@@ -0,0 +1,133 @@
+#include "../src/AnimationCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "../config/AssetFormats.h"
+#include "Check.h"
+
+namespace {
+
+constexpr float kTolerance = 0.001f;
+
+AnimationTrack MakeTrack(AnimationPath path, int components, bool step,
+                         std::size_t key_count) {
+  AnimationTrack track{path, components, step, {}, {}};
+  for (std::size_t key = 0; key < key_count; ++key) {
+    track.times.push_back(static_cast<float>(key) / 30.0f);
+  }
+  return track;
+}
+
+/// linear interpolation of the result at time, for 1-component tracks
+float Evaluate(const AnimationTrack& track, float time) {
+  auto next = std::upper_bound(track.times.begin(), track.times.end(), time);
+  if (next == track.times.begin()) {
+    return track.values.front();
+  }
+  if (next == track.times.end()) {
+    return track.values.back();
+  }
+  auto i = static_cast<std::size_t>(next - track.times.begin()) - 1;
+  if (track.step) {
+    return track.values[i];
+  }
+  float t = (time - track.times[i]) / (track.times[i + 1] - track.times[i]);
+  return track.values[i] + (track.values[i + 1] - track.values[i]) * t;
+}
+
+void TestQuantizeSnorm16() {
+  CHECK(QuantizeSnorm16(1.0f) == 32767);
+  CHECK(QuantizeSnorm16(-1.0f) == -32767);
+  CHECK(QuantizeSnorm16(0.0f) == 0);
+  CHECK(QuantizeSnorm16(2.0f) == 32767);
+  CHECK(DequantizeSnorm16(32767) == 1.0f);
+  CHECK(DequantizeSnorm16(-32768) == -1.0f);
+  CHECK(std::abs(DequantizeSnorm16(QuantizeSnorm16(0.3f)) - 0.3f) <
+        1.0f / 32767);
+}
+
+void TestConstant() {
+  auto track = MakeTrack(AnimationPath::kScale, 3, false, 4);
+  track.values = {1, 2, 3, 1, 2, 3, 1, 2, 3.0001f, 1, 2, 3};
+  auto end_time = track.times.back();
+  auto stats = CompressTrack(track, kTolerance);
+  CHECK(stats.keys_before == 4 && stats.keys_after == 2);
+  /// the clip keeps its length
+  CHECK((track.times == std::vector<float>{0.0f, end_time}));
+  CHECK((track.values == std::vector<float>{1, 2, 3, 1, 2, 3}));
+  CHECK(stats.max_error <= kTolerance);
+}
+
+void TestLinear() {
+  /// a line is reduced to its ends, but segments are capped
+  auto track = MakeTrack(AnimationPath::kWeights, 1, false, 1000);
+  for (float time : track.times) {
+    track.values.push_back(time * 0.01f);
+  }
+  auto source = track;
+  auto stats = CompressTrack(track, kTolerance);
+  constexpr auto kMaxSegmentKeys = faithful::config::kModelAnimMaxSegmentKeys;
+  CHECK(stats.keys_after ==
+        (source.times.size() - 1 + kMaxSegmentKeys - 2) /
+                (kMaxSegmentKeys - 1) + 1);
+  CHECK(track.times.front() == source.times.front());
+  CHECK(track.times.back() == source.times.back());
+
+  /// a curve keeps more keys, every source key is within tolerance
+  track = MakeTrack(AnimationPath::kWeights, 1, false, 300);
+  for (float time : track.times) {
+    track.values.push_back(std::sin(time * 3.0f));
+  }
+  source = track;
+  stats = CompressTrack(track, kTolerance);
+  CHECK(stats.keys_after > 2 && stats.keys_after < stats.keys_before);
+  CHECK(stats.max_error <= kTolerance);
+  for (std::size_t key = 0; key < source.times.size(); ++key) {
+    CHECK(std::abs(Evaluate(track, source.times[key]) - source.values[key]) <=
+          kTolerance * 1.0001f);
+  }
+}
+
+void TestStep() {
+  auto track = MakeTrack(AnimationPath::kWeights, 1, true, 9);
+  track.values = {0, 0, 0, 1, 1, 1, 1, 0, 0};
+  auto source = track;
+  auto stats = CompressTrack(track, kTolerance);
+  /// changes at 3 & 7 and the last key
+  CHECK(stats.keys_after == 4);
+  CHECK(stats.max_error == 0.0f);
+  for (std::size_t key = 0; key < source.times.size(); ++key) {
+    CHECK(Evaluate(track, source.times[key]) == source.values[key]);
+  }
+}
+
+void TestRotation() {
+  /// half a turn around z at constant speed: slerp of the ends reproduces
+  /// it, apart from quantization
+  auto track = MakeTrack(AnimationPath::kRotation, 4, false, 60);
+  for (std::size_t key = 0; key < track.times.size(); ++key) {
+    float angle = 3.0f * static_cast<float>(key) / 59.0f;
+    track.values.insert(track.values.end(),
+                        {0.0f, 0.0f, std::sin(angle / 2), std::cos(angle / 2)});
+  }
+  auto stats = CompressTrack(track, kTolerance);
+  CHECK(stats.keys_after == 2);
+  CHECK(stats.max_error <= kTolerance);
+  /// stored as normalized shorts
+  for (float value : track.values) {
+    CHECK(DequantizeSnorm16(QuantizeSnorm16(value)) == value);
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestQuantizeSnorm16();
+  TestConstant();
+  TestLinear();
+  TestStep();
+  TestRotation();
+  return TestResult();
+}
@@ -0,0 +1,92 @@
+#include "../src/AtlasPacker.h"
+
+#include <vector>
+
+#include "Check.h"
+
+namespace {
+
+bool Overlap(const AtlasPacker::Rect& lhs_rect,
+             const AtlasPacker::Placement& lhs,
+             const AtlasPacker::Rect& rhs_rect,
+             const AtlasPacker::Placement& rhs) {
+  return lhs.page == rhs.page &&
+         lhs.x < rhs.x + rhs_rect.width && rhs.x < lhs.x + lhs_rect.width &&
+         lhs.y < rhs.y + rhs_rect.height && rhs.y < lhs.y + lhs_rect.height;
+}
+
+void TestPlacements() {
+  std::vector<AtlasPacker::Rect> rects{
+      {30, 20}, {64, 64}, {8, 8}, {17, 40}, {100, 3}, {5, 5}, {64, 64}};
+  AtlasPacker packer(4, 32, 128);
+  auto result = packer.Pack(rects);
+
+  CHECK(result.placements.size() == rects.size());
+  for (int page_size : result.page_sizes) {
+    CHECK(page_size >= 32 && page_size <= 128);
+    CHECK((page_size & (page_size - 1)) == 0);
+  }
+  for (std::size_t i = 0; i < rects.size(); ++i) {
+    const auto& placement = result.placements[i];
+    CHECK(placement.page >= 0 &&
+          placement.page < static_cast<int>(result.page_sizes.size()));
+    if (placement.page < 0) {
+      continue;
+    }
+    int page_size = result.page_sizes[placement.page];
+    CHECK(placement.x % 4 == 0 && placement.y % 4 == 0);
+    CHECK(placement.x + rects[i].width <= page_size);
+    CHECK(placement.y + rects[i].height <= page_size);
+    /// padded to alignment, so neighbours don't share a block either
+    AtlasPacker::Rect aligned{(rects[i].width + 3) / 4 * 4,
+                              (rects[i].height + 3) / 4 * 4};
+    for (std::size_t j = i + 1; j < rects.size(); ++j) {
+      AtlasPacker::Rect other{(rects[j].width + 3) / 4 * 4,
+                              (rects[j].height + 3) / 4 * 4};
+      CHECK(!Overlap(aligned, placement, other, result.placements[j]));
+    }
+  }
+
+  /// same input - same output
+  auto again = packer.Pack(rects);
+  CHECK(again.page_sizes == result.page_sizes);
+  for (std::size_t i = 0; i < rects.size(); ++i) {
+    CHECK(again.placements[i].page == result.placements[i].page);
+    CHECK(again.placements[i].x == result.placements[i].x);
+    CHECK(again.placements[i].y == result.placements[i].y);
+  }
+}
+
+void TestPageGrowth() {
+  AtlasPacker packer(4, 32, 64);
+
+  /// fits the min page
+  auto small = packer.Pack({{16, 16}, {16, 16}});
+  CHECK(small.page_sizes == std::vector<int>{32});
+
+  /// doesn't fit 32x32, fits 64x64
+  auto grown = packer.Pack({{32, 32}, {32, 32}});
+  CHECK(grown.page_sizes == std::vector<int>{64});
+
+  /// doesn't fit the max page, so the rest goes to the next one
+  auto split = packer.Pack({{64, 64}, {64, 64}});
+  CHECK(split.page_sizes.size() == 2);
+  CHECK(split.placements[0].page != split.placements[1].page);
+}
+
+void TestTooLarge() {
+  AtlasPacker packer(4, 32, 64);
+  auto result = packer.Pack({{65, 8}, {8, 8}});
+  CHECK(result.placements[0].page == -1);
+  CHECK(result.placements[1].page == 0);
+  CHECK(result.page_sizes.size() == 1);
+}
+
+}  // namespace
+
+int main() {
+  TestPlacements();
+  TestPageGrowth();
+  TestTooLarge();
+  return TestResult();
+}
@@ -0,0 +1,84 @@
+#include "../src/AtomicFile.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include "Check.h"
+
+namespace {
+
+void Touch(const std::filesystem::path& path) {
+  std::ofstream(path) << "data";
+}
+
+void TestIsTempPath() {
+  CHECK(AtomicFile::IsTempPath("dir/.texture.astc.0.part"));
+  CHECK(AtomicFile::IsTempPath(".a.123.part"));
+  /// not hidden, no id, empty filename or non-numeric id
+  CHECK(!AtomicFile::IsTempPath("texture.astc.0.part"));
+  CHECK(!AtomicFile::IsTempPath(".texture.part"));
+  CHECK(!AtomicFile::IsTempPath("..0.part"));
+  CHECK(!AtomicFile::IsTempPath(".texture.astc..part"));
+  CHECK(!AtomicFile::IsTempPath(".texture.astc.1a.part"));
+  CHECK(!AtomicFile::IsTempPath("notes.part"));
+  CHECK(!AtomicFile::IsTempPath(".texture.astc.0.part.txt"));
+}
+
+void TestCommit(const std::filesystem::path& dir) {
+  auto path = dir / "asset.bin";
+  {
+    AtomicFile file(path);
+    CHECK(file.GetTempPath().parent_path() == dir);
+    CHECK(AtomicFile::IsTempPath(file.GetTempPath()));
+    Touch(file.GetTempPath());
+    CHECK(!std::filesystem::exists(path));
+    CHECK(file.Commit());
+    CHECK(!std::filesystem::exists(file.GetTempPath()));
+  }
+  CHECK(std::filesystem::exists(path));
+
+  /// not committed - removed, the final file is untouched
+  std::filesystem::path temp_path;
+  {
+    AtomicFile file(dir / "other.bin");
+    temp_path = file.GetTempPath();
+    Touch(temp_path);
+  }
+  CHECK(!std::filesystem::exists(temp_path));
+  CHECK(!std::filesystem::exists(dir / "other.bin"));
+}
+
+void TestRemoveStaleTempFiles(const std::filesystem::path& dir) {
+  std::filesystem::create_directories(dir / "textures");
+  std::filesystem::create_directories(dir / "models" / ".model.part");
+  Touch(dir / ".music.ogg.3.part");
+  Touch(dir / "textures" / ".a.astc.17.part");
+  Touch(dir / "models" / ".model.part" / "model.gltf");
+  Touch(dir / "notes.part");
+  Touch(dir / ".journal");
+
+  AtomicFile::RemoveStaleTempFiles(dir);
+
+  CHECK(!std::filesystem::exists(dir / ".music.ogg.3.part"));
+  CHECK(!std::filesystem::exists(dir / "textures" / ".a.astc.17.part"));
+  CHECK(std::filesystem::exists(dir / "models" / ".model.part" /
+                                "model.gltf"));
+  CHECK(std::filesystem::exists(dir / "notes.part"));
+  CHECK(std::filesystem::exists(dir / ".journal"));
+}
+
+}  // namespace
+
+int main() {
+  auto dir = std::filesystem::temp_directory_path() /
+             "faithful_atomic_file_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  TestIsTempPath();
+  TestCommit(dir);
+  TestRemoveStaleTempFiles(dir);
+
+  std::filesystem::remove_all(dir);
+  return TestResult();
+}
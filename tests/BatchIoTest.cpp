@@ -0,0 +1,65 @@
+#include "../src/BatchIo.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../src/AssetLoadingThreadPool.h"
+#include "Check.h"
+
+namespace {
+
+std::string ReadFile(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file),
+          std::istreambuf_iterator<char>()};
+}
+
+void TestStat(BatchIo& batch_io, const std::filesystem::path& dir) {
+  std::ofstream(dir / "a.bin", std::ios::binary) << "12345";
+  auto stats = batch_io.Stat({dir / "a.bin", dir / "missing.bin"});
+  CHECK(stats.size() == 2);
+  CHECK(stats[0].exists && stats[0].size == 5);
+  CHECK(!stats[1].exists);
+}
+
+void TestCopy(BatchIo& batch_io, const std::filesystem::path& dir) {
+  /// empty, smaller and larger than one chunk (kIoCopyChunkSize)
+  std::vector<std::string> contents{"", "small",
+                                    std::string(3 * 1024 * 1024 + 7, 'x')};
+  std::vector<BatchIo::CopyRequest> requests;
+  for (std::size_t i = 0; i < contents.size(); ++i) {
+    auto from = dir / ("from_" + std::to_string(i));
+    std::ofstream(from, std::ios::binary) << contents[i];
+    requests.push_back({from, dir / ("to_" + std::to_string(i))});
+  }
+  requests.push_back({dir / "missing.bin", dir / "to_missing"});
+
+  auto errors = batch_io.Copy(requests);
+  CHECK(errors.size() == requests.size());
+  for (std::size_t i = 0; i < contents.size(); ++i) {
+    CHECK(!errors[i]);
+    CHECK(ReadFile(requests[i].to) == contents[i]);
+  }
+  CHECK(errors.back());
+}
+
+}  // namespace
+
+int main() {
+  auto dir = std::filesystem::temp_directory_path() / "faithful_batch_io_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  AssetLoadingThreadPool thread_pool(2);
+  BatchIo batch_io(thread_pool);
+  thread_pool.Run();
+  TestStat(batch_io, dir);
+  TestCopy(batch_io, dir);
+  thread_pool.Stop();
+
+  std::filesystem::remove_all(dir);
+  return TestResult();
+}
@@ -0,0 +1,28 @@
+#ifndef FAITHFUL_UTILS_ASSETPROCESSOR_TESTS_CHECK_H
+#define FAITHFUL_UTILS_ASSETPROCESSOR_TESTS_CHECK_H
+
+#include <cstdlib>
+#include <iostream>
+
+/// failed CHECK() is reported and the test goes on, so one run shows all
+/// failures; main() returns TestResult()
+
+inline int& FailedChecks() {
+  static int failed_checks = 0;
+  return failed_checks;
+}
+
+#define CHECK(condition)                                              \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition \
+                << ") failed" << std::endl;                           \
+      ++FailedChecks();                                               \
+    }                                                                 \
+  } while (false)
+
+inline int TestResult() {
+  return FailedChecks() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif  // FAITHFUL_UTILS_ASSETPROCESSOR_TESTS_CHECK_H
@@ -0,0 +1,79 @@
+#include "../src/DistanceField.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Check.h"
+
+namespace {
+
+constexpr float kCap = 1e6f;
+
+/// random features, the 2d transform as TextureProcessor does it
+/// (all columns, then all rows), compared with brute force
+void TestRandomGrid(int width, int height, uint32_t seed) {
+  std::vector<float> grid(static_cast<std::size_t>(width) * height);
+  std::vector<std::pair<int, int>> features;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      seed = seed * 1664525 + 1013904223;
+      bool feature = (seed >> 24) < 8;
+      grid[static_cast<std::size_t>(y) * width + x] = feature ? 0.0f : kCap;
+      if (feature) {
+        features.push_back({x, y});
+      }
+    }
+  }
+  if (features.empty()) {
+    grid[0] = 0.0f;
+    features.push_back({0, 0});
+  }
+
+  DistanceScratch scratch(static_cast<std::size_t>(std::max(width, height)));
+  for (int x = 0; x < width; ++x) {
+    SquaredDistanceLine(grid.data() + x, width, height, scratch);
+  }
+  for (int y = 0; y < height; ++y) {
+    SquaredDistanceLine(grid.data() + static_cast<std::size_t>(y) * width, 1,
+                        width, scratch);
+  }
+
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      int expected = width * width + height * height;
+      for (auto [feature_x, feature_y] : features) {
+        int dx = x - feature_x;
+        int dy = y - feature_y;
+        expected = std::min(expected, dx * dx + dy * dy);
+      }
+      CHECK(grid[static_cast<std::size_t>(y) * width + x] ==
+            static_cast<float>(expected));
+    }
+  }
+}
+
+void TestLine() {
+  /// feature at 2 and 7: 4 1 0 1 4 4 1 0 1
+  std::vector<float> line{kCap, kCap, 0.0f, kCap, kCap,
+                          kCap, kCap, 0.0f, kCap};
+  DistanceScratch scratch(line.size());
+  SquaredDistanceLine(line.data(), 1, static_cast<int>(line.size()), scratch);
+  CHECK((line == std::vector<float>{4, 1, 0, 1, 4, 4, 1, 0, 1}));
+
+  /// no features - everything stays at least cap
+  std::vector<float> empty(5, kCap);
+  SquaredDistanceLine(empty.data(), 1, 5, scratch);
+  CHECK(std::all_of(empty.begin(), empty.end(),
+                    [](float value) { return value >= kCap; }));
+}
+
+}  // namespace
+
+int main() {
+  TestLine();
+  TestRandomGrid(1, 1, 1);
+  TestRandomGrid(37, 23, 7);
+  TestRandomGrid(64, 64, 12345);
+  return TestResult();
+}
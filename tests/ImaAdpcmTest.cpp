@@ -0,0 +1,169 @@
+#include "../src/ImaAdpcm.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <vector>
+
+#include "Check.h"
+
+namespace {
+
+/// decoder of WAVE_FORMAT_IMA_ADPCM blocks as players do it, written
+/// from the format description, not from the encoder
+constexpr std::array<int, 89> kSteps = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,
+    19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+    337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+    876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+    5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+constexpr std::array<int, 16> kIndexTable = {-1, -1, -1, -1, 2, 4, 6, 8,
+                                             -1, -1, -1, -1, 2, 4, 6, 8};
+
+int DecodeNibble(int nibble, int& predictor, int& index) {
+  int step = kSteps[index];
+  int difference = step >> 3;
+  if (nibble & 4) difference += step;
+  if (nibble & 2) difference += step >> 1;
+  if (nibble & 1) difference += step >> 2;
+  predictor += (nibble & 8) ? -difference : difference;
+  predictor = std::clamp(predictor, -32768, 32767);
+  index = std::clamp(index + kIndexTable[nibble], 0, 88);
+  return predictor;
+}
+
+/// interleaved frames of all blocks (the last one with its padding)
+std::vector<int16_t> Decode(const std::vector<uint8_t>& blocks, int channels,
+                            int block_align) {
+  std::vector<int16_t> frames;
+  std::size_t offset = 0;
+  while (offset < blocks.size()) {
+    std::size_t size =
+        std::min<std::size_t>(block_align, blocks.size() - offset);
+    const uint8_t* block = blocks.data() + offset;
+    std::size_t groups = size / (4 * channels) - 1;
+    std::size_t first = frames.size();
+    frames.resize(first + (1 + groups * 8) * channels);
+    for (int channel = 0; channel < channels; ++channel) {
+      const uint8_t* header = block + channel * 4;
+      int predictor = static_cast<int16_t>(header[0] | (header[1] << 8));
+      int index = header[2];
+      frames[first + channel] = static_cast<int16_t>(predictor);
+      for (std::size_t sample = 0; sample < groups * 8; ++sample) {
+        uint8_t byte = block[4 * channels + (sample / 8) * 4 * channels +
+                             channel * 4 + (sample % 8) / 2];
+        int nibble = sample % 2 == 0 ? byte & 0x0F : byte >> 4;
+        frames[first + (1 + sample) * channels + channel] =
+            static_cast<int16_t>(DecodeNibble(nibble, predictor, index));
+      }
+    }
+    offset += size;
+  }
+  return frames;
+}
+
+/// signal to error ratio (dB) of one channel over frame_count frames
+double SnrDb(const std::vector<int16_t>& source,
+             const std::vector<int16_t>& decoded, int channels, int channel,
+             std::size_t frame_count) {
+  double signal = 0.0;
+  double noise = 0.0;
+  for (std::size_t frame = 0; frame < frame_count; ++frame) {
+    double value = source[frame * channels + channel];
+    double error = value - decoded[frame * channels + channel];
+    signal += value * value;
+    noise += error * error;
+  }
+  return 10.0 * std::log10(signal / std::max(noise, 1.0));
+}
+
+void TestFramesPerBlock() {
+  CHECK(ImaAdpcmFramesPerBlock(512, 1) == 1017);
+  CHECK(ImaAdpcmFramesPerBlock(1024, 2) == 1017);
+  CHECK(ImaAdpcmFramesPerBlock(256, 1) == 505);
+  CHECK(ImaAdpcmFramesPerBlock(2048, 2) == 2041);
+}
+
+/// 3000 frames of mono: 2 full blocks (1017 frames each), the last one
+/// with 966 frames = header + 121 groups of 8 samples
+void TestMonoSine() {
+  constexpr int kBlockAlign = 512;
+  constexpr std::size_t kFrames = 3000;
+  std::vector<int16_t> frames(kFrames);
+  for (std::size_t i = 0; i < kFrames; ++i) {
+    frames[i] = static_cast<int16_t>(
+        std::lround(12000.0 * std::sin(2.0 * std::numbers::pi * 440.0 * i / 44100.0)));
+  }
+  std::vector<uint8_t> blocks =
+      EncodeImaAdpcm(frames.data(), kFrames, 1, kBlockAlign);
+  CHECK(blocks.size() == 2 * kBlockAlign + 4 * (1 + 121));
+
+  std::vector<int16_t> decoded = Decode(blocks, 1, kBlockAlign);
+  CHECK(decoded.size() >= kFrames);
+  if (decoded.size() < kFrames) {
+    return;
+  }
+  /// headers are exact
+  CHECK(decoded[0] == frames[0]);
+  CHECK(decoded[1017] == frames[1017]);
+  CHECK(decoded[2034] == frames[2034]);
+  CHECK(SnrDb(frames, decoded, 1, 0, kFrames) > 30.0);
+  /// padding repeats the last frame
+  CHECK(std::abs(decoded.back() - frames.back()) < 1000);
+}
+
+/// channels are encoded independently: a loud sine on the left, a quiet
+/// one of other frequency on the right
+void TestStereo() {
+  constexpr int kBlockAlign = 1024;
+  constexpr std::size_t kFrames = 5000;
+  std::vector<int16_t> frames(kFrames * 2);
+  for (std::size_t i = 0; i < kFrames; ++i) {
+    frames[i * 2] = static_cast<int16_t>(
+        std::lround(20000.0 * std::sin(2.0 * std::numbers::pi * 220.0 * i / 48000.0)));
+    frames[i * 2 + 1] = static_cast<int16_t>(
+        std::lround(500.0 * std::sin(2.0 * std::numbers::pi * 1000.0 * i / 48000.0)));
+  }
+  std::vector<uint8_t> blocks =
+      EncodeImaAdpcm(frames.data(), kFrames, 2, kBlockAlign);
+  std::vector<int16_t> decoded = Decode(blocks, 2, kBlockAlign);
+  CHECK(decoded.size() >= kFrames * 2);
+  if (decoded.size() < kFrames * 2) {
+    return;
+  }
+  CHECK(decoded[0] == frames[0] && decoded[1] == frames[1]);
+  CHECK(SnrDb(frames, decoded, 2, 0, kFrames) > 30.0);
+  CHECK(SnrDb(frames, decoded, 2, 1, kFrames) > 20.0);
+}
+
+/// the searched step index is the smallest, so silence stays silent
+void TestSilence() {
+  std::vector<int16_t> frames(2000, 0);
+  std::vector<uint8_t> blocks =
+      EncodeImaAdpcm(frames.data(), frames.size(), 1, 512);
+  std::vector<int16_t> decoded = Decode(blocks, 1, 512);
+  CHECK(std::all_of(decoded.begin(), decoded.end(),
+                    [](int16_t sample) { return sample == 0; }));
+  CHECK(blocks.size() > 2 && blocks[2] == 0);
+}
+
+void TestEmpty() {
+  CHECK(EncodeImaAdpcm(nullptr, 0, 2, 1024).empty());
+}
+
+}  // namespace
+
+int main() {
+  TestFramesPerBlock();
+  TestMonoSine();
+  TestStereo();
+  TestSilence();
+  TestEmpty();
+  return TestResult();
+}
@@ -0,0 +1,109 @@
+#include "../src/Loudness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <vector>
+
+#include "Check.h"
+
+namespace {
+
+constexpr uint32_t kSampleRate = 48000;
+
+/// stereo 1 kHz sine, both channels in phase, of peak level_db (dBFS;
+/// -inf - silence)
+struct Segment {
+  double level_db;
+  double seconds;
+};
+
+/// segments are added in chunks of an odd size, so blocks of the meter
+/// don't start at chunk boundaries
+Loudness Measure(const std::vector<Segment>& segments) {
+  constexpr std::size_t kChunk = 4099;
+  LoudnessMeter meter(2, kSampleRate, LoudnessChannelWeights(2, false));
+  std::vector<float> samples;
+  for (const auto& segment : segments) {
+    double amplitude = std::pow(10.0, segment.level_db / 20.0);
+    auto frames = static_cast<std::size_t>(segment.seconds * kSampleRate);
+    for (std::size_t i = 0; i < frames; ++i) {
+      samples.push_back(static_cast<float>(
+          amplitude * std::sin(2.0 * std::numbers::pi * 1000.0 *
+                               samples.size() / kSampleRate)));
+    }
+  }
+  for (std::size_t offset = 0; offset < samples.size(); offset += kChunk) {
+    const float* data = samples.data() + offset;
+    const float* channels[2] = {data, data};
+    meter.Add(channels, std::min(kChunk, samples.size() - offset));
+  }
+  return meter.Result();
+}
+
+bool Near(double value, double expected, double tolerance) {
+  return std::abs(value - expected) <= tolerance;
+}
+
+/// EBU Tech 3341 test cases 1 & 2: -23 and -33 dBFS stereo sine
+void TestConstantSine() {
+  auto loudness = Measure({{-23.0, 20.0}});
+  CHECK(Near(loudness.integrated, -23.0, 0.1));
+  CHECK(Near(loudness.true_peak, -23.0, 0.5));
+  CHECK(Near(loudness.range, 0.0, 0.1));
+
+  CHECK(Near(Measure({{-33.0, 20.0}}).integrated, -33.0, 0.1));
+}
+
+/// EBU Tech 3341 test cases 3 & 5: the absolute gate (-70 LUFS) drops
+/// nothing here, the relative one (-10 LU) drops the quiet parts
+void TestGating() {
+  CHECK(Near(Measure({{-36.0, 10.0}, {-23.0, 60.0}, {-36.0, 10.0}})
+                 .integrated,
+             -23.0, 0.1));
+  CHECK(Near(Measure({{-26.0, 20.0}, {-20.0, 20.1}, {-26.0, 20.0}})
+                 .integrated,
+             -23.0, 0.1));
+}
+
+/// EBU Tech 3342 test case 1: 20 s at -20 dBFS, 20 s at -30 dBFS
+void TestRange() {
+  CHECK(Near(Measure({{-20.0, 20.0}, {-30.0, 20.0}}).range, 10.0, 1.0));
+}
+
+void TestSilence() {
+  auto loudness =
+      Measure({{-std::numeric_limits<double>::infinity(), 2.0}});
+  CHECK(std::isinf(loudness.integrated) && loudness.integrated < 0.0);
+  CHECK(std::isinf(loudness.true_peak) && loudness.true_peak < 0.0);
+  CHECK(loudness.range == 0.0);
+}
+
+/// shorter than one gating block: measured as a whole
+void TestShortSound() {
+  auto loudness = Measure({{-23.0, 0.2}});
+  CHECK(Near(loudness.integrated, -23.0, 0.5));
+  CHECK(loudness.range == 0.0);
+}
+
+void TestChannelWeights() {
+  CHECK(LoudnessChannelWeights(2, false) == std::vector<double>(2, 1.0));
+  auto wav = LoudnessChannelWeights(6, false);
+  CHECK(wav[3] == 0.0 && wav[4] == 1.41 && wav[5] == 1.41);
+  auto vorbis = LoudnessChannelWeights(6, true);
+  CHECK(vorbis[5] == 0.0 && vorbis[3] == 1.41 && vorbis[4] == 1.41);
+}
+
+}  // namespace
+
+int main() {
+  TestConstantSine();
+  TestGating();
+  TestRange();
+  TestSilence();
+  TestShortSound();
+  TestChannelWeights();
+  return TestResult();
+}
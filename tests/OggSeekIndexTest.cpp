@@ -0,0 +1,164 @@
+#include "../src/OggSeekIndex.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "Check.h"
+
+namespace {
+
+constexpr uint32_t kSampleRate = 48000;
+constexpr uint64_t kNoGranule = ~uint64_t{0};
+
+/// ogg stream of hand-made pages: the scan reads only page headers, lacing
+/// values and the identification header, so bodies are zeros and crc
+/// isn't set
+class OggWriter {
+ public:
+  /// offset of the page; lacing values give the packets: < 255 ends one
+  uint64_t Page(uint64_t granule, bool continued,
+                const std::vector<uint8_t>& lacing, uint32_t serial = 1) {
+    uint64_t offset = data_.size();
+    data_.insert(data_.end(), {'O', 'g', 'g', 'S', 0});
+    data_.push_back(continued ? 1 : 0);
+    AppendLe(granule, 8);
+    AppendLe(serial, 4);
+    AppendLe(sequence_++, 4);
+    AppendLe(0, 4);
+    data_.push_back(static_cast<uint8_t>(lacing.size()));
+    data_.insert(data_.end(), lacing.begin(), lacing.end());
+    std::size_t body = 0;
+    for (auto value : lacing) {
+      body += value;
+    }
+    if (offset == 0) {
+      /// 1, "vorbis", version, channels, sample rate
+      const uint8_t identification[] = {1, 'v', 'o', 'r', 'b', 'i', 's',
+                                        0, 0, 0, 0, 2};
+      data_.insert(data_.end(), std::begin(identification),
+                   std::end(identification));
+      AppendLe(kSampleRate, 4);
+      body -= sizeof(identification) + 4;
+    }
+    data_.resize(data_.size() + body, 0);
+    return offset;
+  }
+
+  uint64_t Size() const { return data_.size(); }
+
+  void Write(const std::filesystem::path& path, std::size_t size) const {
+    std::ofstream(path, std::ios::binary)
+        .write(reinterpret_cast<const char*>(data_.data()),
+               static_cast<std::streamsize>(size));
+  }
+
+  void Write(const std::filesystem::path& path) const {
+    Write(path, data_.size());
+  }
+
+ private:
+  void AppendLe(uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+      data_.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+  }
+
+  std::vector<uint8_t> data_;
+  uint32_t sequence_{0};
+};
+
+/// header pages, then 30 pages of 100 ms (one packet each); before the
+/// 11th one a packet starts on its own page, so the 11th is continued
+void WriteTrack(OggWriter& writer, std::vector<uint64_t>& offsets) {
+  writer.Page(0, false, {30});
+  writer.Page(0, false, {40, 200});
+  for (uint64_t page = 0; page < 30; ++page) {
+    if (page == 10) {
+      writer.Page(kNoGranule, false, {255});
+    }
+    uint8_t packet = page == 10 ? 20 : 100;
+    offsets.push_back(writer.Page(4800 * (page + 1), page == 10, {packet}));
+  }
+}
+
+/// 1 s interval: the first audio page, then the first page at >= 1 s
+/// after it which isn't continued
+void TestBuild(const std::filesystem::path& dir) {
+  OggWriter writer;
+  std::vector<uint64_t> offsets;
+  WriteTrack(writer, offsets);
+  auto path = dir / "track.ogg";
+  writer.Write(path);
+
+  OggSeekIndex index;
+  CHECK(BuildOggSeekIndex(path, 1000, index));
+  CHECK(index.sample_rate == kSampleRate);
+  CHECK(index.total_granule == 4800 * 30);
+  CHECK(index.file_size == writer.Size());
+  CHECK(index.entries.size() == 3);
+  if (index.entries.size() == 3) {
+    CHECK(index.entries[0].granule == 4800 &&
+          index.entries[0].offset == offsets[0]);
+    CHECK(index.entries[1].granule == 4800 * 12 &&
+          index.entries[1].offset == offsets[11]);
+    CHECK(index.entries[2].granule == 4800 * 22 &&
+          index.entries[2].offset == offsets[21]);
+  }
+}
+
+void TestErrors(const std::filesystem::path& dir) {
+  OggSeekIndex index;
+  CHECK(!BuildOggSeekIndex(dir / "missing.ogg", 1000, index));
+
+  OggWriter truncated;
+  std::vector<uint64_t> offsets;
+  WriteTrack(truncated, offsets);
+  truncated.Write(dir / "truncated.ogg", truncated.Size() - 10);
+  CHECK(!BuildOggSeekIndex(dir / "truncated.ogg", 1000, index));
+
+  OggWriter chained;
+  chained.Page(0, false, {30});
+  chained.Page(0, false, {40, 200});
+  chained.Page(4800, false, {100}, 2);
+  chained.Write(dir / "chained.ogg");
+  CHECK(!BuildOggSeekIndex(dir / "chained.ogg", 1000, index));
+
+  std::ofstream(dir / "text.ogg") << "not an ogg stream at all, just text";
+  CHECK(!BuildOggSeekIndex(dir / "text.ogg", 1000, index));
+}
+
+void TestSerialize() {
+  OggSeekIndex index;
+  index.sample_rate = kSampleRate;
+  index.total_granule = 0x0102030405060708;
+  index.file_size = 1000;
+  index.entries = {{4800, 3000}, {52800, 9000}};
+  auto data = SerializeOggSeekIndex(index);
+  CHECK(data.size() == 28 + 2 * 16);
+  CHECK(std::memcmp(data.data(), "FSK1", 4) == 0);
+  /// little endian
+  CHECK(data[4] == 0x80 && data[5] == 0xBB && data[6] == 0 && data[7] == 0);
+  CHECK(data[8] == 0x08 && data[15] == 0x01);
+  CHECK(data[16] == 0xE8 && data[17] == 0x03);
+  CHECK(data[24] == 2);
+  CHECK(data[28] == 0xC0 && data[29] == 0x12);
+  CHECK(data[44] == 0x40 && data[45] == 0xCE);
+}
+
+}  // namespace
+
+int main() {
+  auto dir = std::filesystem::temp_directory_path() /
+             "faithful_ogg_seek_index_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+
+  TestBuild(dir);
+  TestErrors(dir);
+  TestSerialize();
+
+  std::filesystem::remove_all(dir);
+  return TestResult();
+}
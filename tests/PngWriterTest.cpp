@@ -0,0 +1,180 @@
+#include "../src/PngWriter.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include <zlib.h>
+
+#include "Check.h"
+
+namespace {
+
+constexpr int kBytesPerPixel = 4;
+
+uint32_t ReadUint32(const uint8_t* in) {
+  return (static_cast<uint32_t>(in[0]) << 24) |
+         (static_cast<uint32_t>(in[1]) << 16) |
+         (static_cast<uint32_t>(in[2]) << 8) | in[3];
+}
+
+/// gradient with noise in the lower half, so rows pick different filters
+std::vector<uint8_t> MakeImage(int width, int height) {
+  std::vector<uint8_t> rgba(static_cast<std::size_t>(width) * height *
+                            kBytesPerPixel);
+  uint32_t seed = 12345;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint8_t* pixel = &rgba[(static_cast<std::size_t>(y) * width + x) *
+                             kBytesPerPixel];
+      seed = seed * 1664525 + 1013904223;
+      uint8_t noise = y < height / 2 ? 0 : static_cast<uint8_t>(seed >> 24);
+      pixel[0] = static_cast<uint8_t>(x + noise);
+      pixel[1] = static_cast<uint8_t>(y);
+      pixel[2] = static_cast<uint8_t>(x ^ y);
+      pixel[3] = static_cast<uint8_t>(255 - noise);
+    }
+  }
+  return rgba;
+}
+
+int Paeth(int a, int b, int c) {
+  int pa = std::abs(b - c);
+  int pb = std::abs(a - c);
+  int pc = std::abs(a + b - 2 * c);
+  return (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+}
+
+/// minimal decoder: checks every chunk crc, inflates concatenated IDAT
+/// (which checks adler32) and reverses filters;
+/// returns empty vector on any error
+std::vector<uint8_t> DecodePng(const std::filesystem::path& path,
+                               int& width, int& height) {
+  std::ifstream file(path, std::ios::binary);
+  std::vector<uint8_t> data{std::istreambuf_iterator<char>(file),
+                            std::istreambuf_iterator<char>()};
+  constexpr uint8_t kSignature[8]{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  if (data.size() < 8 || std::memcmp(data.data(), kSignature, 8) != 0) {
+    return {};
+  }
+  std::vector<uint8_t> idat;
+  bool has_end = false;
+  std::size_t offset = 8;
+  while (offset + 12 <= data.size() && !has_end) {
+    uint32_t length = ReadUint32(&data[offset]);
+    if (offset + 12 + length > data.size()) {
+      return {};
+    }
+    const uint8_t* type = &data[offset + 4];
+    const uint8_t* body = &data[offset + 8];
+    auto crc = crc32(0, type, 4 + length);
+    if (crc != ReadUint32(body + length)) {
+      return {};
+    }
+    if (std::memcmp(type, "IHDR", 4) == 0) {
+      width = static_cast<int>(ReadUint32(body));
+      height = static_cast<int>(ReadUint32(body + 4));
+      if (body[8] != 8 || body[9] != 6) {
+        return {};
+      }
+    } else if (std::memcmp(type, "IDAT", 4) == 0) {
+      idat.insert(idat.end(), body, body + length);
+    } else if (std::memcmp(type, "IEND", 4) == 0) {
+      has_end = true;
+    }
+    offset += 12 + length;
+  }
+  if (!has_end || width <= 0 || height <= 0) {
+    return {};
+  }
+
+  std::size_t stride = static_cast<std::size_t>(width) * kBytesPerPixel;
+  std::vector<uint8_t> filtered((stride + 1) * height);
+  uLongf filtered_size = static_cast<uLongf>(filtered.size());
+  if (uncompress(filtered.data(), &filtered_size, idat.data(),
+                 static_cast<uLong>(idat.size())) != Z_OK ||
+      filtered_size != filtered.size()) {
+    return {};
+  }
+
+  std::vector<uint8_t> rgba(stride * height);
+  std::vector<uint8_t> zero_row(stride, 0);
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* in = &filtered[(stride + 1) * y];
+    uint8_t* row = &rgba[stride * y];
+    const uint8_t* prior = y == 0 ? zero_row.data() : row - stride;
+    for (std::size_t i = 0; i < stride; ++i) {
+      int a = i < kBytesPerPixel ? 0 : row[i - kBytesPerPixel];
+      int b = prior[i];
+      int c = i < kBytesPerPixel ? 0 : prior[i - kBytesPerPixel];
+      int prediction;
+      switch (in[0]) {
+        case 0: prediction = 0; break;
+        case 1: prediction = a; break;
+        case 2: prediction = b; break;
+        case 3: prediction = (a + b) >> 1; break;
+        case 4: prediction = Paeth(a, b, c); break;
+        default: return {};
+      }
+      row[i] = static_cast<uint8_t>(in[1 + i] + prediction);
+    }
+  }
+  return rgba;
+}
+
+void TestRoundTrip(int level, int width, int height, int rows_per_strip) {
+  auto path = std::filesystem::temp_directory_path() /
+              ("faithful_png_writer_test_" + std::to_string(level) + "_" +
+               std::to_string(rows_per_strip) + ".png");
+  auto rgba = MakeImage(width, height);
+  std::size_t stride = static_cast<std::size_t>(width) * kBytesPerPixel;
+
+  PngWriter writer(path, width, height, level);
+  CHECK(writer.IsOpen());
+  std::vector<PngWriter::Strip> strips;
+  for (int y = 0; y < height; y += rows_per_strip) {
+    strips.emplace_back();
+  }
+  /// strips don't depend on each other, so they're encoded backwards
+  /// (as if the later ones were done first by other threads)
+  for (auto i = strips.size(); i-- > 0;) {
+    int first_row = static_cast<int>(i) * rows_per_strip;
+    writer.EncodeStrip(rgba.data() + stride * first_row, first_row,
+                       std::min(rows_per_strip, height - first_row),
+                       strips[i]);
+  }
+  bool written = true;
+  for (const auto& strip : strips) {
+    written &= writer.WriteStrip(strip);
+  }
+  written &= writer.Commit();
+  CHECK(written);
+
+  int decoded_width = 0;
+  int decoded_height = 0;
+  auto decoded = DecodePng(path, decoded_width, decoded_height);
+  CHECK(decoded_width == width && decoded_height == height);
+  CHECK(decoded == rgba);
+  std::filesystem::remove(path);
+}
+
+}  // namespace
+
+int main() {
+  /// adler32 of the stream is combined from all strips; the first row of
+  /// each strip has no prior row
+  for (int level : {0, 1, 6, 9}) {
+    TestRoundTrip(level, 67, 300, 300);
+    TestRoundTrip(level, 67, 300, 128);
+    TestRoundTrip(level, 67, 300, 7);
+    TestRoundTrip(level, 67, 300, 1);
+  }
+  /// one strip, one pixel
+  TestRoundTrip(6, 1, 1, 1);
+  return TestResult();
+}